@@ -433,7 +433,7 @@ static void SaveAudioDevice(const char *name, int channel, obs_data_t *parent,
 
 	audioSources.push_back(source);
 
-	obs_data_t *data = obs_save_source(source);
+	obs_data_t *data = obs_save_source_snapshot(source);
 
 	obs_data_set_obj(parent, name, data);
 
@@ -472,7 +472,7 @@ static obs_data_t *GenerateSaveData(obs_data_array_t *sceneOrder,
 	};
 	using FilterAudioSources_t = decltype(FilterAudioSources);
 
-	obs_data_array_t *sourcesArray = obs_save_sources_filtered(
+	obs_data_array_t *sourcesArray = obs_save_sources_snapshot_filtered(
 		[](void *data, obs_source_t *source) {
 			return (*static_cast<FilterAudioSources_t *>(data))(
 				source);
@@ -483,7 +483,7 @@ static obs_data_t *GenerateSaveData(obs_data_array_t *sceneOrder,
 	/* save group sources separately    */
 
 	/* saving separately ensures they won't be loaded in older versions */
-	obs_data_array_t *groupsArray = obs_save_sources_filtered(
+	obs_data_array_t *groupsArray = obs_save_sources_snapshot_filtered(
 		[](void *, obs_source_t *source) {
 			return obs_source_is_group(source);
 		},
@@ -669,12 +669,32 @@ void OBSBasic::Save(const char *file)
 	if (api) {
 		obs_data_t *moduleObj = obs_data_create();
 		api->on_save(moduleObj);
-		obs_data_set_obj(saveData, "modules", moduleObj);
+
+		/* modules may hand us objects they keep modifying */
+		obs_data_t *moduleCopy =
+			obs_data_create_from_json(obs_data_get_json(moduleObj));
+		obs_data_set_obj(saveData, "modules", moduleCopy);
+		obs_data_release(moduleCopy);
 		obs_data_release(moduleObj);
 	}
 
-	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
-		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	/* the source data are snapshots that the sources never modify, so the
+	 * json can be generated and written on the save thread */
+	{
+		unique_lock<mutex> lock(saveMutex);
+
+		/* never drop pending data of another scene collection */
+		saveCV.wait(lock, [&]() {
+			return !pendingSaveData || pendingSaveFile == file;
+		});
+
+		pendingSaveData = saveData;
+		pendingSaveFile = file;
+
+		if (!saveThread.joinable())
+			saveThread = std::thread([this]() { SaveThread(); });
+		saveCV.notify_all();
+	}
 
 	obs_data_release(saveData);
 	obs_data_array_release(sceneOrder);
@@ -683,6 +703,57 @@ void OBSBasic::Save(const char *file)
 	obs_data_array_release(savedProjectorList);
 }
 
+void OBSBasic::SaveThread()
+{
+	os_set_thread_name("OBSBasic: save thread");
+
+	unique_lock<mutex> lock(saveMutex);
+
+	for (;;) {
+		saveCV.wait(lock, [this]() {
+			return saveThreadExit || !!pendingSaveData;
+		});
+		if (!pendingSaveData)
+			break;
+
+		OBSData data = std::move(pendingSaveData);
+		string file = std::move(pendingSaveFile);
+		pendingSaveData = nullptr;
+		saveWriting = true;
+		saveCV.notify_all();
+		lock.unlock();
+
+		if (!obs_data_save_json_safe(data, file.c_str(), "tmp", "bak"))
+			blog(LOG_ERROR, "Could not save scene data to %s",
+			     file.c_str());
+		data = nullptr;
+
+		lock.lock();
+		saveWriting = false;
+		saveCV.notify_all();
+	}
+}
+
+void OBSBasic::WaitForSave()
+{
+	unique_lock<mutex> lock(saveMutex);
+	saveCV.wait(lock, [this]() { return !pendingSaveData && !saveWriting; });
+}
+
+void OBSBasic::StopSaveThread()
+{
+	if (!saveThread.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(saveMutex);
+		saveThreadExit = true;
+		saveCV.notify_all();
+	}
+
+	saveThread.join();
+}
+
 void OBSBasic::DeferSaveBegin()
 {
 	os_atomic_inc_long(&disableSaving);
@@ -2511,6 +2582,8 @@ OBSBasic::~OBSBasic()
 	/* clear out UI event queue */
 	QApplication::sendPostedEvents(App());
 
+	StopSaveThread();
+
 	if (updateCheckThread && updateCheckThread->isRunning())
 		updateCheckThread->wait();
 
@@ -2638,6 +2711,7 @@ void OBSBasic::SaveProjectNow()
 
 	projectChanged = true;
 	SaveProjectDeferred();
+	WaitForSave();
 }
 
 void OBSBasic::SaveProject()
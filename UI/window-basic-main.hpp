@@ -25,6 +25,9 @@
 #include <obs.hpp>
 #include <vector>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "window-main.hpp"
 #include "window-basic-interaction.hpp"
 #include "window-basic-properties.hpp"
@@ -193,6 +196,14 @@ private:
 	bool loaded = false;
 	long disableSaving = 1;
 	bool projectChanged = false;
+
+	std::thread saveThread;
+	std::mutex saveMutex;
+	std::condition_variable saveCV;
+	OBSData pendingSaveData;
+	std::string pendingSaveFile;
+	bool saveWriting = false;
+	bool saveThreadExit = false;
 	bool previewEnabled = true;
 
 	std::list<const char *> copyStrings;
@@ -309,6 +320,9 @@ private:
 	void UploadLog(const char *subdir, const char *file, const bool crash);
 
 	void Save(const char *file);
+	void SaveThread();
+	void WaitForSave();
+	void StopSaveThread();
 	void Load(const char *file);
 
 	void InitHotkeys();
@@ -92,6 +92,8 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 
 	fps = new QLabel(this);
 	renderTime = new QLabel(this);
+	renderTimeDist = new QLabel(this);
+	tickTimeDist = new QLabel(this);
 	skippedFrames = new QLabel(this);
 	missedFrames = new QLabel(this);
 
@@ -103,6 +105,8 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 
 	newStatBare("FPS", fps, 2);
 	newStat("AverageTimeToRender", renderTime, 2);
+	newStat("RenderTimePercentiles", renderTimeDist, 2);
+	newStat("TickTimePercentiles", tickTimeDist, 2);
 	newStat("MissedFrames", missedFrames, 2);
 	newStat("SkippedFrames", skippedFrames, 2);
 
@@ -372,6 +376,34 @@ void OBSBasicStats::Update()
 
 	/* ------------------ */
 
+	auto setFrameTimeStats = [&](QLabel *label, enum obs_frame_stat stat) {
+		struct obs_frame_time_stats stats;
+		if (!obs_get_frame_time_stats(stat, &stats))
+			return;
+
+		auto ms = [](uint64_t ns) {
+			return QString::number((double)ns / 1000000.0, 'f', 1);
+		};
+
+		label->setText(QString("%1 / %2 / %3 / %4 ms")
+				       .arg(ms(stats.p50_ns), ms(stats.p95_ns),
+					    ms(stats.p99_ns),
+					    ms(stats.max_ns)));
+
+		long double p99 = (long double)stats.p99_ns / 1000000.0l;
+		if (p99 > fpsFrameTime)
+			setThemeID(label, "error");
+		else if (p99 > fpsFrameTime * 0.75l)
+			setThemeID(label, "warning");
+		else
+			setThemeID(label, "");
+	};
+
+	setFrameTimeStats(renderTimeDist, OBS_FRAME_STAT_RENDER);
+	setFrameTimeStats(tickTimeDist, OBS_FRAME_STAT_TICK);
+
+	/* ------------------ */
+
 	video_t *video = obs_get_video();
 	uint32_t total_encoded = video_output_get_total_frames(video);
 	uint32_t total_skipped = video_output_get_skipped_frames(video);
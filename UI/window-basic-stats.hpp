@@ -22,6 +22,8 @@ class OBSBasicStats : public QWidget {
 	QLabel *memUsage = nullptr;
 
 	QLabel *renderTime = nullptr;
+	QLabel *renderTimeDist = nullptr;
+	QLabel *tickTimeDist = nullptr;
 	QLabel *skippedFrames = nullptr;
 	QLabel *missedFrames = nullptr;
 
@@ -17,6 +17,8 @@
 #include "decode.h"
 #include "media.h"
 
+#include <libavutil/imgutils.h>
+
 #if LIBAVCODEC_VERSION_INT > AV_VERSION_INT(58, 4, 100)
 #define USE_NEW_HARDWARE_CODEC_METHOD
 #endif
@@ -208,10 +210,22 @@ void mp_decode_clear_packets(struct mp_decode *d)
 	}
 }
 
+void mp_decode_free_cache(struct mp_decode *d)
+{
+	for (size_t i = 0; i < d->cache.num; i++)
+		av_frame_free(&d->cache.array[i].frame);
+	da_free(d->cache);
+	d->cache_idx = 0;
+
+	if (d->frame != d->sw_frame && d->frame != d->hw_frame)
+		d->frame = d->sw_frame;
+}
+
 void mp_decode_free(struct mp_decode *d)
 {
 	mp_decode_clear_packets(d);
 	circlebuf_free(&d->packets);
+	mp_decode_free_cache(d);
 
 	if (d->hw_frame) {
 		av_frame_unref(d->hw_frame);
@@ -327,12 +341,82 @@ static int decode_packet(struct mp_decode *d, int *got_frame)
 	return ret;
 }
 
+static inline size_t get_frame_data_size(struct mp_decode *d, AVFrame *f)
+{
+	int size;
+
+	if (d->audio)
+		size = av_samples_get_buffer_size(NULL, f->channels,
+						  f->nb_samples, f->format, 1);
+	else
+		size = av_image_get_buffer_size(f->format, f->width, f->height,
+						1);
+
+	return size > 0 ? (size_t)size : 0;
+}
+
+static void mp_decode_cache_frame(struct mp_decode *d)
+{
+	struct mp_media *m = d->m;
+	struct mp_cached_frame *cached;
+	size_t size = get_frame_data_size(d, d->frame);
+
+	if (m->cache_size + size > m->cache_limit) {
+		blog(LOG_INFO,
+		     "MP: '%s' does not fit in the %d MB frame cache, "
+		     "looping will decode",
+		     m->path, (int)(m->cache_limit / (1024 * 1024)));
+
+		mp_decode_free_cache(&m->v);
+		mp_decode_free_cache(&m->a);
+		m->cache_recording = false;
+		m->cache_limit = 0;
+		m->cache_size = 0;
+		return;
+	}
+
+	cached = da_push_back_new(d->cache);
+	cached->frame = av_frame_clone(d->frame);
+	cached->pts = d->frame_pts;
+	cached->duration = d->last_duration;
+
+	if (!cached->frame) {
+		da_pop_back(d->cache);
+		return;
+	}
+
+	m->cache_size += size;
+}
+
+static bool mp_decode_next_cached(struct mp_decode *d)
+{
+	struct mp_cached_frame *cached;
+
+	d->frame_ready = false;
+
+	if (d->cache_idx == d->cache.num) {
+		d->eof = true;
+		return true;
+	}
+
+	cached = &d->cache.array[d->cache_idx++];
+	d->frame = cached->frame;
+	d->frame_pts = cached->pts;
+	d->last_duration = cached->duration;
+	d->next_pts = cached->pts + cached->duration;
+	d->frame_ready = true;
+	return true;
+}
+
 bool mp_decode_next(struct mp_decode *d)
 {
 	bool eof = d->m->eof;
 	int got_frame;
 	int ret;
 
+	if (d->m->cache_replay)
+		return mp_decode_next_cached(d);
+
 	d->frame_ready = false;
 
 	if (!eof && !d->packets.size)
@@ -422,6 +506,9 @@ bool mp_decode_next(struct mp_decode *d)
 
 		d->last_duration = duration;
 		d->next_pts = d->frame_pts + duration;
+
+		if (d->m->cache_recording)
+			mp_decode_cache_frame(d);
 	}
 
 	return true;
@@ -21,6 +21,7 @@ extern "C" {
 #endif
 
 #include <util/circlebuf.h>
+#include <util/darray.h>
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -46,6 +47,12 @@ extern "C" {
 
 struct mp_media;
 
+struct mp_cached_frame {
+	AVFrame *frame;
+	int64_t pts;
+	int64_t duration;
+};
+
 struct mp_decode {
 	struct mp_media *m;
 	AVStream *stream;
@@ -72,6 +79,9 @@ struct mp_decode {
 	AVPacket pkt;
 	bool packet_pending;
 	struct circlebuf packets;
+
+	DARRAY(struct mp_cached_frame) cache;
+	size_t cache_idx;
 };
 
 extern bool mp_decode_init(struct mp_media *media, enum AVMediaType type,
@@ -84,6 +94,8 @@ extern void mp_decode_push_packet(struct mp_decode *decode, AVPacket *pkt);
 extern bool mp_decode_next(struct mp_decode *decode);
 extern void mp_decode_flush(struct mp_decode *decode);
 
+extern void mp_decode_free_cache(struct mp_decode *decode);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,6 +18,7 @@
 #include <util/platform.h>
 
 #include <assert.h>
+#include <inttypes.h>
 
 #include "media.h"
 #include "closest-format.h"
@@ -242,7 +243,7 @@ static bool mp_media_prepare_frames(mp_media_t *m)
 	bool actively_seeking = m->seek_next_ts && m->pause;
 
 	while (!mp_media_ready_to_start(m)) {
-		if (!m->eof) {
+		if (!m->eof && !m->cache_replay) {
 			int ret = mp_media_next_packet(m);
 			if (ret == AVERROR_EOF || ret == AVERROR_EXIT) {
 				if (!actively_seeking) {
@@ -306,6 +307,249 @@ static inline bool mp_media_can_play_frame(mp_media_t *m, struct mp_decode *d)
 	return d->frame_ready && d->frame_pts <= m->next_pts_ns;
 }
 
+/* ------------------------------------------------------------------------- */
+/* When pipelining is enabled, the media thread only demuxes, decodes and
+ * computes timing; the frames it would output are queued with the time they
+ * are due, and a separate output thread converts video frames ahead of that
+ * time and outputs everything once it is due.  Timestamps and due times are
+ * computed exactly as they would be without the pipeline. */
+
+static inline bool mp_pipeline_has_space(mp_media_t *m)
+{
+	/* room for one video frame, one audio frame and a stop */
+	return m->pipe_video_count < (size_t)m->pipeline_depth &&
+	       m->pipe_capacity - m->pipe_count >= 3;
+}
+
+static void mp_pipeline_push(mp_media_t *m, struct mp_pipeline_entry *entry)
+{
+	struct mp_media_pipeline_stats *stats = &m->pipe_stats;
+	size_t idx;
+
+	entry->due_ns = m->next_ns;
+
+	pthread_mutex_lock(&m->pipe_mutex);
+	idx = (m->pipe_start + m->pipe_count) % m->pipe_capacity;
+	m->pipe_entries[idx] = *entry;
+	m->pipe_count++;
+
+	if (entry->type == MP_PIPELINE_VIDEO) {
+		stats->depth = ++m->pipe_video_count;
+		if (stats->depth > stats->max_depth)
+			stats->max_depth = stats->depth;
+	}
+	pthread_mutex_unlock(&m->pipe_mutex);
+
+	os_event_signal(m->pipe_ready);
+}
+
+static void mp_pipeline_pop(mp_media_t *m)
+{
+	struct mp_pipeline_entry *entry = &m->pipe_entries[m->pipe_start];
+
+	if (entry->type == MP_PIPELINE_VIDEO)
+		m->pipe_stats.depth = --m->pipe_video_count;
+
+	av_frame_free(&entry->frame);
+	m->pipe_start = (m->pipe_start + 1) % m->pipe_capacity;
+	m->pipe_count--;
+}
+
+/* discards everything that has not been output yet */
+static void mp_pipeline_flush(mp_media_t *m)
+{
+	if (!m->pipeline)
+		return;
+
+	pthread_mutex_lock(&m->present_mutex);
+	pthread_mutex_lock(&m->pipe_mutex);
+	while (m->pipe_count)
+		mp_pipeline_pop(m);
+	os_atomic_inc_long(&m->pipe_generation);
+	pthread_mutex_unlock(&m->pipe_mutex);
+	pthread_mutex_unlock(&m->present_mutex);
+
+	m->next_ns = 0;
+}
+
+/* returns false if woken up without any space becoming available */
+static bool mp_pipeline_wait_space(mp_media_t *m)
+{
+	bool space;
+
+	if (!m->next_ns)
+		m->next_ns = os_gettime_ns();
+
+	pthread_mutex_lock(&m->pipe_mutex);
+	space = mp_pipeline_has_space(m);
+	pthread_mutex_unlock(&m->pipe_mutex);
+
+	if (!space)
+		os_event_wait(m->pipe_space);
+	return space;
+}
+
+static inline void mp_media_wake(mp_media_t *m)
+{
+	os_sem_post(m->sem);
+	if (m->pipe_space)
+		os_event_signal(m->pipe_space);
+}
+
+static bool mp_media_convert_video(mp_media_t *m, AVFrame *f,
+				   uint8_t *scale_pic[4],
+				   int scale_linesizes[4],
+				   struct obs_source_frame *frame)
+{
+	bool flip = false;
+
+	if (m->swscale) {
+		int ret = sws_scale(m->swscale, (const uint8_t *const *)f->data,
+				    f->linesize, 0, f->height, scale_pic,
+				    scale_linesizes);
+		if (ret < 0)
+			return false;
+
+		flip = scale_linesizes[0] < 0 && scale_linesizes[1] == 0;
+		for (size_t i = 0; i < 4; i++) {
+			frame->data[i] = scale_pic[i];
+			frame->linesize[i] = abs(scale_linesizes[i]);
+		}
+
+	} else {
+		flip = f->linesize[0] < 0 && f->linesize[1] == 0;
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			frame->data[i] = f->data[i];
+			frame->linesize[i] = abs(f->linesize[i]);
+		}
+	}
+
+	if (flip)
+		frame->data[0] -= frame->linesize[0] * (f->height - 1);
+
+	frame->flip = flip;
+	return true;
+}
+
+static bool mp_present_convert(mp_media_t *m, struct mp_pipeline_entry *entry)
+{
+	AVFrame *f = entry->frame;
+
+	if (m->swscale && !m->present_pic[0]) {
+		int ret = av_image_alloc(m->present_pic, m->present_linesizes,
+					 f->width, f->height, m->scale_format,
+					 32);
+		if (ret < 0) {
+			blog(LOG_WARNING, "MP: Failed to create output "
+					  "scale pic data");
+			return false;
+		}
+	}
+
+	return mp_media_convert_video(m, f, m->present_pic,
+				      m->present_linesizes, &entry->video);
+}
+
+static bool mp_present_sleepto(mp_media_t *m, uint64_t due_ns, long gen)
+{
+	for (;;) {
+		uint64_t t = os_gettime_ns();
+		if (t >= due_ns)
+			return true;
+		if (m->present_stop ||
+		    os_atomic_load_long(&m->pipe_generation) != gen)
+			return false;
+
+		/* wake up regularly so flushes are never waited on */
+		os_sleepto_ns(due_ns - t > 10000000 ? t + 10000000 : due_ns);
+	}
+}
+
+static void mp_present_entry(mp_media_t *m, struct mp_pipeline_entry *entry,
+			     long gen)
+{
+	struct mp_media_pipeline_stats *stats = &m->pipe_stats;
+	bool valid = true;
+
+	pthread_mutex_lock(&m->present_mutex);
+	if (os_atomic_load_long(&m->pipe_generation) != gen) {
+		pthread_mutex_unlock(&m->present_mutex);
+		return;
+	}
+
+	if (entry->type == MP_PIPELINE_VIDEO) {
+		uint64_t start = os_gettime_ns();
+		uint64_t end;
+
+		valid = mp_present_convert(m, entry);
+		end = os_gettime_ns();
+
+		pthread_mutex_lock(&m->pipe_mutex);
+		stats->convert_count++;
+		stats->convert_ns += end - start;
+		if (end > entry->due_ns)
+			stats->late_frames++;
+		pthread_mutex_unlock(&m->pipe_mutex);
+	}
+	pthread_mutex_unlock(&m->present_mutex);
+
+	if (!mp_present_sleepto(m, entry->due_ns, gen))
+		return;
+
+	pthread_mutex_lock(&m->present_mutex);
+	if (os_atomic_load_long(&m->pipe_generation) != gen) {
+		pthread_mutex_unlock(&m->present_mutex);
+		return;
+	}
+
+	if (entry->type == MP_PIPELINE_VIDEO) {
+		if (valid && m->v_cb)
+			m->v_cb(m->opaque, &entry->video);
+	} else if (entry->type == MP_PIPELINE_AUDIO) {
+		if (m->a_cb)
+			m->a_cb(m->opaque, &entry->audio);
+	} else if (m->stop_cb) {
+		m->stop_cb(m->opaque);
+	}
+
+	pthread_mutex_lock(&m->pipe_mutex);
+	mp_pipeline_pop(m);
+	pthread_mutex_unlock(&m->pipe_mutex);
+	pthread_mutex_unlock(&m->present_mutex);
+
+	os_event_signal(m->pipe_space);
+}
+
+static void *mp_present_thread(void *opaque)
+{
+	mp_media_t *m = opaque;
+
+	os_set_thread_name("mp_present_thread");
+
+	while (!m->present_stop) {
+		struct mp_pipeline_entry entry;
+		bool have_entry;
+		long gen;
+
+		pthread_mutex_lock(&m->pipe_mutex);
+		have_entry = m->pipe_count > 0;
+		if (have_entry)
+			entry = m->pipe_entries[m->pipe_start];
+		gen = os_atomic_load_long(&m->pipe_generation);
+		pthread_mutex_unlock(&m->pipe_mutex);
+
+		if (have_entry)
+			mp_present_entry(m, &entry, gen);
+		else
+			os_event_wait(m->pipe_ready);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static void mp_media_next_audio(mp_media_t *m)
 {
 	struct mp_decode *d = &m->a;
@@ -319,9 +563,6 @@ static void mp_media_next_audio(mp_media_t *m)
 	if (!m->a_cb)
 		return;
 
-	for (size_t i = 0; i < MAX_AV_PLANES; i++)
-		audio.data[i] = f->data[i];
-
 	audio.samples_per_sec = f->sample_rate * m->speed / 100;
 	audio.speakers = convert_speaker_layout(f->channels);
 	audio.format = convert_sample_format(f->format);
@@ -333,6 +574,24 @@ static void mp_media_next_audio(mp_media_t *m)
 	if (audio.format == AUDIO_FORMAT_UNKNOWN)
 		return;
 
+	if (m->pipeline) {
+		struct mp_pipeline_entry entry = {.type = MP_PIPELINE_AUDIO};
+
+		entry.frame = av_frame_clone(f);
+		if (!entry.frame)
+			return;
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++)
+			audio.data[i] = entry.frame->data[i];
+
+		entry.audio = audio;
+		mp_pipeline_push(m, &entry);
+		return;
+	}
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		audio.data[i] = f->data[i];
+
 	m->a_cb(m->opaque, &audio);
 }
 
@@ -344,6 +603,7 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 	enum video_colorspace new_space;
 	enum video_range_type new_range;
 	AVFrame *f = d->frame;
+	bool queue = m->pipeline && !preload;
 
 	if (!preload) {
 		if (!mp_media_can_play_frame(m, d))
@@ -357,32 +617,21 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 		return;
 	}
 
-	bool flip = false;
-	if (m->swscale) {
-		int ret = sws_scale(m->swscale, (const uint8_t *const *)f->data,
-				    f->linesize, 0, f->height, m->scale_pic,
-				    m->scale_linesizes);
-		if (ret < 0)
-			return;
-
-		flip = m->scale_linesizes[0] < 0 && m->scale_linesizes[1] == 0;
-		for (size_t i = 0; i < 4; i++) {
-			frame->data[i] = m->scale_pic[i];
-			frame->linesize[i] = abs(m->scale_linesizes[i]);
-		}
+	if (!queue) {
+		bool success;
 
-	} else {
-		flip = f->linesize[0] < 0 && f->linesize[1] == 0;
+		/* the output thread may be using the scaler */
+		if (m->pipeline)
+			pthread_mutex_lock(&m->present_mutex);
+		success = mp_media_convert_video(m, f, m->scale_pic,
+						 m->scale_linesizes, frame);
+		if (m->pipeline)
+			pthread_mutex_unlock(&m->present_mutex);
 
-		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-			frame->data[i] = f->data[i];
-			frame->linesize[i] = abs(f->linesize[i]);
-		}
+		if (!success)
+			return;
 	}
 
-	if (flip)
-		frame->data[0] -= frame->linesize[0] * (f->height - 1);
-
 	new_format = convert_pixel_format(m->scale_format);
 	new_space = convert_color_space(f->colorspace, f->color_trc);
 	new_range = m->force_range == VIDEO_RANGE_DEFAULT
@@ -419,7 +668,6 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 
 	frame->width = f->width;
 	frame->height = f->height;
-	frame->flip = flip;
 
 	if (!m->is_local_file && !d->got_first_keyframe) {
 		if (!f->key_frame)
@@ -434,6 +682,15 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 		} else {
 			m->v_preload_cb(m->opaque, frame);
 		}
+	} else if (queue) {
+		struct mp_pipeline_entry entry = {.type = MP_PIPELINE_VIDEO};
+
+		entry.frame = av_frame_clone(f);
+		if (!entry.frame)
+			return;
+
+		entry.video = *frame;
+		mp_pipeline_push(m, &entry);
 	} else {
 		m->v_cb(m->opaque, frame);
 	}
@@ -461,6 +718,55 @@ static void mp_media_calc_next_ns(mp_media_t *m)
 	m->next_pts_ns = min_next_ns;
 }
 
+static void mp_media_free_cache(mp_media_t *m)
+{
+	mp_decode_free_cache(&m->v);
+	mp_decode_free_cache(&m->a);
+	m->cache_size = 0;
+	m->cache_recording = false;
+	m->cache_complete = false;
+	m->cache_replay = false;
+}
+
+/* Decoded frames are recorded during a full pass from the start of the file,
+ * and every later pass from the start is replayed from them without touching
+ * the demuxer or decoders. */
+static void mp_media_start_cache_pass(mp_media_t *m)
+{
+	if (m->cache_complete) {
+		m->cache_replay = true;
+		m->v.cache_idx = 0;
+		m->a.cache_idx = 0;
+		return;
+	}
+
+	mp_media_free_cache(m);
+	m->cache_recording = m->cache_limit && m->is_local_file &&
+			     !m->v.hw && !m->a.hw;
+}
+
+static void mp_media_complete_cache(mp_media_t *m)
+{
+	if (!m->cache_recording || !m->eof)
+		return;
+
+	m->cache_recording = false;
+	m->cache_complete = true;
+
+	blog(LOG_INFO,
+	     "MP: Cached %d video and %d audio frames (%d MB) of '%s' "
+	     "for looping",
+	     (int)m->v.cache.num, (int)m->a.cache.num,
+	     (int)(m->cache_size / (1024 * 1024)), m->path);
+}
+
+static void mp_media_stop_cache_pass(mp_media_t *m)
+{
+	m->cache_replay = false;
+	if (m->cache_recording)
+		mp_media_free_cache(m);
+}
+
 static void seek_to(mp_media_t *m, int64_t pos)
 {
 	AVStream *stream = m->fmt->streams[0];
@@ -477,7 +783,7 @@ static void seek_to(mp_media_t *m, int64_t pos)
 						     stream->time_base)
 				      : seek_pos;
 
-	if (m->is_local_file) {
+	if (m->is_local_file && !m->cache_replay) {
 		int ret = av_seek_frame(m->fmt, 0, seek_target, seek_flags);
 		if (ret < 0) {
 			blog(LOG_WARNING, "MP: Failed to seek: %s",
@@ -500,6 +806,7 @@ static bool mp_media_reset(mp_media_t *m)
 	bool stopping;
 	bool active;
 
+	mp_media_start_cache_pass(m);
 	seek_to(m, m->fmt->start_time);
 
 	int64_t next_ts = mp_media_get_base_pts(m);
@@ -534,8 +841,15 @@ static bool mp_media_reset(mp_media_t *m)
 
 	if (!active && m->is_local_file && m->v_preload_cb)
 		mp_media_next_video(m, true);
-	if (stopping && m->stop_cb)
-		m->stop_cb(m->opaque);
+	if (stopping && m->stop_cb) {
+		if (m->pipeline) {
+			struct mp_pipeline_entry entry = {
+				.type = MP_PIPELINE_STOP};
+			mp_pipeline_push(m, &entry);
+		} else {
+			m->stop_cb(m->opaque);
+		}
+	}
 	return true;
 }
 
@@ -569,6 +883,8 @@ static inline bool mp_media_eof(mp_media_t *m)
 	if (eof) {
 		bool looping;
 
+		mp_media_complete_cache(m);
+
 		pthread_mutex_lock(&m->mutex);
 		looping = m->looping;
 		if (!looping) {
@@ -674,6 +990,10 @@ static inline bool mp_media_thread(mp_media_t *m)
 	if (!init_avformat(m)) {
 		return false;
 	}
+
+	/* hardware decoders reuse the frame they transfer in to */
+	m->pipeline = m->pipe_entries && m->has_video && !m->v.hw;
+
 	if (!mp_media_reset(m)) {
 		return false;
 	}
@@ -693,6 +1013,8 @@ static inline bool mp_media_thread(mp_media_t *m)
 				return false;
 			if (pause)
 				reset_ts(m);
+		} else if (m->pipeline) {
+			timeout = !mp_pipeline_wait_space(m);
 		} else {
 			timeout = mp_media_sleepto(m);
 		}
@@ -717,17 +1039,21 @@ static inline bool mp_media_thread(mp_media_t *m)
 			break;
 		}
 		if (reset) {
+			mp_pipeline_flush(m);
 			mp_media_reset(m);
 			continue;
 		}
 
 		if (seek) {
+			mp_pipeline_flush(m);
+			mp_media_stop_cache_pass(m);
 			m->seek_next_ts = true;
 			seek_to(m, seek_pos);
 			continue;
 		}
 
 		if (reset_time) {
+			mp_pipeline_flush(m);
 			reset_ts(m);
 			continue;
 		}
@@ -742,8 +1068,19 @@ static inline bool mp_media_thread(mp_media_t *m)
 			if (m->has_audio)
 				mp_media_next_audio(m);
 
+			uint64_t start = os_gettime_ns();
+
 			if (!mp_media_prepare_frames(m))
 				return false;
+
+			if (m->pipeline) {
+				uint64_t end = os_gettime_ns();
+
+				pthread_mutex_lock(&m->pipe_mutex);
+				m->pipe_stats.decode_count++;
+				m->pipe_stats.decode_ns += end - start;
+				pthread_mutex_unlock(&m->pipe_mutex);
+			}
 			if (mp_media_eof(m))
 				continue;
 
@@ -767,6 +1104,77 @@ static void *mp_media_thread_start(void *opaque)
 	return NULL;
 }
 
+static bool mp_media_init_pipeline(mp_media_t *m,
+				   const struct mp_media_info *info)
+{
+	if (pthread_mutex_init(&m->pipe_mutex, NULL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init pipeline mutex");
+		return false;
+	}
+	if (pthread_mutex_init(&m->present_mutex, NULL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init output mutex");
+		return false;
+	}
+	if (os_event_init(&m->pipe_ready, OS_EVENT_TYPE_AUTO) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init pipeline event");
+		return false;
+	}
+	if (os_event_init(&m->pipe_space, OS_EVENT_TYPE_AUTO) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init pipeline event");
+		return false;
+	}
+
+	m->pipeline_depth = info->pipeline_depth;
+	m->pipe_capacity = (size_t)m->pipeline_depth * 4 + 4;
+	m->pipe_entries =
+		bzalloc(m->pipe_capacity * sizeof(struct mp_pipeline_entry));
+
+	if (pthread_create(&m->present_thread, NULL, mp_present_thread, m) !=
+	    0) {
+		blog(LOG_WARNING, "MP: Could not create output thread");
+		return false;
+	}
+
+	m->present_thread_valid = true;
+	return true;
+}
+
+static void mp_media_free_pipeline(mp_media_t *m)
+{
+	struct mp_media_pipeline_stats *stats = &m->pipe_stats;
+
+	if (m->present_thread_valid) {
+		m->present_stop = true;
+		os_event_signal(m->pipe_ready);
+		pthread_join(m->present_thread, NULL);
+	}
+
+	if (m->pipeline && stats->decode_count && stats->convert_count) {
+		blog(LOG_INFO,
+		     "MP: Pipeline for '%s': max depth %d, "
+		     "%.2f ms average decode, %.2f ms average convert, "
+		     "%" PRIu64 " late frames",
+		     m->path, (int)stats->max_depth,
+		     (double)stats->decode_ns / (double)stats->decode_count /
+			     1000000.0,
+		     (double)stats->convert_ns / (double)stats->convert_count /
+			     1000000.0,
+		     stats->late_frames);
+	}
+
+	if (m->pipe_entries) {
+		while (m->pipe_count)
+			mp_pipeline_pop(m);
+		bfree(m->pipe_entries);
+	}
+
+	pthread_mutex_destroy(&m->pipe_mutex);
+	pthread_mutex_destroy(&m->present_mutex);
+	os_event_destroy(m->pipe_ready);
+	os_event_destroy(m->pipe_space);
+	av_freep(&m->present_pic[0]);
+}
+
 static inline bool mp_media_init_internal(mp_media_t *m,
 					  const struct mp_media_info *info)
 {
@@ -783,6 +1191,9 @@ static inline bool mp_media_init_internal(mp_media_t *m,
 	m->format_name = info->format ? bstrdup(info->format) : NULL;
 	m->hw = info->hardware_decoding;
 
+	if (info->pipeline_depth > 0 && !mp_media_init_pipeline(m, info))
+		return false;
+
 	if (pthread_create(&m->thread, NULL, mp_media_thread_start, m) != 0) {
 		blog(LOG_WARNING, "MP: Could not create media thread");
 		return false;
@@ -796,6 +1207,8 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 {
 	memset(media, 0, sizeof(*media));
 	pthread_mutex_init_value(&media->mutex);
+	pthread_mutex_init_value(&media->pipe_mutex);
+	pthread_mutex_init_value(&media->present_mutex);
 	media->opaque = info->opaque;
 	media->v_cb = info->v_cb;
 	media->a_cb = info->a_cb;
@@ -806,6 +1219,7 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	media->buffering = info->buffering;
 	media->speed = info->speed;
 	media->is_local_file = info->is_local_file;
+	media->cache_limit = info->frame_cache_size;
 
 	if (!info->is_local_file || media->speed < 1 || media->speed > 200)
 		media->speed = 100;
@@ -838,7 +1252,7 @@ static void mp_kill_thread(mp_media_t *m)
 		pthread_mutex_lock(&m->mutex);
 		m->kill = true;
 		pthread_mutex_unlock(&m->mutex);
-		os_sem_post(m->sem);
+		mp_media_wake(m);
 
 		pthread_join(m->thread, NULL);
 	}
@@ -851,6 +1265,7 @@ void mp_media_free(mp_media_t *media)
 
 	mp_media_stop(media);
 	mp_kill_thread(media);
+	mp_media_free_pipeline(media);
 	mp_decode_free(&media->v);
 	mp_decode_free(&media->a);
 	avformat_close_input(&media->fmt);
@@ -862,6 +1277,8 @@ void mp_media_free(mp_media_t *media)
 	bfree(media->format_name);
 	memset(media, 0, sizeof(*media));
 	pthread_mutex_init_value(&media->mutex);
+	pthread_mutex_init_value(&media->pipe_mutex);
+	pthread_mutex_init_value(&media->present_mutex);
 }
 
 void mp_media_play(mp_media_t *m, bool loop, bool reconnecting)
@@ -877,7 +1294,7 @@ void mp_media_play(mp_media_t *m, bool loop, bool reconnecting)
 
 	pthread_mutex_unlock(&m->mutex);
 
-	os_sem_post(m->sem);
+	mp_media_wake(m);
 }
 
 void mp_media_play_pause(mp_media_t *m, bool pause)
@@ -889,7 +1306,7 @@ void mp_media_play_pause(mp_media_t *m, bool pause)
 	}
 	pthread_mutex_unlock(&m->mutex);
 
-	os_sem_post(m->sem);
+	mp_media_wake(m);
 }
 
 void mp_media_stop(mp_media_t *m)
@@ -902,7 +1319,7 @@ void mp_media_stop(mp_media_t *m)
 	}
 	pthread_mutex_unlock(&m->mutex);
 
-	os_sem_post(m->sem);
+	mp_media_wake(m);
 }
 
 int64_t mp_get_current_time(mp_media_t *m)
@@ -919,5 +1336,17 @@ void mp_media_seek_to(mp_media_t *m, int64_t pos)
 	}
 	pthread_mutex_unlock(&m->mutex);
 
-	os_sem_post(m->sem);
+	mp_media_wake(m);
+}
+
+bool mp_media_get_pipeline_stats(mp_media_t *m,
+				 struct mp_media_pipeline_stats *stats)
+{
+	if (!m->pipeline)
+		return false;
+
+	pthread_mutex_lock(&m->pipe_mutex);
+	*stats = m->pipe_stats;
+	pthread_mutex_unlock(&m->pipe_mutex);
+	return true;
 }
@@ -42,6 +42,37 @@ typedef void (*mp_video_cb)(void *opaque, struct obs_source_frame *frame);
 typedef void (*mp_audio_cb)(void *opaque, struct obs_source_audio *audio);
 typedef void (*mp_stop_cb)(void *opaque);
 
+enum mp_pipeline_type {
+	MP_PIPELINE_VIDEO,
+	MP_PIPELINE_AUDIO,
+	MP_PIPELINE_STOP,
+};
+
+struct mp_pipeline_entry {
+	enum mp_pipeline_type type;
+	uint64_t due_ns;
+	AVFrame *frame;
+	struct obs_source_frame video;
+	struct obs_source_audio audio;
+};
+
+struct mp_media_pipeline_stats {
+	/* video frames decoded ahead and waiting to be converted/output */
+	size_t depth;
+	size_t max_depth;
+
+	/* time spent demuxing and decoding on the media thread */
+	uint64_t decode_count;
+	uint64_t decode_ns;
+
+	/* time spent converting video frames on the output thread */
+	uint64_t convert_count;
+	uint64_t convert_ns;
+
+	/* video frames that were converted after they were due */
+	uint64_t late_frames;
+};
+
 struct mp_media {
 	AVFormatContext *fmt;
 
@@ -101,6 +132,32 @@ struct mp_media {
 	bool seek;
 	bool seek_next_ts;
 	int64_t seek_pos;
+
+	size_t cache_limit;
+	size_t cache_size;
+	bool cache_recording;
+	bool cache_complete;
+	bool cache_replay;
+
+	int pipeline_depth;
+	bool pipeline;
+	struct mp_pipeline_entry *pipe_entries;
+	size_t pipe_capacity;
+	size_t pipe_start;
+	size_t pipe_count;
+	size_t pipe_video_count;
+	volatile long pipe_generation;
+	struct mp_media_pipeline_stats pipe_stats;
+	pthread_mutex_t pipe_mutex;
+	os_event_t *pipe_ready;
+	os_event_t *pipe_space;
+
+	pthread_mutex_t present_mutex;
+	uint8_t *present_pic[4];
+	int present_linesizes[4];
+	bool present_thread_valid;
+	volatile bool present_stop;
+	pthread_t present_thread;
 };
 
 typedef struct mp_media mp_media_t;
@@ -122,6 +179,15 @@ struct mp_media_info {
 	bool hardware_decoding;
 	bool is_local_file;
 	bool reconnecting;
+
+	/* maximum size of decoded frames kept for looping local files, in
+	 * bytes (0 to always decode) */
+	size_t frame_cache_size;
+
+	/* number of video frames to demux/decode ahead of output, with
+	 * conversion and output moved to a separate thread (0 to decode,
+	 * convert and output on the media thread) */
+	int pipeline_depth;
 };
 
 extern bool mp_media_init(mp_media_t *media, const struct mp_media_info *info);
@@ -132,6 +198,8 @@ extern void mp_media_stop(mp_media_t *media);
 extern void mp_media_play_pause(mp_media_t *media, bool pause);
 extern int64_t mp_get_current_time(mp_media_t *m);
 extern void mp_media_seek_to(mp_media_t *m, int64_t pos);
+extern bool mp_media_get_pipeline_stats(mp_media_t *m,
+					struct mp_media_pipeline_stats *stats);
 
 /* #define DETAILED_DEBUG_INFO */
 
@@ -1,14 +1,55 @@
 #include "obs-internal.h"
+#include "media-io/audio-drift.h"
 #include "pulseaudio-wrapper.h"
 
 #define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
 
+/* Audio goes from the audio thread to the stream through a ring, which the
+ * write callback of the stream reads from.  The stream buffer is always kept
+ * full, so the latency is the stream latency plus the audio in the ring.
+ * The amount in the ring is held at a small target by resampling the audio
+ * slightly (audio_drift), which also follows the drift between the clocks
+ * of OBS and of the device. */
+
+/* the ring holds at least a packet, plus this margin for scheduling
+ * jitter.  Every underrun adds a step to the margin, which comes back down
+ * after a while without underruns. */
+#define RING_MARGIN_US 5000
+#define RING_MARGIN_STEP_US 5000
+#define RING_MARGIN_MAX_US 50000
+#define RING_MARGIN_SHRINK_US 1000
+#define RING_MARGIN_SHRINK_INTERVAL 10.0
+
+#define RING_SIZE_US 500000
+#define MIN_TLENGTH_US 10000
+#define MINREQ_US 5000
+
+/* audio this far past the ring target is dropped instead of resampled */
+#define MAX_EXCESS_US 100000
+
+/* PI controller of the resampling ratio, on the ring level error in
+ * seconds */
+#define DRIFT_KP 0.1
+#define DRIFT_KI 0.02
+#define DRIFT_MAX_CORRECTION 0.005
+#define LEVEL_SMOOTHING 0.1
+
+/* single producer, single consumer byte ring.  head is only written by the
+ * audio thread, tail only by the stream callback. */
+struct monitor_ring {
+	uint8_t *data;
+	size_t size;
+	volatile long head;
+	volatile long tail;
+};
+
 struct audio_monitor {
 	obs_source_t *source;
 	pa_stream *stream;
 	char *device;
 	pa_buffer_attr attr;
+	pa_sample_spec spec;
 	enum speaker_layout speakers;
 	pa_sample_format_t format;
 	uint_fast32_t samples_per_sec;
@@ -17,13 +58,31 @@ struct audio_monitor {
 
 	uint_fast32_t packets;
 	uint_fast64_t frames;
+	uint_fast32_t overflows;
 
-	struct circlebuf new_data;
+	struct monitor_ring ring;
+	audio_drift_t *drift;
 	audio_resampler_t *resampler;
-	size_t buffer_size;
-	size_t bytesRemaining;
 	size_t bytes_per_channel;
 
+	/* audio thread */
+	double drift_ratio;
+	double drift_integral;
+	double level_avg;
+	double ring_base;
+	double ring_margin;
+	double since_underrun;
+	long last_underruns;
+
+	/* stream callbacks */
+	volatile bool priming;
+	volatile long ring_target_bytes;
+	volatile long stream_latency_us;
+	volatile long underruns;
+	volatile long skips;
+
+	volatile long latency_us;
+
 	bool ignore;
 	pthread_mutex_t playback_mutex;
 };
@@ -171,32 +230,139 @@ void process_volume(const struct audio_monitor *monitor, float vol,
 	}
 }
 
-static void do_stream_write(void *param)
+static inline size_t ring_level(const struct monitor_ring *ring)
 {
-	PULSE_DATA(param);
-	uint8_t *buffer = NULL;
+	return (size_t)((unsigned long)os_atomic_load_long(&ring->head) -
+			(unsigned long)os_atomic_load_long(&ring->tail));
+}
 
-	while (data->new_data.size >= data->buffer_size &&
-	       data->bytesRemaining > 0) {
-		size_t bytesToFill = data->buffer_size;
+static void ring_init(struct monitor_ring *ring, size_t min_size)
+{
+	size_t size = 4096;
+	while (size < min_size)
+		size *= 2;
+
+	ring->data = bmalloc(size);
+	ring->size = size;
+	ring->head = 0;
+	ring->tail = 0;
+}
 
-		if (bytesToFill > data->bytesRemaining)
-			bytesToFill = data->bytesRemaining;
+static inline void ring_free(struct monitor_ring *ring)
+{
+	bfree(ring->data);
+	ring->data = NULL;
+}
 
-		pulseaudio_lock();
-		pa_stream_begin_write(data->stream, (void **)&buffer,
-				      &bytesToFill);
-		pulseaudio_unlock();
+static bool ring_push(struct monitor_ring *ring, const uint8_t *data,
+		      size_t bytes)
+{
+	const unsigned long head = (unsigned long)ring->head;
+	const size_t pos = head & (ring->size - 1);
+	const size_t first = ring->size - pos;
 
-		circlebuf_pop_front(&data->new_data, buffer, bytesToFill);
+	if (ring->size - ring_level(ring) < bytes)
+		return false;
 
-		pulseaudio_lock();
-		pa_stream_write(data->stream, buffer, bytesToFill, NULL, 0LL,
-				PA_SEEK_RELATIVE);
-		pulseaudio_unlock();
+	if (bytes <= first) {
+		memcpy(ring->data + pos, data, bytes);
+	} else {
+		memcpy(ring->data + pos, data, first);
+		memcpy(ring->data, data + first, bytes - first);
+	}
+
+	os_atomic_set_long(&ring->head, (long)(head + bytes));
+	return true;
+}
+
+/* data is NULL to skip */
+static void ring_pop(struct monitor_ring *ring, uint8_t *data, size_t bytes)
+{
+	const unsigned long tail = (unsigned long)ring->tail;
+	const size_t pos = tail & (ring->size - 1);
+	const size_t first = ring->size - pos;
+
+	if (data && bytes <= first) {
+		memcpy(data, ring->data + pos, bytes);
+	} else if (data) {
+		memcpy(data, ring->data + pos, first);
+		memcpy(data + first, ring->data, bytes - first);
+	}
 
-		data->bytesRemaining -= bytesToFill;
+	os_atomic_set_long(&ring->tail, (long)(tail + bytes));
+}
+
+static inline double bytes_to_sec(const struct audio_monitor *monitor,
+				  size_t bytes)
+{
+	return (double)bytes /
+	       (double)(monitor->bytes_per_frame * monitor->samples_per_sec);
+}
+
+static inline size_t sec_to_bytes(const struct audio_monitor *monitor,
+				  double sec)
+{
+	size_t frames = (size_t)(sec * (double)monitor->samples_per_sec);
+	return frames * monitor->bytes_per_frame;
+}
+
+/* Steers the ring level towards its target, and adapts the target to the
+ * underruns of the stream */
+static void update_drift(struct audio_monitor *monitor, uint32_t in_frames)
+{
+	const struct audio_output_info *info =
+		audio_output_get_info(obs->audio.audio);
+	const double dt = (double)in_frames / (double)info->samples_per_sec;
+	const long underruns = os_atomic_load_long(&monitor->underruns);
+	const size_t level_bytes = ring_level(&monitor->ring);
+	const double level = bytes_to_sec(monitor, level_bytes);
+	double target, error, correction, max_integral;
+
+	if (underruns != monitor->last_underruns) {
+		monitor->last_underruns = underruns;
+		monitor->since_underrun = 0.0;
+		monitor->ring_margin += RING_MARGIN_STEP_US / 1000000.0;
+		if (monitor->ring_margin > RING_MARGIN_MAX_US / 1000000.0)
+			monitor->ring_margin = RING_MARGIN_MAX_US / 1000000.0;
+
+	} else if ((monitor->since_underrun += dt) >=
+		   RING_MARGIN_SHRINK_INTERVAL) {
+		monitor->since_underrun = 0.0;
+		monitor->ring_margin -= RING_MARGIN_SHRINK_US / 1000000.0;
+		if (monitor->ring_margin < RING_MARGIN_US / 1000000.0)
+			monitor->ring_margin = RING_MARGIN_US / 1000000.0;
+	}
+
+	target = monitor->ring_base + monitor->ring_margin;
+	os_atomic_set_long(&monitor->ring_target_bytes,
+			   (long)sec_to_bytes(monitor, target));
+
+	monitor->level_avg += (level - monitor->level_avg) * LEVEL_SMOOTHING;
+	error = monitor->level_avg - target;
+
+	/* the ring is being refilled after an underrun, the level says
+	 * nothing about the drift until then */
+	if (!os_atomic_load_bool(&monitor->priming)) {
+		max_integral = DRIFT_MAX_CORRECTION / DRIFT_KI;
+		monitor->drift_integral += error * dt;
+		if (monitor->drift_integral > max_integral)
+			monitor->drift_integral = max_integral;
+		else if (monitor->drift_integral < -max_integral)
+			monitor->drift_integral = -max_integral;
 	}
+
+	correction = DRIFT_KP * error + DRIFT_KI * monitor->drift_integral;
+	if (correction > DRIFT_MAX_CORRECTION)
+		correction = DRIFT_MAX_CORRECTION;
+	else if (correction < -DRIFT_MAX_CORRECTION)
+		correction = -DRIFT_MAX_CORRECTION;
+
+	/* too much audio in the ring means too many frames are produced */
+	monitor->drift_ratio = 1.0 - correction;
+
+	os_atomic_set_long(&monitor->latency_us,
+			   os_atomic_load_long(&monitor->stream_latency_us) +
+				   (long)(level * 1000000.0));
 }
 
 static void on_audio_playback(void *param, obs_source_t *source,
@@ -206,6 +372,8 @@ static void on_audio_playback(void *param, obs_source_t *source,
 	float vol = source->user_volume;
 	size_t bytes;
 
+	float *drift_data[MAX_AUDIO_CHANNELS];
+	uint32_t drift_frames;
 	uint8_t *resample_data[MAX_AV_PLANES];
 	uint32_t resample_frames;
 	uint64_t ts_offset;
@@ -217,10 +385,16 @@ static void on_audio_playback(void *param, obs_source_t *source,
 	if (os_atomic_load_long(&source->activate_refs) == 0)
 		goto unlock;
 
+	success = audio_drift_process(
+		monitor->drift, monitor->drift_ratio, drift_data,
+		&drift_frames, (const float *const *)audio_data->data,
+		(uint32_t)audio_data->frames);
+	if (!success)
+		goto unlock;
+
 	success = audio_resampler_resample(
 		monitor->resampler, resample_data, &resample_frames, &ts_offset,
-		(const uint8_t *const *)audio_data->data,
-		(uint32_t)audio_data->frames);
+		(const uint8_t *const *)drift_data, drift_frames);
 
 	if (!success)
 		goto unlock;
@@ -236,38 +410,81 @@ static void on_audio_playback(void *param, obs_source_t *source,
 		}
 	}
 
-	circlebuf_push_back(&monitor->new_data, resample_data[0], bytes);
+	if (!ring_push(&monitor->ring, resample_data[0], bytes))
+		monitor->overflows++;
 	monitor->packets++;
 	monitor->frames += resample_frames;
 
+	update_drift(monitor, (uint32_t)audio_data->frames);
+
 unlock:
 	pthread_mutex_unlock(&monitor->playback_mutex);
-	do_stream_write(param);
 }
 
-static void pulseaudio_stream_write(pa_stream *p, size_t nbytes, void *userdata)
+static inline void write_silence(const struct audio_monitor *monitor,
+				 uint8_t *data, size_t bytes)
 {
-	UNUSED_PARAMETER(p);
-	PULSE_DATA(userdata);
+	memset(data, monitor->format == PA_SAMPLE_U8 ? 0x80 : 0, bytes);
+}
 
-	pthread_mutex_lock(&data->playback_mutex);
-	data->bytesRemaining += nbytes;
-	pthread_mutex_unlock(&data->playback_mutex);
+/* Fills the stream buffer from the ring, or with silence while the ring is
+ * refilled after an underrun */
+static void fill_stream_buffer(struct audio_monitor *monitor, uint8_t *data,
+			       size_t bytes)
+{
+	struct monitor_ring *ring = &monitor->ring;
+	const size_t frame = monitor->bytes_per_frame;
+	const size_t target =
+		(size_t)os_atomic_load_long(&monitor->ring_target_bytes);
+	const size_t max_excess =
+		sec_to_bytes(monitor, MAX_EXCESS_US / 1000000.0);
+	size_t level = ring_level(ring);
+	size_t from_ring = 0;
+
+	if (os_atomic_load_bool(&monitor->priming) && level >= target)
+		os_atomic_set_bool(&monitor->priming, false);
+
+	if (!os_atomic_load_bool(&monitor->priming)) {
+		if (level > target + max_excess) {
+			size_t skip = (level - target) / frame * frame;
+			ring_pop(ring, NULL, skip);
+			level -= skip;
+			os_atomic_inc_long(&monitor->skips);
+		}
 
-	pulseaudio_signal(0);
+		from_ring = (level < bytes ? level : bytes) / frame * frame;
+		ring_pop(ring, data, from_ring);
+
+		/* the only place underruns are counted, as the ring margin
+		 * is what update_drift grows for them */
+		if (from_ring < bytes) {
+			os_atomic_set_bool(&monitor->priming, true);
+			if (obs_source_active(monitor->source))
+				os_atomic_inc_long(&monitor->underruns);
+		}
+	}
+
+	if (from_ring < bytes)
+		write_silence(monitor, data + from_ring, bytes - from_ring);
 }
 
-static void pulseaudio_underflow(pa_stream *p, void *userdata)
+static void pulseaudio_stream_write(pa_stream *p, size_t nbytes, void *userdata)
 {
-	UNUSED_PARAMETER(p);
 	PULSE_DATA(userdata);
+	uint8_t *buffer = NULL;
+	pa_usec_t latency;
+	int negative;
+
+	/* called from the mainloop, which is already locked */
+	if (pa_stream_begin_write(p, (void **)&buffer, &nbytes) < 0 || !buffer)
+		return;
 
-	pthread_mutex_lock(&data->playback_mutex);
-	if (obs_source_active(data->source))
-		data->attr.tlength = (data->attr.tlength * 3) / 2;
+	fill_stream_buffer(data, buffer, nbytes);
+	pa_stream_write(p, buffer, nbytes, NULL, 0LL, PA_SEEK_RELATIVE);
 
-	pa_stream_set_buffer_attr(data->stream, &data->attr, NULL, NULL);
-	pthread_mutex_unlock(&data->playback_mutex);
+	if (pa_stream_get_latency(p, &latency, &negative) == 0)
+		os_atomic_set_long(&data->stream_latency_us,
+				   negative ? 0 : (long)latency);
 
 	pulseaudio_signal(0);
 }
@@ -341,7 +558,6 @@ static void pulseaudio_stop_playback(struct audio_monitor *monitor)
 		/* Remove the callbacks, to ensure we no longer try to do anything
 		 * with this stream object */
 		pulseaudio_write_callback(monitor->stream, NULL, NULL);
-		pulseaudio_set_underflow_callback(monitor->stream, NULL, NULL);
 
 		/* Unreference the stream and drop it. PA will free it when it can. */
 		pulseaudio_lock();
@@ -352,11 +568,15 @@ static void pulseaudio_stop_playback(struct audio_monitor *monitor)
 
 	blog(LOG_INFO, "Stopped Monitoring in '%s'", monitor->device);
 	blog(LOG_INFO,
-	     "Got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames",
-	     monitor->packets, monitor->frames);
+	     "Got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames, "
+	     "%ld underruns, %ld skips, %" PRIuFAST32 " overflows",
+	     monitor->packets, monitor->frames,
+	     os_atomic_load_long(&monitor->underruns),
+	     os_atomic_load_long(&monitor->skips), monitor->overflows);
 
 	monitor->packets = 0;
 	monitor->frames = 0;
+	monitor->overflows = 0;
 }
 
 static bool audio_monitor_init(struct audio_monitor *monitor,
@@ -440,6 +660,14 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 		return false;
 	}
 
+	monitor->drift = audio_drift_create(get_audio_channels(info->speakers));
+	if (!monitor->drift) {
+		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
+		     "Failed to create drift resampler");
+		return false;
+	}
+	monitor->drift_ratio = 1.0;
+
 	monitor->bytes_per_channel = get_audio_bytes_per_channel(
 		pulseaudio_to_obs_audio_format(monitor->format));
 	monitor->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
@@ -454,17 +682,30 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 		return false;
 	}
 
+	/* the stream buffers what the ring doesn't, one packet of audio
+	 * output and the margin of the ring */
+	const double packet_us = (double)AUDIO_OUTPUT_FRAMES * 1000000.0 /
+				 (double)info->samples_per_sec;
+	const double ring_base_us = packet_us + RING_MARGIN_US;
+	double tlength_us = obs->audio.monitoring_latency * 1000.0 -
+			    ring_base_us;
+	if (tlength_us < MIN_TLENGTH_US)
+		tlength_us = MIN_TLENGTH_US;
+
+	monitor->spec = spec;
+	monitor->ring_base = packet_us / 1000000.0;
+	monitor->ring_margin = RING_MARGIN_US / 1000000.0;
+	monitor->ring_target_bytes = (long)sec_to_bytes(
+		monitor, monitor->ring_base + monitor->ring_margin);
+	monitor->priming = true;
+	ring_init(&monitor->ring,
+		  pa_usec_to_bytes(RING_SIZE_US, &monitor->spec));
+
 	monitor->attr.fragsize = (uint32_t)-1;
 	monitor->attr.maxlength = (uint32_t)-1;
-	monitor->attr.minreq = (uint32_t)-1;
+	monitor->attr.minreq = pa_usec_to_bytes(MINREQ_US, &spec);
 	monitor->attr.prebuf = (uint32_t)-1;
-	monitor->attr.tlength = pa_usec_to_bytes(25000, &spec);
-
-	monitor->buffer_size =
-		monitor->bytes_per_frame * pa_usec_to_bytes(5000, &spec);
-
-	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
-				  PA_STREAM_AUTO_TIMING_UPDATE;
+	monitor->attr.tlength = pa_usec_to_bytes((pa_usec_t)tlength_us, &spec);
 
 	if (pthread_mutex_init(&monitor->playback_mutex, NULL) != 0) {
 		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
@@ -472,31 +713,38 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 		return false;
 	}
 
-	int_fast32_t ret = pulseaudio_connect_playback(
-		monitor->stream, monitor->device, &monitor->attr, flags);
-	if (ret < 0) {
-		pulseaudio_stop_playback(monitor);
-		blog(LOG_ERROR, "Unable to connect to stream");
-		return false;
-	}
-
-	blog(LOG_INFO, "Started Monitoring in '%s'", monitor->device);
 	return true;
 }
 
+/* The stream is connected once the monitor is at its final address, as
+ * its callbacks have to be set before the first write request */
 static void audio_monitor_init_final(struct audio_monitor *monitor)
 {
 	if (monitor->ignore)
 		return;
 
-	obs_source_add_audio_capture_callback(monitor->source,
-					      on_audio_playback, monitor);
-
 	pulseaudio_write_callback(monitor->stream, pulseaudio_stream_write,
 				  (void *)monitor);
 
-	pulseaudio_set_underflow_callback(monitor->stream, pulseaudio_underflow,
-					  (void *)monitor);
+	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
+				  PA_STREAM_AUTO_TIMING_UPDATE |
+				  PA_STREAM_ADJUST_LATENCY;
+
+	int_fast32_t ret = pulseaudio_connect_playback(
+		monitor->stream, monitor->device, &monitor->attr, flags);
+	if (ret < 0) {
+		pulseaudio_stop_playback(monitor);
+		blog(LOG_ERROR, "Unable to connect to stream");
+		return;
+	}
+
+	obs_source_add_audio_capture_callback(monitor->source,
+					      on_audio_playback, monitor);
+
+	blog(LOG_INFO,
+	     "Started Monitoring in '%s' with a target latency of %" PRIu32
+	     " ms",
+	     monitor->device, obs->audio.monitoring_latency);
 }
 
 static inline void audio_monitor_free(struct audio_monitor *monitor)
@@ -508,13 +756,14 @@ static inline void audio_monitor_free(struct audio_monitor *monitor)
 		obs_source_remove_audio_capture_callback(
 			monitor->source, on_audio_playback, monitor);
 
-	audio_resampler_destroy(monitor->resampler);
-	circlebuf_free(&monitor->new_data);
-
 	if (monitor->stream)
 		pulseaudio_stop_playback(monitor);
 	pulseaudio_unref();
 
+	audio_resampler_destroy(monitor->resampler);
+	audio_drift_destroy(monitor->drift);
+	ring_free(&monitor->ring);
+
 	bfree(monitor->device);
 }
 
@@ -570,3 +819,11 @@ void audio_monitor_destroy(struct audio_monitor *monitor)
 		bfree(monitor);
 	}
 }
+
+uint64_t audio_monitor_get_latency(const struct audio_monitor *monitor)
+{
+	if (monitor->ignore || !monitor->stream)
+		return 0;
+
+	return (uint64_t)os_atomic_load_long(&monitor->latency_us) * 1000;
+}
@@ -460,3 +460,11 @@ void audio_monitor_destroy(struct audio_monitor *monitor)
 		bfree(monitor);
 	}
 }
+
+/* the target latency and its measurement are only implemented with
+ * PulseAudio so far */
+uint64_t audio_monitor_get_latency(const struct audio_monitor *monitor)
+{
+	UNUSED_PARAMETER(monitor);
+	return 0;
+}
@@ -15,6 +15,7 @@
  */
 
 #include "../util/darray.h"
+#include "../util/threading.h"
 
 #include "decl.h"
 #include "proc.h"
@@ -33,12 +34,30 @@ static inline void proc_info_free(struct proc_info *pi)
 struct proc_handler {
 	/* TODO: replace with hash table lookup? */
 	DARRAY(struct proc_info) procs;
+
+	/* held while calling, so a procedure is never removed mid-call */
+	pthread_mutex_t mutex;
 };
 
 proc_handler_t *proc_handler_create(void)
 {
-	struct proc_handler *handler = bmalloc(sizeof(struct proc_handler));
+	struct proc_handler *handler;
+	pthread_mutexattr_t attr;
+
+	if (pthread_mutexattr_init(&attr) != 0)
+		return NULL;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		return NULL;
+
+	handler = bmalloc(sizeof(struct proc_handler));
 	da_init(handler->procs);
+
+	if (pthread_mutex_init(&handler->mutex, &attr) != 0) {
+		blog(LOG_ERROR, "Could not create procedure handler");
+		bfree(handler);
+		return NULL;
+	}
+
 	return handler;
 }
 
@@ -48,6 +67,7 @@ void proc_handler_destroy(proc_handler_t *handler)
 		for (size_t i = 0; i < handler->procs.num; i++)
 			proc_info_free(handler->procs.array + i);
 		da_free(handler->procs);
+		pthread_mutex_destroy(&handler->mutex);
 		bfree(handler);
 	}
 }
@@ -70,23 +90,53 @@ void proc_handler_add(proc_handler_t *handler, const char *decl_string,
 	pi.callback = proc;
 	pi.data = data;
 
+	pthread_mutex_lock(&handler->mutex);
 	da_push_back(handler->procs, &pi);
+	pthread_mutex_unlock(&handler->mutex);
+}
+
+void proc_handler_remove(proc_handler_t *handler, const char *name,
+			 proc_handler_proc_t proc, void *data)
+{
+	if (!handler)
+		return;
+
+	pthread_mutex_lock(&handler->mutex);
+
+	for (size_t i = 0; i < handler->procs.num; i++) {
+		struct proc_info *info = handler->procs.array + i;
+
+		if (info->callback == proc && info->data == data &&
+		    strcmp(info->func.name, name) == 0) {
+			proc_info_free(info);
+			da_erase(handler->procs, i);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&handler->mutex);
 }
 
 bool proc_handler_call(proc_handler_t *handler, const char *name,
 		       calldata_t *params)
 {
+	bool found = false;
+
 	if (!handler)
 		return false;
 
+	pthread_mutex_lock(&handler->mutex);
+
 	for (size_t i = 0; i < handler->procs.num; i++) {
 		struct proc_info *info = handler->procs.array + i;
 
 		if (strcmp(info->func.name, name) == 0) {
 			info->callback(info->data, params);
-			return true;
+			found = true;
+			break;
 		}
 	}
 
-	return false;
+	pthread_mutex_unlock(&handler->mutex);
+	return found;
 }
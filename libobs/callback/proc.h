@@ -42,6 +42,13 @@ EXPORT void proc_handler_destroy(proc_handler_t *handler);
 EXPORT void proc_handler_add(proc_handler_t *handler, const char *decl_string,
 			     proc_handler_proc_t proc, void *data);
 
+/**
+ * Removes a procedure added with the same name, callback and data.  Once it
+ * returns, the callback is no longer running and won't be called again.
+ */
+EXPORT void proc_handler_remove(proc_handler_t *handler, const char *name,
+				proc_handler_proc_t proc, void *data);
+
 /**
  * Calls a function in a procedure handler.  Returns false if the named
  * procedure is not found.
@@ -262,6 +262,46 @@ static inline enum gs_color_format convert_format(enum AVPixelFormat format)
 	return GS_BGRX;
 }
 
+bool gs_get_image_file_size(const char *file, uint32_t *cx, uint32_t *cy)
+{
+	AVFormatContext *fmt_ctx = NULL;
+	bool success = false;
+	int ret;
+
+	if (!file || !*file)
+		return false;
+
+	ret = avformat_open_input(&fmt_ctx, file, NULL, NULL);
+	if (ret < 0) {
+		blog(LOG_WARNING, "Failed to open file '%s': %s", file,
+		     av_err2str(ret));
+		return false;
+	}
+
+	ret = avformat_find_stream_info(fmt_ctx, NULL);
+	if (ret >= 0)
+		ret = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1,
+					  NULL, 0);
+	if (ret >= 0) {
+		AVStream *const stream = fmt_ctx->streams[ret];
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
+		*cx = (uint32_t)stream->codecpar->width;
+		*cy = (uint32_t)stream->codecpar->height;
+#else
+		*cx = (uint32_t)stream->codec->width;
+		*cy = (uint32_t)stream->codec->height;
+#endif
+		success = *cx && *cy;
+	}
+
+	if (!success)
+		blog(LOG_WARNING, "Couldn't find image size of file '%s'",
+		     file);
+
+	avformat_close_input(&fmt_ctx);
+	return success;
+}
+
 uint8_t *gs_create_texture_file_data(const char *file,
 				     enum gs_color_format *format,
 				     uint32_t *cx_out, uint32_t *cy_out)
@@ -20,6 +20,41 @@ void gs_free_image_deps()
 	MagickCoreTerminus();
 }
 
+bool gs_get_image_file_size(const char *file, uint32_t *cx, uint32_t *cy)
+{
+	bool success = false;
+	ImageInfo *info;
+	ExceptionInfo *exception;
+	Image *image;
+
+	if (!file || !*file)
+		return false;
+
+	info = CloneImageInfo(NULL);
+	exception = AcquireExceptionInfo();
+
+	/* pinging only reads the attributes, not the pixels */
+	strcpy(info->filename, file);
+	image = PingImage(info, exception);
+	if (image) {
+		*cx = (uint32_t)image->magick_columns;
+		*cy = (uint32_t)image->magick_rows;
+		success = *cx && *cy;
+		DestroyImage(image);
+
+	} else if (exception->severity != UndefinedException) {
+		blog(LOG_WARNING,
+		     "magickcore warning/error reading file "
+		     "'%s': %s",
+		     file, exception->reason);
+	}
+
+	DestroyImageInfo(info);
+	DestroyExceptionInfo(exception);
+
+	return success;
+}
+
 uint8_t *gs_create_texture_file_data(const char *file,
 				     enum gs_color_format *format,
 				     uint32_t *cx_out, uint32_t *cy_out)
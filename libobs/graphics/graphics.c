@@ -88,6 +88,7 @@ void gs_enum_adapters(bool (*callback)(void *param, const char *name,
 
 extern void gs_init_image_deps(void);
 extern void gs_free_image_deps(void);
+extern void gs_image_file_free_cache(void);
 
 bool load_graphics_imports(struct gs_exports *exports, void *module,
 			   const char *module_name);
@@ -222,6 +223,8 @@ void gs_destroy(graphics_t *graphics)
 		thread_graphics = graphics;
 		graphics->exports.device_enter_context(graphics->device);
 
+		gs_image_file_free_cache();
+
 		while (effect) {
 			struct gs_effect *next = effect->next;
 			gs_effect_actually_destroy(effect);
@@ -18,6 +18,9 @@
 #include "image-file.h"
 #include "../util/base.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
+
+#include <sys/stat.h>
 
 #define blog(level, format, ...) \
 	blog(level, "%s: " format, __FUNCTION__, __VA_ARGS__)
@@ -54,6 +57,449 @@ static void bi_def_bitmap_modified(void *bitmap)
 	UNUSED_PARAMETER(bitmap);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Animations with more frames than the frame budget are not cached in full.
+ * Instead, a worker thread decodes the frames that come next in to a ring of
+ * gif_frame_budget frames, and ticking only moves through the ring.  Frames
+ * are numbered by a sequence number that keeps increasing across loops.
+ * Frames [first, decoded) are held in the ring, first being the frame that is
+ * currently displayed, and target the frame that should be displayed, which
+ * can be ahead of what has been decoded when decoding falls behind. */
+
+#define GIF_MIN_FRAME_BUDGET 2
+
+struct gs_gif_stream {
+	gs_image_file_t *image;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	os_event_t *event;
+	volatile bool stop;
+	bool thread_valid;
+
+	uint8_t *data;
+	size_t frame_size;
+	uint32_t size;
+
+	uint64_t first;
+	uint64_t decoded;
+	uint64_t target;
+};
+
+static inline uint8_t *gif_stream_frame(struct gs_gif_stream *stream,
+					uint64_t seq)
+{
+	return stream->data + (seq % stream->size) * stream->frame_size;
+}
+
+static void *gif_stream_thread(void *data)
+{
+	struct gs_gif_stream *stream = data;
+	gs_image_file_t *image = stream->image;
+	unsigned int frame_count = image->gif.frame_count;
+
+	os_set_thread_name("gif stream decode");
+
+	while (os_event_wait(stream->event) == 0) {
+		if (os_atomic_load_bool(&stream->stop))
+			break;
+
+		for (;;) {
+			uint64_t seq;
+			bool full;
+
+			pthread_mutex_lock(&stream->mutex);
+			seq = stream->decoded;
+			full = seq - stream->first >= stream->size;
+			pthread_mutex_unlock(&stream->mutex);
+
+			if (full || os_atomic_load_bool(&stream->stop))
+				break;
+
+			/* frames are composited on top of the previous ones,
+			 * so keep going even if one of them is corrupt */
+			gif_decode_frame(&image->gif,
+					 (unsigned int)(seq % frame_count));
+			memcpy(gif_stream_frame(stream, seq),
+			       image->gif.frame_image, stream->frame_size);
+
+			pthread_mutex_lock(&stream->mutex);
+			stream->decoded++;
+			pthread_mutex_unlock(&stream->mutex);
+		}
+	}
+
+	return NULL;
+}
+
+static void gif_stream_destroy(struct gs_gif_stream *stream)
+{
+	if (!stream)
+		return;
+
+	if (stream->thread_valid) {
+		os_atomic_set_bool(&stream->stop, true);
+		os_event_signal(stream->event);
+		pthread_join(stream->thread, NULL);
+	}
+
+	os_event_destroy(stream->event);
+	pthread_mutex_destroy(&stream->mutex);
+	bfree(stream->data);
+	bfree(stream);
+}
+
+static struct gs_gif_stream *gif_stream_create(gs_image_file_t *image,
+					       uint32_t size)
+{
+	struct gs_gif_stream *stream = bzalloc(sizeof(*stream));
+
+	stream->image = image;
+	stream->size = size;
+	stream->frame_size = (size_t)image->gif.width * image->gif.height * 4;
+	stream->data = bmalloc(stream->frame_size * size);
+
+	/* frame 0 has already been decoded */
+	memcpy(stream->data, image->gif.frame_image, stream->frame_size);
+	stream->decoded = 1;
+
+	pthread_mutex_init_value(&stream->mutex);
+	if (pthread_mutex_init(&stream->mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (pthread_create(&stream->thread, NULL, gif_stream_thread, stream) !=
+	    0)
+		goto fail;
+
+	stream->thread_valid = true;
+	os_event_signal(stream->event);
+	return stream;
+
+fail:
+	gif_stream_destroy(stream);
+	return NULL;
+}
+
+/* moves the displayed frame towards the given animation frame, returns true
+ * if the displayed frame changed */
+static bool gif_stream_seek(struct gs_gif_stream *stream, int frame)
+{
+	uint64_t frame_count = stream->image->gif.frame_count;
+	uint64_t next;
+	bool updated;
+
+	pthread_mutex_lock(&stream->mutex);
+	stream->target += ((uint64_t)frame + frame_count -
+			   stream->target % frame_count) %
+			  frame_count;
+
+	next = stream->target;
+	if (next >= stream->decoded)
+		next = stream->decoded - 1;
+
+	updated = next != stream->first;
+	stream->first = next;
+	pthread_mutex_unlock(&stream->mutex);
+
+	if (updated)
+		os_event_signal(stream->event);
+	return updated;
+}
+
+static uint8_t *gif_stream_current_frame(struct gs_gif_stream *stream)
+{
+	uint8_t *data;
+
+	pthread_mutex_lock(&stream->mutex);
+	data = gif_stream_frame(stream, stream->first);
+	pthread_mutex_unlock(&stream->mutex);
+
+	return data;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Static images loaded through gs_image_file2 are shared by every user of the
+ * same file.  The decoded data and the texture are kept in a process-wide
+ * cache keyed by path, modification time and file size, and reference
+ * counted.  Unused images stay cached for when they are loaded again until
+ * the cache grows past IMAGE_CACHE_LIMIT, at which point the least recently
+ * used ones are evicted until it is back under the limit.  Eviction destroys
+ * textures, so entries with a texture are only evicted from their graphics
+ * context, when images are freed.  Entries without one are also evicted when
+ * images are added.
+ *
+ * Textures belong to the graphics context that created them.  The shared
+ * texture is only handed out within that context, and only destroyed from it.
+ * Images in any other context create a texture of their own, which is
+ * counted in the size of the cache like the shared one.
+ *
+ * The memory of a shared image is added to the mem_usage of the image that
+ * decoded it, and not to that of the images that reuse it, so that adding up
+ * the usage of every image counts it once. */
+
+#define IMAGE_CACHE_LIMIT (256ULL * 1024ULL * 1024ULL)
+
+struct gs_image_cache_entry {
+	char *path;
+	time_t mtime;
+	int64_t file_size;
+	long refs;
+	bool stale;
+
+	enum gs_color_format format;
+	uint32_t cx;
+	uint32_t cy;
+	uint8_t *texture_data;
+	gs_texture_t *texture;
+	graphics_t *graphics;
+	uint64_t mem_usage;
+	uint64_t last_used;
+
+	/* decoded size of the image.  mem_usage counts it once for the shared
+	 * data or texture, and once for each texture of another context */
+	uint64_t size;
+
+	struct gs_image_cache_entry *next;
+};
+
+static pthread_mutex_t image_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct gs_image_cache_entry *image_cache = NULL;
+static uint64_t image_cache_size = 0;
+
+static void image_cache_remove(struct gs_image_cache_entry *entry)
+{
+	struct gs_image_cache_entry **p_entry = &image_cache;
+
+	while (*p_entry && *p_entry != entry)
+		p_entry = &(*p_entry)->next;
+	if (*p_entry)
+		*p_entry = entry->next;
+
+	image_cache_size -= entry->mem_usage;
+
+	gs_texture_destroy(entry->texture);
+	bfree(entry->texture_data);
+	bfree(entry->path);
+	bfree(entry);
+}
+
+static inline void image_cache_add_copy(struct gs_image_cache_entry *entry)
+{
+	entry->mem_usage += entry->size;
+	image_cache_size += entry->size;
+}
+
+static inline void image_cache_remove_copy(struct gs_image_cache_entry *entry)
+{
+	entry->mem_usage -= entry->size;
+	image_cache_size -= entry->size;
+}
+
+static inline bool image_cache_removable(struct gs_image_cache_entry *entry,
+					 graphics_t *graphics)
+{
+	return !entry->refs && (!entry->texture || entry->graphics == graphics);
+}
+
+static void image_cache_evict(void)
+{
+	graphics_t *graphics = gs_get_context();
+
+	while (image_cache_size > IMAGE_CACHE_LIMIT) {
+		struct gs_image_cache_entry *entry = image_cache;
+		struct gs_image_cache_entry *lru = NULL;
+
+		for (; entry; entry = entry->next) {
+			if (!image_cache_removable(entry, graphics))
+				continue;
+			if (!lru || entry->last_used < lru->last_used)
+				lru = entry;
+		}
+
+		if (!lru)
+			break;
+
+		image_cache_remove(lru);
+	}
+}
+
+static inline void image_cache_use(gs_image_file_t *image,
+				   struct gs_image_cache_entry *entry)
+{
+	entry->refs++;
+	entry->last_used = os_gettime_ns();
+
+	image->format = entry->format;
+	image->cx = entry->cx;
+	image->cy = entry->cy;
+	image->cache_entry = entry;
+	image->loaded = true;
+}
+
+static struct gs_image_cache_entry *image_cache_find(const char *path,
+						     const struct stat *st)
+{
+	struct gs_image_cache_entry *entry = image_cache;
+
+	for (; entry; entry = entry->next) {
+		if (entry->stale || strcmp(entry->path, path) != 0)
+			continue;
+
+		/* the file was modified, drop the old image once unused */
+		if (entry->mtime != st->st_mtime ||
+		    entry->file_size != (int64_t)st->st_size) {
+			entry->stale = true;
+			continue;
+		}
+
+		return entry;
+	}
+
+	return NULL;
+}
+
+static bool image_cache_load(gs_image_file_t *image, const char *path,
+			     const struct stat *st)
+{
+	struct gs_image_cache_entry *entry;
+
+	pthread_mutex_lock(&image_cache_mutex);
+	entry = image_cache_find(path, st);
+	if (entry)
+		image_cache_use(image, entry);
+	pthread_mutex_unlock(&image_cache_mutex);
+
+	return !!entry;
+}
+
+/* moves the decoded data of a freshly loaded image in to the cache, returns
+ * false if another user loaded it in the meantime and its data is used
+ * instead */
+static bool image_cache_insert(gs_image_file_t *image, const char *path,
+			       const struct stat *st, uint64_t mem_size)
+{
+	struct gs_image_cache_entry *entry;
+
+	pthread_mutex_lock(&image_cache_mutex);
+
+	entry = image_cache_find(path, st);
+	if (entry) {
+		bfree(image->texture_data);
+		image->texture_data = NULL;
+		image_cache_use(image, entry);
+		pthread_mutex_unlock(&image_cache_mutex);
+		return false;
+	}
+
+	entry = bzalloc(sizeof(*entry));
+	entry->path = bstrdup(path);
+	entry->mtime = st->st_mtime;
+	entry->file_size = (int64_t)st->st_size;
+	entry->format = image->format;
+	entry->cx = image->cx;
+	entry->cy = image->cy;
+	entry->texture_data = image->texture_data;
+	entry->size = mem_size;
+	entry->next = image_cache;
+
+	image_cache = entry;
+	image_cache_add_copy(entry);
+
+	image->texture_data = NULL;
+	image_cache_use(image, entry);
+
+	/* only entries without a texture can go from here, as this is not
+	 * necessarily the graphics thread */
+	image_cache_evict();
+
+	pthread_mutex_unlock(&image_cache_mutex);
+	return true;
+}
+
+static void image_cache_init_texture(gs_image_file_t *image)
+{
+	struct gs_image_cache_entry *entry = image->cache_entry;
+	graphics_t *graphics = gs_get_context();
+	enum gs_color_format format;
+	uint32_t cx, cy;
+	uint8_t *data;
+
+	if (image->texture)
+		return;
+
+	pthread_mutex_lock(&image_cache_mutex);
+	if (!entry->texture) {
+		entry->texture = gs_texture_create(
+			entry->cx, entry->cy, entry->format, 1,
+			(const uint8_t **)&entry->texture_data, 0);
+		if (entry->texture) {
+			entry->graphics = graphics;
+			bfree(entry->texture_data);
+			entry->texture_data = NULL;
+		}
+	}
+	if (entry->graphics == graphics)
+		image->texture = entry->texture;
+	pthread_mutex_unlock(&image_cache_mutex);
+
+	if (image->texture)
+		return;
+
+	/* the shared texture belongs to another graphics context and its data
+	 * is gone, so decode the file again for a texture of this image's own */
+	data = gs_create_texture_file_data(entry->path, &format, &cx, &cy);
+	if (data && format == image->format && cx == image->cx &&
+	    cy == image->cy)
+		image->texture = gs_texture_create(cx, cy, format, 1,
+						   (const uint8_t **)&data, 0);
+	bfree(data);
+
+	if (image->texture) {
+		pthread_mutex_lock(&image_cache_mutex);
+		image_cache_add_copy(entry);
+		pthread_mutex_unlock(&image_cache_mutex);
+	}
+}
+
+static void image_cache_release(gs_image_file_t *image)
+{
+	struct gs_image_cache_entry *entry = image->cache_entry;
+	graphics_t *graphics = gs_get_context();
+
+	pthread_mutex_lock(&image_cache_mutex);
+	if (image->texture && image->texture != entry->texture) {
+		gs_texture_destroy(image->texture);
+		image_cache_remove_copy(entry);
+	}
+	if (--entry->refs == 0 && entry->stale &&
+	    image_cache_removable(entry, graphics))
+		image_cache_remove(entry);
+	image_cache_evict();
+	pthread_mutex_unlock(&image_cache_mutex);
+}
+
+/* called when a graphics context is destroyed, which frees the images whose
+ * texture it holds, and every image without a texture */
+void gs_image_file_free_cache(void)
+{
+	graphics_t *graphics = gs_get_context();
+	struct gs_image_cache_entry **p_entry = &image_cache;
+
+	pthread_mutex_lock(&image_cache_mutex);
+	while (*p_entry) {
+		struct gs_image_cache_entry *entry = *p_entry;
+
+		if (!entry->texture || entry->graphics == graphics)
+			image_cache_remove(entry);
+		else
+			p_entry = &entry->next;
+	}
+	pthread_mutex_unlock(&image_cache_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline int get_full_decoded_gif_size(gs_image_file_t *image)
 {
 	return image->gif.width * image->gif.height * 4 *
@@ -71,7 +517,7 @@ static inline void *alloc_mem(gs_image_file_t *image, uint64_t *mem_usage,
 }
 
 static bool init_animated_gif(gs_image_file_t *image, const char *path,
-			      uint64_t *mem_usage)
+			      uint64_t *mem_usage, uint32_t gif_frame_budget)
 {
 	bool is_animated_gif = true;
 	gif_result result;
@@ -132,7 +578,31 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 	}
 
 	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
-	if (image->is_animated_gif) {
+	if (image->is_animated_gif && gif_frame_budget &&
+	    image->gif.frame_count > gif_frame_budget) {
+		gif_decode_frame(&image->gif, 0);
+
+		image->gif_stream = gif_stream_create(image, gif_frame_budget);
+		if (!image->gif_stream) {
+			blog(LOG_WARNING, "Failed to start decoding gif '%s'",
+			     path);
+			goto fail;
+		}
+
+		if (mem_usage)
+			*mem_usage += image->gif_stream->frame_size *
+				      gif_frame_budget;
+
+		image->cx = (uint32_t)image->gif.width;
+		image->cy = (uint32_t)image->gif.height;
+		image->format = GS_RGBA;
+
+		if (mem_usage) {
+			*mem_usage += image->cx * image->cy * 4;
+			*mem_usage += size;
+		}
+
+	} else if (image->is_animated_gif) {
 		gif_decode_frame(&image->gif, 0);
 
 		image->animation_frame_cache =
@@ -180,8 +650,12 @@ not_animated:
 }
 
 static void gs_image_file_init_internal(gs_image_file_t *image,
-					const char *file, uint64_t *mem_usage)
+					const char *file, uint64_t *mem_usage,
+					uint32_t gif_frame_budget,
+					bool use_cache)
 {
+	struct stat st;
+	uint64_t mem_size;
 	size_t len;
 
 	if (!image)
@@ -195,28 +669,39 @@ static void gs_image_file_init_internal(gs_image_file_t *image,
 	len = strlen(file);
 
 	if (len > 4 && strcmp(file + len - 4, ".gif") == 0) {
-		if (init_animated_gif(image, file, mem_usage))
+		if (init_animated_gif(image, file, mem_usage,
+				      gif_frame_budget))
 			return;
 	}
 
+	if (use_cache && os_stat(file, &st) != 0)
+		use_cache = false;
+	if (use_cache && image_cache_load(image, file, &st))
+		return;
+
 	image->texture_data = gs_create_texture_file_data(
 		file, &image->format, &image->cx, &image->cy);
 
-	if (mem_usage) {
-		*mem_usage += image->cx * image->cy *
-			      gs_get_format_bpp(image->format) / 8;
-	}
+	mem_size = (uint64_t)image->cx * image->cy *
+		   gs_get_format_bpp(image->format) / 8;
 
 	image->loaded = !!image->texture_data;
 	if (!image->loaded) {
 		blog(LOG_WARNING, "Failed to load file '%s'", file);
 		gs_image_file_free(image);
+		return;
 	}
+
+	/* images that reuse data decoded by another image do not count it */
+	if (use_cache && !image_cache_insert(image, file, &st, mem_size))
+		return;
+	if (mem_usage)
+		*mem_usage += mem_size;
 }
 
 void gs_image_file_init(gs_image_file_t *image, const char *file)
 {
-	gs_image_file_init_internal(image, file, NULL);
+	gs_image_file_init_internal(image, file, NULL, 0, false);
 }
 
 void gs_image_file_free(gs_image_file_t *image)
@@ -226,12 +711,16 @@ void gs_image_file_free(gs_image_file_t *image)
 
 	if (image->loaded) {
 		if (image->is_animated_gif) {
+			gif_stream_destroy(image->gif_stream);
 			gif_finalise(&image->gif);
 			bfree(image->animation_frame_cache);
 			bfree(image->animation_frame_data);
 		}
 
-		gs_texture_destroy(image->texture);
+		if (image->cache_entry)
+			image_cache_release(image);
+		else
+			gs_texture_destroy(image->texture);
 	}
 
 	bfree(image->texture_data);
@@ -241,7 +730,20 @@ void gs_image_file_free(gs_image_file_t *image)
 
 void gs_image_file2_init(gs_image_file2_t *if2, const char *file)
 {
-	gs_image_file_init_internal(&if2->image, file, &if2->mem_usage);
+	gs_image_file_init_internal(&if2->image, file, &if2->mem_usage, 0,
+				    true);
+}
+
+void gs_image_file2_init_gif_budget(gs_image_file2_t *if2, const char *file,
+				    uint32_t gif_frame_budget)
+{
+	/* the ring must hold the displayed frame and the one after it, or
+	 * decoding never gets ahead of the displayed frame */
+	if (gif_frame_budget && gif_frame_budget < GIF_MIN_FRAME_BUDGET)
+		gif_frame_budget = GIF_MIN_FRAME_BUDGET;
+
+	gs_image_file_init_internal(&if2->image, file, &if2->mem_usage,
+				    gif_frame_budget, true);
 }
 
 void gs_image_file_init_texture(gs_image_file_t *image)
@@ -249,10 +751,18 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 	if (!image->loaded)
 		return;
 
-	if (image->is_animated_gif) {
-		image->texture = gs_texture_create(
-			image->cx, image->cy, image->format, 1,
-			(const uint8_t **)&image->gif.frame_image, GS_DYNAMIC);
+	if (image->cache_entry) {
+		image_cache_init_texture(image);
+
+	} else if (image->is_animated_gif) {
+		const uint8_t *data =
+			image->gif_stream
+				? gif_stream_current_frame(image->gif_stream)
+				: image->gif.frame_image;
+
+		image->texture = gs_texture_create(image->cx, image->cy,
+						   image->format, 1, &data,
+						   GS_DYNAMIC);
 
 	} else {
 		image->texture = gs_texture_create(
@@ -345,12 +855,20 @@ bool gs_image_file_tick(gs_image_file_t *image, uint64_t elapsed_time_ns)
 		int new_frame =
 			calculate_new_frame(image, elapsed_time_ns, loops);
 
-		if (new_frame != image->cur_frame) {
+		if (image->gif_stream) {
+			image->cur_frame = new_frame;
+
+		} else if (new_frame != image->cur_frame) {
 			decode_new_frame(image, new_frame);
 			return true;
 		}
 	}
 
+	/* also called when the frame did not change, in case decoding fell
+	 * behind and has caught up with the wanted frame since */
+	if (image->gif_stream)
+		return gif_stream_seek(image->gif_stream, image->cur_frame);
+
 	return false;
 }
 
@@ -359,6 +877,15 @@ void gs_image_file_update_texture(gs_image_file_t *image)
 	if (!image->is_animated_gif || !image->loaded)
 		return;
 
+	if (image->gif_stream) {
+		gif_stream_seek(image->gif_stream, image->cur_frame);
+		gs_texture_set_image(
+			image->texture,
+			gif_stream_current_frame(image->gif_stream),
+			image->gif.width * 4, false);
+		return;
+	}
+
 	if (!image->animation_frame_cache[image->cur_frame])
 		decode_new_frame(image, image->cur_frame);
 
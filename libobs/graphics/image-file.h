@@ -24,6 +24,9 @@
 extern "C" {
 #endif
 
+struct gs_gif_stream;
+struct gs_image_cache_entry;
+
 struct gs_image_file {
 	gs_texture_t *texture;
 	enum gs_color_format format;
@@ -44,6 +47,15 @@ struct gs_image_file {
 
 	uint8_t *texture_data;
 	gif_bitmap_callback_vt bitmap_callbacks;
+
+	/* set when the animation is decoded ahead into a ring of frames by a
+	 * worker thread rather than cached in full */
+	struct gs_gif_stream *gif_stream;
+
+	/* set when the image data and texture are shared through the image
+	 * cache, in which case the texture is not owned by this image unless
+	 * the shared one belongs to another graphics context */
+	struct gs_image_cache_entry *cache_entry;
 };
 
 struct gs_image_file2 {
@@ -63,6 +75,9 @@ EXPORT bool gs_image_file_tick(gs_image_file_t *image,
 EXPORT void gs_image_file_update_texture(gs_image_file_t *image);
 
 EXPORT void gs_image_file2_init(gs_image_file2_t *if2, const char *file);
+EXPORT void gs_image_file2_init_gif_budget(gs_image_file2_t *if2,
+					   const char *file,
+					   uint32_t gif_frame_budget);
 
 static void gs_image_file2_free(gs_image_file2_t *if2)
 {
@@ -0,0 +1,116 @@
+#include "audio-io.h"
+#include "audio-buffering.h"
+
+void audio_buffering_free(struct audio_buffering *buf)
+{
+	circlebuf_free(&buf->timestamps);
+}
+
+bool audio_buffering_begin(struct audio_buffering *buf, struct ts_info *ts,
+			   bool catch_up)
+{
+	if (catch_up) {
+		if (!buf->total_ticks || buf->wait_ticks)
+			return false;
+	} else {
+		circlebuf_push_back(&buf->timestamps, ts, sizeof(*ts));
+	}
+
+	circlebuf_peek_front(&buf->timestamps, ts, sizeof(*ts));
+	return true;
+}
+
+int audio_buffering_add(struct audio_buffering *buf, size_t sample_rate,
+			struct ts_info *ts, uint64_t min_ts)
+{
+	struct ts_info new_ts;
+	uint64_t offset;
+	uint64_t frames;
+	int ticks;
+
+	if (buf->total_ticks == AUDIO_BUFFERING_MAX_TICKS)
+		return 0;
+
+	if (!buf->wait_ticks)
+		buf->buffered_ts = ts->start;
+
+	buf->headroom_ts = 0;
+
+	offset = ts->start - min_ts;
+	frames = ns_to_audio_frames(sample_rate, offset);
+	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+
+	buf->total_ticks += ticks;
+
+	if (buf->total_ticks >= AUDIO_BUFFERING_MAX_TICKS) {
+		ticks -= buf->total_ticks - AUDIO_BUFFERING_MAX_TICKS;
+		buf->total_ticks = AUDIO_BUFFERING_MAX_TICKS;
+	}
+
+	new_ts.start = buf->buffered_ts -
+		       audio_frames_to_ns(sample_rate,
+					  buf->wait_ticks * AUDIO_OUTPUT_FRAMES);
+
+	for (int i = 0; i < ticks; i++) {
+		frames = (uint64_t)++buf->wait_ticks * AUDIO_OUTPUT_FRAMES;
+
+		new_ts.end = new_ts.start;
+		new_ts.start = buf->buffered_ts -
+			       audio_frames_to_ns(sample_rate, frames);
+
+		circlebuf_push_front(&buf->timestamps, &new_ts,
+				     sizeof(new_ts));
+	}
+
+	*ts = new_ts;
+	return ticks;
+}
+
+static bool can_release(struct audio_buffering *buf, size_t sample_rate,
+			const struct ts_info *ts, uint64_t headroom)
+{
+	const uint64_t packet =
+		audio_frames_to_ns(sample_rate, AUDIO_OUTPUT_FRAMES);
+	bool release;
+
+	if (!buf->total_ticks || buf->wait_ticks) {
+		buf->headroom_ts = 0;
+		return false;
+	}
+
+	if (!buf->headroom_ts) {
+		buf->headroom_ts = ts->end;
+		buf->min_headroom = headroom;
+		return false;
+	}
+
+	if (headroom < buf->min_headroom)
+		buf->min_headroom = headroom;
+	if (ts->end - buf->headroom_ts < AUDIO_BUFFERING_RELEASE_TIME)
+		return false;
+
+	release = buf->min_headroom >= 2 * packet;
+	buf->headroom_ts = 0;
+	return release;
+}
+
+bool audio_buffering_end(struct audio_buffering *buf, size_t sample_rate,
+			 const struct ts_info *ts, uint64_t headroom,
+			 bool catch_up, bool *release)
+{
+	circlebuf_pop_front(&buf->timestamps, NULL, sizeof(*ts));
+
+	if (catch_up) {
+		buf->total_ticks--;
+		*release = false;
+	} else {
+		*release = can_release(buf, sample_rate, ts, headroom);
+	}
+
+	if (buf->wait_ticks) {
+		buf->wait_ticks--;
+		return false;
+	}
+
+	return true;
+}
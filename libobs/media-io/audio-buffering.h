@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../util/c99defs.h"
+#include "../util/circlebuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Audio buffering of the mix.  When the audio of a source comes in too late
+ * for the packet being mixed, the mix is pushed back by whole packets, whose
+ * time spans are queued here until they are mixed.  Buffering that goes
+ * unused is given back a packet at a time, once every source has stayed at
+ * least two packets ahead of the mix for AUDIO_BUFFERING_RELEASE_TIME, by
+ * mixing an extra packet without adding one (see audio_output_catch_up). */
+
+#define AUDIO_BUFFERING_MAX_TICKS 45
+#define AUDIO_BUFFERING_RELEASE_TIME 10000000000ULL
+
+struct ts_info {
+	uint64_t start;
+	uint64_t end;
+};
+
+struct audio_buffering {
+	uint64_t buffered_ts;
+	struct circlebuf timestamps;
+	int wait_ticks;
+	int total_ticks;
+
+	/* least audio the sources had ahead of the mix since headroom_ts */
+	uint64_t min_headroom;
+	uint64_t headroom_ts;
+};
+
+EXPORT void audio_buffering_free(struct audio_buffering *buf);
+
+/* Queues the time span of a new packet, unless it is a catch up packet, and
+ * replaces it with the one to mix.  Returns false for a catch up packet with
+ * no buffering to give back. */
+EXPORT bool audio_buffering_begin(struct audio_buffering *buf,
+				  struct ts_info *ts, bool catch_up);
+
+/* Pushes the mix back far enough for audio starting at min_ts, replacing ts
+ * with the packet to mix.  Returns the number of packets added. */
+EXPORT int audio_buffering_add(struct audio_buffering *buf,
+			       size_t sample_rate, struct ts_info *ts,
+			       uint64_t min_ts);
+
+/* Ends the packet from audio_buffering_begin.  A catch up packet gives back
+ * a packet of buffering.  Otherwise headroom, how far the audio of the
+ * sources goes past the end of the packet, decides whether one can be given
+ * back, which sets release.  Returns false while buffering is being added,
+ * when the packet is not output. */
+EXPORT bool audio_buffering_end(struct audio_buffering *buf,
+				size_t sample_rate, const struct ts_info *ts,
+				uint64_t headroom, bool catch_up,
+				bool *release);
+
+#ifdef __cplusplus
+}
+#endif
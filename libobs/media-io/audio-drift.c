@@ -0,0 +1,299 @@
+#include <math.h>
+#include <string.h>
+
+#include "../util/bmem.h"
+#include "audio-io.h"
+#include "audio-resampler-native.h"
+#include "audio-drift.h"
+
+/* phases of the filter bank, the coefficients of the phases in between are
+ * interpolated linearly */
+#define PHASES 256
+
+/* Each channel keeps the input it has not consumed yet.  pos is the start of
+ * the filter window of the next output frame, relative to the first frame
+ * kept, and its fraction the phase.  Windows are centered taps / 2 - 1
+ * frames in.  A reset fills a window but one frame with silence, so that
+ * output comes out as soon as input goes in, delayed by taps / 2 frames. */
+struct audio_drift {
+	struct filter_bank *bank;
+	size_t center;
+	float *coeffs;
+
+	uint32_t channels;
+	double pos;
+
+	float *input[MAX_AUDIO_CHANNELS];
+	size_t input_frames;
+	size_t input_capacity;
+
+	float *output[MAX_AUDIO_CHANNELS];
+	size_t output_capacity;
+};
+
+static void reserve_planes(float **planes, size_t *capacity, size_t frames,
+			   uint32_t channels)
+{
+	if (frames <= *capacity)
+		return;
+
+	for (uint32_t c = 0; c < channels; c++)
+		planes[c] = brealloc(planes[c], frames * sizeof(float));
+	*capacity = frames;
+}
+
+audio_drift_t *audio_drift_create(uint32_t channels)
+{
+	struct audio_drift *drift;
+
+	if (!channels || channels > MAX_AUDIO_CHANNELS)
+		return NULL;
+
+	drift = bzalloc(sizeof(struct audio_drift));
+	drift->bank = native_filter_bank_get(PHASES, PHASES);
+	drift->center = drift->bank->taps / 2 - 1;
+	drift->coeffs = bmalloc(drift->bank->taps * sizeof(float));
+	drift->channels = channels;
+	reserve_planes(drift->input, &drift->input_capacity,
+		       drift->bank->taps - 1, channels);
+	audio_drift_reset(drift);
+	return drift;
+}
+
+void audio_drift_destroy(audio_drift_t *drift)
+{
+	if (!drift)
+		return;
+
+	for (uint32_t c = 0; c < drift->channels; c++) {
+		bfree(drift->input[c]);
+		bfree(drift->output[c]);
+	}
+	native_filter_bank_release(drift->bank);
+	bfree(drift->coeffs);
+	bfree(drift);
+}
+
+void audio_drift_reset(audio_drift_t *drift)
+{
+	size_t frames;
+
+	if (!drift)
+		return;
+
+	frames = drift->bank->taps - 1;
+	for (uint32_t c = 0; c < drift->channels; c++)
+		memset(drift->input[c], 0, frames * sizeof(float));
+	drift->input_frames = frames;
+	drift->pos = 0.0;
+}
+
+/* coefficients between phase p and the next one, the phase after the last
+ * being the first one a frame later */
+static void interpolate_phase(struct audio_drift *drift, uint32_t p, float t)
+{
+	const struct filter_bank *bank = drift->bank;
+	const size_t taps = bank->taps;
+	const float *a = bank->coeffs + p * taps;
+	float *h = drift->coeffs;
+
+	if (p + 1 < bank->phases) {
+		const float *b = a + taps;
+
+		for (size_t k = 0; k < taps; k++)
+			h[k] = a[k] + (b[k] - a[k]) * t;
+	} else {
+		const float *b = bank->coeffs;
+
+		/* the window is zero at both ends, so nothing falls off */
+		h[0] = a[0] * (1.0f - t);
+		for (size_t k = 1; k < taps; k++)
+			h[k] = a[k] + (b[k - 1] - a[k]) * t;
+	}
+}
+
+/* copies whole frames, snapping to the nearest one */
+static size_t copy_frames(struct audio_drift *drift, size_t avail)
+{
+	const size_t taps = drift->bank->taps;
+	const size_t start = (size_t)floor(drift->pos + 0.5);
+	const size_t first = start + drift->center;
+	size_t count;
+
+	if (start + taps > avail) {
+		drift->pos = (double)start;
+		return 0;
+	}
+
+	count = avail - taps - start + 1;
+	for (uint32_t c = 0; c < drift->channels; c++)
+		memcpy(drift->output[c], drift->input[c] + first,
+		       count * sizeof(float));
+
+	drift->pos = (double)(start + count);
+	return count;
+}
+
+static size_t filter_frames(struct audio_drift *drift, size_t avail,
+			    size_t max_out, double step)
+{
+	const size_t taps = drift->bank->taps;
+	double pos = drift->pos;
+	size_t count = 0;
+
+	while ((size_t)pos + taps <= avail && count < max_out) {
+		const size_t idx = (size_t)pos;
+		const double phase = (pos - (double)idx) * PHASES;
+		const uint32_t p = (uint32_t)phase;
+
+		interpolate_phase(drift, p, (float)(phase - (double)p));
+
+		for (uint32_t c = 0; c < drift->channels; c++)
+			drift->output[c][count] = filter_dot_product(
+				drift->input[c] + idx, drift->coeffs, taps);
+
+		count++;
+		pos += step;
+	}
+
+	drift->pos = pos;
+	return count;
+}
+
+bool audio_drift_process(audio_drift_t *drift, double ratio, float *output[],
+			 uint32_t *out_frames, const float *const input[],
+			 uint32_t in_frames)
+{
+	size_t avail, max_out, count, consumed;
+
+	if (!drift || !output || !out_frames || !input)
+		return false;
+
+	if (ratio < 1.0 - AUDIO_DRIFT_MAX_RATIO)
+		ratio = 1.0 - AUDIO_DRIFT_MAX_RATIO;
+	else if (ratio > 1.0 + AUDIO_DRIFT_MAX_RATIO)
+		ratio = 1.0 + AUDIO_DRIFT_MAX_RATIO;
+
+	avail = drift->input_frames + in_frames;
+	reserve_planes(drift->input, &drift->input_capacity, avail,
+		       drift->channels);
+
+	for (uint32_t c = 0; c < drift->channels; c++)
+		memcpy(drift->input[c] + drift->input_frames, input[c],
+		       in_frames * sizeof(float));
+
+	max_out = (size_t)((double)avail * ratio) + 1;
+	reserve_planes(drift->output, &drift->output_capacity, max_out,
+		       drift->channels);
+
+	if (ratio == 1.0)
+		count = copy_frames(drift, avail);
+	else
+		count = filter_frames(drift, avail, max_out, 1.0 / ratio);
+
+	/* keep the input from the next window on */
+	consumed = (size_t)drift->pos;
+	if (consumed > avail)
+		consumed = avail;
+
+	for (uint32_t c = 0; c < drift->channels; c++)
+		memmove(drift->input[c], drift->input[c] + consumed,
+			(avail - consumed) * sizeof(float));
+	drift->input_frames = avail - consumed;
+	drift->pos -= (double)consumed;
+
+	for (uint32_t c = 0; c < drift->channels; c++)
+		output[c] = drift->output[c];
+	*out_frames = (uint32_t)count;
+	return true;
+}
+
+uint64_t audio_drift_get_delay_ns(const audio_drift_t *drift,
+				  uint32_t sample_rate)
+{
+	double delay;
+
+	if (!drift || !sample_rate)
+		return 0;
+
+	delay = (double)drift->input_frames - (double)drift->center -
+		drift->pos;
+	if (delay <= 0.0)
+		return 0;
+
+	return (uint64_t)(delay * 1000000000.0 / sample_rate);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Gains of the controller (error in seconds), and the furthest it will
+ * take the ratio from 1, well above the drift of any real clock */
+#define CLOCK_KP 0.1
+#define CLOCK_KI 0.0025
+#define CLOCK_MAX_CORRECTION 0.005
+
+/* timestamps jitter far more than the clocks drift */
+#define CLOCK_ERROR_SMOOTHING 1.0
+
+/* Corrections under 20 ppm (a frame a second at 48 kHz) bypass the filter,
+ * which is only used again once they are twice that.  Above the noise the
+ * jitter of the timestamps puts on the correction, and far enough apart
+ * that a correction hovering around the threshold doesn't keep switching. */
+#define CLOCK_DEADBAND 0.00002
+
+void audio_drift_clock_init(struct audio_drift_clock *clock)
+{
+	clock->error = 0.0;
+	clock->integral = 0.0;
+	clock->ratio = 1.0;
+}
+
+void audio_drift_clock_reset_error(struct audio_drift_clock *clock)
+{
+	clock->error = 0.0;
+}
+
+double audio_drift_clock_update(struct audio_drift_clock *clock,
+				int64_t error_ns, uint32_t frames,
+				uint32_t sample_rate)
+{
+	const double error = (double)error_ns / 1000000000.0;
+	const double max_integral = CLOCK_MAX_CORRECTION / CLOCK_KI;
+	const bool bypassed = clock->ratio == 1.0;
+	double correction;
+	double dt;
+
+	if (!sample_rate)
+		return clock->ratio;
+
+	dt = (double)frames / (double)sample_rate;
+
+	clock->error += (error - clock->error) * dt /
+			(dt + CLOCK_ERROR_SMOOTHING);
+
+	/* While bypassed there is no drift estimate: what is left of the
+	 * error when the filter stopped would only wind it up until it starts
+	 * again.  Real drift still gets there through the error. */
+	if (!bypassed) {
+		clock->integral += clock->error * dt;
+		if (clock->integral > max_integral)
+			clock->integral = max_integral;
+		else if (clock->integral < -max_integral)
+			clock->integral = -max_integral;
+	}
+
+	correction = CLOCK_KP * clock->error + CLOCK_KI * clock->integral;
+	if (correction > CLOCK_MAX_CORRECTION)
+		correction = CLOCK_MAX_CORRECTION;
+	else if (correction < -CLOCK_MAX_CORRECTION)
+		correction = -CLOCK_MAX_CORRECTION;
+
+	/* timestamps ahead of the sample count mean too few samples */
+	if (fabs(correction) < (bypassed ? 2.0 : 1.0) * CLOCK_DEADBAND) {
+		clock->integral = 0.0;
+		clock->ratio = 1.0;
+	} else {
+		clock->ratio = 1.0 + correction;
+	}
+	return clock->ratio;
+}
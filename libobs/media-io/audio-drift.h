@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Resamples planar float audio by a ratio very close to 1, to follow the
+ * drift between two clocks of the same nominal rate.  The ratio can change
+ * with every call without discontinuities.  Uses the windowed sinc filters
+ * of the native resampler, interpolated between its phases.  A ratio of
+ * exactly 1 copies the input through unfiltered, with the same delay, so
+ * that a stream which does not drift is left untouched. */
+
+struct audio_drift;
+typedef struct audio_drift audio_drift_t;
+
+/* furthest a ratio can be from 1 */
+#define AUDIO_DRIFT_MAX_RATIO 0.05
+
+EXPORT audio_drift_t *audio_drift_create(uint32_t channels);
+EXPORT void audio_drift_destroy(audio_drift_t *drift);
+
+/* Drops the filter history, for discontinuities in the input */
+EXPORT void audio_drift_reset(audio_drift_t *drift);
+
+/* ratio is output frames per input frame.  The output planes are owned by
+ * the object and valid until the next call. */
+EXPORT bool audio_drift_process(audio_drift_t *drift, double ratio,
+				float *output[], uint32_t *out_frames,
+				const float *const input[], uint32_t in_frames);
+
+/* How far the first output frame of the next call is behind the first
+ * input frame given to it, like the offset of audio_resampler_resample */
+EXPORT uint64_t audio_drift_get_delay_ns(const audio_drift_t *drift,
+					 uint32_t sample_rate);
+
+/* Clock recovery: a PI controller turning the error between the timestamps
+ * of a stream and the time its sample count adds up to into the ratio to
+ * resample it by.  Corrections too small to matter give a ratio of exactly
+ * 1, which bypasses the filter. */
+struct audio_drift_clock {
+	double error;
+	double integral;
+	double ratio;
+};
+
+EXPORT void audio_drift_clock_init(struct audio_drift_clock *clock);
+
+/* Forgets the error after a timestamp jump.  The drift estimate held by
+ * the integral stays valid. */
+EXPORT void audio_drift_clock_reset_error(struct audio_drift_clock *clock);
+
+/* error_ns is how far the timestamp of a packet of frames is ahead of the
+ * end of the audio before it.  Returns the new ratio. */
+EXPORT double audio_drift_clock_update(struct audio_drift_clock *clock,
+				       int64_t error_ns, uint32_t frames,
+				       uint32_t sample_rate);
+
+#ifdef __cplusplus
+}
+#endif
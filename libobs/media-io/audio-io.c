@@ -70,6 +70,8 @@ struct audio_output {
 	void *input_param;
 	pthread_mutex_t input_mutex;
 	struct audio_mix mixes[MAX_AUDIO_MIXES];
+
+	volatile bool catch_up;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -227,6 +229,9 @@ static void *audio_thread(void *param)
 
 			input_and_output(audio, audio_time, prev_time);
 			prev_time = audio_time;
+
+			if (os_atomic_exchange_bool(&audio->catch_up, false))
+				input_and_output(audio, audio_time, audio_time);
 		}
 
 		profile_end(audio_thread_name);
@@ -422,6 +427,12 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+void audio_output_catch_up(audio_t *audio)
+{
+	if (audio)
+		os_atomic_set_bool(&audio->catch_up, true);
+}
+
 bool audio_output_active(const audio_t *audio)
 {
 	if (!audio)
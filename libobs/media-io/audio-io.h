@@ -229,6 +229,12 @@ EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
 EXPORT const struct audio_output_info *
 audio_output_get_info(const audio_t *audio);
 
+/* Makes the audio thread ask the input callback for one more packet right
+ * after the current one, with start_ts equal to end_ts.  Lets an input that
+ * buffers audio give a packet of it back without a gap in the timestamps of
+ * the output. */
+EXPORT void audio_output_catch_up(audio_t *audio);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,13 +16,17 @@
 ******************************************************************************/
 
 #include "../util/bmem.h"
+#include "../util/threading.h"
 #include "audio-resampler.h"
+#include "audio-resampler-native.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
 struct audio_resampler {
+	struct native_resampler *native;
+
 	struct SwrContext *context;
 	bool opened;
 
@@ -39,6 +43,18 @@ struct audio_resampler {
 	uint32_t output_planes;
 };
 
+static volatile long resampler_type = AUDIO_RESAMPLER_SWRESAMPLE;
+
+void audio_resampler_set_type(enum audio_resampler_type type)
+{
+	os_atomic_set_long(&resampler_type, (long)type);
+}
+
+enum audio_resampler_type audio_resampler_get_type(void)
+{
+	return (enum audio_resampler_type)os_atomic_load_long(&resampler_type);
+}
+
 static inline enum AVSampleFormat convert_audio_format(enum audio_format format)
 {
 	switch (format) {
@@ -97,6 +113,12 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	struct audio_resampler *rs = bzalloc(sizeof(struct audio_resampler));
 	int errcode;
 
+	if (audio_resampler_get_type() == AUDIO_RESAMPLER_NATIVE) {
+		rs->native = native_resampler_create(dst, src);
+		if (rs->native)
+			return rs;
+	}
+
 	rs->opened = false;
 	rs->input_freq = src->samples_per_sec;
 	rs->input_layout = convert_speaker_layout(src->speakers);
@@ -151,6 +173,7 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 void audio_resampler_destroy(audio_resampler_t *rs)
 {
 	if (rs) {
+		native_resampler_destroy(rs->native);
 		if (rs->context)
 			swr_free(&rs->context);
 		if (rs->output_buffer[0])
@@ -166,6 +189,9 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 {
 	if (!rs)
 		return false;
+	if (rs->native)
+		return native_resampler_resample(rs->native, output, out_frames,
+						 ts_offset, input, in_frames);
 
 	struct SwrContext *context = rs->context;
 	int ret;
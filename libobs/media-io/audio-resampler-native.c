@@ -0,0 +1,679 @@
+#include <math.h>
+
+#include "../util/bmem.h"
+#include "../util/darray.h"
+#include "../util/threading.h"
+#include "audio-resampler-native.h"
+
+/* Polyphase resampler.  Output sample n is interpolated at input time
+ * n * step / phases (the rate ratio reduced by its gcd) from a windowed sinc
+ * filter, with one precomputed set of coefficients for each of the phases.
+ * Filter banks depend only on the ratio, so they are shared between all
+ * resamplers that convert between the same rates. */
+
+/* filter length when upsampling, grows with the downsampling ratio */
+#define BASE_TAPS 64
+#define MAX_PHASES 1024
+#define MAX_DOWNSAMPLE_RATIO 4
+
+/* relative to the lower of the two nyquist frequencies */
+#define CUTOFF 0.92
+#define KAISER_BETA 8.5
+
+#define PI 3.14159265358979323846
+
+struct sample_buffer {
+	float *planes[MAX_AUDIO_CHANNELS];
+	size_t channels;
+	size_t capacity;
+};
+
+struct native_resampler {
+	struct filter_bank *bank;
+	uint32_t input_freq;
+
+	enum audio_format input_format;
+	uint32_t input_ch;
+	bool output_planar;
+	uint32_t output_ch;
+
+	/* remixing is done on the side with fewer channels */
+	bool remix;
+	bool remix_first;
+	float matrix[MAX_AUDIO_CHANNELS][MAX_AUDIO_CHANNELS];
+
+	/* filter state: input not consumed yet and phase of the next output */
+	struct sample_buffer history;
+	size_t history_frames;
+	uint32_t phase;
+
+	struct sample_buffer converted;
+	struct sample_buffer resampled;
+	struct sample_buffer remixed;
+	float *packed;
+	size_t packed_capacity;
+};
+
+static pthread_mutex_t bank_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct filter_bank *) filter_banks = {0};
+
+/* -------------------------------------------------------- */
+/* filter banks                                              */
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* modified bessel function of the first kind, order 0 */
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (int k = 1; k < 50; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+static void build_filter_bank(struct filter_bank *bank)
+{
+	const double ratio = (double)bank->phases / (double)bank->step;
+	const double fc = CUTOFF * (ratio < 1.0 ? ratio : 1.0);
+	const double half = bank->taps / 2.0;
+	const double center = half - 1.0;
+	const double i0_beta = bessel_i0(KAISER_BETA);
+
+	bank->coeffs = bmalloc(sizeof(float) * bank->phases * bank->taps);
+
+	for (uint32_t p = 0; p < bank->phases; p++) {
+		float *h = bank->coeffs + p * bank->taps;
+		double frac = (double)p / (double)bank->phases;
+		double sum = 0.0;
+
+		for (uint32_t k = 0; k < bank->taps; k++) {
+			double t = (double)k - center - frac;
+			double x = t / half;
+			double w = 0.0;
+			double s = fc;
+
+			if (x > -1.0 && x < 1.0)
+				w = bessel_i0(KAISER_BETA * sqrt(1.0 - x * x)) /
+				    i0_beta;
+			if (t != 0.0)
+				s = sin(PI * fc * t) / (PI * t);
+
+			h[k] = (float)(s * w);
+			sum += s * w;
+		}
+
+		/* unity gain at DC for every phase */
+		for (uint32_t k = 0; k < bank->taps; k++)
+			h[k] = (float)(h[k] / sum);
+	}
+}
+
+struct filter_bank *native_filter_bank_get(uint32_t phases, uint32_t step)
+{
+	struct filter_bank *bank = NULL;
+
+	pthread_mutex_lock(&bank_mutex);
+
+	for (size_t i = 0; i < filter_banks.num; i++) {
+		struct filter_bank *cur = filter_banks.array[i];
+		if (cur->phases == phases && cur->step == step) {
+			bank = cur;
+			break;
+		}
+	}
+
+	if (!bank) {
+		uint32_t taps = BASE_TAPS;
+		if (step > phases)
+			taps = (BASE_TAPS * step + phases - 1) / phases;
+
+		bank = bzalloc(sizeof(*bank));
+		bank->phases = phases;
+		bank->step = step;
+		bank->taps = (taps + 7) & ~7;
+		build_filter_bank(bank);
+
+		da_push_back(filter_banks, &bank);
+	}
+
+	bank->refs++;
+	pthread_mutex_unlock(&bank_mutex);
+	return bank;
+}
+
+void native_filter_bank_release(struct filter_bank *bank)
+{
+	if (!bank)
+		return;
+
+	pthread_mutex_lock(&bank_mutex);
+	if (--bank->refs == 0) {
+		da_erase_item(filter_banks, &bank);
+		if (!filter_banks.num)
+			da_free(filter_banks);
+
+		bfree(bank->coeffs);
+		bfree(bank);
+	}
+	pthread_mutex_unlock(&bank_mutex);
+}
+
+/* -------------------------------------------------------- */
+/* channel remixing                                          */
+
+enum speaker_pos {
+	POS_FL,
+	POS_FR,
+	POS_FC,
+	POS_LFE,
+	POS_BL,
+	POS_BR,
+	POS_BC,
+	POS_SL,
+	POS_SR,
+	POS_NONE,
+};
+
+/* channel positions in the order of the FFmpeg layouts the swresample path
+ * maps each speaker layout to, so that both mix channels the same way */
+static const enum speaker_pos positions[][MAX_AUDIO_CHANNELS] = {
+	[SPEAKERS_MONO] = {POS_FC},
+	[SPEAKERS_STEREO] = {POS_FL, POS_FR},
+	[SPEAKERS_2POINT1] = {POS_FL, POS_FR, POS_FC},
+	[SPEAKERS_4POINT0] = {POS_FL, POS_FR, POS_FC, POS_BC},
+	[SPEAKERS_4POINT1] = {POS_FL, POS_FR, POS_FC, POS_LFE, POS_BC},
+	[SPEAKERS_5POINT1] = {POS_FL, POS_FR, POS_FC, POS_LFE, POS_BL, POS_BR},
+	[SPEAKERS_7POINT1] = {POS_FL, POS_FR, POS_FC, POS_LFE, POS_BL, POS_BR,
+			      POS_SL, POS_SR},
+};
+
+/* same as the mono upmix matrix of the swresample path */
+static const float mono_upmix[MAX_AUDIO_CHANNELS][MAX_AUDIO_CHANNELS] = {
+	{1},
+	{1, 1},
+	{1, 1, 0},
+	{1, 1, 1, 1},
+	{1, 1, 1, 0, 1},
+	{1, 1, 1, 1, 1, 1},
+	{1, 1, 1, 0, 1, 1, 1},
+	{1, 1, 1, 0, 1, 1, 1, 1},
+};
+
+#define SQRT1_2 0.70710678f
+
+struct layout_map {
+	int channel[POS_NONE];
+};
+
+static void get_layout_map(struct layout_map *map, enum speaker_layout layout)
+{
+	uint32_t channels = get_audio_channels(layout);
+
+	for (size_t i = 0; i < POS_NONE; i++)
+		map->channel[i] = -1;
+	for (uint32_t i = 0; i < channels; i++)
+		map->channel[positions[layout][i]] = (int)i;
+}
+
+static inline bool has_pos(const struct layout_map *map, enum speaker_pos pos)
+{
+	return map->channel[pos] != -1;
+}
+
+static inline void mix_to(struct native_resampler *rs,
+			  const struct layout_map *out, enum speaker_pos pos,
+			  uint32_t in_ch, float level)
+{
+	rs->matrix[out->channel[pos]][in_ch] += level;
+}
+
+/* mixes a pair of channels (left in_l/right in_r) into the first available
+ * output pair or center */
+static void mix_pair(struct native_resampler *rs, const struct layout_map *out,
+		     int in_l, int in_r, enum speaker_pos pos_l,
+		     enum speaker_pos pos_r, float pair_level,
+		     float center_level)
+{
+	if (has_pos(out, pos_l)) {
+		mix_to(rs, out, pos_l, in_l, pair_level);
+		mix_to(rs, out, pos_r, in_r, pair_level);
+	} else {
+		mix_to(rs, out, POS_FC, in_l, center_level);
+		mix_to(rs, out, POS_FC, in_r, center_level);
+	}
+}
+
+/* Default downmix coefficients of swresample (center and surround mix levels
+ * of -3 dB, LFE dropped, no normalization for float output) */
+static void build_matrix(struct native_resampler *rs,
+			 enum speaker_layout out_layout,
+			 enum speaker_layout in_layout)
+{
+	struct layout_map in, out;
+
+	if (in_layout == SPEAKERS_MONO) {
+		for (uint32_t i = 0; i < rs->output_ch; i++)
+			rs->matrix[i][0] = mono_upmix[rs->output_ch - 1][i];
+		return;
+	}
+
+	get_layout_map(&in, in_layout);
+	get_layout_map(&out, out_layout);
+
+	for (uint32_t i = 0; i < rs->input_ch; i++) {
+		enum speaker_pos pos = positions[in_layout][i];
+
+		if (has_pos(&out, pos)) {
+			mix_to(rs, &out, pos, i, 1.0f);
+			continue;
+		}
+
+		switch (pos) {
+		case POS_FL:
+		case POS_FR:
+			mix_to(rs, &out, POS_FC, i, SQRT1_2);
+			break;
+		case POS_FC:
+			mix_to(rs, &out, POS_FL, i, SQRT1_2);
+			mix_to(rs, &out, POS_FR, i, SQRT1_2);
+			break;
+		case POS_BC:
+			if (has_pos(&out, POS_BL)) {
+				mix_to(rs, &out, POS_BL, i, SQRT1_2);
+				mix_to(rs, &out, POS_BR, i, SQRT1_2);
+			} else if (has_pos(&out, POS_SL)) {
+				mix_to(rs, &out, POS_SL, i, SQRT1_2);
+				mix_to(rs, &out, POS_SR, i, SQRT1_2);
+			} else if (has_pos(&out, POS_FL)) {
+				mix_to(rs, &out, POS_FL, i, SQRT1_2 * SQRT1_2);
+				mix_to(rs, &out, POS_FR, i, SQRT1_2 * SQRT1_2);
+			} else {
+				mix_to(rs, &out, POS_FC, i, SQRT1_2 * SQRT1_2);
+			}
+			break;
+		case POS_LFE:
+		case POS_NONE:
+		default:
+			break;
+		}
+	}
+
+	/* surround pairs */
+	if (has_pos(&in, POS_BL) && !has_pos(&out, POS_BL)) {
+		int l = in.channel[POS_BL];
+		int r = in.channel[POS_BR];
+
+		if (has_pos(&out, POS_BC)) {
+			mix_to(rs, &out, POS_BC, l, SQRT1_2);
+			mix_to(rs, &out, POS_BC, r, SQRT1_2);
+		} else if (has_pos(&out, POS_SL)) {
+			mix_pair(rs, &out, l, r, POS_SL, POS_SR, 1.0f, 0.0f);
+		} else {
+			mix_pair(rs, &out, l, r, POS_FL, POS_FR, SQRT1_2,
+				 SQRT1_2 * SQRT1_2);
+		}
+	}
+
+	if (has_pos(&in, POS_SL) && !has_pos(&out, POS_SL)) {
+		int l = in.channel[POS_SL];
+		int r = in.channel[POS_SR];
+
+		if (has_pos(&out, POS_BL)) {
+			mix_pair(rs, &out, l, r, POS_BL, POS_BR, 1.0f, 0.0f);
+		} else if (has_pos(&out, POS_BC)) {
+			mix_to(rs, &out, POS_BC, l, SQRT1_2);
+			mix_to(rs, &out, POS_BC, r, SQRT1_2);
+		} else {
+			mix_pair(rs, &out, l, r, POS_FL, POS_FR, SQRT1_2,
+				 SQRT1_2 * SQRT1_2);
+		}
+	}
+}
+
+static void remix(float *const *dst, const float *const *src,
+		  const float (*matrix)[MAX_AUDIO_CHANNELS], uint32_t out_ch,
+		  uint32_t in_ch, size_t frames)
+{
+	for (uint32_t o = 0; o < out_ch; o++) {
+		float *out = dst[o];
+		bool first = true;
+
+		for (uint32_t i = 0; i < in_ch; i++) {
+			const float *in = src[i];
+			const float level = matrix[o][i];
+			const __m128 level_v = _mm_set1_ps(level);
+			size_t j = 0;
+
+			if (level == 0.0f)
+				continue;
+
+			if (first) {
+				for (; j + 3 < frames; j += 4) {
+					__m128 v = _mm_loadu_ps(in + j);
+					_mm_storeu_ps(out + j,
+						      _mm_mul_ps(v, level_v));
+				}
+				for (; j < frames; j++)
+					out[j] = in[j] * level;
+			} else {
+				for (; j + 3 < frames; j += 4) {
+					__m128 v = _mm_loadu_ps(in + j);
+					__m128 acc = _mm_loadu_ps(out + j);
+					v = _mm_mul_ps(v, level_v);
+					acc = _mm_add_ps(acc, v);
+					_mm_storeu_ps(out + j, acc);
+				}
+				for (; j < frames; j++)
+					out[j] += in[j] * level;
+			}
+
+			first = false;
+		}
+
+		if (first)
+			memset(out, 0, frames * sizeof(float));
+	}
+}
+
+/* -------------------------------------------------------- */
+/* sample conversion                                         */
+
+static void sample_buffer_reserve(struct sample_buffer *buf, size_t frames)
+{
+	if (frames <= buf->capacity)
+		return;
+
+	buf->capacity = frames + frames / 2;
+	for (size_t i = 0; i < buf->channels; i++)
+		buf->planes[i] = brealloc(buf->planes[i],
+					  buf->capacity * sizeof(float));
+}
+
+static void sample_buffer_free(struct sample_buffer *buf)
+{
+	for (size_t i = 0; i < buf->channels; i++)
+		bfree(buf->planes[i]);
+}
+
+static void convert_input(float *const *dst, size_t offset,
+			  const uint8_t *const input[],
+			  enum audio_format format, uint32_t channels,
+			  size_t frames)
+{
+	const bool planar = is_audio_planar(format);
+	const size_t stride = planar ? 1 : channels;
+
+	for (uint32_t c = 0; c < channels; c++) {
+		const uint8_t *plane = input[planar ? c : 0];
+		const size_t start = planar ? 0 : c;
+		float *out = dst[c] + offset;
+
+		switch (format) {
+		case AUDIO_FORMAT_U8BIT:
+		case AUDIO_FORMAT_U8BIT_PLANAR:
+			for (size_t i = 0; i < frames; i++)
+				out[i] = ((float)plane[start + i * stride] -
+					  128.0f) /
+					 128.0f;
+			break;
+		case AUDIO_FORMAT_16BIT:
+		case AUDIO_FORMAT_16BIT_PLANAR: {
+			const int16_t *in = (const int16_t *)plane;
+			for (size_t i = 0; i < frames; i++)
+				out[i] = (float)in[start + i * stride] /
+					 32768.0f;
+			break;
+		}
+		case AUDIO_FORMAT_32BIT:
+		case AUDIO_FORMAT_32BIT_PLANAR: {
+			const int32_t *in = (const int32_t *)plane;
+			for (size_t i = 0; i < frames; i++)
+				out[i] = (float)((double)in[start + i * stride] /
+						 2147483648.0);
+			break;
+		}
+		case AUDIO_FORMAT_FLOAT:
+		case AUDIO_FORMAT_FLOAT_PLANAR: {
+			const float *in = (const float *)plane;
+			if (planar) {
+				memcpy(out, in, frames * sizeof(float));
+			} else {
+				for (size_t i = 0; i < frames; i++)
+					out[i] = in[start + i * stride];
+			}
+			break;
+		}
+		case AUDIO_FORMAT_UNKNOWN:
+			break;
+		}
+	}
+}
+
+/* -------------------------------------------------------- */
+/* filtering                                                 */
+
+static size_t max_output_frames(const struct native_resampler *rs,
+				size_t in_frames)
+{
+	const struct filter_bank *bank = rs->bank;
+
+	return (size_t)(((uint64_t)in_frames * bank->phases + bank->step - 1) /
+			bank->step) +
+	       1;
+}
+
+/* runs the filter over all complete input windows, keeps the rest */
+static size_t filter(struct native_resampler *rs, uint32_t channels,
+		     size_t in_frames)
+{
+	const struct filter_bank *bank = rs->bank;
+	const size_t taps = bank->taps;
+	const size_t avail = rs->history_frames + in_frames;
+	float *const *history = rs->history.planes;
+	float *const *out = rs->resampled.planes;
+	uint32_t phase = rs->phase;
+	size_t idx = 0;
+	size_t n = 0;
+
+	while (idx + taps <= avail) {
+		const float *h = bank->coeffs + phase * taps;
+
+		for (uint32_t c = 0; c < channels; c++)
+			out[c][n] = filter_dot_product(history[c] + idx, h,
+						       taps);
+		n++;
+
+		phase += bank->step;
+		idx += phase / bank->phases;
+		phase %= bank->phases;
+	}
+
+	for (uint32_t c = 0; c < channels; c++)
+		memmove(history[c], history[c] + idx,
+			(avail - idx) * sizeof(float));
+
+	rs->history_frames = avail - idx;
+	rs->phase = phase;
+	return n;
+}
+
+/* delay between the end of the input received so far and the next output
+ * sample */
+static uint64_t get_delay_ns(const struct native_resampler *rs)
+{
+	const struct filter_bank *bank = rs->bank;
+	double delay;
+
+	if (!bank)
+		return 0;
+
+	delay = (double)rs->history_frames - (bank->taps / 2.0 - 1.0) -
+		(double)rs->phase / (double)bank->phases;
+	if (delay <= 0.0)
+		return 0;
+
+	return (uint64_t)(delay * 1000000000.0 / rs->input_freq);
+}
+
+/* -------------------------------------------------------- */
+
+struct native_resampler *
+native_resampler_create(const struct resample_info *dst,
+			const struct resample_info *src)
+{
+	struct native_resampler *rs;
+	uint32_t divisor, phases, step;
+	uint32_t filter_ch;
+
+	if (!dst->samples_per_sec || !src->samples_per_sec)
+		return NULL;
+	if (dst->speakers == SPEAKERS_UNKNOWN ||
+	    src->speakers == SPEAKERS_UNKNOWN)
+		return NULL;
+	if (src->format == AUDIO_FORMAT_UNKNOWN)
+		return NULL;
+	if (dst->format != AUDIO_FORMAT_FLOAT &&
+	    dst->format != AUDIO_FORMAT_FLOAT_PLANAR)
+		return NULL;
+
+	divisor = gcd(dst->samples_per_sec, src->samples_per_sec);
+	phases = dst->samples_per_sec / divisor;
+	step = src->samples_per_sec / divisor;
+
+	if (phases > MAX_PHASES || step > phases * MAX_DOWNSAMPLE_RATIO)
+		return NULL;
+
+	rs = bzalloc(sizeof(*rs));
+	rs->input_freq = src->samples_per_sec;
+	rs->input_format = src->format;
+	rs->input_ch = get_audio_channels(src->speakers);
+	rs->output_planar = dst->format == AUDIO_FORMAT_FLOAT_PLANAR;
+	rs->output_ch = get_audio_channels(dst->speakers);
+
+	rs->remix = src->speakers != dst->speakers;
+	rs->remix_first = rs->remix && rs->output_ch <= rs->input_ch;
+	if (rs->remix)
+		build_matrix(rs, dst->speakers, src->speakers);
+
+	filter_ch = rs->remix_first ? rs->output_ch : rs->input_ch;
+	rs->history.channels = filter_ch;
+	rs->resampled.channels = filter_ch;
+	rs->converted.channels = rs->remix_first ? rs->input_ch : 0;
+	rs->remixed.channels = rs->remix && !rs->remix_first ? rs->output_ch
+							     : 0;
+
+	if (phases != step) {
+		rs->bank = native_filter_bank_get(phases, step);
+
+		/* start centered on the first input sample */
+		rs->history_frames = rs->bank->taps / 2 - 1;
+		sample_buffer_reserve(&rs->history, rs->history_frames);
+		for (uint32_t c = 0; c < filter_ch; c++)
+			memset(rs->history.planes[c], 0,
+			       rs->history_frames * sizeof(float));
+	}
+
+	return rs;
+}
+
+void native_resampler_destroy(struct native_resampler *rs)
+{
+	if (rs) {
+		native_filter_bank_release(rs->bank);
+		sample_buffer_free(&rs->history);
+		sample_buffer_free(&rs->converted);
+		sample_buffer_free(&rs->resampled);
+		sample_buffer_free(&rs->remixed);
+		bfree(rs->packed);
+		bfree(rs);
+	}
+}
+
+bool native_resampler_resample(struct native_resampler *rs,
+			       uint8_t *output[], uint32_t *out_frames,
+			       uint64_t *ts_offset,
+			       const uint8_t *const input[], uint32_t in_frames)
+{
+	const uint32_t filter_ch = (uint32_t)rs->history.channels;
+	float *const *result;
+	size_t frames;
+
+	*ts_offset = get_delay_ns(rs);
+
+	/* convert (and downmix) to float, after the unconsumed input */
+	sample_buffer_reserve(&rs->history, rs->history_frames + in_frames);
+
+	if (rs->remix_first) {
+		float *dst[MAX_AUDIO_CHANNELS];
+
+		sample_buffer_reserve(&rs->converted, in_frames);
+		convert_input(rs->converted.planes, 0, input, rs->input_format,
+			      rs->input_ch, in_frames);
+
+		for (uint32_t c = 0; c < filter_ch; c++)
+			dst[c] = rs->history.planes[c] + rs->history_frames;
+		remix(dst, (const float *const *)rs->converted.planes,
+		      rs->matrix, rs->output_ch, rs->input_ch, in_frames);
+	} else {
+		convert_input(rs->history.planes, rs->history_frames, input,
+			      rs->input_format, rs->input_ch, in_frames);
+	}
+
+	/* resample */
+	if (rs->bank) {
+		sample_buffer_reserve(&rs->resampled,
+				      max_output_frames(rs, rs->history_frames +
+								    in_frames));
+		frames = filter(rs, filter_ch, in_frames);
+		result = rs->resampled.planes;
+	} else {
+		frames = in_frames;
+		result = rs->history.planes;
+	}
+
+	/* upmix */
+	if (rs->remix && !rs->remix_first) {
+		sample_buffer_reserve(&rs->remixed, frames);
+		remix(rs->remixed.planes, (const float *const *)result,
+		      rs->matrix, rs->output_ch, rs->input_ch, frames);
+		result = rs->remixed.planes;
+	}
+
+	if (rs->output_planar) {
+		for (uint32_t c = 0; c < rs->output_ch; c++)
+			output[c] = (uint8_t *)result[c];
+	} else {
+		size_t size = frames * rs->output_ch;
+
+		if (size > rs->packed_capacity) {
+			rs->packed_capacity = size + size / 2;
+			rs->packed = brealloc(rs->packed,
+					      rs->packed_capacity *
+						      sizeof(float));
+		}
+
+		for (uint32_t c = 0; c < rs->output_ch; c++)
+			for (size_t i = 0; i < frames; i++)
+				rs->packed[i * rs->output_ch + c] =
+					result[c][i];
+
+		output[0] = (uint8_t *)rs->packed;
+	}
+
+	*out_frames = (uint32_t)frames;
+	return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../util/sse-intrin.h"
+#include "audio-resampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Built-in polyphase resampler used by audio_resampler_create when the
+ * native resampler type is selected.  Only used internally by the audio
+ * resampler and the drift compensator. */
+
+struct native_resampler;
+
+/* returns NULL if the conversion isn't supported, in which case the
+ * swresample path is used instead */
+extern struct native_resampler *
+native_resampler_create(const struct resample_info *dst,
+			const struct resample_info *src);
+extern void native_resampler_destroy(struct native_resampler *rs);
+
+extern bool native_resampler_resample(struct native_resampler *rs,
+				      uint8_t *output[], uint32_t *out_frames,
+				      uint64_t *ts_offset,
+				      const uint8_t *const input[],
+				      uint32_t in_frames);
+
+/* Windowed sinc filters for output at step / phases input samples apart:
+ * row p of coeffs is the taps coefficients interpolating at p / phases
+ * samples past the center of the window, which is taps / 2 - 1.  taps is a
+ * multiple of 8 and rows are aligned for filter_dot_product.  Banks are
+ * shared and reference counted. */
+struct filter_bank {
+	uint32_t phases;
+	uint32_t step;
+	uint32_t taps;
+	float *coeffs;
+	long refs;
+};
+
+extern struct filter_bank *native_filter_bank_get(uint32_t phases,
+						  uint32_t step);
+extern void native_filter_bank_release(struct filter_bank *bank);
+
+static inline float filter_dot_product(const float *x, const float *h,
+				       size_t taps)
+{
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	for (size_t i = 0; i < taps; i += 8) {
+		__m128 x0 = _mm_loadu_ps(x + i);
+		__m128 x1 = _mm_loadu_ps(x + i + 4);
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(x0, _mm_load_ps(h + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(x1, _mm_load_ps(h + i + 4)));
+	}
+
+	sum0 = _mm_add_ps(sum0, sum1);
+	sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+	sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+	return _mm_cvtss_f32(sum0);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -33,6 +33,19 @@ struct resample_info {
 	enum speaker_layout speakers;
 };
 
+enum audio_resampler_type {
+	AUDIO_RESAMPLER_SWRESAMPLE,
+	AUDIO_RESAMPLER_NATIVE,
+};
+
+/**
+ * Sets the implementation used by resamplers created from now on.  The native
+ * resampler converts to float output only and falls back to swresample for
+ * anything it does not support.
+ */
+EXPORT void audio_resampler_set_type(enum audio_resampler_type type);
+EXPORT enum audio_resampler_type audio_resampler_get_type(void);
+
 EXPORT audio_resampler_t *
 audio_resampler_create(const struct resample_info *dst,
 		       const struct resample_info *src);
@@ -0,0 +1,565 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/bmem.h"
+#include "../util/sse-intrin.h"
+#include "video-deinterlace.h"
+#include "video-slices.h"
+
+/* Every type is a port of the matching pixel shader in
+ * deinterlace_base.effect, run on each byte of each plane.  Lines where
+ * (y % 2) == field are kept, field being 1 for top field first like the
+ * effect's field_order.  Rows and columns outside of a plane are clamped to
+ * its edges, where the effects read zeros instead.
+ *
+ * Frames are split into horizontal slices, see video-slices.h. */
+
+/* bias of yadif's spatial score, 1.0 in the effect */
+#define YADIF_BIAS 255
+
+struct plane_info {
+	uint32_t bytes;
+	uint32_t rows;
+	/* distance between horizontally adjacent samples of a component */
+	uint32_t step;
+};
+
+struct deinterlace_job {
+	uint8_t *output[MAX_AV_PLANES];
+	uint32_t out_linesize[MAX_AV_PLANES];
+	const uint8_t *input[MAX_AV_PLANES];
+	uint32_t in_linesize[MAX_AV_PLANES];
+	const uint8_t *prev[MAX_AV_PLANES];
+	uint32_t prev_linesize[MAX_AV_PLANES];
+	int field;
+	bool frame2;
+};
+
+struct video_deinterlacer {
+	struct video_deinterlace_info info;
+	struct plane_info planes[MAX_AV_PLANES];
+	size_t num_planes;
+
+	struct deinterlace_job job;
+	struct video_slices *slices;
+};
+
+static inline void set_plane(struct plane_info *plane, uint32_t bytes,
+			     uint32_t rows, uint32_t step)
+{
+	plane->bytes = bytes;
+	plane->rows = rows;
+	plane->step = step;
+}
+
+static size_t get_planes(const struct video_deinterlace_info *info,
+			 struct plane_info *planes)
+{
+	const uint32_t w = info->width;
+	const uint32_t h = info->height;
+
+	switch (info->format) {
+	case VIDEO_FORMAT_I420:
+		set_plane(&planes[0], w, h, 1);
+		set_plane(&planes[1], w / 2, h / 2, 1);
+		set_plane(&planes[2], w / 2, h / 2, 1);
+		return 3;
+
+	case VIDEO_FORMAT_NV12:
+		set_plane(&planes[0], w, h, 1);
+		set_plane(&planes[1], w / 2 * 2, h / 2, 2);
+		return 2;
+
+	case VIDEO_FORMAT_Y800:
+		set_plane(&planes[0], w, h, 1);
+		return 1;
+
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		/* compares whole macropixels, like the packed chroma */
+		set_plane(&planes[0], w * 2, h, 4);
+		return 1;
+
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_AYUV:
+		set_plane(&planes[0], w * 4, h, 4);
+		return 1;
+
+	case VIDEO_FORMAT_BGR3:
+		set_plane(&planes[0], w * 3, h, 3);
+		return 1;
+
+	case VIDEO_FORMAT_I444:
+		for (size_t i = 0; i < 3; i++)
+			set_plane(&planes[i], w, h, 1);
+		return 3;
+
+	case VIDEO_FORMAT_I422:
+		set_plane(&planes[0], w, h, 1);
+		set_plane(&planes[1], w / 2, h, 1);
+		set_plane(&planes[2], w / 2, h, 1);
+		return 3;
+
+	case VIDEO_FORMAT_I40A:
+		set_plane(&planes[0], w, h, 1);
+		set_plane(&planes[1], w / 2, h / 2, 1);
+		set_plane(&planes[2], w / 2, h / 2, 1);
+		set_plane(&planes[3], w, h, 1);
+		return 4;
+
+	case VIDEO_FORMAT_I42A:
+		set_plane(&planes[0], w, h, 1);
+		set_plane(&planes[1], w / 2, h, 1);
+		set_plane(&planes[2], w / 2, h, 1);
+		set_plane(&planes[3], w, h, 1);
+		return 4;
+
+	case VIDEO_FORMAT_YUVA:
+		for (size_t i = 0; i < 4; i++)
+			set_plane(&planes[i], w, h, 1);
+		return 4;
+
+	case VIDEO_FORMAT_NONE:
+		break;
+	}
+
+	return 0;
+}
+
+struct plane_rows {
+	const uint8_t *data;
+	uint32_t linesize;
+	uint32_t rows;
+};
+
+static inline const uint8_t *row_at(const struct plane_rows *plane, int y)
+{
+	if (y < 0)
+		y = 0;
+	else if (y >= (int)plane->rows)
+		y = (int)plane->rows - 1;
+
+	return plane->data + (size_t)plane->linesize * (size_t)y;
+}
+
+static void average_rows(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+			 uint32_t bytes)
+{
+	uint32_t i = 0;
+
+	for (; i + 16 <= bytes; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_avg_epu8(va, vb));
+	}
+
+	for (; i < bytes; i++)
+		dst[i] = (uint8_t)((a[i] + b[i] + 1) >> 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/* yadif                                                                     */
+
+struct yadif_rows {
+	/* rows y - 2 to y + 2 */
+	const uint8_t *prev[5];
+	const uint8_t *cur[5];
+
+	/* rows around y of the field the line is interpolated from */
+	const uint8_t *above;
+	const uint8_t *below;
+
+	uint32_t bytes;
+	uint32_t step;
+};
+
+static inline int avg(int a, int b)
+{
+	return (a + b + 1) >> 1;
+}
+
+static inline int max3(int a, int b, int c)
+{
+	int m = a > b ? a : b;
+	return m > c ? m : c;
+}
+
+static inline int min3(int a, int b, int c)
+{
+	int m = a < b ? a : b;
+	return m < c ? m : c;
+}
+
+/* index of the same component x samples away, clamped to the row */
+static inline uint32_t offset(const struct yadif_rows *r, uint32_t i, int x)
+{
+	const long idx = (long)i + (long)x * (long)r->step;
+	const uint32_t comp = i % r->step;
+
+	if (idx < 0)
+		return comp;
+	if (idx >= (long)r->bytes)
+		return comp + (r->bytes - 1 - comp) / r->step * r->step;
+	return (uint32_t)idx;
+}
+
+#define A(x) r->above[offset(r, i, x)]
+#define B(x) r->below[offset(r, i, x)]
+
+static inline int yadif_score(const struct yadif_rows *r, uint32_t i,
+			      int level)
+{
+	return abs(B(level - 1) - A(-level - 1)) + abs(B(level) - A(-level)) +
+	       abs(B(level + 1) - A(1 - level));
+}
+
+static inline void yadif_check(const struct yadif_rows *r, uint32_t i,
+			       int level, int *score, int *pred)
+{
+	int s = yadif_score(r, i, level);
+	if (s >= *score)
+		return;
+
+	*score = s;
+	*pred = avg(A(level), B(-level));
+
+	s = yadif_score(r, i, level * 2);
+	if (s < *score) {
+		*score = s;
+		*pred = avg(A(level * 2), B(-level * 2));
+	}
+}
+
+static uint8_t yadif_pixel(const struct yadif_rows *r, uint32_t i)
+{
+	const int c = r->below[i];
+	const int e = r->above[i];
+	const int d = avg(r->prev[2][i], r->cur[2][i]);
+	const int b = avg(r->prev[4][i], r->cur[4][i]);
+	const int f = avg(r->prev[0][i], r->cur[0][i]);
+
+	int diff = max3(abs(r->prev[2][i] - r->cur[2][i]) >> 1,
+			(abs(r->prev[3][i] - c) + abs(r->prev[1][i] - e)) >> 1,
+			(abs(r->cur[3][i] - c) + abs(r->cur[1][i] - e)) >> 1);
+
+	int pred = avg(c, e);
+	int score = abs(B(-1) - A(-1)) + abs(c - e) + abs(B(1) - A(1)) -
+		    YADIF_BIAS;
+
+	yadif_check(r, i, -1, &score, &pred);
+	yadif_check(r, i, 1, &score, &pred);
+
+	const int max_ = max3(d - e, d - c, b - c < f - e ? b - c : f - e);
+	const int min_ = min3(d - e, d - c, b - c > f - e ? b - c : f - e);
+	diff = max3(diff, min_, -max_);
+
+	if (pred > d + diff)
+		pred = d + diff;
+	else if (pred < d - diff)
+		pred = d - diff;
+
+	return (uint8_t)pred;
+}
+
+#undef A
+#undef B
+
+static inline __m128i load8(const uint8_t *p)
+{
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p),
+				 _mm_setzero_si128());
+}
+
+static inline __m128i absdiff16(__m128i a, __m128i b)
+{
+	return _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a));
+}
+
+static inline __m128i select16(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128i yadif_score8(const uint8_t *a, const uint8_t *b,
+				   int level, int step)
+{
+	__m128i s0 = absdiff16(load8(b + (level - 1) * step),
+			       load8(a + (-level - 1) * step));
+	__m128i s1 = absdiff16(load8(b + level * step),
+			       load8(a - level * step));
+	__m128i s2 = absdiff16(load8(b + (level + 1) * step),
+			       load8(a + (1 - level) * step));
+
+	return _mm_add_epi16(_mm_add_epi16(s0, s1), s2);
+}
+
+static inline void yadif_check8(const uint8_t *a, const uint8_t *b, int level,
+				int step, __m128i *score, __m128i *pred)
+{
+	__m128i s = yadif_score8(a, b, level, step);
+	__m128i mask = _mm_cmplt_epi16(s, *score);
+	__m128i p = _mm_avg_epu16(load8(a + level * step),
+				  load8(b - level * step));
+
+	*score = select16(mask, s, *score);
+	*pred = select16(mask, p, *pred);
+
+	s = yadif_score8(a, b, level * 2, step);
+	mask = _mm_and_si128(mask, _mm_cmplt_epi16(s, *score));
+	p = _mm_avg_epu16(load8(a + level * 2 * step),
+			  load8(b - level * 2 * step));
+
+	*score = select16(mask, s, *score);
+	*pred = select16(mask, p, *pred);
+}
+
+/* yadif_pixel for 8 bytes at once, at least 3 samples away from the edges */
+static inline void yadif_pixels8(const struct yadif_rows *r, uint32_t i,
+				 uint8_t *dst)
+{
+	const uint8_t *a = r->above + i;
+	const uint8_t *b = r->below + i;
+	const int step = (int)r->step;
+
+	__m128i c = load8(b);
+	__m128i e = load8(a);
+	__m128i p0 = load8(r->prev[0] + i);
+	__m128i p1 = load8(r->prev[1] + i);
+	__m128i p2 = load8(r->prev[2] + i);
+	__m128i p3 = load8(r->prev[3] + i);
+	__m128i p4 = load8(r->prev[4] + i);
+	__m128i c0 = load8(r->cur[0] + i);
+	__m128i c1 = load8(r->cur[1] + i);
+	__m128i c2 = load8(r->cur[2] + i);
+	__m128i c3 = load8(r->cur[3] + i);
+	__m128i c4 = load8(r->cur[4] + i);
+
+	__m128i d = _mm_avg_epu16(p2, c2);
+	__m128i bb = _mm_avg_epu16(p4, c4);
+	__m128i f = _mm_avg_epu16(p0, c0);
+
+	__m128i td0 = _mm_srli_epi16(absdiff16(p2, c2), 1);
+	__m128i td1 = _mm_srli_epi16(
+		_mm_add_epi16(absdiff16(p3, c), absdiff16(p1, e)), 1);
+	__m128i td2 = _mm_srli_epi16(
+		_mm_add_epi16(absdiff16(c3, c), absdiff16(c1, e)), 1);
+	__m128i diff = _mm_max_epi16(td0, _mm_max_epi16(td1, td2));
+
+	__m128i pred = _mm_avg_epu16(c, e);
+	__m128i score = _mm_add_epi16(
+		_mm_add_epi16(absdiff16(load8(b - step), load8(a - step)),
+			      absdiff16(c, e)),
+		absdiff16(load8(b + step), load8(a + step)));
+	score = _mm_sub_epi16(score, _mm_set1_epi16(YADIF_BIAS));
+
+	yadif_check8(a, b, -1, step, &score, &pred);
+	yadif_check8(a, b, 1, step, &score, &pred);
+
+	__m128i de = _mm_sub_epi16(d, e);
+	__m128i dc = _mm_sub_epi16(d, c);
+	__m128i bc = _mm_sub_epi16(bb, c);
+	__m128i fe = _mm_sub_epi16(f, e);
+	__m128i max_ = _mm_max_epi16(_mm_max_epi16(de, dc),
+				     _mm_min_epi16(bc, fe));
+	__m128i min_ = _mm_min_epi16(_mm_min_epi16(de, dc),
+				     _mm_max_epi16(bc, fe));
+
+	__m128i neg_max = _mm_sub_epi16(_mm_setzero_si128(), max_);
+	diff = _mm_max_epi16(diff, _mm_max_epi16(min_, neg_max));
+
+	pred = _mm_max_epi16(pred, _mm_sub_epi16(d, diff));
+	pred = _mm_min_epi16(pred, _mm_add_epi16(d, diff));
+
+	_mm_storel_epi64((__m128i *)dst,
+			 _mm_packus_epi16(pred, _mm_setzero_si128()));
+}
+
+static void yadif_row(uint8_t *dst, const struct yadif_rows *r)
+{
+	const uint32_t edge = r->step * 3;
+	uint32_t i = 0;
+
+	for (; i < edge && i < r->bytes; i++)
+		dst[i] = yadif_pixel(r, i);
+	for (; i + 8 + edge <= r->bytes; i += 8)
+		yadif_pixels8(r, i, dst + i);
+	for (; i < r->bytes; i++)
+		dst[i] = yadif_pixel(r, i);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void deinterlace_rows(const struct video_deinterlacer *d, size_t plane,
+			     uint32_t y0, uint32_t y1)
+{
+	const struct deinterlace_job *job = &d->job;
+	const uint32_t bytes = d->planes[plane].bytes;
+	const uint32_t rows = d->planes[plane].rows;
+	const int field = job->field;
+
+	const struct plane_rows cur = {job->input[plane],
+				       job->in_linesize[plane], rows};
+	const struct plane_rows prev = {job->prev[plane],
+					job->prev_linesize[plane], rows};
+
+	/* the field yadif interpolates from, like load_at in the effect */
+	const struct plane_rows *src = field == 0 ? &cur : &prev;
+
+	for (uint32_t y = y0; y < y1; y++) {
+		uint8_t *dst = job->output[plane] +
+			       (size_t)job->out_linesize[plane] * y;
+		const int iy = (int)y;
+		const bool kept = (int)(y % 2) == field;
+
+		switch (d->info.type) {
+		case VIDEO_DEINTERLACE_DISCARD:
+		case VIDEO_DEINTERLACE_RETRO:
+			memcpy(dst, row_at(&cur, iy / 2 * 2 + field), bytes);
+			break;
+
+		case VIDEO_DEINTERLACE_BLEND:
+			average_rows(dst, row_at(&cur, iy),
+				     row_at(&cur, iy + 1), bytes);
+			break;
+
+		case VIDEO_DEINTERLACE_BLEND_2X:
+			average_rows(dst, row_at(&cur, iy),
+				     row_at(job->frame2 ? &cur : &prev, iy + 1),
+				     bytes);
+			break;
+
+		case VIDEO_DEINTERLACE_LINEAR:
+		case VIDEO_DEINTERLACE_LINEAR_2X:
+			if (kept)
+				memcpy(dst, row_at(&cur, iy), bytes);
+			else
+				average_rows(dst, row_at(&cur, iy - 1),
+					     row_at(&cur, iy + 1), bytes);
+			break;
+
+		case VIDEO_DEINTERLACE_YADIF:
+		case VIDEO_DEINTERLACE_YADIF_2X:
+			if (kept) {
+				memcpy(dst, row_at(src, iy), bytes);
+			} else {
+				struct yadif_rows r;
+
+				for (int j = 0; j < 5; j++) {
+					r.prev[j] = row_at(&prev, iy + j - 2);
+					r.cur[j] = row_at(&cur, iy + j - 2);
+				}
+
+				r.above = row_at(src, iy - 1);
+				r.below = row_at(src, iy + 1);
+				r.bytes = bytes;
+				r.step = d->planes[plane].step;
+				yadif_row(dst, &r);
+			}
+			break;
+		}
+	}
+}
+
+static void run_slice(void *param, size_t slice, size_t num_slices)
+{
+	const struct video_deinterlacer *d = param;
+
+	for (size_t i = 0; i < d->num_planes; i++) {
+		const uint32_t rows = d->planes[i].rows;
+		const uint32_t y0 = (uint32_t)((uint64_t)rows * slice /
+					       num_slices);
+		const uint32_t y1 = (uint32_t)((uint64_t)rows * (slice + 1) /
+					       num_slices);
+
+		deinterlace_rows(d, i, y0, y1);
+	}
+}
+
+int video_deinterlacer_create(video_deinterlacer_t **deinterlacer,
+			      const struct video_deinterlace_info *info)
+{
+	struct video_deinterlacer *d;
+	size_t size = 0;
+
+	if (!deinterlacer || !info)
+		return VIDEO_DEINTERLACER_FAILED;
+
+	d = bzalloc(sizeof(struct video_deinterlacer));
+	d->info = *info;
+	d->num_planes = get_planes(info, d->planes);
+
+	if (!d->num_planes || !info->width || !info->height) {
+		bfree(d);
+		return VIDEO_DEINTERLACER_BAD_FORMAT;
+	}
+
+	for (size_t i = 0; i < d->num_planes; i++)
+		size += (size_t)d->planes[i].bytes * d->planes[i].rows;
+
+	d->slices = video_slices_create(info->threads, size, run_slice, d);
+	*deinterlacer = d;
+	return VIDEO_DEINTERLACER_SUCCESS;
+}
+
+void video_deinterlacer_destroy(video_deinterlacer_t *deinterlacer)
+{
+	struct video_deinterlacer *d = deinterlacer;
+
+	if (!d)
+		return;
+
+	video_slices_destroy(d->slices);
+	bfree(d);
+}
+
+static int get_field(const struct video_deinterlacer *d, bool frame2)
+{
+	const int field = d->info.top_field_first ? 1 : 0;
+
+	switch (d->info.type) {
+	case VIDEO_DEINTERLACE_RETRO:
+	case VIDEO_DEINTERLACE_LINEAR_2X:
+		return frame2 ? field : 1 - field;
+	case VIDEO_DEINTERLACE_YADIF_2X:
+		return frame2 ? 1 - field : field;
+	default:
+		return field;
+	}
+}
+
+bool video_deinterlacer_deinterlace(video_deinterlacer_t *deinterlacer,
+				    uint8_t *output[],
+				    const uint32_t out_linesize[],
+				    const uint8_t *const input[],
+				    const uint32_t in_linesize[],
+				    const uint8_t *const prev[],
+				    const uint32_t prev_linesize[], bool frame2)
+{
+	struct video_deinterlacer *d = deinterlacer;
+	struct deinterlace_job *job;
+
+	if (!d || !output || !input)
+		return false;
+
+	job = &d->job;
+	for (size_t i = 0; i < d->num_planes; i++) {
+		job->output[i] = output[i];
+		job->out_linesize[i] = out_linesize[i];
+		job->input[i] = input[i];
+		job->in_linesize[i] = in_linesize[i];
+
+		/* without a previous frame, the frame is its own */
+		job->prev[i] = prev ? prev[i] : input[i];
+		job->prev_linesize[i] = prev ? prev_linesize[i]
+					     : in_linesize[i];
+	}
+
+	job->field = get_field(d, frame2);
+	job->frame2 = frame2;
+
+	video_slices_run(d->slices);
+	return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../util/c99defs.h"
+#include "video-io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Deinterlaces raw frames on the CPU.  The result matches the deinterlace
+ * effects, but is computed on the planes of the frame itself instead of
+ * the converted RGB texture. */
+
+struct video_deinterlacer;
+typedef struct video_deinterlacer video_deinterlacer_t;
+
+enum video_deinterlace_type {
+	VIDEO_DEINTERLACE_DISCARD,
+	VIDEO_DEINTERLACE_RETRO,
+	VIDEO_DEINTERLACE_BLEND,
+	VIDEO_DEINTERLACE_BLEND_2X,
+	VIDEO_DEINTERLACE_LINEAR,
+	VIDEO_DEINTERLACE_LINEAR_2X,
+	VIDEO_DEINTERLACE_YADIF,
+	VIDEO_DEINTERLACE_YADIF_2X,
+};
+
+struct video_deinterlace_info {
+	enum video_format format;
+	uint32_t width;
+	uint32_t height;
+	enum video_deinterlace_type type;
+	bool top_field_first;
+
+	/* number of slices processed in parallel, 0 to pick one from the
+	 * frame size and the number of cores */
+	uint32_t threads;
+};
+
+#define VIDEO_DEINTERLACER_SUCCESS 0
+#define VIDEO_DEINTERLACER_BAD_FORMAT -1
+#define VIDEO_DEINTERLACER_FAILED -2
+
+EXPORT int video_deinterlacer_create(video_deinterlacer_t **deinterlacer,
+				     const struct video_deinterlace_info *info);
+EXPORT void video_deinterlacer_destroy(video_deinterlacer_t *deinterlacer);
+
+/* prev is the previous frame, which the yadif and blend 2x types use.
+ * frame2 selects the second field of the 2x types. */
+EXPORT bool video_deinterlacer_deinterlace(video_deinterlacer_t *deinterlacer,
+					   uint8_t *output[],
+					   const uint32_t out_linesize[],
+					   const uint8_t *const input[],
+					   const uint32_t in_linesize[],
+					   const uint8_t *const prev[],
+					   const uint32_t prev_linesize[],
+					   bool frame2);
+
+static inline bool video_deinterlace_is_2x(enum video_deinterlace_type type)
+{
+	return type == VIDEO_DEINTERLACE_RETRO ||
+	       type == VIDEO_DEINTERLACE_BLEND_2X ||
+	       type == VIDEO_DEINTERLACE_LINEAR_2X ||
+	       type == VIDEO_DEINTERLACE_YADIF_2X;
+}
+
+#ifdef __cplusplus
+}
+#endif
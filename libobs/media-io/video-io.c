@@ -45,6 +45,11 @@ struct video_input {
 	video_scaler_t *scaler;
 	struct video_frame frame[MAX_CONVERT_BUFFERS];
 	int cur_frame;
+	bool scaled;
+
+	/* scales from the frame of a larger input, see find_ladder_source */
+	video_scaler_t *ladder_scaler;
+	struct video_scale_info ladder_from;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
@@ -55,6 +60,7 @@ static inline void video_input_free(struct video_input *input)
 	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
 		video_frame_free(&input->frame[i]);
 	video_scaler_destroy(input->scaler);
+	video_scaler_destroy(input->ladder_scaler);
 }
 
 struct video_output {
@@ -85,32 +91,133 @@ struct video_output {
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
+static inline bool same_color(const struct video_scale_info *a,
+			      const struct video_scale_info *b)
+{
+	return a->format == b->format && a->range == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+static inline bool same_conversion(const struct video_scale_info *a,
+				   const struct video_scale_info *b)
+{
+	return same_color(a, b) && a->width == b->width &&
+	       a->height == b->height;
+}
+
+static inline uint64_t get_area(const struct video_scale_info *info)
+{
+	return (uint64_t)info->width * info->height;
+}
+
+/* Renditions of a ladder (e.g. 1080p, 720p and 480p encoders of the same
+ * canvas) are scaled from the smallest frame already scaled this frame that
+ * is at least as large, in the same format.  The colour conversion and the
+ * bulk of the downscaling are then done once for the whole ladder, and each
+ * rendition only scales down from the one above it.  Inputs are kept from
+ * the largest to the smallest for this, see video_output_connect. */
+static struct video_input *find_ladder_source(struct video_output *video,
+					      size_t idx)
+{
+	struct video_input *input = video->inputs.array + idx;
+	struct video_input *best = NULL;
+
+	for (size_t i = 0; i < idx; i++) {
+		struct video_input *prev = video->inputs.array + i;
+
+		if (!prev->scaled ||
+		    !same_color(&prev->conversion, &input->conversion))
+			continue;
+		if (prev->conversion.width < input->conversion.width ||
+		    prev->conversion.height < input->conversion.height)
+			continue;
+
+		if (!best || get_area(&prev->conversion) <
+				     get_area(&best->conversion))
+			best = prev;
+	}
+
+	return best;
+}
+
+static bool update_ladder_scaler(struct video_input *input,
+				 const struct video_scale_info *from)
+{
+	if (input->ladder_scaler && same_conversion(&input->ladder_from, from))
+		return true;
+
+	video_scaler_destroy(input->ladder_scaler);
+	input->ladder_scaler = NULL;
+
+	int ret = video_scaler_create(&input->ladder_scaler, &input->conversion,
+				      from, VIDEO_SCALE_FAST_BILINEAR);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		input->ladder_scaler = NULL;
+		return false;
+	}
+
+	input->ladder_from = *from;
+	return true;
+}
+
+static inline void set_frame_data(struct video_data *data,
+				  const struct video_frame *frame)
+{
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		data->data[i] = frame->data[i];
+		data->linesize[i] = frame->linesize[i];
+	}
+}
+
+static inline bool scale_video_output(struct video_output *video, size_t idx,
 				      struct video_data *data)
 {
-	bool success = true;
+	struct video_input *input = video->inputs.array + idx;
+	struct video_input *source;
+	struct video_frame *frame;
+	bool success;
 
-	if (input->scaler) {
-		struct video_frame *frame;
+	input->scaled = false;
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	if (!input->scaler)
+		return true;
 
-		frame = &input->frame[input->cur_frame];
+	source = find_ladder_source(video, idx);
 
+	/* the same conversion reuses the scaled frame as is */
+	if (source && same_conversion(&source->conversion, &input->conversion)) {
+		set_frame_data(data, &source->frame[source->cur_frame]);
+		return true;
+	}
+
+	if (source && !update_ladder_scaler(input, &source->conversion))
+		source = NULL;
+
+	if (++input->cur_frame == MAX_CONVERT_BUFFERS)
+		input->cur_frame = 0;
+
+	frame = &input->frame[input->cur_frame];
+
+	if (source) {
+		const struct video_frame *src =
+			&source->frame[source->cur_frame];
+
+		success = video_scaler_scale(input->ladder_scaler, frame->data,
+					     frame->linesize,
+					     (const uint8_t *const *)src->data,
+					     src->linesize);
+	} else {
 		success = video_scaler_scale(input->scaler, frame->data,
 					     frame->linesize,
 					     (const uint8_t *const *)data->data,
 					     data->linesize);
+	}
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
-		} else {
-			blog(LOG_WARNING, "video-io: Could not scale frame!");
-		}
+	if (success) {
+		set_frame_data(data, frame);
+		input->scaled = true;
+	} else {
+		blog(LOG_WARNING, "video-io: Could not scale frame!");
 	}
 
 	return success;
@@ -138,7 +245,7 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		struct video_input *input = video->inputs.array + i;
 		struct video_data frame = frame_info->frame;
 
-		if (scale_video_output(input, &frame))
+		if (scale_video_output(video, i, &frame))
 			input->callback(input->param, &frame);
 	}
 
@@ -340,6 +447,20 @@ static inline void reset_frames(video_t *video)
 	os_atomic_set_long(&video->total_frames, 0);
 }
 
+/* keeps inputs from the largest to the smallest, for find_ladder_source */
+static size_t get_input_pos(const struct video_output *video,
+			    const struct video_input *input)
+{
+	const uint64_t area = get_area(&input->conversion);
+	size_t pos = 0;
+
+	while (pos < video->inputs.num &&
+	       get_area(&video->inputs.array[pos].conversion) >= area)
+		pos++;
+
+	return pos;
+}
+
 bool video_output_connect(
 	video_t *video, const struct video_scale_info *conversion,
 	void (*callback)(void *param, struct video_data *frame), void *param)
@@ -379,7 +500,8 @@ bool video_output_connect(
 				}
 				os_atomic_set_bool(&video->raw_active, true);
 			}
-			da_push_back(video->inputs, &input);
+			da_insert(video->inputs, get_input_pos(video, &input),
+				  &input);
 		}
 	}
 
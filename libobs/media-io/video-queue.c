@@ -0,0 +1,246 @@
+#include "../util/circlebuf.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+#include "video-queue.h"
+
+struct queued_frame {
+	struct video_frame frame;
+	int64_t pts;
+	uint64_t queued_ts;
+};
+
+/* frames holds the frames waiting for the callback, avail the unused ones.
+ * The semaphore is posted once for every frame pushed and once to stop. */
+struct video_queue {
+	struct video_queue_info info;
+
+	pthread_mutex_t mutex;
+	struct circlebuf frames;
+	struct circlebuf avail;
+	struct video_queue_stats stats;
+	volatile long depth;
+	bool stop;
+
+	os_sem_t *semaphore;
+	pthread_t thread;
+	bool thread_active;
+	volatile bool abort;
+};
+
+static void free_queued_frames(struct circlebuf *buf)
+{
+	while (buf->size) {
+		struct queued_frame *qf;
+		circlebuf_pop_front(buf, &qf, sizeof(qf));
+		video_frame_free(&qf->frame);
+		bfree(qf);
+	}
+
+	circlebuf_free(buf);
+}
+
+static inline size_t get_latency_bucket(uint64_t latency_ns)
+{
+	uint64_t ms = latency_ns / 1000000;
+	size_t bucket = 0;
+
+	while (ms && bucket < VIDEO_QUEUE_LATENCY_BUCKETS - 1) {
+		ms >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+static void *video_queue_thread(void *param)
+{
+	struct video_queue *queue = param;
+
+	os_set_thread_name("video-io: queue thread");
+
+	while (os_sem_wait(queue->semaphore) == 0) {
+		struct queued_frame *qf;
+		bool success;
+
+		pthread_mutex_lock(&queue->mutex);
+		if (!queue->frames.size) {
+			/* either stopped once everything queued before the
+			 * stop was handed out, or the frame was dropped after
+			 * being signaled */
+			bool stop = queue->stop;
+			pthread_mutex_unlock(&queue->mutex);
+			if (stop)
+				break;
+			continue;
+		}
+		circlebuf_pop_front(&queue->frames, &qf, sizeof(qf));
+		os_atomic_dec_long(&queue->depth);
+		pthread_mutex_unlock(&queue->mutex);
+
+		success = queue->info.callback(queue->info.param, &qf->frame,
+					       qf->pts);
+
+		pthread_mutex_lock(&queue->mutex);
+		if (success) {
+			uint64_t latency = os_gettime_ns() - qf->queued_ts;
+			queue->stats.latency_ms[get_latency_bucket(latency)]++;
+		}
+		circlebuf_push_back(&queue->avail, &qf, sizeof(qf));
+		pthread_mutex_unlock(&queue->mutex);
+
+		if (!success || os_atomic_load_bool(&queue->abort))
+			break;
+	}
+
+	return NULL;
+}
+
+video_queue_t *video_queue_create(const struct video_queue_info *info)
+{
+	struct video_queue *queue;
+
+	if (!info || !info->callback || !info->max_frames)
+		return NULL;
+
+	queue = bzalloc(sizeof(struct video_queue));
+	queue->info = *info;
+	pthread_mutex_init_value(&queue->mutex);
+
+	if (pthread_mutex_init(&queue->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&queue->semaphore, 0) != 0)
+		goto fail;
+
+	/* one extra frame for the one currently in the callback */
+	for (size_t i = 0; i < info->max_frames + 1; i++) {
+		struct queued_frame *qf = bzalloc(sizeof(*qf));
+		video_frame_init(&qf->frame, info->format, info->width,
+				 info->height);
+		circlebuf_push_back(&queue->avail, &qf, sizeof(qf));
+	}
+
+	if (pthread_create(&queue->thread, NULL, video_queue_thread, queue) !=
+	    0)
+		goto fail;
+
+	queue->thread_active = true;
+	return queue;
+
+fail:
+	video_queue_destroy(queue);
+	return NULL;
+}
+
+void video_queue_destroy(video_queue_t *queue)
+{
+	if (!queue)
+		return;
+
+	video_queue_stop(queue);
+
+	free_queued_frames(&queue->frames);
+	free_queued_frames(&queue->avail);
+	if (queue->semaphore)
+		os_sem_destroy(queue->semaphore);
+	pthread_mutex_destroy(&queue->mutex);
+	bfree(queue);
+}
+
+bool video_queue_push(video_queue_t *queue, const struct video_data *frame,
+		      int64_t pts)
+{
+	struct queued_frame *qf = NULL;
+	struct video_frame src;
+	size_t depth;
+
+	if (!queue || !frame)
+		return false;
+
+	pthread_mutex_lock(&queue->mutex);
+
+	if (queue->stop) {
+		pthread_mutex_unlock(&queue->mutex);
+		return false;
+	}
+
+	if (queue->frames.size / sizeof(qf) == queue->info.max_frames ||
+	    !queue->avail.size) {
+		queue->stats.dropped_frames++;
+
+		if (queue->info.drop == VIDEO_QUEUE_DROP_OLDEST &&
+		    queue->frames.size) {
+			circlebuf_pop_front(&queue->frames, &qf, sizeof(qf));
+			os_atomic_dec_long(&queue->depth);
+		}
+	} else {
+		circlebuf_pop_front(&queue->avail, &qf, sizeof(qf));
+	}
+
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (!qf)
+		return false;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		src.data[i] = frame->data[i];
+		src.linesize[i] = frame->linesize[i];
+	}
+
+	video_frame_copy(&qf->frame, &src, queue->info.format,
+			 queue->info.height);
+	qf->pts = pts;
+	qf->queued_ts = os_gettime_ns();
+
+	pthread_mutex_lock(&queue->mutex);
+	circlebuf_push_back(&queue->frames, &qf, sizeof(qf));
+	depth = queue->frames.size / sizeof(qf);
+	if (depth > queue->stats.max_depth)
+		queue->stats.max_depth = depth;
+	queue->stats.queued_frames++;
+	os_atomic_inc_long(&queue->depth);
+	pthread_mutex_unlock(&queue->mutex);
+
+	os_sem_post(queue->semaphore);
+	return true;
+}
+
+bool video_queue_stop(video_queue_t *queue)
+{
+	if (!queue)
+		return true;
+
+	pthread_mutex_lock(&queue->mutex);
+	queue->stop = true;
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (!queue->thread_active)
+		return true;
+
+	if (pthread_equal(pthread_self(), queue->thread)) {
+		os_atomic_set_bool(&queue->abort, true);
+		return false;
+	}
+
+	os_sem_post(queue->semaphore);
+	pthread_join(queue->thread, NULL);
+	queue->thread_active = false;
+	return true;
+}
+
+size_t video_queue_get_depth(const video_queue_t *queue)
+{
+	return queue ? (size_t)os_atomic_load_long(&queue->depth) : 0;
+}
+
+void video_queue_get_stats(video_queue_t *queue,
+			   struct video_queue_stats *stats)
+{
+	if (!queue || !stats)
+		return;
+
+	pthread_mutex_lock(&queue->mutex);
+	*stats = queue->stats;
+	pthread_mutex_unlock(&queue->mutex);
+
+	stats->depth = video_queue_get_depth(queue);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../util/c99defs.h"
+#include "video-frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bounded queue of raw video frames, handed to a callback on a thread of its
+ * own instead of the thread producing them.  Frames are copied in to frames
+ * allocated up front.  When the queue is full, either the oldest queued
+ * frame or the incoming one is dropped.  Used by the video encoder input
+ * queues (obs_encoder_set_queue). */
+
+struct video_queue;
+typedef struct video_queue video_queue_t;
+
+enum video_queue_drop {
+	VIDEO_QUEUE_DROP_OLDEST,
+	VIDEO_QUEUE_DROP_NEWEST,
+};
+
+#define VIDEO_QUEUE_LATENCY_BUCKETS 12
+
+/* see struct obs_encoder_queue_stats */
+struct video_queue_stats {
+	size_t depth;
+	size_t max_depth;
+	uint64_t queued_frames;
+	uint64_t dropped_frames;
+	uint64_t latency_ms[VIDEO_QUEUE_LATENCY_BUCKETS];
+};
+
+/* Called on the queue thread for each frame.  Returning false stops the
+ * queue right away, dropping the frames still queued. */
+typedef bool (*video_queue_cb)(void *param, struct video_frame *frame,
+			       int64_t pts);
+
+struct video_queue_info {
+	size_t max_frames;
+	enum video_queue_drop drop;
+	enum video_format format;
+	uint32_t width;
+	uint32_t height;
+
+	video_queue_cb callback;
+	void *param;
+};
+
+EXPORT video_queue_t *video_queue_create(const struct video_queue_info *info);
+
+/* Stops the queue if it still runs, then frees it.  Must not be called from
+ * the callback. */
+EXPORT void video_queue_destroy(video_queue_t *queue);
+
+/* Copies a frame in to the queue.  Returns false if it was dropped, or if
+ * the queue is stopping. */
+EXPORT bool video_queue_push(video_queue_t *queue,
+			     const struct video_data *frame, int64_t pts);
+
+/* Stops taking frames, hands every frame still queued to the callback and
+ * waits for the thread to exit.  From the callback itself, only stops taking
+ * frames and returns false: the thread exits once the callback returns, and
+ * is waited for by video_queue_destroy. */
+EXPORT bool video_queue_stop(video_queue_t *queue);
+
+EXPORT size_t video_queue_get_depth(const video_queue_t *queue);
+EXPORT void video_queue_get_stats(video_queue_t *queue,
+				  struct video_queue_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
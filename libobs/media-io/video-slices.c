@@ -0,0 +1,230 @@
+#include "../util/bmem.h"
+#include "../util/darray.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+#include "video-slices.h"
+
+#define MAX_SLICES 8
+#define MAX_AUTO_SLICES 4
+
+/* smaller frames (in bytes of all planes) aren't worth splitting */
+#define MIN_THREADED_SIZE (1280 * 720)
+
+/* The worker threads are shared by every video_slices object in the process,
+ * so that the unpackers and deinterlacers of many sources do not each start
+ * their own threads.  The pool is created with the first object that needs
+ * threads and destroyed with the last one.  A run queues its object, and the
+ * workers claim slices from the first queued object that has some left.  The
+ * calling thread processes slices too, and unqueues its object once every
+ * slice has been claimed, so a worker never touches an object after its run
+ * has returned. */
+
+struct video_slices {
+	video_slice_func_t func;
+	void *param;
+
+	size_t num_slices;
+	volatile long next_slice;
+	volatile long remaining;
+	os_event_t *done;
+	bool pooled;
+};
+
+struct slice_pool {
+	pthread_mutex_t init_mutex;
+	long refs;
+
+	pthread_t threads[MAX_SLICES - 1];
+	size_t num_threads;
+	os_sem_t *work;
+	volatile bool stop;
+
+	pthread_mutex_t mutex;
+	DARRAY(struct video_slices *) queue;
+};
+
+static struct slice_pool pool = {
+	.init_mutex = PTHREAD_MUTEX_INITIALIZER,
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void run_slice(struct video_slices *vs, long slice)
+{
+	vs->func(vs->param, (size_t)slice, vs->num_slices);
+
+	if (os_atomic_dec_long(&vs->remaining) == 0)
+		os_event_signal(vs->done);
+}
+
+/* must be called with the pool locked */
+static struct video_slices *claim_queued_slice(long *slice)
+{
+	while (pool.queue.num) {
+		struct video_slices *vs = pool.queue.array[0];
+
+		*slice = os_atomic_inc_long(&vs->next_slice) - 1;
+		if (*slice < (long)vs->num_slices)
+			return vs;
+
+		da_erase(pool.queue, 0);
+	}
+
+	return NULL;
+}
+
+static void *slice_thread(void *data)
+{
+	os_set_thread_name("video-io: slice worker");
+
+	while (os_sem_wait(pool.work) == 0) {
+		struct video_slices *vs;
+		long slice;
+
+		if (os_atomic_load_bool(&pool.stop))
+			break;
+
+		pthread_mutex_lock(&pool.mutex);
+		vs = claim_queued_slice(&slice);
+		pthread_mutex_unlock(&pool.mutex);
+
+		if (vs)
+			run_slice(vs, slice);
+	}
+
+	UNUSED_PARAMETER(data);
+	return NULL;
+}
+
+static void pool_stop(void)
+{
+	os_atomic_set_bool(&pool.stop, true);
+	for (size_t i = 0; i < pool.num_threads; i++)
+		os_sem_post(pool.work);
+	for (size_t i = 0; i < pool.num_threads; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	os_sem_destroy(pool.work);
+	da_free(pool.queue);
+	pool.work = NULL;
+	pool.num_threads = 0;
+	pool.stop = false;
+}
+
+static void pool_start(void)
+{
+	int cores = os_get_logical_cores();
+	size_t threads = cores > 1 ? (size_t)cores - 1 : 0;
+
+	if (threads > MAX_SLICES - 1)
+		threads = MAX_SLICES - 1;
+	if (!threads || os_sem_init(&pool.work, 0) != 0)
+		return;
+
+	for (size_t i = 0; i < threads; i++) {
+		if (pthread_create(&pool.threads[i], NULL, slice_thread,
+				   NULL) != 0)
+			break;
+		pool.num_threads++;
+	}
+}
+
+/* returns the number of worker threads */
+static size_t pool_acquire(void)
+{
+	size_t threads;
+
+	pthread_mutex_lock(&pool.init_mutex);
+	if (pool.refs++ == 0)
+		pool_start();
+	threads = pool.num_threads;
+	pthread_mutex_unlock(&pool.init_mutex);
+
+	return threads;
+}
+
+static void pool_release(void)
+{
+	pthread_mutex_lock(&pool.init_mutex);
+	if (--pool.refs == 0)
+		pool_stop();
+	pthread_mutex_unlock(&pool.init_mutex);
+}
+
+static size_t get_auto_slices(size_t frame_size)
+{
+	int cores;
+
+	if (frame_size < MIN_THREADED_SIZE)
+		return 1;
+
+	cores = os_get_logical_cores();
+	if (cores < 1)
+		return 1;
+	return cores > MAX_AUTO_SLICES ? MAX_AUTO_SLICES : (size_t)cores;
+}
+
+struct video_slices *video_slices_create(size_t slices, size_t frame_size,
+					 video_slice_func_t func, void *param)
+{
+	struct video_slices *vs = bzalloc(sizeof(struct video_slices));
+	vs->func = func;
+	vs->param = param;
+	vs->num_slices = 1;
+
+	if (!slices)
+		slices = get_auto_slices(frame_size);
+	if (slices > MAX_SLICES)
+		slices = MAX_SLICES;
+	if (slices < 2)
+		return vs;
+
+	if (os_event_init(&vs->done, OS_EVENT_TYPE_AUTO) != 0)
+		return vs;
+
+	vs->pooled = true;
+	if (pool_acquire())
+		vs->num_slices = slices;
+	return vs;
+}
+
+void video_slices_destroy(struct video_slices *vs)
+{
+	if (!vs)
+		return;
+
+	if (vs->pooled)
+		pool_release();
+
+	os_event_destroy(vs->done);
+	bfree(vs);
+}
+
+void video_slices_run(struct video_slices *vs)
+{
+	long slice;
+
+	if (vs->num_slices == 1) {
+		vs->func(vs->param, 0, 1);
+		return;
+	}
+
+	os_atomic_set_long(&vs->remaining, (long)vs->num_slices);
+	os_atomic_set_long(&vs->next_slice, 0);
+
+	pthread_mutex_lock(&pool.mutex);
+	da_push_back(pool.queue, &vs);
+	pthread_mutex_unlock(&pool.mutex);
+
+	for (size_t i = 1; i < vs->num_slices; i++)
+		os_sem_post(pool.work);
+
+	while ((slice = os_atomic_inc_long(&vs->next_slice) - 1) <
+	       (long)vs->num_slices)
+		run_slice(vs, slice);
+
+	pthread_mutex_lock(&pool.mutex);
+	da_erase_item(pool.queue, &vs);
+	pthread_mutex_unlock(&pool.mutex);
+
+	os_event_wait(vs->done);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Splits per-frame work into horizontal slices, processed by the calling
+ * thread and a pool of worker threads shared by the whole process.  Used by
+ * the CPU frame processing of media-io, not exported. */
+
+struct video_slices;
+
+/* processes the given slice out of num_slices */
+typedef void (*video_slice_func_t)(void *param, size_t slice,
+				   size_t num_slices);
+
+/* slices is 0 to pick a count from frame_size (bytes of all planes) and the
+ * number of cores.  Never fails: without threads, slices run serially. */
+struct video_slices *video_slices_create(size_t slices, size_t frame_size,
+					 video_slice_func_t func, void *param);
+void video_slices_destroy(struct video_slices *vs);
+
+/* runs every slice and returns once they are all done */
+void video_slices_run(struct video_slices *vs);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,392 @@
+#include <math.h>
+#include <string.h>
+
+#include "../util/bmem.h"
+#include "video-unpack.h"
+#include "video-slices.h"
+
+/* YUV formats go through per-component tables: the contribution of each
+ * possible Y, U and V value to R, G and B, in 16.16 fixed point, with the
+ * range clamp of YUV_to_RGB folded in.  Limited range Y800, BGR3 and RGB
+ * frames go through a single expansion table instead.
+ *
+ * Chroma is point sampled like the Load calls of the effect.  Frames are
+ * split into horizontal slices, see video-slices.h. */
+
+struct rgb_terms {
+	int32_t r;
+	int32_t g;
+	int32_t b;
+};
+
+struct unpack_job {
+	uint8_t *output;
+	uint32_t out_linesize;
+	const uint8_t *input[MAX_AV_PLANES];
+	uint32_t in_linesize[MAX_AV_PLANES];
+
+	/* indexed by component (Y, U, V) then value */
+	struct rgb_terms terms[3][256];
+	uint8_t expand[256];
+};
+
+struct video_unpacker {
+	struct video_unpack_info info;
+	struct unpack_job job;
+	struct video_slices *slices;
+};
+
+/* offsets of the components in a macropixel of packed 4:2:2 */
+struct packed422 {
+	int y0;
+	int y1;
+	int u;
+	int v;
+};
+
+static inline uint8_t clamp8(int32_t val)
+{
+	return val < 0 ? 0 : (val > 255 ? 255 : (uint8_t)val);
+}
+
+static inline void write_yuv(uint8_t *dst, const struct unpack_job *job,
+			     uint8_t y, uint8_t u, uint8_t v, uint8_t a)
+{
+	const struct rgb_terms *ty = &job->terms[0][y];
+	const struct rgb_terms *tu = &job->terms[1][u];
+	const struct rgb_terms *tv = &job->terms[2][v];
+
+	dst[0] = clamp8((ty->b + tu->b + tv->b) >> 16);
+	dst[1] = clamp8((ty->g + tu->g + tv->g) >> 16);
+	dst[2] = clamp8((ty->r + tu->r + tv->r) >> 16);
+	dst[3] = a;
+}
+
+static inline const uint8_t *plane_row(const struct unpack_job *job,
+				       size_t plane, uint32_t y)
+{
+	return job->input[plane] + (size_t)job->in_linesize[plane] * y;
+}
+
+static void unpack_planar_row(const struct unpack_job *job, uint8_t *dst,
+			      uint32_t y, uint32_t width, uint32_t height,
+			      bool half_width, bool half_height, bool alpha)
+{
+	const uint32_t cw = half_width ? width / 2 : width;
+	const uint32_t ch = half_height ? height / 2 : height;
+	uint32_t cy = half_height ? y / 2 : y;
+
+	/* odd sizes: the last column and row reuse the last chroma */
+	if (cy >= ch)
+		cy = ch - 1;
+
+	const uint8_t *row_y = plane_row(job, 0, y);
+	const uint8_t *row_u = plane_row(job, 1, cy);
+	const uint8_t *row_v = plane_row(job, 2, cy);
+	const uint8_t *row_a = alpha ? plane_row(job, 3, y) : NULL;
+
+	for (uint32_t x = 0; x < width; x++) {
+		uint32_t cx = half_width ? x / 2 : x;
+		if (cx >= cw)
+			cx = cw - 1;
+
+		write_yuv(dst + x * 4, job, row_y[x], row_u[cx], row_v[cx],
+			  alpha ? row_a[x] : 255);
+	}
+}
+
+static void unpack_nv12_row(const struct unpack_job *job, uint8_t *dst,
+			    uint32_t y, uint32_t width, uint32_t height)
+{
+	const uint32_t cw = width / 2;
+	uint32_t cy = y / 2;
+
+	if (cy >= height / 2)
+		cy = height / 2 - 1;
+
+	const uint8_t *row_y = plane_row(job, 0, y);
+	const uint8_t *row_uv = plane_row(job, 1, cy);
+
+	for (uint32_t x = 0; x < width; x++) {
+		uint32_t cx = x / 2;
+		if (cx >= cw)
+			cx = cw - 1;
+
+		write_yuv(dst + x * 4, job, row_y[x], row_uv[cx * 2],
+			  row_uv[cx * 2 + 1], 255);
+	}
+}
+
+static void unpack_packed422_row(const struct unpack_job *job, uint8_t *dst,
+				 uint32_t y, uint32_t width,
+				 const struct packed422 *p)
+{
+	const uint8_t *row = plane_row(job, 0, y);
+	uint32_t x = 0;
+
+	for (; x + 2 <= width; x += 2) {
+		const uint8_t *mp = row + x * 2;
+
+		write_yuv(dst + x * 4, job, mp[p->y0], mp[p->u], mp[p->v],
+			  255);
+		write_yuv(dst + x * 4 + 4, job, mp[p->y1], mp[p->u], mp[p->v],
+			  255);
+	}
+
+	/* an odd width only has the first luma of the last macropixel */
+	if (x < width) {
+		const uint8_t *mp = row + x * 2;
+		write_yuv(dst + x * 4, job, mp[p->y0], mp[p->u], mp[p->v],
+			  255);
+	}
+}
+
+static void unpack_ayuv_row(const struct unpack_job *job, uint8_t *dst,
+			    uint32_t y, uint32_t width)
+{
+	const uint8_t *row = plane_row(job, 0, y);
+
+	for (uint32_t x = 0; x < width; x++) {
+		const uint8_t *px = row + x * 4;
+		write_yuv(dst + x * 4, job, px[2], px[1], px[0], px[3]);
+	}
+}
+
+static void unpack_y800_row(const struct unpack_job *job, uint8_t *dst,
+			    uint32_t y, uint32_t width)
+{
+	const uint8_t *row = plane_row(job, 0, y);
+
+	for (uint32_t x = 0; x < width; x++) {
+		const uint8_t val = job->expand[row[x]];
+		dst[x * 4] = val;
+		dst[x * 4 + 1] = val;
+		dst[x * 4 + 2] = val;
+		dst[x * 4 + 3] = 255;
+	}
+}
+
+static void unpack_bgr3_row(const struct unpack_job *job, uint8_t *dst,
+			    uint32_t y, uint32_t width)
+{
+	const uint8_t *row = plane_row(job, 0, y);
+
+	for (uint32_t x = 0; x < width; x++) {
+		dst[x * 4] = job->expand[row[x * 3]];
+		dst[x * 4 + 1] = job->expand[row[x * 3 + 1]];
+		dst[x * 4 + 2] = job->expand[row[x * 3 + 2]];
+		dst[x * 4 + 3] = 255;
+	}
+}
+
+static void unpack_rgb_row(const struct unpack_job *job, uint8_t *dst,
+			   uint32_t y, uint32_t width)
+{
+	const uint8_t *row = plane_row(job, 0, y);
+
+	for (uint32_t x = 0; x < width; x++) {
+		dst[x * 4] = job->expand[row[x * 4]];
+		dst[x * 4 + 1] = job->expand[row[x * 4 + 1]];
+		dst[x * 4 + 2] = job->expand[row[x * 4 + 2]];
+		dst[x * 4 + 3] = row[x * 4 + 3];
+	}
+}
+
+static const struct packed422 yuy2_offsets = {0, 2, 1, 3};
+static const struct packed422 uyvy_offsets = {1, 3, 0, 2};
+static const struct packed422 yvyu_offsets = {0, 2, 3, 1};
+
+static void unpack_row(const struct video_unpacker *u, uint32_t y)
+{
+	const struct unpack_job *job = &u->job;
+	const uint32_t w = u->info.width;
+	const uint32_t h = u->info.height;
+	uint8_t *dst = job->output + (size_t)job->out_linesize * y;
+
+	switch (u->info.format) {
+	case VIDEO_FORMAT_I420:
+		unpack_planar_row(job, dst, y, w, h, true, true, false);
+		break;
+	case VIDEO_FORMAT_I40A:
+		unpack_planar_row(job, dst, y, w, h, true, true, true);
+		break;
+	case VIDEO_FORMAT_I422:
+		unpack_planar_row(job, dst, y, w, h, true, false, false);
+		break;
+	case VIDEO_FORMAT_I42A:
+		unpack_planar_row(job, dst, y, w, h, true, false, true);
+		break;
+	case VIDEO_FORMAT_I444:
+		unpack_planar_row(job, dst, y, w, h, false, false, false);
+		break;
+	case VIDEO_FORMAT_YUVA:
+		unpack_planar_row(job, dst, y, w, h, false, false, true);
+		break;
+	case VIDEO_FORMAT_NV12:
+		unpack_nv12_row(job, dst, y, w, h);
+		break;
+	case VIDEO_FORMAT_YUY2:
+		unpack_packed422_row(job, dst, y, w, &yuy2_offsets);
+		break;
+	case VIDEO_FORMAT_UYVY:
+		unpack_packed422_row(job, dst, y, w, &uyvy_offsets);
+		break;
+	case VIDEO_FORMAT_YVYU:
+		unpack_packed422_row(job, dst, y, w, &yvyu_offsets);
+		break;
+	case VIDEO_FORMAT_AYUV:
+		unpack_ayuv_row(job, dst, y, w);
+		break;
+	case VIDEO_FORMAT_Y800:
+		unpack_y800_row(job, dst, y, w);
+		break;
+	case VIDEO_FORMAT_BGR3:
+		unpack_bgr3_row(job, dst, y, w);
+		break;
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		unpack_rgb_row(job, dst, y, w);
+		break;
+	case VIDEO_FORMAT_NONE:
+		break;
+	}
+}
+
+static void run_slice(void *param, size_t slice, size_t num_slices)
+{
+	const struct video_unpacker *u = param;
+	const uint32_t rows = u->info.height;
+	const uint32_t y0 = (uint32_t)((uint64_t)rows * slice / num_slices);
+	const uint32_t y1 =
+		(uint32_t)((uint64_t)rows * (slice + 1) / num_slices);
+
+	for (uint32_t y = y0; y < y1; y++)
+		unpack_row(u, y);
+}
+
+static inline bool is_yuv_format(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_Y800:
+	case VIDEO_FORMAT_BGR3:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_NONE:
+		return false;
+	default:
+		return true;
+	}
+}
+
+static void set_terms(struct unpack_job *job, const float color_matrix[16],
+		      const float range_min[3], const float range_max[3])
+{
+	for (int c = 0; c < 3; c++) {
+		const float min = range_min ? range_min[c] : 0.0f;
+		const float max = range_max ? range_max[c] : 1.0f;
+
+		for (int i = 0; i < 256; i++) {
+			float val = (float)i / 255.0f;
+			if (val < min)
+				val = min;
+			else if (val > max)
+				val = max;
+
+			/* 255 for the 8-bit output, 65536 for 16.16 */
+			val *= 255.0f * 65536.0f;
+
+			struct rgb_terms *t = &job->terms[c][i];
+			t->r = (int32_t)lrintf(color_matrix[c] * val);
+			t->g = (int32_t)lrintf(color_matrix[4 + c] * val);
+			t->b = (int32_t)lrintf(color_matrix[8 + c] * val);
+		}
+	}
+
+	/* the constant terms and the rounding of the output go to Y */
+	const float offset = 255.0f * 65536.0f;
+	const int32_t half = 1 << 15;
+	for (int i = 0; i < 256; i++) {
+		struct rgb_terms *t = &job->terms[0][i];
+		t->r += (int32_t)lrintf(color_matrix[3] * offset) + half;
+		t->g += (int32_t)lrintf(color_matrix[7] * offset) + half;
+		t->b += (int32_t)lrintf(color_matrix[11] * offset) + half;
+	}
+}
+
+static void set_expand(struct unpack_job *job, bool limited)
+{
+	for (int i = 0; i < 256; i++) {
+		/* (255 / 219) * limited - (16 / 219), in 8-bit units */
+		int val = limited ? ((i - 16) * 255 * 2 + 219) / (219 * 2) : i;
+		if (limited && i < 16)
+			val = 0;
+		job->expand[i] = clamp8(val);
+	}
+}
+
+int video_unpacker_create(video_unpacker_t **unpacker,
+			  const struct video_unpack_info *info)
+{
+	struct video_unpacker *u;
+
+	if (!unpacker || !info)
+		return VIDEO_UNPACKER_FAILED;
+	if (info->format == VIDEO_FORMAT_NONE || !info->width ||
+	    !info->height)
+		return VIDEO_UNPACKER_BAD_FORMAT;
+
+	u = bzalloc(sizeof(struct video_unpacker));
+	u->info = *info;
+
+	/* per pixel, which costs about the same whatever the format is */
+	u->slices = video_slices_create(info->threads,
+					(size_t)info->width * info->height,
+					run_slice, u);
+	*unpacker = u;
+	return VIDEO_UNPACKER_SUCCESS;
+}
+
+void video_unpacker_destroy(video_unpacker_t *unpacker)
+{
+	struct video_unpacker *u = unpacker;
+
+	if (!u)
+		return;
+
+	video_slices_destroy(u->slices);
+	bfree(u);
+}
+
+bool video_unpacker_unpack(video_unpacker_t *unpacker, uint8_t *output,
+			   uint32_t out_linesize, const uint8_t *const input[],
+			   const uint32_t in_linesize[],
+			   const float color_matrix[16],
+			   const float range_min[3], const float range_max[3])
+{
+	struct video_unpacker *u = unpacker;
+	struct unpack_job *job;
+
+	if (!u || !output || !input)
+		return false;
+
+	job = &u->job;
+	job->output = output;
+	job->out_linesize = out_linesize;
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		job->input[i] = input[i];
+		job->in_linesize[i] = in_linesize[i];
+	}
+
+	if (is_yuv_format(u->info.format)) {
+		if (!color_matrix)
+			return false;
+		set_terms(job, color_matrix, range_min, range_max);
+	} else {
+		set_expand(job, range_min != NULL);
+	}
+
+	video_slices_run(u->slices);
+	return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../util/c99defs.h"
+#include "video-io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Converts raw frames to packed RGB on the CPU, so that they can be uploaded
+ * to a texture as they are.  The result matches the conversion techniques of
+ * format_conversion.effect. */
+
+struct video_unpacker;
+typedef struct video_unpacker video_unpacker_t;
+
+struct video_unpack_info {
+	enum video_format format;
+	uint32_t width;
+	uint32_t height;
+
+	/* number of slices processed in parallel, 0 to pick one from the
+	 * frame size and the number of cores */
+	uint32_t threads;
+};
+
+#define VIDEO_UNPACKER_SUCCESS 0
+#define VIDEO_UNPACKER_BAD_FORMAT -1
+#define VIDEO_UNPACKER_FAILED -2
+
+EXPORT int video_unpacker_create(video_unpacker_t **unpacker,
+				 const struct video_unpack_info *info);
+EXPORT void video_unpacker_destroy(video_unpacker_t *unpacker);
+
+/* output is a single plane of video_unpack_format(format).  color_matrix
+ * converts YUV to RGB, range_min and range_max are NULL for full range
+ * frames. */
+EXPORT bool video_unpacker_unpack(video_unpacker_t *unpacker, uint8_t *output,
+				  uint32_t out_linesize,
+				  const uint8_t *const input[],
+				  const uint32_t in_linesize[],
+				  const float color_matrix[16],
+				  const float range_min[3],
+				  const float range_max[3]);
+
+static inline enum video_format video_unpack_format(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		return format;
+
+	case VIDEO_FORMAT_I40A:
+	case VIDEO_FORMAT_I42A:
+	case VIDEO_FORMAT_YUVA:
+	case VIDEO_FORMAT_AYUV:
+		return VIDEO_FORMAT_BGRA;
+
+	default:
+		return VIDEO_FORMAT_BGRX;
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
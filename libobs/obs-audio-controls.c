@@ -19,7 +19,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "util/sse-intrin.h"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || \
+	defined(__x86_64__)
+#define VOLMETER_AVX
+#include <immintrin.h>
+#endif
+
 #include "util/threading.h"
+#include "util/platform.h"
 #include "util/bmem.h"
 #include "media-io/audio-math.h"
 #include "obs.h"
@@ -63,6 +70,21 @@ struct meter_cb {
 	void *param;
 };
 
+/* must be a power of two and a multiple of four */
+#define METER_QUEUE_FRAMES 8192
+#define METER_QUEUE_MASK (METER_QUEUE_FRAMES - 1)
+#define METER_WORKER_INTERVAL_MS 10
+
+/* Ring of planar samples written by the audio callback of the source and read
+ * by the metering thread.  There is only ever one writer and one reader, so
+ * the positions are all that needs to be synchronized. */
+struct meter_queue {
+	float *data[MAX_AUDIO_CHANNELS];
+	int channels;
+	volatile long write_pos;
+	volatile long read_pos;
+};
+
 struct obs_volmeter {
 	pthread_mutex_t mutex;
 	obs_source_t *source;
@@ -74,12 +96,31 @@ struct obs_volmeter {
 
 	enum obs_peak_meter_type peak_meter_type;
 	unsigned int update_ms;
-	float prev_samples[MAX_AUDIO_CHANNELS][4];
 
-	float magnitude[MAX_AUDIO_CHANNELS];
+	struct meter_queue queue;
+	volatile long nr_channels;
+	volatile bool muted;
+
+	/* only used by the metering thread */
+	float prev_samples[MAX_AUDIO_CHANNELS][4];
+	float sum_squares[MAX_AUDIO_CHANNELS];
 	float peak[MAX_AUDIO_CHANNELS];
+	size_t frames;
+	uint64_t last_update_ns;
 };
 
+/* computes the levels of all volume meters, started with the first volume
+ * meter and stopped when the last one is destroyed */
+struct volmeter_worker {
+	pthread_t thread;
+	os_event_t *stop_event;
+	bool avx;
+};
+
+static pthread_mutex_t meters_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct obs_volmeter *) meters = {0};
+static struct volmeter_worker *worker = NULL;
+
 static float cubic_def_to_db(const float def)
 {
 	if (def == 1.0f)
@@ -261,16 +302,6 @@ static void volmeter_source_destroyed(void *vptr, calldata_t *calldata)
 	obs_volmeter_detach_source(volmeter);
 }
 
-static int get_nr_channels_from_audio_data(const struct audio_data *data)
-{
-	int nr_channels = 0;
-	for (int i = 0; i < MAX_AV_PLANES; i++) {
-		if (data->data[i])
-			nr_channels++;
-	}
-	return CLAMP(nr_channels, 0, MAX_AUDIO_CHANNELS);
-}
-
 /* msb(h, g, f, e) lsb(d, c, b, a)   -->  msb(h, h, g, f) lsb(e, d, c, b)
  */
 #define SHIFT_RIGHT_2PS(msb, lsb)                                          \
@@ -373,6 +404,94 @@ static float get_true_peak(__m128 previous_samples, const float *samples,
 	return r;
 }
 
+#ifdef VOLMETER_AVX
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX __attribute__((target("avx")))
+#else
+#define TARGET_AVX
+#endif
+
+/* Same as SHIFT_RIGHT_2PS and VECTOR_MATRIX_CROSS_PS, for each 128-bit lane */
+#define SHIFT_RIGHT_2PS_256(msb, lsb)                                         \
+	{                                                                     \
+		__m256 tmp = _mm256_shuffle_ps(lsb, msb,                      \
+					       _MM_SHUFFLE(0, 0, 3, 3));      \
+		lsb = _mm256_shuffle_ps(lsb, tmp, _MM_SHUFFLE(2, 1, 2, 1));   \
+		msb = _mm256_shuffle_ps(msb, msb, _MM_SHUFFLE(3, 3, 2, 1));   \
+	}
+
+#define VECTOR_MATRIX_CROSS_PS_256(out, v, m0, m1, m2, m3)             \
+	{                                                              \
+		__m256 sum01 = _mm256_hadd_ps(_mm256_mul_ps(v, m0),    \
+					      _mm256_mul_ps(v, m1));   \
+		__m256 sum23 = _mm256_hadd_ps(_mm256_mul_ps(v, m2),    \
+					      _mm256_mul_ps(v, m3));   \
+		out = _mm256_hadd_ps(sum01, sum23);                    \
+	}
+
+#define TRUE_PEAK_STEP_256()                                               \
+	{                                                                  \
+		__m256 intrp_samples;                                      \
+		SHIFT_RIGHT_2PS_256(new_work, work);                       \
+		VECTOR_MATRIX_CROSS_PS_256(intrp_samples, work, m3, m1, p1, \
+					   p3);                            \
+		peak = _mm256_max_ps(peak,                                 \
+				     _mm256_andnot_ps(sign, intrp_samples)); \
+	}
+
+static inline float hmax4(const float *x)
+{
+	return fmaxf(fmaxf(x[0], x[1]), fmaxf(x[2], x[3]));
+}
+
+/* get_true_peak for two channels at once.  The low and high 128-bit lanes
+ * each hold the interpolation window of one channel; none of the shuffles
+ * used cross lanes, so the math is the same as in the SSE version. */
+TARGET_AVX
+static void get_true_peak_avx(const float *previous_a, const float *previous_b,
+			      const float *samples_a, const float *samples_b,
+			      size_t nr_samples, float *peak_a, float *peak_b)
+{
+	const __m256 m3 = _mm256_set_ps(-0.155915f, 0.935489f, 0.233872f,
+					-0.103943f, -0.155915f, 0.935489f,
+					0.233872f, -0.103943f);
+	const __m256 m1 = _mm256_set_ps(-0.216236f, 0.756827f, 0.504551f,
+					-0.189207f, -0.216236f, 0.756827f,
+					0.504551f, -0.189207f);
+	const __m256 p1 = _mm256_set_ps(-0.189207f, 0.504551f, 0.756827f,
+					-0.216236f, -0.189207f, 0.504551f,
+					0.756827f, -0.216236f);
+	const __m256 p3 = _mm256_set_ps(-0.103943f, 0.233872f, 0.935489f,
+					-0.155915f, -0.103943f, 0.233872f,
+					0.935489f, -0.155915f);
+	const __m256 sign = _mm256_set1_ps(-0.f);
+
+	__m256 work = _mm256_insertf128_ps(
+		_mm256_castps128_ps256(_mm_loadu_ps(previous_a)),
+		_mm_loadu_ps(previous_b), 1);
+	__m256 peak = work;
+
+	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
+		__m256 new_work = _mm256_insertf128_ps(
+			_mm256_castps128_ps256(_mm_load_ps(&samples_a[i])),
+			_mm_load_ps(&samples_b[i]), 1);
+
+		/* Include the actual sample values in the peak. */
+		peak = _mm256_max_ps(peak, _mm256_andnot_ps(sign, new_work));
+
+		TRUE_PEAK_STEP_256();
+		TRUE_PEAK_STEP_256();
+		TRUE_PEAK_STEP_256();
+		TRUE_PEAK_STEP_256();
+	}
+
+	float peak_mem[8];
+	_mm256_storeu_ps(peak_mem, peak);
+	*peak_a = hmax4(peak_mem);
+	*peak_b = hmax4(peak_mem + 4);
+}
+#endif
+
 /* points contain the first four samples to calculate the sinc interpolation
  * over. They will have come from a previous iteration.
  */
@@ -433,25 +552,53 @@ static void volmeter_process_peak_last_samples(obs_volmeter_t *volmeter,
 	}
 }
 
-static void volmeter_process_peak(obs_volmeter_t *volmeter,
-				  const struct audio_data *data,
-				  int nr_channels)
+static float get_sum_squares(const float *samples, size_t nr_samples)
+{
+	__m128 sum = _mm_setzero_ps();
+	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
+		__m128 work = _mm_load_ps(&samples[i]);
+		sum = _mm_add_ps(sum, _mm_mul_ps(work, work));
+	}
+
+	float sum_mem[4];
+	_mm_storeu_ps(sum_mem, sum);
+	return sum_mem[0] + sum_mem[1] + sum_mem[2] + sum_mem[3];
+}
+
+/* Processes frames of the queue that are known to be a multiple of four and
+ * to start on a four frame boundary, so all loads are aligned. */
+static void volmeter_process_frames(obs_volmeter_t *volmeter, size_t offset,
+				    size_t nr_samples, int nr_channels,
+				    enum obs_peak_meter_type peak_meter_type,
+				    bool avx)
 {
-	int nr_samples = data->frames;
+	struct meter_queue *queue = &volmeter->queue;
 	int channel_nr = 0;
-	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
-		if (!samples) {
-			continue;
-		}
-		if (((uintptr_t)samples & 0xf) > 0) {
-			printf("Audio plane %i is not aligned %p skipping "
-			       "peak volume measurement.\n",
-			       plane_nr, samples);
-			volmeter->peak[channel_nr] = 1.0;
-			channel_nr++;
-			continue;
+
+#ifdef VOLMETER_AVX
+	if (avx && peak_meter_type == TRUE_PEAK_METER) {
+		for (; channel_nr + 1 < nr_channels; channel_nr += 2) {
+			float peak_a, peak_b;
+
+			get_true_peak_avx(
+				volmeter->prev_samples[channel_nr],
+				volmeter->prev_samples[channel_nr + 1],
+				queue->data[channel_nr] + offset,
+				queue->data[channel_nr + 1] + offset,
+				nr_samples, &peak_a, &peak_b);
+
+			volmeter->peak[channel_nr] =
+				fmaxf(volmeter->peak[channel_nr], peak_a);
+			volmeter->peak[channel_nr + 1] =
+				fmaxf(volmeter->peak[channel_nr + 1], peak_b);
 		}
+	}
+#else
+	UNUSED_PARAMETER(avx);
+#endif
+
+	for (; channel_nr < nr_channels; channel_nr++) {
+		float *samples = queue->data[channel_nr] + offset;
 
 		/* volmeter->prev_samples may not be aligned to 16 bytes;
 		 * use unaligned load. */
@@ -459,7 +606,7 @@ static void volmeter_process_peak(obs_volmeter_t *volmeter,
 			_mm_loadu_ps(volmeter->prev_samples[channel_nr]);
 
 		float peak;
-		switch (volmeter->peak_meter_type) {
+		switch (peak_meter_type) {
 		case TRUE_PEAK_METER:
 			peak = get_true_peak(previous_samples, samples,
 					     nr_samples);
@@ -472,51 +619,198 @@ static void volmeter_process_peak(obs_volmeter_t *volmeter,
 			break;
 		}
 
+		volmeter->peak[channel_nr] =
+			fmaxf(volmeter->peak[channel_nr], peak);
+	}
+
+	for (channel_nr = 0; channel_nr < nr_channels; channel_nr++) {
+		float *samples = queue->data[channel_nr] + offset;
+
+		volmeter->sum_squares[channel_nr] +=
+			get_sum_squares(samples, nr_samples);
 		volmeter_process_peak_last_samples(volmeter, channel_nr,
 						   samples, nr_samples);
+	}
 
-		volmeter->peak[channel_nr] = peak;
+	volmeter->frames += nr_samples;
+}
 
-		channel_nr++;
+static void volmeter_update_levels(obs_volmeter_t *volmeter, int nr_channels,
+				   float cur_db)
+{
+	float mul;
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS];
+	float input_peak[MAX_AUDIO_CHANNELS];
+
+	// Adjust magnitude/peak based on the volume level set by the user.
+	// And convert to dB.
+	mul = os_atomic_load_bool(&volmeter->muted) ? 0.0f
+						    : db_to_mul(cur_db);
+	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS;
+	     channel_nr++) {
+		float channel_magnitude = 0.0f;
+		float channel_peak = 0.0f;
+
+		if (channel_nr < nr_channels) {
+			channel_magnitude =
+				sqrtf(volmeter->sum_squares[channel_nr] /
+				      volmeter->frames);
+			channel_peak = volmeter->peak[channel_nr];
+		}
+
+		magnitude[channel_nr] = mul_to_db(channel_magnitude * mul);
+		peak[channel_nr] = mul_to_db(channel_peak * mul);
+
+		/* The input-peak is NOT adjusted with volume, so that the user
+		 * can check the input-gain. */
+		input_peak[channel_nr] = mul_to_db(channel_peak);
+
+		volmeter->sum_squares[channel_nr] = 0.0f;
+		volmeter->peak[channel_nr] = 0.0f;
 	}
 
-	/* Clear the peak of the channels that have not been handled. */
-	for (; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
-		volmeter->peak[channel_nr] = 0.0;
+	volmeter->frames = 0;
+
+	signal_levels_updated(volmeter, magnitude, peak, input_peak);
+}
+
+/* called on the metering thread for every volume meter */
+static void volmeter_process_queue(obs_volmeter_t *volmeter, uint64_t now,
+				   bool avx)
+{
+	struct meter_queue *queue = &volmeter->queue;
+	enum obs_peak_meter_type peak_meter_type;
+	uint64_t interval_ns;
+	float cur_db;
+	long read_pos = queue->read_pos;
+	long write_pos = os_atomic_load_long(&queue->write_pos);
+	size_t avail = (size_t)(write_pos - read_pos) & METER_QUEUE_MASK;
+	int nr_channels = (int)os_atomic_load_long(&volmeter->nr_channels);
+
+	/* leftover frames are processed with the next batch */
+	avail &= ~(size_t)3;
+
+	if (nr_channels > queue->channels)
+		nr_channels = queue->channels;
+
+	pthread_mutex_lock(&volmeter->mutex);
+	peak_meter_type = volmeter->peak_meter_type;
+	interval_ns = (uint64_t)volmeter->update_ms * 1000000ULL;
+	cur_db = volmeter->cur_db;
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	if (avail) {
+		size_t first = METER_QUEUE_FRAMES - (size_t)read_pos;
+		if (first > avail)
+			first = avail;
+
+		volmeter_process_frames(volmeter, (size_t)read_pos, first,
+					nr_channels, peak_meter_type, avx);
+		if (avail > first)
+			volmeter_process_frames(volmeter, 0, avail - first,
+						nr_channels, peak_meter_type,
+						avx);
+
+		os_atomic_set_long(&queue->read_pos,
+				   (long)(((size_t)read_pos + avail) &
+					  METER_QUEUE_MASK));
 	}
+
+	if (!volmeter->frames || now - volmeter->last_update_ns < interval_ns)
+		return;
+
+	volmeter->last_update_ns = now;
+	volmeter_update_levels(volmeter, nr_channels, cur_db);
 }
 
-static void volmeter_process_magnitude(obs_volmeter_t *volmeter,
-				       const struct audio_data *data,
-				       int nr_channels)
+static void *volmeter_worker_thread(void *data)
 {
-	size_t nr_samples = data->frames;
+	struct volmeter_worker *vw = data;
 
-	int channel_nr = 0;
-	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
-		if (!samples) {
-			continue;
-		}
+	os_set_thread_name("volume meters");
 
-		float sum = 0.0;
-		for (size_t i = 0; i < nr_samples; i++) {
-			float sample = samples[i];
-			sum += sample * sample;
-		}
-		volmeter->magnitude[channel_nr] = sqrtf(sum / nr_samples);
+	while (os_event_timedwait(vw->stop_event, METER_WORKER_INTERVAL_MS) ==
+	       ETIMEDOUT) {
+		uint64_t now = os_gettime_ns();
 
-		channel_nr++;
+		pthread_mutex_lock(&meters_mutex);
+		for (size_t i = 0; i < meters.num; i++)
+			volmeter_process_queue(meters.array[i], now, vw->avx);
+		pthread_mutex_unlock(&meters_mutex);
 	}
+
+	return NULL;
 }
 
-static void volmeter_process_audio_data(obs_volmeter_t *volmeter,
-					const struct audio_data *data)
+static void volmeter_worker_free(struct volmeter_worker *vw)
 {
-	int nr_channels = get_nr_channels_from_audio_data(data);
+	if (!vw)
+		return;
 
-	volmeter_process_peak(volmeter, data, nr_channels);
-	volmeter_process_magnitude(volmeter, data, nr_channels);
+	os_event_destroy(vw->stop_event);
+	bfree(vw);
+}
+
+static struct volmeter_worker *volmeter_worker_create(void)
+{
+	struct volmeter_worker *vw = bzalloc(sizeof(*vw));
+
+	vw->avx = os_cpu_has_avx();
+
+	if (os_event_init(&vw->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&vw->thread, NULL, volmeter_worker_thread, vw) != 0)
+		goto fail;
+
+	return vw;
+
+fail:
+	blog(LOG_ERROR, "Failed to start the volume meter thread");
+	volmeter_worker_free(vw);
+	return NULL;
+}
+
+static void volmeter_worker_stop(struct volmeter_worker *vw)
+{
+	os_event_signal(vw->stop_event);
+	pthread_join(vw->thread, NULL);
+	volmeter_worker_free(vw);
+}
+
+/* Only copies the samples, the levels are computed in batches on the
+ * metering thread so that many meters do not slow down the audio thread. */
+static void meter_queue_push(struct meter_queue *queue, const float **planes,
+			     int nr_channels, size_t frames)
+{
+	long write_pos = queue->write_pos;
+	long read_pos = os_atomic_load_long(&queue->read_pos);
+	size_t used = (size_t)(write_pos - read_pos) & METER_QUEUE_MASK;
+	size_t space = METER_QUEUE_FRAMES - 1 - used;
+	size_t first;
+
+	/* the metering thread has fallen behind, drop what does not fit */
+	if (frames > space)
+		frames = space;
+
+	first = METER_QUEUE_FRAMES - (size_t)write_pos;
+	if (first > frames)
+		first = frames;
+
+	if (nr_channels > queue->channels)
+		nr_channels = queue->channels;
+
+	for (int channel_nr = 0; channel_nr < nr_channels; channel_nr++) {
+		float *dst = queue->data[channel_nr];
+		const float *src = planes[channel_nr];
+
+		memcpy(dst + write_pos, src, first * sizeof(float));
+		memcpy(dst, src + first, (frames - first) * sizeof(float));
+	}
+
+	os_atomic_set_long(&queue->write_pos,
+			   (long)(((size_t)write_pos + frames) &
+				  METER_QUEUE_MASK));
 }
 
 static void volmeter_source_data_received(void *vptr, obs_source_t *source,
@@ -524,32 +818,21 @@ static void volmeter_source_data_received(void *vptr, obs_source_t *source,
 					  bool muted)
 {
 	struct obs_volmeter *volmeter = (struct obs_volmeter *)vptr;
-	float mul;
-	float magnitude[MAX_AUDIO_CHANNELS];
-	float peak[MAX_AUDIO_CHANNELS];
-	float input_peak[MAX_AUDIO_CHANNELS];
-
-	pthread_mutex_lock(&volmeter->mutex);
-
-	volmeter_process_audio_data(volmeter, data);
+	const float *planes[MAX_AUDIO_CHANNELS];
+	int nr_channels = 0;
 
-	// Adjust magnitude/peak based on the volume level set by the user.
-	// And convert to dB.
-	mul = muted ? 0.0f : db_to_mul(volmeter->cur_db);
-	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS;
-	     channel_nr++) {
-		magnitude[channel_nr] =
-			mul_to_db(volmeter->magnitude[channel_nr] * mul);
-		peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr] * mul);
+	for (int i = 0; i < MAX_AV_PLANES; i++) {
+		if (!data->data[i])
+			continue;
+		if (nr_channels == MAX_AUDIO_CHANNELS)
+			break;
 
-		/* The input-peak is NOT adjusted with volume, so that the user
-		 * can check the input-gain. */
-		input_peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr]);
+		planes[nr_channels++] = (const float *)data->data[i];
 	}
 
-	pthread_mutex_unlock(&volmeter->mutex);
-
-	signal_levels_updated(volmeter, magnitude, peak, input_peak);
+	meter_queue_push(&volmeter->queue, planes, nr_channels, data->frames);
+	os_atomic_set_long(&volmeter->nr_channels, nr_channels);
+	os_atomic_set_bool(&volmeter->muted, muted);
 
 	UNUSED_PARAMETER(source);
 }
@@ -768,6 +1051,61 @@ void obs_fader_remove_callback(obs_fader_t *fader, obs_fader_changed_t callback,
 	pthread_mutex_unlock(&fader->callback_mutex);
 }
 
+static void meter_queue_init(struct meter_queue *queue)
+{
+	struct obs_audio_info oai;
+	float *data;
+
+	/* sources are metered after they have been converted to the output
+	 * format, so they never have more channels than the output */
+	if (obs_get_audio_info(&oai))
+		queue->channels = (int)get_audio_channels(oai.speakers);
+	if (queue->channels <= 0 || queue->channels > MAX_AUDIO_CHANNELS)
+		queue->channels = MAX_AUDIO_CHANNELS;
+
+	data = bzalloc(queue->channels * METER_QUEUE_FRAMES * sizeof(float));
+	for (int i = 0; i < queue->channels; i++)
+		queue->data[i] = data + i * METER_QUEUE_FRAMES;
+}
+
+static bool volmeter_register(struct obs_volmeter *volmeter)
+{
+	pthread_mutex_lock(&meters_mutex);
+
+	if (!worker)
+		worker = volmeter_worker_create();
+	if (worker)
+		da_push_back(meters, &volmeter);
+
+	pthread_mutex_unlock(&meters_mutex);
+	return worker != NULL;
+}
+
+static void volmeter_unregister(struct obs_volmeter *volmeter)
+{
+	struct volmeter_worker *vw = NULL;
+
+	pthread_mutex_lock(&meters_mutex);
+
+	if (da_find(meters, &volmeter, 0) == DARRAY_INVALID) {
+		pthread_mutex_unlock(&meters_mutex);
+		return;
+	}
+
+	da_erase_item(meters, &volmeter);
+
+	if (!meters.num) {
+		da_free(meters);
+		vw = worker;
+		worker = NULL;
+	}
+
+	pthread_mutex_unlock(&meters_mutex);
+
+	if (vw)
+		volmeter_worker_stop(vw);
+}
+
 obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 {
 	struct obs_volmeter *volmeter = bzalloc(sizeof(struct obs_volmeter));
@@ -782,9 +1120,13 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 		goto fail;
 
 	volmeter->type = type;
+	meter_queue_init(&volmeter->queue);
 
 	obs_volmeter_set_update_interval(volmeter, 50);
 
+	if (!volmeter_register(volmeter))
+		goto fail;
+
 	return volmeter;
 fail:
 	obs_volmeter_destroy(volmeter);
@@ -797,10 +1139,12 @@ void obs_volmeter_destroy(obs_volmeter_t *volmeter)
 		return;
 
 	obs_volmeter_detach_source(volmeter);
+	volmeter_unregister(volmeter);
 	da_free(volmeter->callbacks);
 	pthread_mutex_destroy(&volmeter->callback_mutex);
 	pthread_mutex_destroy(&volmeter->mutex);
 
+	bfree(volmeter->queue.data[0]);
 	bfree(volmeter);
 }
 
@@ -236,18 +236,14 @@ obs_volmeter_set_peak_meter_type(obs_volmeter_t *volmeter,
  * @param volmeter pointer to the volume meter object
  * @param ms update interval in ms
  *
- * This sets the update interval in milliseconds that should be processed before
- * the resulting values are emitted by the levels_updated signal. The resulting
- * number of audio samples is rounded to an integer.
+ * This sets the minimum interval in milliseconds between two invocations of
+ * the level callbacks.  The levels of all volume meters are computed in
+ * batches on a shared metering thread, so each invocation reports the peak
+ * and the magnitude of all audio received since the previous one.
  *
- * Please note that due to way obs does receive audio data from the sources
- * this is no hard guarantee for the timing of the signal itself. When the
- * volume meter receives a chunk of data that is multiple the size of the sample
- * interval, all data will be sampled and the values updated accordingly, but
- * only the signal for the last segment is actually emitted.
- * On the other hand data might be received in a way that will cause the signal
- * to be emitted in shorter intervals than specified here under some
- * circumstances.
+ * Please note that the metering thread wakes up at a fixed rate, so this is no
+ * hard guarantee for the timing of the callbacks, and they are not invoked at
+ * all while the source does not output any audio.
  */
 EXPORT void obs_volmeter_set_update_interval(obs_volmeter_t *volmeter,
 					     const unsigned int ms);
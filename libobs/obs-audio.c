@@ -19,14 +19,8 @@
 #include "obs-internal.h"
 #include "util/util_uint64.h"
 
-struct ts_info {
-	uint64_t start;
-	uint64_t end;
-};
-
 #define DEBUG_AUDIO 0
 #define DEBUG_LAGGED_AUDIO 0
-#define MAX_BUFFERING_TICKS 45
 
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
@@ -240,9 +234,10 @@ static inline void discard_audio(struct obs_core_audio *audio,
 
 		/* ignore_audio should have already run and marked this source
 		 * pending, unless we *just* added buffering */
-		assert(audio->total_buffering_ticks < MAX_BUFFERING_TICKS ||
+		assert(audio->buffering.total_ticks <
+			       AUDIO_BUFFERING_MAX_TICKS ||
 		       source->audio_pending || !source->audio_ts ||
-		       audio->buffering_wait_ticks);
+		       audio->buffering.wait_ticks);
 #endif
 		return;
 	}
@@ -295,73 +290,63 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 				size_t sample_rate, struct ts_info *ts,
 				uint64_t min_ts, const char *buffering_name)
 {
-	struct ts_info new_ts;
-	uint64_t offset;
-	uint64_t frames;
+	struct audio_buffering *buf = &audio->buffering;
 	size_t total_ms;
 	size_t ms;
 	int ticks;
 
-	if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
-		return;
-
-	if (!audio->buffering_wait_ticks)
-		audio->buffered_ts = ts->start;
-
-	offset = ts->start - min_ts;
-	frames = ns_to_audio_frames(sample_rate, offset);
-	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+#if DEBUG_AUDIO == 1
+	blog(LOG_DEBUG,
+	     "min_ts (%" PRIu64 ") < start timestamp "
+	     "(%" PRIu64 ")",
+	     min_ts, ts->start);
+	blog(LOG_DEBUG, "old buffered ts: %" PRIu64 "-%" PRIu64, ts->start,
+	     ts->end);
+#endif
 
-	audio->total_buffering_ticks += ticks;
+	ticks = audio_buffering_add(buf, sample_rate, ts, min_ts);
+	if (!ticks)
+		return;
 
-	if (audio->total_buffering_ticks >= MAX_BUFFERING_TICKS) {
-		ticks -= audio->total_buffering_ticks - MAX_BUFFERING_TICKS;
-		audio->total_buffering_ticks = MAX_BUFFERING_TICKS;
+	if (buf->total_ticks == AUDIO_BUFFERING_MAX_TICKS)
 		blog(LOG_WARNING, "Max audio buffering reached!");
-	}
 
 	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
-		   sample_rate;
+	total_ms = buf->total_ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
 
 	blog(LOG_INFO,
 	     "adding %d milliseconds of audio buffering, total "
 	     "audio buffering is now %d milliseconds"
 	     " (source: %s)\n",
 	     (int)ms, (int)total_ms, buffering_name);
-#if DEBUG_AUDIO == 1
-	blog(LOG_DEBUG,
-	     "min_ts (%" PRIu64 ") < start timestamp "
-	     "(%" PRIu64 ")",
-	     min_ts, ts->start);
-	blog(LOG_DEBUG, "old buffered ts: %" PRIu64 "-%" PRIu64, ts->start,
-	     ts->end);
-#endif
-
-	new_ts.start =
-		audio->buffered_ts -
-		audio_frames_to_ns(sample_rate, audio->buffering_wait_ticks *
-							AUDIO_OUTPUT_FRAMES);
+}
 
-	while (ticks--) {
-		int cur_ticks = ++audio->buffering_wait_ticks;
+/* how far the audio of a source goes past the end of the mix */
+static uint64_t get_headroom(struct obs_source *source, size_t sample_rate,
+			     uint64_t end_ts)
+{
+	size_t frames = source->audio_input_buf[0].size / sizeof(float);
+	uint64_t buffered_end;
 
-		new_ts.end = new_ts.start;
-		new_ts.start =
-			audio->buffered_ts -
-			audio_frames_to_ns(sample_rate,
-					   cur_ticks * AUDIO_OUTPUT_FRAMES);
+	if (source->info.audio_render || source->audio_pending ||
+	    !source->audio_ts)
+		return UINT64_MAX;
 
-#if DEBUG_AUDIO == 1
-		blog(LOG_DEBUG, "add buffered ts: %" PRIu64 "-%" PRIu64,
-		     new_ts.start, new_ts.end);
-#endif
+	buffered_end =
+		source->audio_ts + audio_frames_to_ns(sample_rate, frames);
+	return buffered_end > end_ts ? buffered_end - end_ts : 0;
+}
 
-		circlebuf_push_front(&audio->buffered_timestamps, &new_ts,
-				     sizeof(new_ts));
-	}
+static void log_removed_buffering(struct obs_core_audio *audio,
+				  size_t sample_rate)
+{
+	size_t total_ms = audio->buffering.total_ticks * AUDIO_OUTPUT_FRAMES *
+			  1000 / sample_rate;
 
-	*ts = new_ts;
+	blog(LOG_INFO,
+	     "removing %d milliseconds of audio buffering, total "
+	     "audio buffering is now %d milliseconds",
+	     (int)(AUDIO_OUTPUT_FRAMES * 1000 / sample_rate), (int)total_ms);
 }
 
 static bool audio_buffer_insuffient(struct obs_source *source,
@@ -453,12 +438,20 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	struct ts_info ts = {start_ts_in, end_ts_in};
 	size_t audio_size;
 	uint64_t min_ts;
+	uint64_t headroom = UINT64_MAX;
+	bool release;
+	bool output;
+
+	/* an extra packet asked for to give back buffering: no time has
+	 * passed, so the oldest buffered packet is mixed without adding one */
+	bool catch_up = start_ts_in == end_ts_in;
+
+	if (!audio_buffering_begin(&audio->buffering, &ts, catch_up))
+		return false;
 
 	da_resize(audio->render_order, 0);
 	da_resize(audio->root_nodes, 0);
 
-	circlebuf_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
-	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
 	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
@@ -500,7 +493,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 		/* if a source has gone backward in time and we can no
 		 * longer buffer, drop some or all of its audio */
-		if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS &&
+		if (audio->buffering.total_ticks == AUDIO_BUFFERING_MAX_TICKS &&
 		    source->audio_ts < ts.start) {
 			if (source->info.audio_render) {
 				blog(LOG_DEBUG,
@@ -545,7 +538,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* mix audio */
-	if (!audio->buffering_wait_ticks) {
+	if (!audio->buffering.wait_ticks) {
 		for (size_t i = 0; i < audio->root_nodes.num; i++) {
 			obs_source_t *source = audio->root_nodes.array[i];
 
@@ -570,6 +563,11 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	while (source) {
 		pthread_mutex_lock(&source->audio_buf_mutex);
 		discard_audio(audio, source, channels, sample_rate, &ts);
+
+		uint64_t source_headroom =
+			get_headroom(source, sample_rate, ts.end);
+		if (source_headroom < headroom)
+			headroom = source_headroom;
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 
 		source = (struct obs_source *)source->next_audio_source;
@@ -581,15 +579,18 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	/* release audio sources */
 	release_audio_sources(audio);
 
-	circlebuf_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
+	output = audio_buffering_end(&audio->buffering, sample_rate, &ts,
+				     headroom, catch_up, &release);
 
-	*out_ts = ts.start;
+	if (catch_up)
+		log_removed_buffering(audio, sample_rate);
 
-	if (audio->buffering_wait_ticks) {
-		audio->buffering_wait_ticks--;
-		return false;
-	}
+	/* the packet is mixed right after this one */
+	if (release)
+		audio_output_catch_up(audio->audio);
+
+	*out_ts = ts.start;
 
 	UNUSED_PARAMETER(param);
-	return true;
+	return output;
 }
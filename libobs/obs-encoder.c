@@ -17,7 +17,9 @@
 
 #include "obs.h"
 #include "obs-internal.h"
+#include <inttypes.h>
 #include "util/util_uint64.h"
+#include "media-io/video-frame.h"
 
 #define encoder_active(encoder) os_atomic_load_bool(&encoder->active)
 #define set_encoder_active(encoder, val) \
@@ -50,6 +52,7 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 	pthread_mutex_init_value(&encoder->callbacks_mutex);
 	pthread_mutex_init_value(&encoder->outputs_mutex);
 	pthread_mutex_init_value(&encoder->pause.mutex);
+	pthread_mutex_init_value(&encoder->queue_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -66,6 +69,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		return false;
 	if (pthread_mutex_init(&encoder->pause.mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->queue_mutex, NULL) != 0)
+		return false;
 
 	if (encoder->orig_info.get_defaults) {
 		encoder->orig_info.get_defaults(encoder->context.settings);
@@ -142,7 +147,13 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
 }
 
 static void receive_video(void *param, struct video_data *frame);
+static bool start_video_queue(struct obs_encoder *encoder,
+			      const struct video_scale_info *info);
+static void drain_video_queue(struct obs_encoder *encoder);
+static void stop_video_queue(struct obs_encoder *encoder);
+static void free_video_queue(struct obs_encoder *encoder);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
+static void log_audio_copies(struct obs_encoder *encoder);
 
 static inline void get_audio_info(const struct obs_encoder *encoder,
 				  struct audio_convert_info *info)
@@ -211,6 +222,13 @@ static void add_connection(struct obs_encoder *encoder)
 		if (gpu_encode_available(encoder)) {
 			start_gpu_encode(encoder);
 		} else {
+			/* a previous encode error may have stopped the queue
+			 * from its own thread, in which case it still needs
+			 * to be freed */
+			free_video_queue(encoder);
+
+			if (encoder->queue_max_frames)
+				start_video_queue(encoder, &info);
 			start_raw_video(encoder->media, &info, receive_video,
 					encoder);
 		}
@@ -224,11 +242,13 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
 		audio_output_disconnect(encoder->media, encoder->mixer_idx,
 					receive_audio, encoder);
+		log_audio_copies(encoder);
 	} else {
 		if (gpu_encode_available(encoder)) {
 			stop_gpu_encode(encoder);
 		} else {
 			stop_raw_video(encoder->media, receive_video, encoder);
+			stop_video_queue(encoder);
 		}
 	}
 
@@ -266,6 +286,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		     encoder->context.name);
 
 		free_audio_buffers(encoder);
+		free_video_queue(encoder);
 
 		if (encoder->context.data)
 			encoder->info.destroy(encoder->context.data);
@@ -274,6 +295,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
 		pthread_mutex_destroy(&encoder->pause.mutex);
+		pthread_mutex_destroy(&encoder->queue_mutex);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void *)encoder->info.id);
@@ -424,6 +446,13 @@ obs_data_t *obs_encoder_get_settings(const obs_encoder_t *encoder)
 	return encoder->context.settings;
 }
 
+proc_handler_t *obs_encoder_get_proc_handler(const obs_encoder_t *encoder)
+{
+	return obs_encoder_valid(encoder, "obs_encoder_get_proc_handler")
+		       ? encoder->context.procs
+		       : NULL;
+}
+
 static inline void reset_audio_buffers(struct obs_encoder *encoder)
 {
 	free_audio_buffers(encoder);
@@ -579,6 +608,7 @@ static inline void obs_encoder_start_internal(
 		pause_reset(&encoder->pause);
 
 		encoder->cur_pts = 0;
+		encoder->audio_copied_bytes = 0;
 		add_connection(encoder);
 	}
 }
@@ -606,8 +636,19 @@ static inline bool obs_encoder_stop_internal(
 	bool last = false;
 	size_t idx;
 
+	pthread_mutex_lock(&encoder->callbacks_mutex);
+	idx = get_callback_idx(encoder, new_packet, param);
+	last = idx != DARRAY_INVALID && encoder->callbacks.num == 1;
+	pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+	/* the frames still queued go to the output before it stops */
+	if (last)
+		drain_video_queue(encoder);
+
 	pthread_mutex_lock(&encoder->callbacks_mutex);
 
+	/* an encode error while draining has removed every callback */
+	last = false;
 	idx = get_callback_idx(encoder, new_packet, param);
 	if (idx != DARRAY_INVALID) {
 		da_erase(encoder->callbacks, idx);
@@ -698,6 +739,67 @@ void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 	encoder->scaled_height = height;
 }
 
+void obs_encoder_set_queue(obs_encoder_t *encoder, size_t max_frames,
+			   enum obs_encoder_queue_drop drop)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_queue"))
+		return;
+	if (encoder->info.type != OBS_ENCODER_VIDEO) {
+		blog(LOG_WARNING,
+		     "obs_encoder_set_queue: "
+		     "encoder '%s' is not a video encoder",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+	if (encoder_active(encoder)) {
+		blog(LOG_WARNING,
+		     "encoder '%s': Cannot change the input "
+		     "queue while the encoder is active",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+
+	encoder->queue_max_frames = max_frames;
+	encoder->queue_drop = drop;
+}
+
+size_t obs_encoder_get_queue_depth(obs_encoder_t *encoder)
+{
+	size_t depth;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_queue_depth"))
+		return 0;
+
+	pthread_mutex_lock(&encoder->queue_mutex);
+	depth = video_queue_get_depth(encoder->queue);
+	pthread_mutex_unlock(&encoder->queue_mutex);
+	return depth;
+}
+
+bool obs_encoder_get_queue_stats(obs_encoder_t *encoder,
+				 struct obs_encoder_queue_stats *stats)
+{
+	struct video_queue_stats queue_stats;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_queue_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_encoder_get_queue_stats"))
+		return false;
+
+	pthread_mutex_lock(&encoder->queue_mutex);
+	queue_stats = encoder->queue_stats;
+	video_queue_get_stats(encoder->queue, &queue_stats);
+	pthread_mutex_unlock(&encoder->queue_mutex);
+
+	stats->depth = queue_stats.depth;
+	stats->max_depth = queue_stats.max_depth;
+	stats->queued_frames = queue_stats.queued_frames;
+	stats->dropped_frames = queue_stats.dropped_frames;
+	for (size_t i = 0; i < OBS_ENCODER_QUEUE_LATENCY_BUCKETS; i++)
+		stats->latency_ms[i] = queue_stats.latency_ms[i];
+	return true;
+}
+
 bool obs_encoder_scaling_enabled(const obs_encoder_t *encoder)
 {
 	if (!obs_encoder_valid(encoder, "obs_encoder_scaling_enabled"))
@@ -1015,6 +1117,99 @@ bool video_pause_check(struct pause_data *pause, uint64_t timestamp)
 	return ignore_frame;
 }
 
+/* ------------------------------------------------------------------------- */
+/* video input queue */
+
+static bool encode_queued_frame(void *param, struct video_frame *frame,
+				int64_t pts)
+{
+	struct obs_encoder *encoder = param;
+	struct encoder_frame enc_frame;
+	bool success;
+
+	profile_start(encoder->profile_queue_thread_name);
+
+	memset(&enc_frame, 0, sizeof(struct encoder_frame));
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		enc_frame.data[i] = frame->data[i];
+		enc_frame.linesize[i] = frame->linesize[i];
+	}
+	enc_frame.frames = 1;
+	enc_frame.pts = pts;
+
+	success = do_encode(encoder, &enc_frame);
+
+	profile_end(encoder->profile_queue_thread_name);
+	profile_reenable_thread();
+	return success;
+}
+
+static void free_video_queue(struct obs_encoder *encoder)
+{
+	video_queue_t *queue;
+
+	/* keep the statistics of the last run */
+	pthread_mutex_lock(&encoder->queue_mutex);
+	queue = encoder->queue;
+	video_queue_get_stats(queue, &encoder->queue_stats);
+	encoder->queue = NULL;
+	pthread_mutex_unlock(&encoder->queue_mutex);
+
+	video_queue_destroy(queue);
+}
+
+static bool start_video_queue(struct obs_encoder *encoder,
+			      const struct video_scale_info *info)
+{
+	struct video_queue_info queue_info = {
+		.max_frames = encoder->queue_max_frames,
+		.drop = encoder->queue_drop == OBS_ENCODER_QUEUE_DROP_OLDEST
+				? VIDEO_QUEUE_DROP_OLDEST
+				: VIDEO_QUEUE_DROP_NEWEST,
+		.format = info->format,
+		.width = info->width,
+		.height = info->height,
+		.callback = encode_queued_frame,
+		.param = encoder,
+	};
+	video_queue_t *queue;
+
+	if (!encoder->profile_queue_thread_name)
+		encoder->profile_queue_thread_name = profile_store_name(
+			obs_get_profiler_name_store(),
+			"encoder_queue_thread(%s)", encoder->context.name);
+
+	queue = video_queue_create(&queue_info);
+	if (!queue) {
+		blog(LOG_WARNING,
+		     "encoder '%s': Failed to start the input queue, "
+		     "encoding on the video thread instead",
+		     encoder->context.name);
+		return false;
+	}
+
+	pthread_mutex_lock(&encoder->queue_mutex);
+	encoder->queue = queue;
+	pthread_mutex_unlock(&encoder->queue_mutex);
+	return true;
+}
+
+/* Encodes every frame still queued.  Called before the last output stops
+ * receiving packets, so the end of the recording or stream isn't cut off.
+ * Frames the video thread sends after this are dropped. */
+static void drain_video_queue(struct obs_encoder *encoder)
+{
+	video_queue_stop(encoder->queue);
+}
+
+static void stop_video_queue(struct obs_encoder *encoder)
+{
+	/* encode errors stop the encoder from the queue thread itself, so
+	 * just stop taking frames and leave freeing it to the next start */
+	if (video_queue_stop(encoder->queue))
+		free_video_queue(encoder);
+}
+
 static const char *receive_video_name = "receive_video";
 static void receive_video(void *param, struct video_data *frame)
 {
@@ -1034,6 +1229,16 @@ static void receive_video(void *param, struct video_data *frame)
 	if (video_pause_check(&encoder->pause, frame->timestamp))
 		goto wait_for_audio;
 
+	if (!encoder->start_ts)
+		encoder->start_ts = frame->timestamp;
+
+	/* the pts still advances for dropped frames to keep a/v sync */
+	if (encoder->queue) {
+		video_queue_push(encoder->queue, frame, encoder->cur_pts);
+		encoder->cur_pts += encoder->timebase_num;
+		goto wait_for_audio;
+	}
+
 	memset(&enc_frame, 0, sizeof(struct encoder_frame));
 
 	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
@@ -1041,9 +1246,6 @@ static void receive_video(void *param, struct video_data *frame)
 		enc_frame.linesize[i] = frame->linesize[i];
 	}
 
-	if (!encoder->start_ts)
-		encoder->start_ts = frame->timestamp;
-
 	enc_frame.frames = 1;
 	enc_frame.pts = encoder->cur_pts;
 
@@ -1067,10 +1269,13 @@ static inline void push_back_audio(struct obs_encoder *encoder,
 	size -= offset_size;
 
 	/* push in to the circular buffer */
-	if (size)
+	if (size) {
 		for (size_t i = 0; i < encoder->planes; i++)
 			circlebuf_push_back(&encoder->audio_input_buffer[i],
 					    data->data[i] + offset_size, size);
+
+		encoder->audio_copied_bytes += size * encoder->planes;
+	}
 }
 
 static inline size_t calc_offset_size(struct obs_encoder *encoder,
@@ -1103,8 +1308,12 @@ static void start_from_buffer(struct obs_encoder *encoder, uint64_t v_start_ts)
 		bfree(audio.data[i]);
 }
 
+/* returns false while audio is still waiting for video to start, in which case
+ * the data is buffered.  otherwise the data is left for the caller to encode,
+ * starting at offset_size */
 static const char *buffer_audio_name = "buffer_audio";
-static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
+static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data,
+			 size_t *p_offset_size)
 {
 	profile_start(buffer_audio_name);
 
@@ -1150,24 +1359,23 @@ static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
 	}
 
 fail:
-	push_back_audio(encoder, data, size, offset_size);
+	if (success)
+		*p_offset_size = offset_size;
+	else
+		push_back_audio(encoder, data, size, offset_size);
 
 	profile_end(buffer_audio_name);
 	return success;
 }
 
-static bool send_audio_data(struct obs_encoder *encoder)
+static bool send_audio_frame(struct obs_encoder *encoder, uint8_t **data)
 {
 	struct encoder_frame enc_frame;
 
 	memset(&enc_frame, 0, sizeof(struct encoder_frame));
 
 	for (size_t i = 0; i < encoder->planes; i++) {
-		circlebuf_pop_front(&encoder->audio_input_buffer[i],
-				    encoder->audio_output_buffer[i],
-				    encoder->framesize_bytes);
-
-		enc_frame.data[i] = encoder->audio_output_buffer[i];
+		enc_frame.data[i] = data[i];
 		enc_frame.linesize[i] = (uint32_t)encoder->framesize_bytes;
 	}
 
@@ -1181,6 +1389,104 @@ static bool send_audio_data(struct obs_encoder *encoder)
 	return true;
 }
 
+/* encodes a frame from the input buffer.  the frame is passed to the encoder
+ * in place unless it wraps around the end of the buffer */
+static bool send_audio_data(struct obs_encoder *encoder)
+{
+	uint8_t *data[MAX_AV_PLANES] = {0};
+	bool in_place[MAX_AV_PLANES] = {0};
+	size_t size = encoder->framesize_bytes;
+	bool success;
+
+	for (size_t i = 0; i < encoder->planes; i++) {
+		struct circlebuf *buf = &encoder->audio_input_buffer[i];
+
+		if (buf->start_pos + size <= buf->capacity) {
+			data[i] = (uint8_t *)buf->data + buf->start_pos;
+			in_place[i] = true;
+		} else {
+			circlebuf_pop_front(buf, encoder->audio_output_buffer[i],
+					    size);
+			data[i] = encoder->audio_output_buffer[i];
+			encoder->audio_copied_bytes += size;
+		}
+	}
+
+	success = send_audio_frame(encoder, data);
+
+	for (size_t i = 0; i < encoder->planes; i++) {
+		if (in_place[i])
+			circlebuf_pop_front(&encoder->audio_input_buffer[i],
+					    NULL, size);
+	}
+
+	return success;
+}
+
+/* encodes as much of the data as possible straight from the mix buffers and
+ * only buffers what does not make up a whole encoder frame */
+static void encode_audio(struct obs_encoder *encoder, struct audio_data *audio,
+			 size_t offset_size)
+{
+	size_t frame_size = encoder->framesize_bytes;
+	size_t size = audio->frames * encoder->blocksize;
+	size_t pos = offset_size;
+	uint8_t *data[MAX_AV_PLANES] = {0};
+
+	while (encoder->audio_input_buffer[0].size >= frame_size) {
+		if (!send_audio_data(encoder))
+			return;
+	}
+
+	if (encoder->audio_input_buffer[0].size) {
+		size_t needed = frame_size - encoder->audio_input_buffer[0].size;
+
+		if (size - pos < needed) {
+			push_back_audio(encoder, audio, size, pos);
+			return;
+		}
+
+		push_back_audio(encoder, audio, pos + needed, pos);
+		pos += needed;
+
+		if (!send_audio_data(encoder))
+			return;
+	}
+
+	while (size - pos >= frame_size) {
+		for (size_t i = 0; i < encoder->planes; i++)
+			data[i] = audio->data[i] + pos;
+
+		if (!send_audio_frame(encoder, data))
+			return;
+
+		pos += frame_size;
+	}
+
+	push_back_audio(encoder, audio, size, pos);
+}
+
+static void log_audio_copies(struct obs_encoder *encoder)
+{
+	/* blocksize is per plane, and audio_copied_bytes counts every plane */
+	uint64_t encoded = (uint64_t)encoder->cur_pts * encoder->blocksize *
+			   encoder->planes;
+	double seconds;
+
+	if (!encoded || !encoder->samplerate)
+		return;
+
+	seconds = (double)encoder->cur_pts / (double)encoder->samplerate;
+
+	blog(LOG_DEBUG,
+	     "encoder '%s': copied %" PRIu64 " bytes of %" PRIu64
+	     " encoded audio bytes (%.2f copies per byte, "
+	     "%.0f bytes per second)",
+	     encoder->context.name, encoder->audio_copied_bytes, encoded,
+	     (double)encoder->audio_copied_bytes / (double)encoded,
+	     (double)encoder->audio_copied_bytes / seconds);
+}
+
 static void pause_audio(struct pause_data *pause, struct audio_data *data,
 			size_t sample_rate)
 {
@@ -1260,6 +1566,7 @@ static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
 
 	struct obs_encoder *encoder = param;
 	struct audio_data audio = *in;
+	size_t offset_size = 0;
 
 	if (!encoder->first_received) {
 		encoder->first_raw_ts = audio.timestamp;
@@ -1270,15 +1577,10 @@ static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
 	if (audio_pause_check(&encoder->pause, &audio, encoder->samplerate))
 		goto end;
 
-	if (!buffer_audio(encoder, &audio))
+	if (!buffer_audio(encoder, &audio, &offset_size))
 		goto end;
 
-	while (encoder->audio_input_buffer[0].size >=
-	       encoder->framesize_bytes) {
-		if (!send_audio_data(encoder)) {
-			break;
-		}
-	}
+	encode_audio(encoder, &audio, offset_size);
 
 	UNUSED_PARAMETER(mix_idx);
 
@@ -102,6 +102,36 @@ struct encoder_frame {
 	int64_t pts;
 };
 
+/** Specifies which frame is dropped when an encoder input queue is full */
+enum obs_encoder_queue_drop {
+	/** Drop the oldest queued frame to make room for the new one */
+	OBS_ENCODER_QUEUE_DROP_OLDEST,
+	/** Drop the incoming frame and keep the queued ones */
+	OBS_ENCODER_QUEUE_DROP_NEWEST,
+};
+
+#define OBS_ENCODER_QUEUE_LATENCY_BUCKETS 12
+
+/** Statistics of an encoder input queue */
+struct obs_encoder_queue_stats {
+	/** Number of frames currently waiting to be encoded */
+	size_t depth;
+	/** Highest number of frames that were waiting at once */
+	size_t max_depth;
+	/** Number of frames accepted in to the queue */
+	uint64_t queued_frames;
+	/** Number of frames dropped because the queue was full */
+	uint64_t dropped_frames;
+
+	/**
+	 * Histogram of the time between a frame being queued and its encode
+	 * call returning.  Bucket 0 counts frames under 1 millisecond, bucket
+	 * i counts frames in [2^(i-1), 2^i) milliseconds, and the last bucket
+	 * counts everything above that.
+	 */
+	uint64_t latency_ms[OBS_ENCODER_QUEUE_LATENCY_BUCKETS];
+};
+
 /**
  * Encoder interface
  *
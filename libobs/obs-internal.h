@@ -31,7 +31,12 @@
 #include "graphics/matrix4.h"
 
 #include "media-io/audio-resampler.h"
+#include "media-io/audio-buffering.h"
+#include "media-io/audio-drift.h"
+#include "media-io/video-deinterlace.h"
+#include "media-io/video-unpack.h"
 #include "media-io/video-io.h"
+#include "media-io/video-queue.h"
 #include "media-io/audio-io.h"
 
 #include "obs.h"
@@ -39,6 +44,7 @@
 #include <caption/caption.h>
 
 #define NUM_TEXTURES 2
+#define MAX_NUM_TEXTURES 4
 #define NUM_CHANNELS 3
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 3
@@ -245,12 +251,12 @@ struct obs_task_info {
 
 struct obs_core_video {
 	graphics_t *graphics;
-	gs_stagesurf_t *copy_surfaces[NUM_TEXTURES][NUM_CHANNELS];
+	gs_stagesurf_t *copy_surfaces[MAX_NUM_TEXTURES][NUM_CHANNELS];
 	gs_texture_t *render_texture;
 	gs_texture_t *output_texture;
 	gs_texture_t *convert_textures[NUM_CHANNELS];
 	bool texture_rendered;
-	bool textures_copied[NUM_TEXTURES];
+	bool textures_copied[MAX_NUM_TEXTURES];
 	bool texture_converted;
 	bool using_nv12_tex;
 	struct circlebuf vframe_info_buffer;
@@ -269,6 +275,15 @@ struct obs_core_video {
 	gs_samplerstate_t *point_sampler;
 	gs_stagesurf_t *mapped_surfaces[NUM_CHANNELS];
 	int cur_texture;
+	int num_textures;
+	uint32_t readback_depth;
+	pthread_t readback_thread;
+	bool readback_thread_initialized;
+	os_sem_t *readback_semaphore;
+	os_event_t *readback_done;
+	volatile bool readback_stop;
+	struct video_data readback_frame;
+	int readback_count;
 	long raw_active;
 	long gpu_encoder_active;
 	pthread_mutex_t gpu_encoder_mutex;
@@ -291,6 +306,11 @@ struct obs_core_video {
 	uint32_t lagged_frames;
 	bool thread_initialized;
 
+	/* rolling per-stage frame times, written by the graphics thread only */
+	uint64_t frame_stats[OBS_FRAME_STAT_COUNT][OBS_FRAME_STATS_WINDOW];
+	volatile long frame_stats_count;
+	uint64_t cur_frame_stats[OBS_FRAME_STAT_COUNT];
+
 	bool gpu_conversion;
 	const char *conversion_techs[NUM_CHANNELS];
 	bool conversion_needed;
@@ -322,16 +342,18 @@ struct obs_core_video {
 
 struct audio_monitor;
 
+/* target latency of audio monitoring, in milliseconds */
+#define DEFAULT_MONITORING_LATENCY 60
+#define MIN_MONITORING_LATENCY 20
+#define MAX_MONITORING_LATENCY 1000
+
 struct obs_core_audio {
 	audio_t *audio;
 
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
 
-	uint64_t buffered_ts;
-	struct circlebuf buffered_timestamps;
-	int buffering_wait_ticks;
-	int total_buffering_ticks;
+	struct audio_buffering buffering;
 
 	float user_volume;
 
@@ -339,6 +361,7 @@ struct obs_core_audio {
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
 	char *monitoring_device_id;
+	uint32_t monitoring_latency;
 };
 
 /* user sources, output channels, and displays */
@@ -366,6 +389,11 @@ struct obs_core_data {
 
 	obs_data_t *private_data;
 
+	bool parallel_source_load;
+
+	/* incremented when a change can affect the saved data of any scene */
+	volatile long scene_save_gen;
+
 	volatile bool valid;
 };
 
@@ -460,6 +488,10 @@ extern bool
 obs_graphics_thread_loop_autorelease(struct obs_graphics_context *context);
 #endif
 
+extern bool init_video_readback(struct obs_core_video *video);
+extern void stop_video_readback(struct obs_core_video *video);
+extern void free_video_readback(struct obs_core_video *video);
+
 extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 
 extern bool audio_callback(void *param, uint64_t start_ts_in,
@@ -655,6 +687,11 @@ struct obs_source {
 	float *audio_mix_buf[MAX_AUDIO_CHANNELS];
 	struct resample_info sample_info;
 	audio_resampler_t *resampler;
+
+	/* clock recovery: audio is resampled slightly to keep its sample
+	 * count in line with its timestamps */
+	audio_drift_t *audio_drift;
+	struct audio_drift_clock audio_clock;
 	pthread_mutex_t audio_actions_mutex;
 	pthread_mutex_t audio_buf_mutex;
 	pthread_mutex_t audio_mutex;
@@ -697,6 +734,12 @@ struct obs_source {
 	uint32_t async_convert_width[MAX_AV_PLANES];
 	uint32_t async_convert_height[MAX_AV_PLANES];
 
+	/* CPU conversion to upload-ready frames, done as frames are output */
+	volatile bool async_cpu_conversion;
+	video_unpacker_t *async_unpacker;
+	struct video_unpack_info async_unpacker_info;
+	struct obs_source_frame *async_unpack_frame;
+
 	pthread_mutex_t caption_cb_mutex;
 	DARRAY(struct caption_cb_info) caption_cb_list;
 
@@ -712,6 +755,12 @@ struct obs_source {
 	bool deinterlace_top_first;
 	bool deinterlace_rendered;
 
+	/* CPU deinterlacing, done as frames are output */
+	volatile bool deinterlace_cpu;
+	video_deinterlacer_t *deinterlacer;
+	struct video_deinterlace_info deinterlacer_info;
+	struct obs_source_frame *deinterlace_prev_input;
+
 	/* filters */
 	struct obs_source *filter_parent;
 	struct obs_source *filter_target;
@@ -721,6 +770,10 @@ struct obs_source {
 	enum obs_allow_direct_render allow_direct;
 	bool rendering_filter;
 
+	/* profiler name of the source when it outputs audio or filters it,
+	 * replaced with every rename under audio_mutex */
+	const char *profile_audio_name;
+
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id mute_unmute_key;
 	obs_hotkey_id push_to_mute_key;
@@ -765,6 +818,11 @@ struct obs_source {
 	enum obs_monitoring_type monitoring_type;
 
 	obs_data_t *private_settings;
+
+	/* copy of the saved data, reused until the source changes */
+	obs_data_t *save_snapshot;
+	long save_snapshot_gen;
+	volatile bool save_dirty;
 };
 
 extern struct obs_source_info *get_source_info(const char *id);
@@ -786,12 +844,25 @@ extern void obs_transition_load(obs_source_t *source, obs_data_t *data);
 struct audio_monitor *audio_monitor_create(obs_source_t *source);
 void audio_monitor_reset(struct audio_monitor *monitor);
 extern void audio_monitor_destroy(struct audio_monitor *monitor);
+extern uint64_t audio_monitor_get_latency(const struct audio_monitor *monitor);
 
 extern obs_source_t *obs_source_create_set_last_ver(const char *id,
 						    const char *name,
 						    obs_data_t *settings,
 						    obs_data_t *hotkey_data,
 						    uint32_t last_obs_ver);
+
+/* creates the source without calling the create callback of its type, which
+ * lets obs_load_sources run the create callbacks of several sources at once.
+ * obs_source_call_create and then obs_source_finish_create must be called
+ * before the source is used. */
+extern obs_source_t *obs_source_create_deferred(const char *id,
+						const char *name,
+						obs_data_t *settings,
+						obs_data_t *hotkey_data,
+						uint32_t last_obs_ver);
+extern void obs_source_call_create(obs_source_t *source);
+extern void obs_source_finish_create(obs_source_t *source);
 extern void obs_source_destroy(struct obs_source *source);
 
 enum view_type {
@@ -868,12 +939,21 @@ extern bool set_async_texture_size(struct obs_source *source,
 				   const struct obs_source_frame *frame);
 extern void remove_async_frame(obs_source_t *source,
 			       struct obs_source_frame *frame);
+extern struct obs_source_frame *
+get_async_cache_frame(struct obs_source *source,
+		      const struct obs_source_frame *frame);
+extern void push_async_frame(struct obs_source *source,
+			     struct obs_source_frame *frame);
+extern void copy_frame_info(struct obs_source_frame *dst,
+			    const struct obs_source_frame *src);
 
 extern void set_deinterlace_texture_size(obs_source_t *source);
 extern void deinterlace_process_last_frame(obs_source_t *source,
 					   uint64_t sys_time);
 extern void deinterlace_update_async_video(obs_source_t *source);
 extern void deinterlace_render(obs_source_t *s);
+extern bool deinterlace_output_video(obs_source_t *source,
+				     const struct obs_source_frame *frame);
 
 /* ------------------------------------------------------------------------- */
 /* outputs  */
@@ -1084,6 +1164,7 @@ struct obs_encoder {
 
 	struct circlebuf audio_input_buffer[MAX_AV_PLANES];
 	uint8_t *audio_output_buffer[MAX_AV_PLANES];
+	uint64_t audio_copied_bytes;
 
 	/* if a video encoder is paired with an audio encoder, make it start
 	 * up at the specific timestamp.  if this is the audio encoder,
@@ -1109,7 +1190,18 @@ struct obs_encoder {
 
 	struct pause_data pause;
 
+	/* optional video input queue, encodes on its own thread instead of
+	 * the video output thread.  queue_mutex protects the queue pointer
+	 * from the statistics getters, queue_stats are those of the last
+	 * queue freed */
+	size_t queue_max_frames;
+	enum obs_encoder_queue_drop queue_drop;
+	pthread_mutex_t queue_mutex;
+	video_queue_t *queue;
+	struct video_queue_stats queue_stats;
+
 	const char *profile_encoder_encode_name;
+	const char *profile_queue_thread_name;
 	char *last_error_message;
 };
 
@@ -225,8 +225,17 @@ static void scene_enum_all_sources(void *data,
 	scene_enum_sources(data, enum_callback, param, false);
 }
 
+/* the items of a scene are saved in its settings */
+static inline void scene_changed(struct obs_scene *scene)
+{
+	if (scene)
+		obs_source_mark_dirty(scene->source);
+}
+
 static inline void detach_sceneitem(struct obs_scene_item *item)
 {
+	scene_changed(item->parent);
+
 	if (item->prev)
 		item->prev->next = item->next;
 	else
@@ -245,6 +254,8 @@ static inline void attach_sceneitem(struct obs_scene *parent,
 	item->prev = prev;
 	item->parent = parent;
 
+	scene_changed(parent);
+
 	if (prev) {
 		item->next = prev->next;
 		if (prev->next)
@@ -1736,6 +1747,8 @@ static obs_sceneitem_t *obs_scene_add_internal(obs_scene_t *scene,
 
 	full_unlock(scene);
 
+	scene_changed(scene);
+
 	if (!scene->source->context.private)
 		init_hotkeys(scene, item, obs_source_get_name(source));
 
@@ -1871,6 +1884,7 @@ bool obs_sceneitem_selected(const obs_sceneitem_t *item)
 
 #define do_update_transform(item)                                          \
 	do {                                                               \
+		scene_changed(item->parent);                               \
 		if (!item->parent || item->parent->is_group)               \
 			os_atomic_set_bool(&item->update_transform, true); \
 		else                                                       \
@@ -2155,6 +2169,7 @@ bool obs_sceneitem_set_visible(obs_sceneitem_t *item, bool visible)
 	}
 
 	item->user_visible = visible;
+	scene_changed(item->parent);
 
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "item", item);
@@ -2192,6 +2207,7 @@ bool obs_sceneitem_set_locked(obs_sceneitem_t *item, bool lock)
 		return false;
 
 	item->locked = lock;
+	scene_changed(item->parent);
 
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "item", item);
@@ -2311,6 +2327,7 @@ void obs_sceneitem_set_crop(obs_sceneitem_t *item,
 	if (item->crop.bottom < 0)
 		item->crop.bottom = 0;
 
+	scene_changed(item->parent);
 	os_atomic_set_bool(&item->update_transform, true);
 }
 
@@ -2333,6 +2350,7 @@ void obs_sceneitem_set_scale_filter(obs_sceneitem_t *item,
 
 	item->scale_filter = filter;
 
+	scene_changed(item->parent);
 	os_atomic_set_bool(&item->update_transform, true);
 }
 
@@ -2390,6 +2408,8 @@ obs_data_t *obs_sceneitem_get_private_settings(obs_sceneitem_t *item)
 	if (!obs_ptr_valid(item, "obs_sceneitem_get_private_settings"))
 		return NULL;
 
+	scene_changed(item->parent);
+
 	obs_data_addref(item->private_settings);
 	return item->private_settings;
 }
@@ -2541,6 +2561,9 @@ static void resize_group(obs_sceneitem_t *group)
 	if (!resize_scene_base(scene, &minv, &maxv, &scale))
 		return;
 
+	scene_changed(scene);
+	scene_changed(group->parent);
+
 	if (group->bounds_type == OBS_BOUNDS_NONE) {
 		struct vec2 new_pos;
 
@@ -466,6 +466,8 @@ void obs_source_set_deinterlace_mode(obs_source_t *source,
 	if (source->deinterlace_mode == mode)
 		return;
 
+	obs_source_mark_dirty(source);
+
 	if (source->deinterlace_mode == OBS_DEINTERLACE_MODE_DISABLE) {
 		enable_deinterlacing(source, mode);
 	} else if (mode == OBS_DEINTERLACE_MODE_DISABLE) {
@@ -492,6 +494,8 @@ void obs_source_set_deinterlace_field_order(
 	if (!obs_source_valid(source, "obs_source_set_deinterlace_field_order"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	source->deinterlace_top_first = field_order ==
 					OBS_DEINTERLACE_FIELD_ORDER_TOP;
 }
@@ -506,3 +510,166 @@ obs_source_get_deinterlace_field_order(const obs_source_t *source)
 		       ? OBS_DEINTERLACE_FIELD_ORDER_TOP
 		       : OBS_DEINTERLACE_FIELD_ORDER_BOTTOM;
 }
+
+static enum video_deinterlace_type get_cpu_type(enum obs_deinterlace_mode mode)
+{
+	switch (mode) {
+	case OBS_DEINTERLACE_MODE_DISABLE:
+	case OBS_DEINTERLACE_MODE_DISCARD:
+		return VIDEO_DEINTERLACE_DISCARD;
+	case OBS_DEINTERLACE_MODE_RETRO:
+		return VIDEO_DEINTERLACE_RETRO;
+	case OBS_DEINTERLACE_MODE_BLEND:
+		return VIDEO_DEINTERLACE_BLEND;
+	case OBS_DEINTERLACE_MODE_BLEND_2X:
+		return VIDEO_DEINTERLACE_BLEND_2X;
+	case OBS_DEINTERLACE_MODE_LINEAR:
+		return VIDEO_DEINTERLACE_LINEAR;
+	case OBS_DEINTERLACE_MODE_LINEAR_2X:
+		return VIDEO_DEINTERLACE_LINEAR_2X;
+	case OBS_DEINTERLACE_MODE_YADIF:
+		return VIDEO_DEINTERLACE_YADIF;
+	case OBS_DEINTERLACE_MODE_YADIF_2X:
+		return VIDEO_DEINTERLACE_YADIF_2X;
+	}
+
+	return VIDEO_DEINTERLACE_DISCARD;
+}
+
+static inline bool
+deinterlace_info_equal(const struct video_deinterlace_info *a,
+		       const struct video_deinterlace_info *b)
+{
+	return a->format == b->format && a->width == b->width &&
+	       a->height == b->height && a->type == b->type &&
+	       a->top_field_first == b->top_field_first;
+}
+
+/* (re)creates the deinterlacer when the frames or the mode change, returns
+ * false if the frames can't be deinterlaced on the CPU */
+static bool update_deinterlacer(obs_source_t *source,
+				const struct obs_source_frame *frame)
+{
+	struct video_deinterlace_info info = {
+		.format = frame->format,
+		.width = frame->width,
+		.height = frame->height,
+		.type = get_cpu_type(source->deinterlace_mode),
+		.top_field_first = source->deinterlace_top_first,
+	};
+	int ret;
+
+	if (deinterlace_info_equal(&info, &source->deinterlacer_info))
+		return source->deinterlacer != NULL;
+
+	video_deinterlacer_destroy(source->deinterlacer);
+	source->deinterlacer = NULL;
+	source->deinterlacer_info = info;
+
+	ret = video_deinterlacer_create(&source->deinterlacer, &info);
+	if (ret != VIDEO_DEINTERLACER_SUCCESS) {
+		blog(LOG_WARNING,
+		     "Source '%s': failed to create CPU deinterlacer (%d)",
+		     obs_source_get_name(source), ret);
+		return false;
+	}
+
+	return true;
+}
+
+static inline bool prev_input_valid(const obs_source_t *source,
+				    const struct obs_source_frame *frame)
+{
+	const struct obs_source_frame *prev = source->deinterlace_prev_input;
+
+	return prev && prev->format == frame->format &&
+	       prev->width == frame->width && prev->height == frame->height &&
+	       frame->timestamp > prev->timestamp &&
+	       frame->timestamp - prev->timestamp < MAX_TS_VAR;
+}
+
+static void store_prev_input(obs_source_t *source,
+			     const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *prev = source->deinterlace_prev_input;
+
+	if (!prev || prev->format != frame->format ||
+	    prev->width != frame->width || prev->height != frame->height) {
+		obs_source_frame_destroy(prev);
+		prev = obs_source_frame_create(frame->format, frame->width,
+					       frame->height);
+		source->deinterlace_prev_input = prev;
+	}
+
+	obs_source_frame_copy(prev, frame);
+}
+
+static void output_deinterlaced(obs_source_t *source,
+				const struct obs_source_frame *frame,
+				const struct obs_source_frame *prev,
+				uint64_t timestamp, bool frame2)
+{
+	struct obs_source_frame *output = get_async_cache_frame(source, frame);
+	if (!output)
+		return;
+
+	copy_frame_info(output, frame);
+	output->timestamp = timestamp;
+
+	video_deinterlacer_deinterlace(
+		source->deinterlacer, output->data, output->linesize,
+		(const uint8_t *const *)frame->data, frame->linesize,
+		prev ? (const uint8_t *const *)prev->data : NULL,
+		prev ? prev->linesize : NULL, frame2);
+
+	push_async_frame(source, output);
+}
+
+/* Deinterlaces a frame into the async frame cache instead of copying it.
+ * The 2x modes output the second field as another frame, half way to the
+ * next frame (estimated from the previous one). */
+bool deinterlace_output_video(obs_source_t *source,
+			      const struct obs_source_frame *frame)
+{
+	const struct obs_source_frame *prev = NULL;
+
+	if (!update_deinterlacer(source, frame))
+		return false;
+
+	if (prev_input_valid(source, frame))
+		prev = source->deinterlace_prev_input;
+
+	output_deinterlaced(source, frame, prev, frame->timestamp, false);
+
+	if (prev && video_deinterlace_is_2x(source->deinterlacer_info.type)) {
+		uint64_t half = (frame->timestamp - prev->timestamp) / 2;
+		output_deinterlaced(source, frame, prev,
+				    frame->timestamp + half, true);
+	}
+
+	store_prev_input(source, frame);
+	return true;
+}
+
+void obs_source_set_deinterlace_cpu(obs_source_t *source, bool cpu)
+{
+	if (!obs_source_valid(source, "obs_source_set_deinterlace_cpu"))
+		return;
+
+	/* frames already queued keep the previous path, drop the previous
+	 * frame of the GPU path so that it isn't mixed with them */
+	pthread_mutex_lock(&source->async_mutex);
+	os_atomic_set_bool(&source->deinterlace_cpu, cpu);
+	if (source->prev_async_frame) {
+		remove_async_frame(source, source->prev_async_frame);
+		source->prev_async_frame = NULL;
+	}
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+bool obs_source_get_deinterlace_cpu(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_deinterlace_cpu")
+		       ? os_atomic_load_bool(&source->deinterlace_cpu)
+		       : false;
+}
@@ -24,6 +24,7 @@
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/util_uint64.h"
+#include "util/sse-intrin.h"
 #include "callback/calldata.h"
 #include "graphics/matrix3.h"
 #include "graphics/vec3.h"
@@ -43,6 +44,18 @@ static inline bool deinterlacing_enabled(const struct obs_source *source)
 	return source->deinterlace_mode != OBS_DEINTERLACE_MODE_DISABLE;
 }
 
+static inline bool gpu_deinterlacing(const struct obs_source *source)
+{
+	return deinterlacing_enabled(source) &&
+	       !os_atomic_load_bool(&source->deinterlace_cpu);
+}
+
+static inline bool cpu_deinterlacing(const struct obs_source *source)
+{
+	return deinterlacing_enabled(source) &&
+	       os_atomic_load_bool(&source->deinterlace_cpu);
+}
+
 struct obs_source_info *get_source_info(const char *id)
 {
 	for (size_t i = 0; i < obs->source_types.num; i++) {
@@ -169,6 +182,28 @@ static inline bool is_composite_source(const struct obs_source *source)
 
 extern char *find_libobs_data_file(const char *file);
 
+/* the names are never freed, only replaced on renames */
+static void set_audio_profile_name(obs_source_t *source)
+{
+	const char *name = profile_store_name(
+		obs_get_profiler_name_store(), "%s",
+		source->context.name ? source->context.name : "");
+
+	pthread_mutex_lock(&source->audio_mutex);
+	source->profile_audio_name = name;
+	pthread_mutex_unlock(&source->audio_mutex);
+}
+
+static const char *get_audio_profile_name(obs_source_t *source)
+{
+	const char *name;
+
+	pthread_mutex_lock(&source->audio_mutex);
+	name = source->profile_audio_name;
+	pthread_mutex_unlock(&source->audio_mutex);
+	return name;
+}
+
 /* internal initialization */
 static bool obs_source_init(struct obs_source *source)
 {
@@ -205,6 +240,8 @@ static bool obs_source_init(struct obs_source *source)
 	if (pthread_mutex_init(&source->caption_cb_mutex, NULL) != 0)
 		return false;
 
+	set_audio_profile_name(source);
+
 	if (is_audio_source(source) || is_composite_source(source))
 		allocate_audio_output_buffer(source);
 	if (source->info.audio_mix)
@@ -335,9 +372,9 @@ static void obs_source_init_audio_hotkeys(struct obs_source *source)
 }
 
 static obs_source_t *
-obs_source_create_internal(const char *id, const char *name,
-			   obs_data_t *settings, obs_data_t *hotkey_data,
-			   bool private, uint32_t last_obs_ver)
+obs_source_create_begin(const char *id, const char *name, obs_data_t *settings,
+			obs_data_t *hotkey_data, bool private,
+			uint32_t last_obs_ver)
 {
 	struct obs_source *source = bzalloc(sizeof(struct obs_source));
 
@@ -385,16 +422,34 @@ obs_source_create_internal(const char *id, const char *name,
 	if (!private)
 		obs_source_init_audio_hotkeys(source);
 
+	return source;
+
+fail:
+	blog(LOG_ERROR, "obs_source_create failed");
+	obs_source_destroy(source);
+	return NULL;
+}
+
+void obs_source_call_create(obs_source_t *source)
+{
+	const struct obs_source_info *info = &source->info;
+
 	/* allow the source to be created even if creation fails so that the
 	 * user's data doesn't become lost */
-	if (info && info->create)
+	if (info->create)
 		source->context.data =
 			info->create(source->context.settings, source);
-	if ((!info || info->create) && !source->context.data)
-		blog(LOG_ERROR, "Failed to create source '%s'!", name);
+	if ((source->owns_info_id || info->create) && !source->context.data)
+		blog(LOG_ERROR, "Failed to create source '%s'!",
+		     source->context.name);
+}
+
+void obs_source_finish_create(obs_source_t *source)
+{
+	bool private = source->context.private;
 
 	blog(LOG_DEBUG, "%ssource '%s' (%s) created", private ? "private " : "",
-	     name, id);
+	     source->context.name, source->info.id);
 
 	source->flags = source->default_flags;
 	source->enabled = true;
@@ -404,12 +459,21 @@ obs_source_create_internal(const char *id, const char *name,
 	}
 
 	obs_source_init_finalize(source);
-	return source;
+}
 
-fail:
-	blog(LOG_ERROR, "obs_source_create failed");
-	obs_source_destroy(source);
-	return NULL;
+static obs_source_t *
+obs_source_create_internal(const char *id, const char *name,
+			   obs_data_t *settings, obs_data_t *hotkey_data,
+			   bool private, uint32_t last_obs_ver)
+{
+	obs_source_t *source = obs_source_create_begin(
+		id, name, settings, hotkey_data, private, last_obs_ver);
+	if (!source)
+		return NULL;
+
+	obs_source_call_create(source);
+	obs_source_finish_create(source);
+	return source;
 }
 
 obs_source_t *obs_source_create(const char *id, const char *name,
@@ -435,6 +499,15 @@ obs_source_t *obs_source_create_set_last_ver(const char *id, const char *name,
 					  false, last_obs_ver);
 }
 
+obs_source_t *obs_source_create_deferred(const char *id, const char *name,
+					 obs_data_t *settings,
+					 obs_data_t *hotkey_data,
+					 uint32_t last_obs_ver)
+{
+	return obs_source_create_begin(id, name, settings, hotkey_data, false,
+				       last_obs_ver);
+}
+
 static char *get_new_filter_name(obs_source_t *dst, const char *name)
 {
 	struct dstr new_name = {0};
@@ -676,10 +749,15 @@ void obs_source_destroy(struct obs_source *source)
 	for (i = 0; i < MAX_AUDIO_CHANNELS; i++)
 		circlebuf_free(&source->audio_input_buf[i]);
 	audio_resampler_destroy(source->resampler);
+	audio_drift_destroy(source->audio_drift);
 	bfree(source->audio_output_buf[0][0]);
 	bfree(source->audio_mix_buf[0]);
 
 	obs_source_frame_destroy(source->async_preload_frame);
+	obs_source_frame_destroy(source->deinterlace_prev_input);
+	video_deinterlacer_destroy(source->deinterlacer);
+	obs_source_frame_destroy(source->async_unpack_frame);
+	video_unpacker_destroy(source->async_unpacker);
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_free(source);
@@ -698,6 +776,7 @@ void obs_source_destroy(struct obs_source *source)
 	pthread_mutex_destroy(&source->caption_cb_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
 	obs_data_release(source->private_settings);
+	obs_data_release(source->save_snapshot);
 	obs_context_data_free(&source->context);
 
 	if (source->owns_info_id) {
@@ -929,6 +1008,8 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	if (!obs_source_valid(source, "obs_source_update"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	if (settings)
 		obs_data_apply(source->context.settings, settings);
 
@@ -1126,7 +1207,7 @@ static void async_tick(obs_source_t *source)
 
 	pthread_mutex_lock(&source->async_mutex);
 
-	if (deinterlacing_enabled(source)) {
+	if (gpu_deinterlacing(source)) {
 		deinterlace_process_last_frame(source, sys_time);
 	} else {
 		if (source->cur_async_frame) {
@@ -1240,7 +1321,11 @@ static inline size_t conv_time_to_frames(const size_t sample_rate,
 #define MAX_BUF_SIZE (1000 * AUDIO_OUTPUT_FRAMES * sizeof(float))
 
 /* time threshold in nanoseconds to ensure audio timing is as seamless as
- * possible */
+ * possible.  Within it, the timestamps of the audio are replaced by the time
+ * its sample count adds up to, and the error between the two drives the
+ * resampling ratio of the source (see audio_drift_clock_update), so that its
+ * sample count follows its timestamps instead of drifting off until the
+ * threshold is hit and the audio jumps, or more audio buffering is needed. */
 #define TS_SMOOTHING_THRESHOLD 70000000ULL
 
 static inline void reset_audio_timing(obs_source_t *source, uint64_t timestamp,
@@ -1248,6 +1333,7 @@ static inline void reset_audio_timing(obs_source_t *source, uint64_t timestamp,
 {
 	source->timing_set = true;
 	source->timing_adjust = os_time - timestamp;
+	audio_drift_clock_reset_error(&source->audio_clock);
 }
 
 static void reset_audio_data(obs_source_t *source, uint64_t os_time)
@@ -1411,7 +1497,14 @@ static void source_output_audio_data(obs_source_t *source,
 		else if (diff < TS_SMOOTHING_THRESHOLD) {
 			if (source->async_unbuffered && source->async_decoupled)
 				source->timing_adjust = os_time - in.timestamp;
+			audio_drift_clock_update(
+				&source->audio_clock,
+				(int64_t)(in.timestamp -
+					  source->next_audio_ts_min),
+				in.frames, (uint32_t)sample_rate);
 			in.timestamp = source->next_audio_ts_min;
+		} else {
+			audio_drift_clock_reset_error(&source->audio_clock);
 		}
 	}
 
@@ -2240,7 +2333,7 @@ static inline void render_video(obs_source_t *source)
 	if (source->info.type == OBS_SOURCE_TYPE_INPUT &&
 	    (source->info.output_flags & OBS_SOURCE_ASYNC) != 0 &&
 	    !source->rendering_filter) {
-		if (deinterlacing_enabled(source))
+		if (gpu_deinterlacing(source))
 			deinterlace_update_async_video(source);
 		obs_source_update_async_video(source);
 	}
@@ -2264,7 +2357,7 @@ static inline void render_video(obs_source_t *source)
 	else if (source->filter_target)
 		obs_source_video_render(source->filter_target);
 
-	else if (deinterlacing_enabled(source))
+	else if (gpu_deinterlacing(source))
 		deinterlace_render(source);
 
 	else
@@ -2458,6 +2551,8 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_mark_dirty(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -2492,6 +2587,8 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_mark_dirty(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -2612,6 +2709,8 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 
 	if (!obs_source_valid(source, "obs_source_filter_set_order"))
 		return;
+
+	obs_source_mark_dirty(source);
 	if (!obs_ptr_valid(filter, "obs_source_filter_set_order"))
 		return;
 
@@ -2628,6 +2727,9 @@ obs_data_t *obs_source_get_settings(const obs_source_t *source)
 	if (!obs_source_valid(source, "obs_source_get_settings"))
 		return NULL;
 
+	/* the caller may modify the settings directly */
+	obs_source_mark_dirty((obs_source_t *)source);
+
 	obs_data_addref(source->context.settings);
 	return source->context.settings;
 }
@@ -2684,8 +2786,8 @@ static inline void copy_frame_data_plane(struct obs_source_frame *dst,
 	}
 }
 
-static void copy_frame_data(struct obs_source_frame *dst,
-			    const struct obs_source_frame *src)
+void copy_frame_info(struct obs_source_frame *dst,
+		     const struct obs_source_frame *src)
 {
 	dst->flip = src->flip;
 	dst->full_range = src->full_range;
@@ -2696,6 +2798,12 @@ static void copy_frame_data(struct obs_source_frame *dst,
 		memcpy(dst->color_range_min, src->color_range_min, size);
 		memcpy(dst->color_range_max, src->color_range_max, size);
 	}
+}
+
+static void copy_frame_data(struct obs_source_frame *dst,
+			    const struct obs_source_frame *src)
+{
+	copy_frame_info(dst, src);
 
 	switch (src->format) {
 	case VIDEO_FORMAT_I420:
@@ -2794,8 +2902,9 @@ static void clean_cache(obs_source_t *source)
 
 #define MAX_ASYNC_FRAMES 30
 //if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
-static inline struct obs_source_frame *
-cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+struct obs_source_frame *
+get_async_cache_frame(struct obs_source *source,
+		      const struct obs_source_frame *frame)
 {
 	struct obs_source_frame *new_frame = NULL;
 
@@ -2848,11 +2957,141 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 
 	pthread_mutex_unlock(&source->async_mutex);
 
-	copy_frame_data(new_frame, frame);
+	return new_frame;
+}
+
+static inline struct obs_source_frame *
+cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *new_frame =
+		get_async_cache_frame(source, frame);
+
+	if (new_frame)
+		copy_frame_data(new_frame, frame);
 
 	return new_frame;
 }
 
+void push_async_frame(struct obs_source *source,
+		      struct obs_source_frame *output)
+{
+	pthread_mutex_lock(&source->async_mutex);
+	if (output) {
+		if (os_atomic_dec_long(&output->refs) == 0) {
+			obs_source_frame_destroy(output);
+			output = NULL;
+		} else {
+			da_push_back(source->async_frames, &output);
+			source->async_active = true;
+		}
+	}
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+static inline bool cpu_conversion(const struct obs_source *source,
+				  const struct obs_source_frame *frame)
+{
+	return os_atomic_load_bool(&source->async_cpu_conversion) &&
+	       get_convert_type(frame->format, frame->full_range) !=
+		       CONVERT_NONE;
+}
+
+/* (re)creates the unpacker when the frames change, returns false if the
+ * frames can't be converted on the CPU */
+static bool update_async_unpacker(obs_source_t *source,
+				  const struct obs_source_frame *frame)
+{
+	struct video_unpack_info *cur = &source->async_unpacker_info;
+	struct video_unpack_info info = {
+		.format = frame->format,
+		.width = frame->width,
+		.height = frame->height,
+	};
+	int ret;
+
+	if (cur->format == info.format && cur->width == info.width &&
+	    cur->height == info.height)
+		return source->async_unpacker != NULL;
+
+	video_unpacker_destroy(source->async_unpacker);
+	source->async_unpacker = NULL;
+	*cur = info;
+
+	ret = video_unpacker_create(&source->async_unpacker, &info);
+	if (ret != VIDEO_UNPACKER_SUCCESS) {
+		blog(LOG_WARNING,
+		     "Source '%s': failed to create CPU frame converter (%d)",
+		     obs_source_get_name(source), ret);
+		return false;
+	}
+
+	return true;
+}
+
+static void unpack_frame(obs_source_t *source, struct obs_source_frame *dst,
+			 const struct obs_source_frame *src)
+{
+	copy_frame_info(dst, src);
+	dst->full_range = true;
+
+	video_unpacker_unpack(source->async_unpacker, dst->data[0],
+			      dst->linesize[0],
+			      (const uint8_t *const *)src->data, src->linesize,
+			      src->color_matrix,
+			      src->full_range ? NULL : src->color_range_min,
+			      src->full_range ? NULL : src->color_range_max);
+}
+
+/* Converts a frame straight into the async frame cache instead of copying
+ * it, so that the graphics thread only has to upload it.  The unpacked
+ * frame is a full range RGB frame, which needs no conversion pass. */
+static bool unpack_output_video(obs_source_t *source,
+				const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *output;
+	struct obs_source_frame desc = {
+		.format = video_unpack_format(frame->format),
+		.width = frame->width,
+		.height = frame->height,
+		.full_range = true,
+	};
+
+	if (!update_async_unpacker(source, frame))
+		return false;
+
+	output = get_async_cache_frame(source, &desc);
+	if (output)
+		unpack_frame(source, output, frame);
+
+	push_async_frame(source, output);
+	return true;
+}
+
+/* With CPU deinterlacing, frames are converted first, and then deinterlaced
+ * into the cache.  Returns the converted frame, or NULL on failure. */
+static const struct obs_source_frame *
+unpack_video_for_deinterlace(obs_source_t *source,
+			     const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *unpacked = source->async_unpack_frame;
+	const enum video_format format = video_unpack_format(frame->format);
+
+	if (!update_async_unpacker(source, frame))
+		return NULL;
+
+	if (!unpacked || unpacked->format != format ||
+	    unpacked->width != frame->width ||
+	    unpacked->height != frame->height) {
+		obs_source_frame_destroy(unpacked);
+		unpacked = obs_source_frame_create(format, frame->width,
+						   frame->height);
+		source->async_unpack_frame = unpacked;
+	}
+
+	unpack_frame(source, unpacked, frame);
+	return unpacked;
+}
+
 static void
 obs_source_output_video_internal(obs_source_t *source,
 				 const struct obs_source_frame *frame)
@@ -2865,21 +3104,27 @@ obs_source_output_video_internal(obs_source_t *source,
 		return;
 	}
 
+	if (cpu_conversion(source, frame)) {
+		if (!cpu_deinterlacing(source)) {
+			if (unpack_output_video(source, frame))
+				return;
+		} else {
+			const struct obs_source_frame *unpacked =
+				unpack_video_for_deinterlace(source, frame);
+			if (unpacked)
+				frame = unpacked;
+		}
+	}
+
+	if (cpu_deinterlacing(source) &&
+	    deinterlace_output_video(source, frame))
+		return;
+
 	struct obs_source_frame *output = !!frame ? cache_video(source, frame)
 						  : NULL;
 
 	/* ------------------------------------------- */
-	pthread_mutex_lock(&source->async_mutex);
-	if (output) {
-		if (os_atomic_dec_long(&output->refs) == 0) {
-			obs_source_frame_destroy(output);
-			output = NULL;
-		} else {
-			da_push_back(source->async_frames, &output);
-			source->async_active = true;
-		}
-	}
-	pthread_mutex_unlock(&source->async_mutex);
+	push_async_frame(source, output);
 }
 
 void obs_source_output_video(obs_source_t *source,
@@ -2937,6 +3182,29 @@ void obs_source_set_async_rotation(obs_source_t *source, long rotation)
 		source->async_rotation = rotation;
 }
 
+void obs_source_set_async_cpu_conversion(obs_source_t *source, bool cpu)
+{
+	if (!obs_source_valid(source, "obs_source_set_async_cpu_conversion"))
+		return;
+
+	/* the formats of queued frames change, don't deinterlace with a
+	 * previous frame of the other format */
+	pthread_mutex_lock(&source->async_mutex);
+	os_atomic_set_bool(&source->async_cpu_conversion, cpu);
+	if (source->prev_async_frame) {
+		remove_async_frame(source, source->prev_async_frame);
+		source->prev_async_frame = NULL;
+	}
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+bool obs_source_get_async_cpu_conversion(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_async_cpu_conversion")
+		       ? os_atomic_load_bool(&source->async_cpu_conversion)
+		       : false;
+}
+
 void obs_source_output_cea708(obs_source_t *source,
 			      const struct obs_source_cea_708 *captions)
 {
@@ -3166,24 +3434,76 @@ void obs_source_set_video_frame2(obs_source_t *source,
 	obs_source_set_video_frame_internal(source, &new_frame);
 }
 
+static void apply_audio_gain(struct obs_audio_data *audio, float gain)
+{
+	const size_t channels = audio_output_get_channels(obs->audio.audio);
+	const __m128 gain_v = _mm_set1_ps(gain);
+
+	for (size_t c = 0; c < channels; c++) {
+		float *data = (float *)audio->data[c];
+		size_t i = 0;
+
+		if (!data)
+			continue;
+
+		for (; i + 3 < audio->frames; i += 4) {
+			__m128 v = _mm_loadu_ps(data + i);
+			_mm_storeu_ps(data + i, _mm_mul_ps(v, gain_v));
+		}
+		for (; i < audio->frames; i++)
+			data[i] *= gain;
+	}
+}
+
+/* Filters all process the same block in place unless they return their own
+ * data.  Gain-only filters are not called one after another: their gains are
+ * multiplied together and applied once, before the next filter that needs to
+ * see the audio. */
+static const char *filter_audio_name = "filter_audio";
 static inline struct obs_audio_data *
 filter_async_audio(obs_source_t *source, struct obs_audio_data *in)
 {
+	float gain = 1.0f;
 	size_t i;
+
+	if (!source->filters.num)
+		return in;
+
+	profile_start(filter_audio_name);
+
 	for (i = source->filters.num; i > 0; i--) {
 		struct obs_source *filter = source->filters.array[i - 1];
+		const char *name;
 
-		if (!filter->enabled)
+		if (!filter->enabled || !filter->context.data)
 			continue;
 
-		if (filter->context.data && filter->info.filter_audio) {
-			in = filter->info.filter_audio(filter->context.data,
-						       in);
-			if (!in)
-				return NULL;
+		if (filter->info.get_audio_gain) {
+			gain *= filter->info.get_audio_gain(
+				filter->context.data);
+			continue;
+		}
+		if (!filter->info.filter_audio)
+			continue;
+
+		if (gain != 1.0f) {
+			apply_audio_gain(in, gain);
+			gain = 1.0f;
 		}
+
+		name = get_audio_profile_name(filter);
+		profile_start(name);
+		in = filter->info.filter_audio(filter->context.data, in);
+		profile_end(name);
+
+		if (!in)
+			break;
 	}
 
+	if (in && gain != 1.0f)
+		apply_audio_gain(in, gain);
+
+	profile_end(filter_audio_name);
 	return in;
 }
 
@@ -3207,6 +3527,14 @@ static inline void reset_resampler(obs_source_t *source,
 	source->resampler = NULL;
 	source->resample_offset = 0;
 
+	if (!source->audio_drift) {
+		source->audio_drift = audio_drift_create(
+			(uint32_t)audio_output_get_channels(obs->audio.audio));
+		audio_drift_clock_init(&source->audio_clock);
+	} else {
+		audio_drift_reset(source->audio_drift);
+	}
+
 	if (source->sample_info.samples_per_sec == obs_info->samples_per_sec &&
 	    source->sample_info.format == obs_info->format &&
 	    source->sample_info.speakers == obs_info->speakers) {
@@ -3303,7 +3631,11 @@ static void process_audio_balancing(struct obs_source *source, uint32_t frames,
 static void process_audio(obs_source_t *source,
 			  const struct obs_source_audio *audio)
 {
+	const uint8_t *const *data = audio->data;
+	uint8_t *output[MAX_AV_PLANES];
+	float *drift_output[MAX_AUDIO_CHANNELS];
 	uint32_t frames = audio->frames;
+	uint64_t offset = 0;
 	bool mono_output;
 
 	if (source->sample_info.samples_per_sec != audio->samples_per_sec ||
@@ -3315,21 +3647,30 @@ static void process_audio(obs_source_t *source,
 		return;
 
 	if (source->resampler) {
-		uint8_t *output[MAX_AV_PLANES];
-
 		memset(output, 0, sizeof(output));
 
 		audio_resampler_resample(source->resampler, output, &frames,
-					 &source->resample_offset, audio->data,
-					 audio->frames);
+					 &offset, audio->data, audio->frames);
+		data = (const uint8_t *const *)output;
+	}
 
-		copy_audio_data(source, (const uint8_t *const *)output, frames,
-				audio->timestamp);
-	} else {
-		copy_audio_data(source, audio->data, audio->frames,
-				audio->timestamp);
+	/* audio is in the planar float format of the mix from here on */
+	if (source->audio_drift) {
+		offset += audio_drift_get_delay_ns(
+			source->audio_drift,
+			audio_output_get_sample_rate(obs->audio.audio));
+
+		if (audio_drift_process(source->audio_drift,
+					source->audio_clock.ratio, drift_output,
+					&frames, (const float *const *)data,
+					frames))
+			data = (const uint8_t *const *)drift_output;
 	}
 
+	source->resample_offset = offset;
+
+	copy_audio_data(source, data, frames, audio->timestamp);
+
 	mono_output = audio_output_get_channels(obs->audio.audio) == 1;
 
 	if (!mono_output && source->sample_info.speakers == SPEAKERS_STEREO &&
@@ -3342,16 +3683,26 @@ static void process_audio(obs_source_t *source,
 		downmix_to_mono_planar(source, frames);
 }
 
+static const char *output_audio_name = "obs_source_output_audio";
 void obs_source_output_audio(obs_source_t *source,
 			     const struct obs_source_audio *audio)
 {
 	struct obs_audio_data *output;
+	const char *name;
+	bool root;
 
 	if (!obs_source_valid(source, "obs_source_output_audio"))
 		return;
 	if (!obs_ptr_valid(audio, "obs_source_output_audio"))
 		return;
 
+	/* audio mostly comes from the threads of the sources, which are not
+	 * profiled otherwise, so this starts a root of its own there */
+	root = !profile_thread_has_root();
+	name = get_audio_profile_name(source);
+	profile_start(output_audio_name);
+	profile_start(name);
+
 	process_audio(source, audio);
 
 	pthread_mutex_lock(&source->filter_mutex);
@@ -3372,6 +3723,11 @@ void obs_source_output_audio(obs_source_t *source,
 	}
 
 	pthread_mutex_unlock(&source->filter_mutex);
+
+	profile_end(name);
+	profile_end(output_audio_name);
+	if (root)
+		profile_reenable_thread();
 }
 
 void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
@@ -3565,6 +3921,12 @@ void obs_source_set_name(obs_source_t *source, const char *name)
 		char *prev_name = bstrdup(source->context.name);
 		obs_context_data_setname(&source->context, name);
 
+		set_audio_profile_name(source);
+
+		/* scenes refer to their sources by name */
+		obs_source_mark_dirty(source);
+		os_atomic_inc_long(&obs->data.scene_save_gen);
+
 		calldata_init(&data);
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_string(&data, "new_name", source->context.name);
@@ -3786,7 +4148,7 @@ void obs_source_skip_video_filter(obs_source_t *filter)
 			obs_source_default_render(target);
 		else if (target->info.video_render)
 			obs_source_main_render(target);
-		else if (deinterlacing_enabled(target))
+		else if (gpu_deinterlacing(target))
 			deinterlace_render(target);
 		else
 			obs_source_render_async_video(target);
@@ -3836,6 +4198,7 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		pthread_mutex_unlock(&source->audio_actions_mutex);
 
 		source->user_volume = volume;
+		obs_source_mark_dirty(source);
 	}
 }
 
@@ -3860,6 +4223,7 @@ void obs_source_set_sync_offset(obs_source_t *source, int64_t offset)
 				      &data);
 
 		source->sync_offset = calldata_int(&data, "offset");
+		obs_source_mark_dirty(source);
 	}
 }
 
@@ -4113,6 +4477,8 @@ void obs_source_set_flags(obs_source_t *source, uint32_t flags)
 	if (!obs_source_valid(source, "obs_source_set_flags"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	if (flags != source->flags) {
 		source->flags = flags;
 		signal_flags_updated(source);
@@ -4140,6 +4506,8 @@ void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers)
 
 	if (!obs_source_valid(source, "obs_source_set_audio_mixers"))
 		return;
+
+	obs_source_mark_dirty(source);
 	if ((source->info.output_flags & OBS_SOURCE_AUDIO) == 0)
 		return;
 
@@ -4324,6 +4692,8 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 	if (!obs_source_valid(source, "obs_source_set_enabled"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	source->enabled = enabled;
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
@@ -4350,6 +4720,8 @@ void obs_source_set_muted(obs_source_t *source, bool muted)
 	if (!obs_source_valid(source, "obs_source_set_muted"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	source->user_muted = muted;
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
@@ -4407,6 +4779,8 @@ void obs_source_enable_push_to_mute(obs_source_t *source, bool enabled)
 	if (!obs_source_valid(source, "obs_source_enable_push_to_mute"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	pthread_mutex_lock(&source->audio_mutex);
 	bool changed = source->push_to_mute_enabled != enabled;
 	if (obs_source_get_output_flags(source) & OBS_SOURCE_AUDIO && changed)
@@ -4440,6 +4814,8 @@ void obs_source_set_push_to_mute_delay(obs_source_t *source, uint64_t delay)
 	if (!obs_source_valid(source, "obs_source_set_push_to_mute_delay"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	pthread_mutex_lock(&source->audio_mutex);
 	source->push_to_mute_delay = delay;
 
@@ -4465,6 +4841,8 @@ void obs_source_enable_push_to_talk(obs_source_t *source, bool enabled)
 	if (!obs_source_valid(source, "obs_source_enable_push_to_talk"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	pthread_mutex_lock(&source->audio_mutex);
 	bool changed = source->push_to_talk_enabled != enabled;
 	if (obs_source_get_output_flags(source) & OBS_SOURCE_AUDIO && changed)
@@ -4498,6 +4876,8 @@ void obs_source_set_push_to_talk_delay(obs_source_t *source, uint64_t delay)
 	if (!obs_source_valid(source, "obs_source_set_push_to_talk_delay"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	pthread_mutex_lock(&source->audio_mutex);
 	source->push_to_talk_delay = delay;
 
@@ -4900,6 +5280,8 @@ void obs_source_set_monitoring_type(obs_source_t *source,
 
 	if (!obs_source_valid(source, "obs_source_set_monitoring_type"))
 		return;
+
+	obs_source_mark_dirty(source);
 	if (source->monitoring_type == type)
 		return;
 
@@ -4926,6 +5308,27 @@ obs_source_get_monitoring_type(const obs_source_t *source)
 		       : OBS_MONITORING_TYPE_NONE;
 }
 
+uint64_t obs_source_get_monitoring_latency(const obs_source_t *source)
+{
+	uint64_t latency = 0;
+
+	if (!obs_source_valid(source, "obs_source_get_monitoring_latency"))
+		return 0;
+
+	/* the monitor is only freed once it's out of the list */
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+	for (size_t i = 0; i < obs->audio.monitors.num; i++) {
+		struct audio_monitor *monitor = obs->audio.monitors.array[i];
+		if (monitor == source->monitor) {
+			latency = audio_monitor_get_latency(monitor);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+
+	return latency;
+}
+
 void obs_source_set_async_unbuffered(obs_source_t *source, bool unbuffered)
 {
 	if (!obs_source_valid(source, "obs_source_set_async_unbuffered"))
@@ -4946,10 +5349,32 @@ obs_data_t *obs_source_get_private_settings(obs_source_t *source)
 	if (!obs_ptr_valid(source, "obs_source_get_private_settings"))
 		return NULL;
 
+	obs_source_mark_dirty(source);
+
 	obs_data_addref(source->private_settings);
 	return source->private_settings;
 }
 
+void obs_source_mark_dirty(obs_source_t *source)
+{
+	obs_source_t *parent;
+
+	if (!obs_ptr_valid(source, "obs_source_mark_dirty"))
+		return;
+
+	os_atomic_set_bool(&source->save_dirty, true);
+
+	/* filters are saved as part of their parent */
+	parent = source->filter_parent;
+	if (parent)
+		os_atomic_set_bool(&parent->save_dirty, true);
+
+	/* and groups as part of the scenes that contain them */
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE &&
+	    strcmp(source->info.id, "group") == 0)
+		os_atomic_inc_long(&obs->data.scene_save_gen);
+}
+
 void obs_source_set_async_decoupled(obs_source_t *source, bool decouple)
 {
 	if (!obs_ptr_valid(source, "obs_source_set_async_decoupled"))
@@ -4997,6 +5422,8 @@ void obs_source_set_balance_value(obs_source_t *source, float balance)
 	if (!obs_source_valid(source, "obs_source_set_balance_value"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	source->balance = balance;
 }
 
@@ -191,6 +191,15 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CEA_708 (1 << 14)
 
+/**
+ * The create callback of this source type may be called from threads other
+ * than the one loading the scene collection, at the same time as the create
+ * callbacks of other sources.  It must not depend on other sources existing
+ * and must only use thread safe functions (graphics functions are fine within
+ * obs_enter_graphics).
+ */
+#define OBS_SOURCE_PARALLEL_CREATE (1 << 15)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -535,6 +544,18 @@ struct obs_source_info {
 
 	/** Missing files **/
 	obs_missing_files_t *(*missing_files)(void *data);
+
+	/**
+	 * Called instead of filter_audio for filters that only multiply the
+	 * audio by a gain.  The gains of consecutive filters that implement
+	 * this are combined and applied to the audio in a single pass.
+	 *
+	 * @note          This function is only used with filter sources.
+	 *
+	 * @param  data   Filter data
+	 * @return        Linear gain to apply to all channels
+	 */
+	float (*get_audio_gain)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
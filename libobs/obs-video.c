@@ -112,8 +112,14 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_set_viewport(0, 0, width, height);
 }
 
+static const char *wait_for_readback_name = "wait_for_readback";
 static inline void unmap_last_surface(struct obs_core_video *video)
 {
+	/* the readback thread may still be copying from the mapped surfaces */
+	profile_start(wait_for_readback_name);
+	os_event_wait(video->readback_done);
+	profile_end(wait_for_readback_name);
+
 	for (int c = 0; c < NUM_CHANNELS; ++c) {
 		if (video->mapped_surfaces[c]) {
 			gs_stagesurface_unmap(video->mapped_surfaces[c]);
@@ -709,6 +715,82 @@ static inline void output_video_data(struct obs_core_video *video,
 	}
 }
 
+static const char *readback_thread_name = "video_readback_thread";
+static void *readback_thread(void *param)
+{
+	struct obs_core_video *video = param;
+
+	os_set_thread_name("libobs: video readback thread");
+
+	while (os_sem_wait(video->readback_semaphore) == 0) {
+		if (os_atomic_load_bool(&video->readback_stop))
+			break;
+
+		profile_start(readback_thread_name);
+		output_video_data(video, &video->readback_frame,
+				  video->readback_count);
+		profile_end(readback_thread_name);
+
+		os_event_signal(video->readback_done);
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
+bool init_video_readback(struct obs_core_video *video)
+{
+	video->readback_stop = false;
+
+	if (os_sem_init(&video->readback_semaphore, 0) != 0)
+		return false;
+	if (os_event_init(&video->readback_done, OS_EVENT_TYPE_MANUAL) != 0)
+		return false;
+	if (pthread_create(&video->readback_thread, NULL, readback_thread,
+			   video) != 0)
+		return false;
+
+	os_event_signal(video->readback_done);
+
+	video->readback_thread_initialized = true;
+	return true;
+}
+
+void stop_video_readback(struct obs_core_video *video)
+{
+	if (video->readback_thread_initialized) {
+		os_event_wait(video->readback_done);
+		os_atomic_set_bool(&video->readback_stop, true);
+		os_sem_post(video->readback_semaphore);
+		pthread_join(video->readback_thread, NULL);
+		video->readback_thread_initialized = false;
+	}
+}
+
+void free_video_readback(struct obs_core_video *video)
+{
+	if (video->readback_semaphore) {
+		os_sem_destroy(video->readback_semaphore);
+		video->readback_semaphore = NULL;
+	}
+	if (video->readback_done) {
+		os_event_destroy(video->readback_done);
+		video->readback_done = NULL;
+	}
+}
+
+/* hands the mapped frame to the readback thread, which copies it in to the
+ * video output while the graphics thread carries on rendering.  the
+ * surfaces stay mapped until the copy is done */
+static inline void queue_readback(struct obs_core_video *video,
+				  struct video_data *frame, int count)
+{
+	os_event_reset(video->readback_done);
+	video->readback_frame = *frame;
+	video->readback_count = count;
+	os_sem_post(video->readback_semaphore);
+}
+
 static inline void video_sleep(struct obs_core_video *video, bool raw_active,
 			       const bool gpu_active, uint64_t *p_time,
 			       uint64_t interval_ns)
@@ -719,9 +801,13 @@ static inline void video_sleep(struct obs_core_video *video, bool raw_active,
 	int count;
 
 	if (os_sleepto_ns(t)) {
+		uint64_t woke_time = os_gettime_ns();
+		video->cur_frame_stats[OBS_FRAME_STAT_SLEEP_OVERSHOOT] =
+			woke_time > t ? woke_time - t : 0;
 		*p_time = t;
 		count = 1;
 	} else {
+		video->cur_frame_stats[OBS_FRAME_STAT_SLEEP_OVERSHOOT] = 0;
 		count = (int)((os_gettime_ns() - cur_time) / interval_ns);
 		*p_time = cur_time + interval_ns * count;
 	}
@@ -744,13 +830,16 @@ static const char *output_frame_gs_context_name = "gs_context(video->graphics)";
 static const char *output_frame_render_video_name = "render_video";
 static const char *output_frame_download_frame_name = "download_frame";
 static const char *output_frame_gs_flush_name = "gs_flush";
-static const char *output_frame_output_video_data_name = "output_video_data";
+static const char *output_frame_queue_readback_name = "queue_readback";
 static inline void output_frame(bool raw_active, const bool gpu_active)
 {
 	struct obs_core_video *video = &obs->video;
 	int cur_texture = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES - 1
-					    : cur_texture - 1;
+	/* the oldest staged texture, which has had num_textures - 1 frames to
+	 * finish copying, so mapping it should not stall */
+	int prev_texture = cur_texture == video->num_textures - 1
+				   ? 0
+				   : cur_texture + 1;
 	struct video_data frame;
 	bool frame_ready = 0;
 
@@ -759,12 +848,16 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	profile_start(output_frame_gs_context_name);
 	gs_enter_context(video->graphics);
 
+	uint64_t render_start = os_gettime_ns();
 	profile_start(output_frame_render_video_name);
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_RENDER_VIDEO,
 			      output_frame_render_video_name);
 	render_video(video, raw_active, gpu_active, cur_texture);
 	GS_DEBUG_MARKER_END();
 	profile_end(output_frame_render_video_name);
+	uint64_t output_start = os_gettime_ns();
+	video->cur_frame_stats[OBS_FRAME_STAT_RENDER] =
+		output_start - render_start;
 
 	if (raw_active) {
 		profile_start(output_frame_download_frame_name);
@@ -785,12 +878,15 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 				    sizeof(vframe_info));
 
 		frame.timestamp = vframe_info.timestamp;
-		profile_start(output_frame_output_video_data_name);
-		output_video_data(video, &frame, vframe_info.count);
-		profile_end(output_frame_output_video_data_name);
+		profile_start(output_frame_queue_readback_name);
+		queue_readback(video, &frame, vframe_info.count);
+		profile_end(output_frame_queue_readback_name);
 	}
 
-	if (++video->cur_texture == NUM_TEXTURES)
+	video->cur_frame_stats[OBS_FRAME_STAT_OUTPUT] =
+		os_gettime_ns() - output_start;
+
+	if (++video->cur_texture == video->num_textures)
 		video->cur_texture = 0;
 }
 
@@ -920,6 +1016,22 @@ static void uninit_winrt_state(struct winrt_state *winrt)
 
 #endif // #ifdef _WIN32
 
+/* each stat is a ring of the last OBS_FRAME_STATS_WINDOW frames.  readers
+ * copy the rings without locking, see obs_get_frame_time_stats */
+static inline void commit_frame_stats(struct obs_core_video *video)
+{
+	long count = os_atomic_load_long(&video->frame_stats_count);
+	size_t idx = (size_t)count % OBS_FRAME_STATS_WINDOW;
+
+	for (size_t i = 0; i < OBS_FRAME_STAT_COUNT; i++)
+		video->frame_stats[i][idx] = video->cur_frame_stats[i];
+
+	/* keep the count from wrapping negative, only the window matters */
+	if (count == LONG_MAX - OBS_FRAME_STATS_WINDOW + 1)
+		count -= OBS_FRAME_STATS_WINDOW;
+	os_atomic_set_long(&video->frame_stats_count, count + 1);
+}
+
 static const char *tick_sources_name = "tick_sources";
 static const char *render_displays_name = "render_displays";
 static const char *output_frame_name = "output_frame";
@@ -930,6 +1042,7 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 
 	uint64_t frame_start = os_gettime_ns();
 	uint64_t frame_time_ns;
+	uint64_t stage_start;
 	bool raw_active = obs->video.raw_active > 0;
 #ifdef _WIN32
 	const bool gpu_active = obs->video.gpu_encoder_active > 0;
@@ -958,10 +1071,13 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	gs_begin_frame();
 	gs_leave_context();
 
+	stage_start = os_gettime_ns();
 	profile_start(tick_sources_name);
 	context->last_time =
 		tick_sources(obs->video.video_time, context->last_time);
 	profile_end(tick_sources_name);
+	obs->video.cur_frame_stats[OBS_FRAME_STAT_TICK] = os_gettime_ns() -
+							  stage_start;
 
 	execute_graphics_tasks();
 
@@ -977,9 +1093,12 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	output_frame(raw_active, gpu_active);
 	profile_end(output_frame_name);
 
+	stage_start = os_gettime_ns();
 	profile_start(render_displays_name);
 	render_displays();
 	profile_end(render_displays_name);
+	obs->video.cur_frame_stats[OBS_FRAME_STAT_DISPLAYS] = os_gettime_ns() -
+							      stage_start;
 
 	frame_time_ns = os_gettime_ns() - frame_start;
 
@@ -990,6 +1109,8 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	video_sleep(&obs->video, raw_active, gpu_active, &obs->video.video_time,
 		    context->interval);
 
+	commit_frame_stats(&obs->video);
+
 	context->frame_time_total_ns += frame_time_ns;
 	context->fps_total_ns += (obs->video.video_time - context->last_time);
 	context->fps_total_frames++;
@@ -203,7 +203,13 @@ static bool obs_init_textures(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+	video->num_textures = NUM_TEXTURES;
+	if (video->readback_depth > NUM_TEXTURES)
+		video->num_textures = video->readback_depth > MAX_NUM_TEXTURES
+					      ? MAX_NUM_TEXTURES
+					      : (int)video->readback_depth;
+
+	for (int i = 0; i < video->num_textures; i++) {
 #ifdef _WIN32
 		if (video->using_nv12_tex) {
 			video->copy_surfaces[i][0] =
@@ -428,6 +434,8 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
+	if (!init_video_readback(video))
+		return OBS_VIDEO_FAIL;
 
 #ifdef __APPLE__
 	errorcode = pthread_create(&video->video_thread, NULL,
@@ -456,6 +464,8 @@ static void stop_video(void)
 			video->thread_initialized = false;
 		}
 	}
+
+	stop_video_readback(video);
 }
 
 static void obs_free_video(void)
@@ -479,7 +489,7 @@ static void obs_free_video(void)
 			}
 		}
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		for (size_t i = 0; i < MAX_NUM_TEXTURES; i++) {
 			for (size_t c = 0; c < NUM_CHANNELS; c++) {
 				if (video->copy_surfaces[i][c]) {
 					gs_stagesurface_destroy(
@@ -498,7 +508,7 @@ static void obs_free_video(void)
 			}
 		}
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		for (size_t i = 0; i < MAX_NUM_TEXTURES; i++) {
 			for (size_t c = 0; c < NUM_CHANNELS; c++) {
 				if (video->copy_surfaces[i][c]) {
 					gs_stagesurface_destroy(
@@ -530,6 +540,8 @@ static void obs_free_video(void)
 		pthread_mutex_init_value(&video->task_mutex);
 		circlebuf_free(&video->tasks);
 
+		free_video_readback(video);
+
 		video->gpu_encoder_active = 0;
 		video->cur_texture = 0;
 	}
@@ -585,6 +597,7 @@ static bool obs_init_audio(struct audio_output_info *ai)
 
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
+	audio->monitoring_latency = DEFAULT_MONITORING_LATENCY;
 
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
@@ -603,7 +616,7 @@ static void obs_free_audio(void)
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
-	circlebuf_free(&audio->buffered_timestamps);
+	audio_buffering_free(&audio->buffering);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
 
@@ -647,6 +660,7 @@ static bool obs_init_data(void)
 		goto fail;
 
 	data->private_data = obs_data_create();
+	data->parallel_source_load = true;
 	data->valid = true;
 
 fail:
@@ -1213,6 +1227,14 @@ bool obs_reset_audio(const struct obs_audio_info *oai)
 	return obs_init_audio(&ai);
 }
 
+void obs_set_video_readback_depth(uint32_t depth)
+{
+	if (!obs)
+		return;
+
+	obs->video.readback_depth = depth;
+}
+
 bool obs_get_video_info(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -1737,7 +1759,20 @@ float obs_get_master_volume(void)
 	return obs->audio.user_volume;
 }
 
-static obs_source_t *obs_load_source_type(obs_data_t *source_data)
+struct source_load_job {
+	obs_source_t *source;
+	obs_data_t *source_data;
+	obs_source_t *parent;
+	bool created;
+};
+
+typedef DARRAY(struct source_load_job) source_load_jobs_t;
+
+/* creates the source (and its filters) without calling the create callbacks
+ * of their types yet, in the same order they would be created in */
+static obs_source_t *obs_load_source_begin(source_load_jobs_t *jobs,
+					   obs_data_t *source_data,
+					   obs_source_t *parent)
 {
 	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
 	obs_source_t *source;
@@ -1746,30 +1781,67 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 	const char *v_id = obs_data_get_string(source_data, "versioned_id");
 	obs_data_t *settings = obs_data_get_obj(source_data, "settings");
 	obs_data_t *hotkeys = obs_data_get_obj(source_data, "hotkeys");
-	double volume;
-	double balance;
-	int64_t sync;
 	uint32_t prev_ver;
-	uint32_t caps;
-	uint32_t flags;
-	uint32_t mixers;
-	int di_order;
-	int di_mode;
-	int monitoring_type;
+	struct source_load_job *job;
 
 	prev_ver = (uint32_t)obs_data_get_int(source_data, "prev_ver");
 
 	if (!*v_id)
 		v_id = id;
 
-	source = obs_source_create_set_last_ver(v_id, name, settings, hotkeys,
-						prev_ver);
+	source = obs_source_create_deferred(v_id, name, settings, hotkeys,
+					    prev_ver);
+	obs_data_release(hotkeys);
+	obs_data_release(settings);
+
+	if (!source) {
+		obs_data_array_release(filters);
+		return NULL;
+	}
+
 	if (source->owns_info_id) {
 		bfree((void *)source->info.unversioned_id);
 		source->info.unversioned_id = bstrdup(id);
 	}
 
-	obs_data_release(hotkeys);
+	job = darray_push_back_new(sizeof(*job), &jobs->da);
+	job->source = source;
+	job->source_data = source_data;
+	obs_data_addref(source_data);
+	job->parent = parent;
+
+	if (filters) {
+		size_t count = obs_data_array_count(filters);
+
+		for (size_t i = 0; i < count; i++) {
+			obs_data_t *filter_data =
+				obs_data_array_item(filters, i);
+			obs_load_source_begin(jobs, filter_data, source);
+			obs_data_release(filter_data);
+		}
+
+		obs_data_array_release(filters);
+	}
+
+	return source;
+}
+
+/* applies the saved source state once the source has been created */
+static void obs_load_source_finish(obs_source_t *source,
+				   obs_data_t *source_data)
+{
+	double volume;
+	double balance;
+	int64_t sync;
+	uint32_t prev_ver;
+	uint32_t caps;
+	uint32_t flags;
+	uint32_t mixers;
+	int di_order;
+	int di_mode;
+	int monitoring_type;
+
+	prev_ver = (uint32_t)obs_data_get_int(source_data, "prev_ver");
 
 	caps = obs_source_get_output_flags(source);
 
@@ -1842,35 +1914,127 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 		obs_data_get_obj(source_data, "private_settings");
 	if (!source->private_settings)
 		source->private_settings = obs_data_create();
+}
 
-	if (filters) {
-		size_t count = obs_data_array_count(filters);
+#define MAX_SOURCE_CREATE_THREADS 8
 
-		for (size_t i = 0; i < count; i++) {
-			obs_data_t *filter_data =
-				obs_data_array_item(filters, i);
+struct source_create_pool {
+	struct source_load_job **jobs;
+	size_t num;
+	volatile long next;
+};
 
-			obs_source_t *filter =
-				obs_load_source_type(filter_data);
-			if (filter) {
-				obs_source_filter_add(source, filter);
-				obs_source_release(filter);
-			}
+static void run_source_creates(struct source_create_pool *pool)
+{
+	for (;;) {
+		size_t idx = (size_t)os_atomic_inc_long(&pool->next) - 1;
+		if (idx >= pool->num)
+			break;
 
-			obs_data_release(filter_data);
+		obs_source_call_create(pool->jobs[idx]->source);
+		pool->jobs[idx]->created = true;
+	}
+}
+
+static void *source_create_thread(void *param)
+{
+	os_set_thread_name("libobs: source create thread");
+	run_source_creates(param);
+	return NULL;
+}
+
+/* Runs the create callbacks of the sources whose types are marked with
+ * OBS_SOURCE_PARALLEL_CREATE on a few threads.  Those sources are not in the
+ * source list yet, so nothing else can see them while they are created. */
+static void create_sources_parallel(source_load_jobs_t *jobs)
+{
+	struct source_create_pool pool = {0};
+	DARRAY(struct source_load_job *) parallel;
+	pthread_t threads[MAX_SOURCE_CREATE_THREADS];
+	size_t num_threads = 0;
+	int cores;
+
+	da_init(parallel);
+
+	for (size_t i = 0; i < jobs->num; i++) {
+		struct source_load_job *job = &jobs->array[i];
+		uint32_t flags = job->source->info.output_flags;
+
+		if ((flags & OBS_SOURCE_PARALLEL_CREATE) != 0)
+			da_push_back(parallel, &job);
+	}
+
+	cores = os_get_logical_cores();
+	if (parallel.num < 2 || cores < 2) {
+		da_free(parallel);
+		return;
+	}
+
+	pool.jobs = parallel.array;
+	pool.num = parallel.num;
+
+	/* the calling thread creates sources as well */
+	while (num_threads < MAX_SOURCE_CREATE_THREADS &&
+	       num_threads + 1 < (size_t)cores &&
+	       num_threads + 1 < parallel.num) {
+		if (pthread_create(&threads[num_threads], NULL,
+				   source_create_thread, &pool) != 0)
+			break;
+		num_threads++;
+	}
+
+	run_source_creates(&pool);
+
+	for (size_t i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	blog(LOG_DEBUG, "created %zu sources on %zu threads", parallel.num,
+	     num_threads + 1);
+
+	da_free(parallel);
+}
+
+/* finishes creating the sources in their original order, so that the source
+ * list, signals and filter order are the same as when loading serially */
+static void finish_source_loads(source_load_jobs_t *jobs)
+{
+	for (size_t i = 0; i < jobs->num; i++) {
+		struct source_load_job *job = &jobs->array[i];
+
+		if (!job->created)
+			obs_source_call_create(job->source);
+		obs_source_finish_create(job->source);
+		obs_load_source_finish(job->source, job->source_data);
+
+		if (job->parent) {
+			obs_source_filter_add(job->parent, job->source);
+			obs_source_release(job->source);
 		}
 
-		obs_data_array_release(filters);
+		obs_data_release(job->source_data);
 	}
+}
 
-	obs_data_release(settings);
+obs_source_t *obs_load_source(obs_data_t *source_data)
+{
+	source_load_jobs_t jobs;
+	obs_source_t *source;
+
+	da_init(jobs);
 
+	source = obs_load_source_begin(&jobs, source_data, NULL);
+	finish_source_loads(&jobs);
+
+	da_free(jobs);
 	return source;
 }
 
-obs_source_t *obs_load_source(obs_data_t *source_data)
+void obs_set_parallel_source_load(bool enable)
 {
-	return obs_load_source_type(source_data);
+	if (!obs)
+		return;
+
+	obs->data.parallel_source_load = enable;
 }
 
 void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
@@ -1878,25 +2042,36 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 {
 	struct obs_core_data *data = &obs->data;
 	DARRAY(obs_source_t *) sources;
+	source_load_jobs_t jobs;
 	size_t count;
 	size_t i;
 
 	da_init(sources);
+	da_init(jobs);
 
 	count = obs_data_array_count(array);
 	da_reserve(sources, count);
 
-	pthread_mutex_lock(&data->sources_mutex);
-
 	for (i = 0; i < count; i++) {
 		obs_data_t *source_data = obs_data_array_item(array, i);
-		obs_source_t *source = obs_load_source(source_data);
+		obs_source_t *source =
+			obs_load_source_begin(&jobs, source_data, NULL);
 
 		da_push_back(sources, &source);
 
 		obs_data_release(source_data);
 	}
 
+	/* scene items, groups and transitions only refer to other sources by
+	 * name when loading, so creating the sources does not depend on the
+	 * other sources existing */
+	if (data->parallel_source_load)
+		create_sources_parallel(&jobs);
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	finish_source_loads(&jobs);
+
 	/* tell sources that we want to load */
 	for (i = 0; i < sources.num; i++) {
 		obs_source_t *source = sources.array[i];
@@ -1922,13 +2097,14 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 	pthread_mutex_unlock(&data->sources_mutex);
 
 	da_free(sources);
+	da_free(jobs);
 }
 
 obs_data_t *obs_save_source(obs_source_t *source)
 {
 	obs_data_array_t *filters = obs_data_array_create();
 	obs_data_t *source_data = obs_data_create();
-	obs_data_t *settings = obs_source_get_settings(source);
+	obs_data_t *settings = source->context.settings;
 	obs_data_t *hotkey_data = source->context.hotkey_data;
 	obs_data_t *hotkeys;
 	float volume = obs_source_get_volume(source);
@@ -1949,6 +2125,7 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	int di_mode = (int)obs_source_get_deinterlace_mode(source);
 	int di_order = (int)obs_source_get_deinterlace_field_order(source);
 
+	obs_data_addref(settings);
 	obs_source_save(source);
 	hotkeys = obs_hotkeys_save_source(source);
 
@@ -2007,8 +2184,75 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	return source_data;
 }
 
-obs_data_array_t *obs_save_sources_filtered(obs_save_source_filter_cb cb,
-					    void *data_)
+/* sources that save their own state in their save callback can change
+ * without libobs knowing about it, so their saved data is never reused.
+ * scenes are the exception, any change to their items marks them dirty. */
+static bool save_changes_tracked(obs_source_t *source)
+{
+	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		return false;
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE)
+		return true;
+	return !source->info.save;
+}
+
+static bool save_snapshot_valid(obs_source_t *source)
+{
+	long gen = os_atomic_load_long(&obs->data.scene_save_gen);
+	bool valid = source->save_snapshot && save_changes_tracked(source);
+
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE &&
+	    source->save_snapshot_gen != gen)
+		valid = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; valid && i < source->filters.num; i++) {
+		if (!save_changes_tracked(source->filters.array[i]))
+			valid = false;
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return valid;
+}
+
+obs_data_t *obs_save_source_snapshot(obs_source_t *source)
+{
+	obs_data_t *snapshot;
+
+	if (!obs_source_valid(source, "obs_save_source_snapshot"))
+		return NULL;
+
+	pthread_mutex_lock(&obs->data.sources_mutex);
+
+	/* cleared before saving so that changes made while saving are not
+	 * lost */
+	if (os_atomic_set_bool(&source->save_dirty, false) ||
+	    !save_snapshot_valid(source)) {
+		long gen = os_atomic_load_long(&obs->data.scene_save_gen);
+		obs_data_t *source_data = obs_save_source(source);
+		const char *json;
+
+		/* round trip through json so that the snapshot does not share
+		 * any objects with the source */
+		json = obs_data_get_json(source_data);
+
+		obs_data_release(source->save_snapshot);
+		source->save_snapshot = obs_data_create_from_json(json);
+		source->save_snapshot_gen = gen;
+
+		obs_data_release(source_data);
+	}
+
+	snapshot = source->save_snapshot;
+	obs_data_addref(snapshot);
+
+	pthread_mutex_unlock(&obs->data.sources_mutex);
+
+	return snapshot;
+}
+
+static obs_data_array_t *save_sources_internal(obs_save_source_filter_cb cb,
+					       void *data_, bool snapshot)
 {
 	struct obs_core_data *data = &obs->data;
 	obs_data_array_t *array;
@@ -2024,7 +2268,9 @@ obs_data_array_t *obs_save_sources_filtered(obs_save_source_filter_cb cb,
 		if ((source->info.type != OBS_SOURCE_TYPE_FILTER) != 0 &&
 		    !source->context.private && !source->removed &&
 		    cb(data_, source)) {
-			obs_data_t *source_data = obs_save_source(source);
+			obs_data_t *source_data =
+				snapshot ? obs_save_source_snapshot(source)
+					 : obs_save_source(source);
 
 			obs_data_array_push_back(array, source_data);
 			obs_data_release(source_data);
@@ -2038,6 +2284,18 @@ obs_data_array_t *obs_save_sources_filtered(obs_save_source_filter_cb cb,
 	return array;
 }
 
+obs_data_array_t *obs_save_sources_filtered(obs_save_source_filter_cb cb,
+					    void *data)
+{
+	return save_sources_internal(cb, data, false);
+}
+
+obs_data_array_t *
+obs_save_sources_snapshot_filtered(obs_save_source_filter_cb cb, void *data)
+{
+	return save_sources_internal(cb, data, true);
+}
+
 static bool save_source_filter(void *data, obs_source_t *source)
 {
 	UNUSED_PARAMETER(data);
@@ -2199,6 +2457,49 @@ uint64_t obs_get_frame_interval_ns(void)
 	return obs->video.video_frame_interval_ns;
 }
 
+static int cmp_frame_time(const void *a, const void *b)
+{
+	uint64_t val_a = *(const uint64_t *)a;
+	uint64_t val_b = *(const uint64_t *)b;
+	return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+}
+
+static inline uint64_t get_percentile(const uint64_t *sorted, size_t num,
+				      size_t percentile)
+{
+	size_t idx = (num * percentile + 99) / 100;
+	return sorted[idx ? idx - 1 : 0];
+}
+
+bool obs_get_frame_time_stats(enum obs_frame_stat stat,
+			      struct obs_frame_time_stats *stats)
+{
+	uint64_t sorted[OBS_FRAME_STATS_WINDOW];
+	long count;
+	size_t num;
+
+	if (!obs || !stats || stat < 0 || stat >= OBS_FRAME_STAT_COUNT)
+		return false;
+
+	count = os_atomic_load_long(&obs->video.frame_stats_count);
+	num = count < OBS_FRAME_STATS_WINDOW ? (size_t)count
+					     : OBS_FRAME_STATS_WINDOW;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!num)
+		return true;
+
+	memcpy(sorted, obs->video.frame_stats[stat], num * sizeof(uint64_t));
+	qsort(sorted, num, sizeof(uint64_t), cmp_frame_time);
+
+	stats->p50_ns = get_percentile(sorted, num, 50);
+	stats->p95_ns = get_percentile(sorted, num, 95);
+	stats->p99_ns = get_percentile(sorted, num, 99);
+	stats->max_ns = sorted[num - 1];
+	stats->samples = (uint32_t)num;
+	return true;
+}
+
 enum obs_obj_type obs_obj_get_type(void *obj)
 {
 	struct obs_context_data *context = obj;
@@ -2285,6 +2586,32 @@ void obs_get_audio_monitoring_device(const char **name, const char **id)
 		*id = obs->audio.monitoring_device_id;
 }
 
+void obs_set_audio_monitoring_latency(uint32_t ms)
+{
+	if (!ms)
+		ms = DEFAULT_MONITORING_LATENCY;
+	else if (ms < MIN_MONITORING_LATENCY)
+		ms = MIN_MONITORING_LATENCY;
+	else if (ms > MAX_MONITORING_LATENCY)
+		ms = MAX_MONITORING_LATENCY;
+
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+
+	if (obs->audio.monitoring_latency != ms) {
+		obs->audio.monitoring_latency = ms;
+
+		for (size_t i = 0; i < obs->audio.monitors.num; i++)
+			audio_monitor_reset(obs->audio.monitors.array[i]);
+	}
+
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+}
+
+uint32_t obs_get_audio_monitoring_latency(void)
+{
+	return obs->audio.monitoring_latency;
+}
+
 void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 			   void *param)
 {
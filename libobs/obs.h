@@ -390,6 +390,14 @@ EXPORT int obs_reset_video(struct obs_video_info *ovi);
  */
 EXPORT bool obs_reset_audio(const struct obs_audio_info *oai);
 
+/**
+ * Sets the number of staging textures used to read back raw video frames
+ * from the GPU (2 to 4, 2 by default).  A deeper ring adds frames of latency
+ * to raw outputs but avoids stalling the graphics thread on a map when the
+ * GPU is busy.  Takes effect on the next call to obs_reset_video.
+ */
+EXPORT void obs_set_video_readback_depth(uint32_t depth);
+
 /** Gets the current video settings, returns false if no video */
 EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 
@@ -690,6 +698,13 @@ EXPORT float obs_get_master_volume(void);
 /** Saves a source to settings data */
 EXPORT obs_data_t *obs_save_source(obs_source_t *source);
 
+/**
+ * Saves a source to settings data that is not shared with the source, so it
+ * can be serialized on another thread.  The data saved last time is reused if
+ * the source has not changed since, so it must not be modified.
+ */
+EXPORT obs_data_t *obs_save_source_snapshot(obs_source_t *source);
+
 /** Loads a source from settings data */
 EXPORT obs_source_t *obs_load_source(obs_data_t *data);
 
@@ -705,6 +720,12 @@ typedef void (*obs_load_source_cb)(void *private_data, obs_source_t *source);
 EXPORT void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 			     void *private_data);
 
+/**
+ * Sets whether obs_load_sources may create sources with the
+ * OBS_SOURCE_PARALLEL_CREATE flag on multiple threads (enabled by default)
+ */
+EXPORT void obs_set_parallel_source_load(bool enable);
+
 /** Saves sources to a data array */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
@@ -712,6 +733,10 @@ typedef bool (*obs_save_source_filter_cb)(void *data, obs_source_t *source);
 EXPORT obs_data_array_t *obs_save_sources_filtered(obs_save_source_filter_cb cb,
 						   void *data);
 
+/** Same as obs_save_sources_filtered, using obs_save_source_snapshot */
+EXPORT obs_data_array_t *
+obs_save_sources_snapshot_filtered(obs_save_source_filter_cb cb, void *data);
+
 enum obs_obj_type {
 	OBS_OBJ_TYPE_INVALID,
 	OBS_OBJ_TYPE_SOURCE,
@@ -734,6 +759,13 @@ EXPORT void obs_enum_audio_monitoring_devices(obs_enum_audio_device_cb cb,
 EXPORT bool obs_set_audio_monitoring_device(const char *name, const char *id);
 EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
 
+/**
+ * Sets the latency monitoring aims for, in milliseconds (0 for the default).
+ * Resets the monitors that are active.
+ */
+EXPORT void obs_set_audio_monitoring_latency(uint32_t ms);
+EXPORT uint32_t obs_get_audio_monitoring_latency(void);
+
 EXPORT void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 				  void *param);
 EXPORT void obs_remove_tick_callback(void (*tick)(void *param, float seconds),
@@ -760,6 +792,35 @@ EXPORT uint64_t obs_get_frame_interval_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+/** Stages of the graphics loop that are timed every frame */
+enum obs_frame_stat {
+	OBS_FRAME_STAT_TICK,            /**< Ticking sources */
+	OBS_FRAME_STAT_RENDER,          /**< Rendering the main view */
+	OBS_FRAME_STAT_OUTPUT,          /**< Staging/downloading output */
+	OBS_FRAME_STAT_DISPLAYS,        /**< Rendering displays */
+	OBS_FRAME_STAT_SLEEP_OVERSHOOT, /**< Time slept past the deadline */
+	OBS_FRAME_STAT_COUNT,
+};
+
+/** Distribution of a frame stat over the last OBS_FRAME_STATS_WINDOW frames */
+struct obs_frame_time_stats {
+	uint64_t p50_ns;
+	uint64_t p95_ns;
+	uint64_t p99_ns;
+	uint64_t max_ns;
+	uint32_t samples;
+};
+
+#define OBS_FRAME_STATS_WINDOW 256
+
+/**
+ * Gets rolling percentiles of a graphics loop stage.  Does not lock, so it is
+ * cheap to call from any thread, but a frame that completes during the call
+ * may or may not be counted.
+ */
+EXPORT bool obs_get_frame_time_stats(enum obs_frame_stat stat,
+				     struct obs_frame_time_stats *stats);
+
 EXPORT bool obs_nv12_tex_active(void);
 
 EXPORT void obs_apply_private_data(obs_data_t *settings);
@@ -1170,6 +1231,11 @@ EXPORT void obs_source_set_deinterlace_field_order(
 EXPORT enum obs_deinterlace_field_order
 obs_source_get_deinterlace_field_order(const obs_source_t *source);
 
+/** Deinterlaces frames on the CPU as they are output instead of when they are
+ * rendered, so that raw frames are progressive too */
+EXPORT void obs_source_set_deinterlace_cpu(obs_source_t *source, bool cpu);
+EXPORT bool obs_source_get_deinterlace_cpu(const obs_source_t *source);
+
 enum obs_monitoring_type {
 	OBS_MONITORING_TYPE_NONE,
 	OBS_MONITORING_TYPE_MONITOR_ONLY,
@@ -1181,10 +1247,22 @@ EXPORT void obs_source_set_monitoring_type(obs_source_t *source,
 EXPORT enum obs_monitoring_type
 obs_source_get_monitoring_type(const obs_source_t *source);
 
+/** Returns the measured latency of monitoring the source in nanoseconds, or 0
+ * if it isn't monitored or the latency isn't known */
+EXPORT uint64_t obs_source_get_monitoring_latency(const obs_source_t *source);
+
 /** Gets private front-end settings data.  This data is saved/loaded
  * automatically.  Returns an incremented reference. */
 EXPORT obs_data_t *obs_source_get_private_settings(obs_source_t *item);
 
+/**
+ * Marks the saved data of a source as changed.  Only needed when the settings
+ * of a source are modified without going through obs_source_update or
+ * obs_source_get_settings, such as by a source that keeps the settings object
+ * given to its create or update callback.
+ */
+EXPORT void obs_source_mark_dirty(obs_source_t *source);
+
 /* ------------------------------------------------------------------------- */
 /* Functions used by sources */
 
@@ -1235,6 +1313,15 @@ EXPORT void obs_source_output_video2(obs_source_t *source,
 
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
+/**
+ * Converts asynchronous video frames to RGB on the CPU as they are output,
+ * so that the graphics thread only has to upload them instead of running a
+ * conversion pass.
+ */
+EXPORT void obs_source_set_async_cpu_conversion(obs_source_t *source,
+						bool cpu);
+EXPORT bool obs_source_get_async_cpu_conversion(const obs_source_t *source);
+
 EXPORT void obs_source_output_cea708(obs_source_t *source,
 				     const struct obs_source_cea_708 *captions);
 
@@ -2059,6 +2146,24 @@ EXPORT enum obs_encoder_type obs_encoder_get_type(const obs_encoder_t *encoder);
 EXPORT void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 					uint32_t height);
 
+/**
+ * Gives a video encoder its own input queue and encode thread, so that a
+ * stalling encoder does not hold up the video output thread.  Frames still
+ * queued when the encoder stops are encoded before its last output is
+ * disconnected.  max_frames is the queue depth, set it to 0 to encode
+ * synchronously (the default).  Has no effect on encoders that are fed
+ * textures directly.  Can only be changed while the encoder is inactive.
+ */
+EXPORT void obs_encoder_set_queue(obs_encoder_t *encoder, size_t max_frames,
+				  enum obs_encoder_queue_drop drop);
+
+/** Returns the number of frames waiting in the encoder's input queue */
+EXPORT size_t obs_encoder_get_queue_depth(obs_encoder_t *encoder);
+
+/** Gets the input queue statistics of the encoder since it was last started */
+EXPORT bool obs_encoder_get_queue_stats(obs_encoder_t *encoder,
+					struct obs_encoder_queue_stats *stats);
+
 /** For video encoders, returns true if pre-encode scaling is enabled */
 EXPORT bool obs_encoder_scaling_enabled(const obs_encoder_t *encoder);
 
@@ -2110,6 +2215,10 @@ EXPORT bool obs_encoder_get_extra_data(const obs_encoder_t *encoder,
 /** Returns the current settings for this encoder */
 EXPORT obs_data_t *obs_encoder_get_settings(const obs_encoder_t *encoder);
 
+/** Returns the procedure handler of the encoder */
+EXPORT proc_handler_t *
+obs_encoder_get_proc_handler(const obs_encoder_t *encoder);
+
 /** Sets the video output context to be used with this encoder */
 EXPORT void obs_encoder_set_video(obs_encoder_t *encoder, video_t *video);
 
@@ -0,0 +1,338 @@
+#include "file-watch.h"
+#include "threading.h"
+#include "platform.h"
+#include "darray.h"
+#include "bmem.h"
+#include "base.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define INOTIFY_MASK                                                   \
+	(IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | \
+	 IN_MOVED_FROM | IN_MOVED_TO)
+#endif
+
+#define WAIT_MS 250
+#define POLL_INTERVAL_NS 1000000000ULL
+
+struct os_file_watch {
+	char *path;
+	char *dir;
+	const char *name;
+
+	/* inotify watch descriptor of the directory, -1 if polled */
+	int wd;
+	time_t mtime;
+	int64_t size;
+
+	volatile bool changed;
+};
+
+/* the thread servicing the watches, started with the first watch and stopped
+ * when the last one is destroyed */
+struct file_watcher {
+	pthread_t thread;
+	os_event_t *stop_event;
+#ifdef __linux__
+	int inotify_fd;
+	int wake_fds[2];
+#endif
+};
+
+static pthread_mutex_t watch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct os_file_watch *) watches = {0};
+static struct file_watcher *watcher = NULL;
+
+static void get_file_info(const char *path, time_t *mtime, int64_t *size)
+{
+	struct stat st;
+
+	if (os_stat(path, &st) == 0) {
+		*mtime = st.st_mtime;
+		*size = (int64_t)st.st_size;
+	} else {
+		*mtime = -1;
+		*size = -1;
+	}
+}
+
+static void poll_files(void)
+{
+	pthread_mutex_lock(&watch_mutex);
+
+	for (size_t i = 0; i < watches.num; i++) {
+		struct os_file_watch *watch = watches.array[i];
+		time_t mtime;
+		int64_t size;
+
+		if (watch->wd != -1)
+			continue;
+
+		get_file_info(watch->path, &mtime, &size);
+		if (mtime != watch->mtime || size != watch->size) {
+			watch->mtime = mtime;
+			watch->size = size;
+			os_atomic_set_bool(&watch->changed, true);
+		}
+	}
+
+	pthread_mutex_unlock(&watch_mutex);
+}
+
+#ifdef __linux__
+static void read_inotify_events(struct file_watcher *fw)
+{
+	struct pollfd fds[2] = {
+		{.fd = fw->inotify_fd, .events = POLLIN},
+		{.fd = fw->wake_fds[0], .events = POLLIN},
+	};
+	char buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+
+	if (poll(fds, 2, WAIT_MS) <= 0 || !(fds[0].revents & POLLIN))
+		return;
+
+	len = read(fw->inotify_fd, buf, sizeof(buf));
+	if (len <= 0)
+		return;
+
+	pthread_mutex_lock(&watch_mutex);
+
+	for (char *ptr = buf; ptr < buf + len;) {
+		const struct inotify_event *event = (void *)ptr;
+
+		for (size_t i = 0; i < watches.num; i++) {
+			struct os_file_watch *watch = watches.array[i];
+
+			/* events were lost, any file may have changed */
+			if (event->mask & IN_Q_OVERFLOW) {
+				if (watch->wd != -1)
+					os_atomic_set_bool(&watch->changed,
+							   true);
+				continue;
+			}
+
+			if (watch->wd != event->wd)
+				continue;
+
+			/* the directory is gone or was unmounted, so the
+			 * kernel dropped its watch: poll the file instead */
+			if (event->mask & IN_IGNORED) {
+				watch->wd = -1;
+				get_file_info(watch->path, &watch->mtime,
+					      &watch->size);
+				continue;
+			}
+
+			if (event->len && strcmp(event->name, watch->name) != 0)
+				continue;
+
+			os_atomic_set_bool(&watch->changed, true);
+		}
+
+		ptr += sizeof(struct inotify_event) + event->len;
+	}
+
+	pthread_mutex_unlock(&watch_mutex);
+}
+#endif
+
+static void *file_watch_thread(void *data)
+{
+	struct file_watcher *fw = data;
+	uint64_t next_poll = os_gettime_ns() + POLL_INTERVAL_NS;
+
+	os_set_thread_name("file watcher");
+
+	while (os_event_try(fw->stop_event) == EAGAIN) {
+#ifdef __linux__
+		if (fw->inotify_fd != -1)
+			read_inotify_events(fw);
+		else
+#endif
+			os_event_timedwait(fw->stop_event, WAIT_MS);
+
+		if (os_gettime_ns() >= next_poll) {
+			poll_files();
+			next_poll = os_gettime_ns() + POLL_INTERVAL_NS;
+		}
+	}
+
+	return NULL;
+}
+
+static void file_watcher_free(struct file_watcher *fw)
+{
+	if (!fw)
+		return;
+
+#ifdef __linux__
+	if (fw->inotify_fd != -1)
+		close(fw->inotify_fd);
+	if (fw->wake_fds[0] != -1) {
+		close(fw->wake_fds[0]);
+		close(fw->wake_fds[1]);
+	}
+#endif
+	os_event_destroy(fw->stop_event);
+	bfree(fw);
+}
+
+static struct file_watcher *file_watcher_create(void)
+{
+	struct file_watcher *fw = bzalloc(sizeof(*fw));
+
+#ifdef __linux__
+	fw->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fw->inotify_fd == -1)
+		blog(LOG_WARNING, "file watch: inotify is not available, "
+				  "falling back to polling");
+
+	if (pipe(fw->wake_fds) != 0)
+		fw->wake_fds[0] = fw->wake_fds[1] = -1;
+#endif
+
+	if (os_event_init(&fw->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&fw->thread, NULL, file_watch_thread, fw) != 0)
+		goto fail;
+
+	return fw;
+
+fail:
+	blog(LOG_ERROR, "file watch: Failed to start the file watch thread");
+	file_watcher_free(fw);
+	return NULL;
+}
+
+static void file_watcher_stop(struct file_watcher *fw)
+{
+	os_event_signal(fw->stop_event);
+#ifdef __linux__
+	if (fw->wake_fds[1] != -1) {
+		char c = 0;
+		if (write(fw->wake_fds[1], &c, 1) != 1)
+			blog(LOG_DEBUG, "file watch: Failed to wake thread");
+	}
+#endif
+	pthread_join(fw->thread, NULL);
+	file_watcher_free(fw);
+}
+
+static inline void add_dir_watch(struct os_file_watch *watch)
+{
+#ifdef __linux__
+	if (watcher->inotify_fd != -1)
+		watch->wd = inotify_add_watch(watcher->inotify_fd, watch->dir,
+					      INOTIFY_MASK);
+#else
+	UNUSED_PARAMETER(watch);
+#endif
+}
+
+static inline void remove_dir_watch(struct os_file_watch *watch)
+{
+#ifdef __linux__
+	if (watch->wd == -1)
+		return;
+
+	/* directory watches are shared by all files in the directory */
+	for (size_t i = 0; i < watches.num; i++) {
+		if (watches.array[i] != watch && watches.array[i]->wd == watch->wd)
+			return;
+	}
+
+	inotify_rm_watch(watcher->inotify_fd, watch->wd);
+#else
+	UNUSED_PARAMETER(watch);
+#endif
+}
+
+os_file_watch_t *os_file_watch_create(const char *path)
+{
+	struct os_file_watch *watch;
+	const char *slash;
+
+	if (!path || !*path)
+		return NULL;
+
+	watch = bzalloc(sizeof(*watch));
+	watch->path = bstrdup(path);
+	watch->wd = -1;
+
+	slash = strrchr(watch->path, '/');
+#ifdef _WIN32
+	const char *backslash = strrchr(watch->path, '\\');
+	if (!slash || (backslash && backslash > slash))
+		slash = backslash;
+#endif
+	if (slash) {
+		watch->dir = bstrdup_n(watch->path, slash - watch->path + 1);
+		watch->name = slash + 1;
+	} else {
+		watch->dir = bstrdup(".");
+		watch->name = watch->path;
+	}
+
+	get_file_info(path, &watch->mtime, &watch->size);
+
+	pthread_mutex_lock(&watch_mutex);
+
+	if (!watcher)
+		watcher = file_watcher_create();
+	if (!watcher) {
+		pthread_mutex_unlock(&watch_mutex);
+		bfree(watch->dir);
+		bfree(watch->path);
+		bfree(watch);
+		return NULL;
+	}
+
+	add_dir_watch(watch);
+	da_push_back(watches, &watch);
+
+	pthread_mutex_unlock(&watch_mutex);
+
+	return watch;
+}
+
+void os_file_watch_destroy(os_file_watch_t *watch)
+{
+	struct file_watcher *fw = NULL;
+
+	if (!watch)
+		return;
+
+	pthread_mutex_lock(&watch_mutex);
+
+	remove_dir_watch(watch);
+	da_erase_item(watches, &watch);
+
+	if (!watches.num) {
+		da_free(watches);
+		fw = watcher;
+		watcher = NULL;
+	}
+
+	pthread_mutex_unlock(&watch_mutex);
+
+	if (fw)
+		file_watcher_stop(fw);
+
+	bfree(watch->dir);
+	bfree(watch->path);
+	bfree(watch);
+}
+
+bool os_file_watch_changed(os_file_watch_t *watch)
+{
+	return watch && os_atomic_set_bool(&watch->changed, false);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ * File change notifications
+ *
+ *   All file watches are serviced by a single thread.  On Linux, it waits on
+ * inotify events for the directories of the watched files.  Elsewhere, or
+ * when a directory cannot be watched, it checks the modification time and
+ * size of the files once a second instead.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct os_file_watch;
+typedef struct os_file_watch os_file_watch_t;
+
+EXPORT os_file_watch_t *os_file_watch_create(const char *path);
+EXPORT void os_file_watch_destroy(os_file_watch_t *watch);
+
+/** Returns true if the file changed since the last call */
+EXPORT bool os_file_watch_changed(os_file_watch_t *watch);
+
+#ifdef __cplusplus
+}
+#endif
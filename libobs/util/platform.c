@@ -27,6 +27,16 @@
 #include "dstr.h"
 #include "obs.h"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || \
+	defined(__x86_64__)
+#define OS_CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
 	FILE *file = NULL;
@@ -803,3 +813,47 @@ char *os_generate_formatted_filename(const char *extension, bool space,
 
 	return sf.array;
 }
+
+#ifdef OS_CPU_X86
+static void get_cpuid(unsigned int leaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int *)regs, (int)leaf, 0);
+#else
+	__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/* AVX registers are only usable if the OS saves them on context switches */
+static bool os_saves_avx_state(void)
+{
+#ifdef _MSC_VER
+	return (_xgetbv(0) & 6) == 6;
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	UNUSED_PARAMETER(edx);
+	return (eax & 6) == 6;
+#endif
+}
+#endif
+
+bool os_cpu_has_avx(void)
+{
+#ifdef OS_CPU_X86
+	unsigned int regs[4];
+
+	get_cpuid(0, regs);
+	if (regs[0] < 1)
+		return false;
+
+	/* ecx bit 27: OSXSAVE, ecx bit 28: AVX */
+	get_cpuid(1, regs);
+	if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0)
+		return false;
+
+	return os_saves_avx_state();
+#else
+	return false;
+#endif
+}
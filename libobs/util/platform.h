@@ -186,6 +186,10 @@ EXPORT void os_breakpoint(void);
 EXPORT int os_get_physical_cores(void);
 EXPORT int os_get_logical_cores(void);
 
+/* returns whether the cpu and the operating system support AVX; always false
+ * on non-x86 platforms.  callers should cache the result. */
+EXPORT bool os_cpu_has_avx(void);
+
 EXPORT uint64_t os_get_sys_free_size(void);
 
 struct os_proc_memory_usage {
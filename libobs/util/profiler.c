@@ -287,6 +287,11 @@ void profile_reenable_thread(void)
 	pthread_mutex_unlock(&root_mutex);
 }
 
+bool profile_thread_has_root(void)
+{
+	return thread_enabled && thread_context != NULL;
+}
+
 static bool lock_root(void)
 {
 	pthread_mutex_lock(&root_mutex);
@@ -22,6 +22,11 @@ EXPORT void profile_end(const char *name);
 
 EXPORT void profile_reenable_thread(void);
 
+/* returns whether a profile node is active in the calling thread, in which
+ * case profile_start adds a child to it rather than starting a new root.
+ * Whoever starts a root calls profile_reenable_thread after ending it. */
+EXPORT bool profile_thread_has_root(void);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler control */
 
@@ -2,7 +2,7 @@
 #include <graphics/image-file.h>
 #include <util/platform.h>
 #include <util/dstr.h>
-#include <sys/stat.h>
+#include <util/file-watch.h>
 
 #define blog(log_level, format, ...)                    \
 	blog(log_level, "[image_source: '%s'] " format, \
@@ -17,7 +17,8 @@ struct image_source {
 
 	char *file;
 	bool persistent;
-	time_t file_timestamp;
+	uint32_t gif_frame_budget;
+	os_file_watch_t *file_watch;
 	float update_time_elapsed;
 	uint64_t last_time;
 	bool active;
@@ -25,14 +26,6 @@ struct image_source {
 	gs_image_file2_t if2;
 };
 
-static time_t get_modified_timestamp(const char *filename)
-{
-	struct stat stats;
-	if (os_stat(filename, &stats) != 0)
-		return -1;
-	return stats.st_mtime;
-}
-
 static const char *image_source_get_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -49,8 +42,9 @@ static void image_source_load(struct image_source *context)
 
 	if (file && *file) {
 		debug("loading texture '%s'", file);
-		context->file_timestamp = get_modified_timestamp(file);
-		gs_image_file2_init(&context->if2, file);
+		os_file_watch_changed(context->file_watch);
+		gs_image_file2_init_gif_budget(&context->if2, file,
+					       context->gif_frame_budget);
 		context->update_time_elapsed = 0;
 
 		obs_enter_graphics();
@@ -78,7 +72,15 @@ static void image_source_update(void *data, obs_data_t *settings)
 	if (context->file)
 		bfree(context->file);
 	context->file = bstrdup(file);
+
+	os_file_watch_destroy(context->file_watch);
+	context->file_watch = os_file_watch_create(file);
 	context->persistent = !unload;
+	context->gif_frame_budget =
+		obs_data_get_bool(settings, "limit_gif_frames")
+			? (uint32_t)obs_data_get_int(settings,
+						     "gif_frame_budget")
+			: 0;
 
 	/* Load the image if the source is persistent or showing */
 	if (context->persistent || obs_source_showing(context->source))
@@ -90,6 +92,8 @@ static void image_source_update(void *data, obs_data_t *settings)
 static void image_source_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_bool(settings, "unload", false);
+	obs_data_set_default_bool(settings, "limit_gif_frames", false);
+	obs_data_set_default_int(settings, "gif_frame_budget", 30);
 }
 
 static void image_source_show(void *data)
@@ -122,6 +126,7 @@ static void image_source_destroy(void *data)
 	struct image_source *context = data;
 
 	image_source_unload(context);
+	os_file_watch_destroy(context->file_watch);
 
 	if (context->file)
 		bfree(context->file);
@@ -173,12 +178,10 @@ static void image_source_tick(void *data, float seconds)
 
 	if (obs_source_showing(context->source)) {
 		if (context->update_time_elapsed >= 1.0f) {
-			time_t t = get_modified_timestamp(context->file);
 			context->update_time_elapsed = 0.0f;
 
-			if (context->file_timestamp != t) {
+			if (os_file_watch_changed(context->file_watch))
 				image_source_load(context);
-			}
 		}
 	}
 
@@ -232,6 +235,15 @@ static const char *image_filter =
 	"WebP Files (*.webp);;"
 	"All Files (*.*)";
 
+static bool limit_gif_frames_modified(obs_properties_t *props,
+				      obs_property_t *p, obs_data_t *settings)
+{
+	bool limit = obs_data_get_bool(settings, "limit_gif_frames");
+	p = obs_properties_get(props, "gif_frame_budget");
+	obs_property_set_visible(p, limit);
+	return true;
+}
+
 static obs_properties_t *image_source_properties(void *data)
 {
 	struct image_source *s = data;
@@ -253,6 +265,16 @@ static obs_properties_t *image_source_properties(void *data)
 				OBS_PATH_FILE, image_filter, path.array);
 	obs_properties_add_bool(props, "unload",
 				obs_module_text("UnloadWhenNotShowing"));
+
+	obs_property_t *p = obs_properties_add_bool(
+		props, "limit_gif_frames", obs_module_text("LimitGifFrames"));
+	obs_property_set_modified_callback(p, limit_gif_frames_modified);
+
+	p = obs_properties_add_int(props, "gif_frame_budget",
+				   obs_module_text("GifFrameBudget"), 2, 1024,
+				   1);
+	obs_property_set_long_description(
+		p, obs_module_text("GifFrameBudget.ToolTip"));
 	dstr_free(&path);
 
 	return props;
@@ -298,7 +320,7 @@ static obs_missing_files_t *image_source_missingfiles(void *data)
 static struct obs_source_info image_source_info = {
 	.id = "image_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_PARALLEL_CREATE,
 	.get_name = image_source_get_name,
 	.create = image_source_create,
 	.destroy = image_source_destroy,
@@ -3,6 +3,7 @@
 #include <util/platform.h>
 #include <util/darray.h>
 #include <util/dstr.h>
+#include <graphics/image-file.h>
 
 #define do_log(level, format, ...)               \
 	blog(level, "[slideshow: '%s'] " format, \
@@ -27,6 +28,7 @@
 #define S_MODE                         "slide_mode"
 #define S_MODE_AUTO                    "mode_auto"
 #define S_MODE_MANUAL                  "mode_manual"
+#define S_MEM_LIMIT                    "memory_limit_mb"
 
 #define TR_CUT                         "cut"
 #define TR_FADE                        "fade"
@@ -50,6 +52,7 @@
 #define T_MODE                         T_("SlideMode")
 #define T_MODE_AUTO                    T_("SlideMode.Auto")
 #define T_MODE_MANUAL                  T_("SlideMode.Manual")
+#define T_MEM_LIMIT                    T_("MemoryLimit")
 
 #define T_TR_(text) obs_module_text("SlideShow.Transition." text)
 #define T_TR_CUT                       T_TR_("Cut")
@@ -64,11 +67,20 @@
 extern uint64_t image_source_get_memory_usage(void *data);
 
 #define BYTES_TO_MBYTES (1024 * 1024)
-#define MAX_MEM_USAGE (400 * BYTES_TO_MBYTES)
+#define DEFAULT_MEM_LIMIT_MB 400
+
+/* number of upcoming slides that are loaded ahead of time */
+#define PREFETCH_SLIDES 3
 
 struct image_file_data {
 	char *path;
 	obs_source_t *source;
+
+	uint32_t cx;
+	uint32_t cy;
+	bool size_known;
+	uint64_t mem_usage;
+	uint64_t last_used;
 };
 
 enum behavior {
@@ -100,10 +112,25 @@ struct slideshow {
 
 	uint32_t cx;
 	uint32_t cy;
+	bool use_auto_size;
+	bool aspect_only;
+	int custom_cx;
+	int custom_cy;
+	volatile bool size_changed;
+
 	uint64_t mem_usage;
+	uint64_t mem_limit;
 
 	pthread_mutex_t mutex;
 	DARRAY(struct image_file_data) files;
+	size_t upcoming[PREFETCH_SLIDES];
+	size_t num_upcoming;
+	uint64_t files_gen;
+
+	pthread_t prefetch_thread;
+	os_event_t *prefetch_event;
+	bool prefetch_thread_valid;
+	volatile bool prefetch_stop;
 
 	enum behavior behavior;
 
@@ -140,24 +167,21 @@ static obs_source_t *get_transition(struct slideshow *ss)
 	return tr;
 }
 
-static obs_source_t *get_source(struct darray *array, const char *path)
+static struct image_file_data *find_file(struct darray *array,
+					 const char *path)
 {
 	DARRAY(struct image_file_data) files;
-	obs_source_t *source = NULL;
 
 	files.da = *array;
 
 	for (size_t i = 0; i < files.num; i++) {
 		const char *cur_path = files.array[i].path;
 
-		if (strcmp(path, cur_path) == 0) {
-			source = files.array[i].source;
-			obs_source_addref(source);
-			break;
-		}
+		if (strcmp(path, cur_path) == 0)
+			return &files.array[i];
 	}
 
-	return source;
+	return NULL;
 }
 
 static obs_source_t *create_source_from_file(const char *file)
@@ -191,6 +215,342 @@ static inline size_t random_file(struct slideshow *ss)
 	return (size_t)rand() % ss->files.num;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Slides are loaded lazily.  A prefetch thread creates the image sources of
+ * the current and upcoming slides ahead of time, so images are decoded and
+ * their textures created off the tick thread, and releases the least recently
+ * used ones once the loaded images exceed the memory limit.  When the size is
+ * automatic, it also reads the size of slides that have not been loaded. */
+
+static inline bool slide_wanted(struct slideshow *ss, size_t idx)
+{
+	if (idx == ss->cur_item)
+		return true;
+
+	for (size_t i = 0; i < ss->num_upcoming; i++) {
+		if (ss->upcoming[i] == idx)
+			return true;
+	}
+
+	return false;
+}
+
+static void set_file_source(struct image_file_data *file,
+			    obs_source_t *source)
+{
+	void *source_data = obs_obj_get_data(source);
+
+	file->source = source;
+	file->cx = obs_source_get_width(source);
+	file->cy = obs_source_get_height(source);
+	file->size_known = true;
+	file->mem_usage = image_source_get_memory_usage(source_data);
+	file->last_used = os_gettime_ns();
+}
+
+static bool load_slide(struct slideshow *ss, size_t idx)
+{
+	struct image_file_data *file;
+	obs_source_t *source;
+	bool new_size = false;
+	bool loaded = false;
+	uint64_t gen;
+	char *path;
+
+	pthread_mutex_lock(&ss->mutex);
+	if (idx >= ss->files.num || ss->files.array[idx].source) {
+		pthread_mutex_unlock(&ss->mutex);
+		return false;
+	}
+	path = bstrdup(ss->files.array[idx].path);
+	gen = ss->files_gen;
+	pthread_mutex_unlock(&ss->mutex);
+
+	source = create_source_from_file(path);
+	bfree(path);
+
+	pthread_mutex_lock(&ss->mutex);
+	if (source && gen == ss->files_gen) {
+		file = &ss->files.array[idx];
+		if (!file->source) {
+			new_size = !file->size_known;
+			set_file_source(file, source);
+			ss->mem_usage += file->mem_usage;
+			loaded = true;
+		}
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	if (!loaded)
+		obs_source_release(source);
+	if (new_size)
+		os_atomic_set_bool(&ss->size_changed, true);
+	return loaded;
+}
+
+static obs_source_t *get_loaded_slide(struct slideshow *ss, size_t idx)
+{
+	obs_source_t *source = NULL;
+
+	pthread_mutex_lock(&ss->mutex);
+	if (idx < ss->files.num) {
+		struct image_file_data *file = &ss->files.array[idx];
+
+		source = file->source;
+		if (source) {
+			obs_source_addref(source);
+			file->last_used = os_gettime_ns();
+		}
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	return source;
+}
+
+static obs_source_t *get_slide(struct slideshow *ss, size_t idx)
+{
+	obs_source_t *source = get_loaded_slide(ss, idx);
+
+	/* not prefetched in time, so load it here */
+	if (!source) {
+		load_slide(ss, idx);
+		source = get_loaded_slide(ss, idx);
+	}
+
+	return source;
+}
+
+static void evict_slides(struct slideshow *ss)
+{
+	DARRAY(obs_source_t *) sources;
+
+	da_init(sources);
+
+	pthread_mutex_lock(&ss->mutex);
+	while (ss->mem_usage > ss->mem_limit) {
+		struct image_file_data *lru = NULL;
+
+		for (size_t i = 0; i < ss->files.num; i++) {
+			struct image_file_data *file = &ss->files.array[i];
+
+			if (!file->source || slide_wanted(ss, i))
+				continue;
+			if (!lru || file->last_used < lru->last_used)
+				lru = file;
+		}
+
+		if (!lru)
+			break;
+
+		da_push_back(sources, &lru->source);
+		ss->mem_usage -= lru->mem_usage;
+		lru->source = NULL;
+		lru->mem_usage = 0;
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	for (size_t i = 0; i < sources.num; i++)
+		obs_source_release(sources.array[i]);
+	da_free(sources);
+}
+
+static bool prefetch_slides(struct slideshow *ss)
+{
+	size_t wanted[PREFETCH_SLIDES + 1];
+	size_t num_wanted;
+
+	pthread_mutex_lock(&ss->mutex);
+	wanted[0] = ss->cur_item;
+	for (size_t i = 0; i < ss->num_upcoming; i++)
+		wanted[i + 1] = ss->upcoming[i];
+	num_wanted = ss->num_upcoming + 1;
+	pthread_mutex_unlock(&ss->mutex);
+
+	for (size_t i = 0; i < num_wanted && !ss->prefetch_stop; i++) {
+		if (load_slide(ss, wanted[i])) {
+			evict_slides(ss);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool scan_slide_size(struct slideshow *ss)
+{
+	uint32_t cx = 0;
+	uint32_t cy = 0;
+	char *path = NULL;
+	size_t idx = 0;
+	uint64_t gen;
+
+	pthread_mutex_lock(&ss->mutex);
+	for (size_t i = 0; ss->use_auto_size && i < ss->files.num; i++) {
+		if (!ss->files.array[i].size_known) {
+			path = bstrdup(ss->files.array[i].path);
+			idx = i;
+			break;
+		}
+	}
+	gen = ss->files_gen;
+	pthread_mutex_unlock(&ss->mutex);
+
+	if (!path)
+		return false;
+
+	/* only the header is read, so the image is neither decoded nor added
+	 * to the image cache */
+	gs_get_image_file_size(path, &cx, &cy);
+	bfree(path);
+
+	pthread_mutex_lock(&ss->mutex);
+	if (gen == ss->files_gen && !ss->files.array[idx].size_known) {
+		ss->files.array[idx].cx = cx;
+		ss->files.array[idx].cy = cy;
+		ss->files.array[idx].size_known = true;
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	os_atomic_set_bool(&ss->size_changed, true);
+	return true;
+}
+
+static void *prefetch_thread(void *data)
+{
+	struct slideshow *ss = data;
+
+	os_set_thread_name("slideshow: prefetch");
+
+	while (!ss->prefetch_stop) {
+		if (prefetch_slides(ss))
+			continue;
+		if (scan_slide_size(ss))
+			continue;
+
+		os_event_wait(ss->prefetch_event);
+	}
+
+	return NULL;
+}
+
+/* picks the upcoming slides, call whenever the current slide changes */
+static void queue_prefetch(struct slideshow *ss)
+{
+	pthread_mutex_lock(&ss->mutex);
+
+	size_t num = ss->files.num;
+
+	if (ss->randomize) {
+		size_t prev = ss->num_upcoming
+				      ? ss->upcoming[ss->num_upcoming - 1]
+				      : ss->cur_item;
+
+		while (ss->num_upcoming < PREFETCH_SLIDES && num > 1) {
+			size_t next = prev;
+			while (next == prev)
+				next = random_file(ss);
+
+			ss->upcoming[ss->num_upcoming++] = next;
+			prev = next;
+		}
+	} else {
+		ss->num_upcoming = 0;
+
+		for (size_t i = 1; i <= PREFETCH_SLIDES && i < num; i++) {
+			size_t idx = ss->cur_item + i;
+			if (idx >= num) {
+				if (!ss->loop)
+					break;
+				idx -= num;
+			}
+
+			ss->upcoming[ss->num_upcoming++] = idx;
+		}
+	}
+
+	pthread_mutex_unlock(&ss->mutex);
+
+	if (ss->prefetch_event)
+		os_event_signal(ss->prefetch_event);
+}
+
+static size_t next_random_file(struct slideshow *ss)
+{
+	size_t next = ss->cur_item;
+
+	pthread_mutex_lock(&ss->mutex);
+	if (ss->num_upcoming) {
+		next = ss->upcoming[0];
+		ss->num_upcoming--;
+		memmove(ss->upcoming, ss->upcoming + 1,
+			ss->num_upcoming * sizeof(size_t));
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	if (ss->files.num > 1) {
+		while (next == ss->cur_item || next >= ss->files.num)
+			next = random_file(ss);
+	}
+
+	return next;
+}
+
+static void update_size(struct slideshow *ss)
+{
+	uint32_t cx = 0;
+	uint32_t cy = 0;
+	bool has_files;
+
+	pthread_mutex_lock(&ss->mutex);
+	for (size_t i = 0; i < ss->files.num; i++) {
+		struct image_file_data *file = &ss->files.array[i];
+
+		if (file->cx > cx)
+			cx = file->cx;
+		if (file->cy > cy)
+			cy = file->cy;
+	}
+	has_files = ss->files.num > 0;
+	pthread_mutex_unlock(&ss->mutex);
+
+	/* the sizes of the slides are read in the background, so until one
+	 * is known the canvas size stands in for them */
+	if (has_files && (!cx || !cy)) {
+		struct obs_video_info ovi;
+
+		if (obs_get_video_info(&ovi)) {
+			cx = ovi.base_width;
+			cy = ovi.base_height;
+		}
+	}
+
+	if (!ss->use_auto_size) {
+		double cx_f = (double)cx;
+		double cy_f = (double)cy;
+
+		double old_aspect = cx_f / cy_f;
+		double new_aspect =
+			(double)ss->custom_cx / (double)ss->custom_cy;
+
+		if (ss->aspect_only) {
+			if (cx && cy &&
+			    fabs(old_aspect - new_aspect) > EPSILON) {
+				if (new_aspect > old_aspect)
+					cx = (uint32_t)(cy_f * new_aspect);
+				else
+					cy = (uint32_t)(cx_f / new_aspect);
+			}
+		} else {
+			cx = (uint32_t)ss->custom_cx;
+			cy = (uint32_t)ss->custom_cy;
+		}
+	}
+
+	ss->cx = cx;
+	ss->cy = cy;
+	obs_transition_set_size(ss->transition, cx, cy);
+}
+
 /* ------------------------------------------------------------------------- */
 
 static const char *ss_getname(void *unused)
@@ -200,40 +560,34 @@ static const char *ss_getname(void *unused)
 }
 
 static void add_file(struct slideshow *ss, struct darray *array,
-		     const char *path, uint32_t *cx, uint32_t *cy)
+		     const char *path)
 {
 	DARRAY(struct image_file_data) new_files;
-	struct image_file_data data;
-	obs_source_t *new_source;
+	struct image_file_data data = {0};
+	struct image_file_data *cur;
 
 	new_files.da = *array;
 
+	/* keep the loaded image and size of files that were already listed */
 	pthread_mutex_lock(&ss->mutex);
-	new_source = get_source(&ss->files.da, path);
+	cur = find_file(&ss->files.da, path);
+	if (cur) {
+		data = *cur;
+		obs_source_addref(data.source);
+	}
 	pthread_mutex_unlock(&ss->mutex);
 
-	if (!new_source)
-		new_source = get_source(&new_files.da, path);
-	if (!new_source)
-		new_source = create_source_from_file(path);
-
-	if (new_source) {
-		uint32_t new_cx = obs_source_get_width(new_source);
-		uint32_t new_cy = obs_source_get_height(new_source);
-
-		data.path = bstrdup(path);
-		data.source = new_source;
-		da_push_back(new_files, &data);
-
-		if (new_cx > *cx)
-			*cx = new_cx;
-		if (new_cy > *cy)
-			*cy = new_cy;
-
-		void *source_data = obs_obj_get_data(new_source);
-		ss->mem_usage += image_source_get_memory_usage(source_data);
+	if (!cur) {
+		cur = find_file(&new_files.da, path);
+		if (cur) {
+			data = *cur;
+			obs_source_addref(data.source);
+		}
 	}
 
+	data.path = bstrdup(path);
+	da_push_back(new_files, &data);
+
 	*array = new_files.da;
 }
 
@@ -255,15 +609,17 @@ static void do_transition(void *data, bool to_null)
 {
 	struct slideshow *ss = data;
 	bool valid = item_valid(ss);
+	obs_source_t *source = NULL;
+
+	if (valid && (ss->use_cut || !to_null))
+		source = get_slide(ss, ss->cur_item);
 
 	if (valid && ss->use_cut) {
-		obs_transition_set(ss->transition,
-				   ss->files.array[ss->cur_item].source);
+		obs_transition_set(ss->transition, source);
 
 	} else if (valid && !to_null) {
 		obs_transition_start(ss->transition, OBS_TRANSITION_MODE_AUTO,
-				     ss->tr_speed,
-				     ss->files.array[ss->cur_item].source);
+				     ss->tr_speed, source);
 
 	} else {
 		obs_transition_start(ss->transition, OBS_TRANSITION_MODE_AUTO,
@@ -271,6 +627,9 @@ static void do_transition(void *data, bool to_null)
 		set_media_state(ss, OBS_MEDIA_STATE_ENDED);
 		obs_source_media_ended(ss->source);
 	}
+
+	obs_source_release(source);
+	queue_prefetch(ss);
 }
 
 static void ss_update(void *data, obs_data_t *settings)
@@ -284,8 +643,7 @@ static void ss_update(void *data, obs_data_t *settings)
 	const char *tr_name;
 	uint32_t new_duration;
 	uint32_t new_speed;
-	uint32_t cx = 0;
-	uint32_t cy = 0;
+	uint64_t mem_usage = 0;
 	size_t count;
 	const char *behavior;
 	const char *mode;
@@ -328,13 +686,29 @@ static void ss_update(void *data, obs_data_t *settings)
 	new_duration = (uint32_t)obs_data_get_int(settings, S_SLIDE_TIME);
 	new_speed = (uint32_t)obs_data_get_int(settings, S_TR_SPEED);
 
+	const char *res_str = obs_data_get_string(settings, S_CUSTOM_SIZE);
+	bool aspect_only = false, use_auto = true;
+	int cx_in = 0, cy_in = 0;
+
+	if (strcmp(res_str, T_CUSTOM_SIZE_AUTO) != 0) {
+		int ret = sscanf(res_str, "%dx%d", &cx_in, &cy_in);
+		if (ret == 2) {
+			aspect_only = false;
+			use_auto = false;
+		} else {
+			ret = sscanf(res_str, "%d:%d", &cx_in, &cy_in);
+			if (ret == 2) {
+				aspect_only = true;
+				use_auto = false;
+			}
+		}
+	}
+
 	array = obs_data_get_array(settings, S_FILES);
 	count = obs_data_array_count(array);
 
 	/* ------------------------------------- */
-	/* create new list of sources */
-
-	ss->mem_usage = 0;
+	/* create new list of files, images are loaded as they are needed */
 
 	for (size_t i = 0; i < count; i++) {
 		obs_data_t *item = obs_data_array_item(array, i);
@@ -361,25 +735,21 @@ static void ss_update(void *data, obs_data_t *settings)
 				dstr_copy(&dir_path, path);
 				dstr_cat_ch(&dir_path, '/');
 				dstr_cat(&dir_path, ent->d_name);
-				add_file(ss, &new_files.da, dir_path.array, &cx,
-					 &cy);
-
-				if (ss->mem_usage >= MAX_MEM_USAGE)
-					break;
+				add_file(ss, &new_files.da, dir_path.array);
 			}
 
 			dstr_free(&dir_path);
 			os_closedir(dir);
 		} else {
-			add_file(ss, &new_files.da, path, &cx, &cy);
+			add_file(ss, &new_files.da, path);
 		}
 
 		obs_data_release(item);
-
-		if (ss->mem_usage >= MAX_MEM_USAGE)
-			break;
 	}
 
+	for (size_t i = 0; i < new_files.num; i++)
+		mem_usage += new_files.array[i].mem_usage;
+
 	/* ------------------------------------- */
 	/* update settings data */
 
@@ -387,6 +757,16 @@ static void ss_update(void *data, obs_data_t *settings)
 
 	old_files.da = ss->files.da;
 	ss->files.da = new_files.da;
+	ss->files_gen++;
+	ss->num_upcoming = 0;
+	ss->cur_item = 0;
+	ss->mem_usage = mem_usage;
+	ss->mem_limit = (uint64_t)obs_data_get_int(settings, S_MEM_LIMIT) *
+			BYTES_TO_MBYTES;
+	ss->use_auto_size = use_auto;
+	ss->aspect_only = aspect_only;
+	ss->custom_cx = cx_in;
+	ss->custom_cy = cy_in;
 	if (new_tr) {
 		old_tr = ss->transition;
 		ss->transition = new_tr;
@@ -415,53 +795,7 @@ static void ss_update(void *data, obs_data_t *settings)
 		obs_source_release(old_tr);
 	free_files(&old_files.da);
 
-	/* ------------------------- */
-
-	const char *res_str = obs_data_get_string(settings, S_CUSTOM_SIZE);
-	bool aspect_only = false, use_auto = true;
-	int cx_in = 0, cy_in = 0;
-
-	if (strcmp(res_str, T_CUSTOM_SIZE_AUTO) != 0) {
-		int ret = sscanf(res_str, "%dx%d", &cx_in, &cy_in);
-		if (ret == 2) {
-			aspect_only = false;
-			use_auto = false;
-		} else {
-			ret = sscanf(res_str, "%d:%d", &cx_in, &cy_in);
-			if (ret == 2) {
-				aspect_only = true;
-				use_auto = false;
-			}
-		}
-	}
-
-	if (!use_auto) {
-		double cx_f = (double)cx;
-		double cy_f = (double)cy;
-
-		double old_aspect = cx_f / cy_f;
-		double new_aspect = (double)cx_in / (double)cy_in;
-
-		if (aspect_only) {
-			if (fabs(old_aspect - new_aspect) > EPSILON) {
-				if (new_aspect > old_aspect)
-					cx = (uint32_t)(cy_f * new_aspect);
-				else
-					cy = (uint32_t)(cx_f / new_aspect);
-			}
-		} else {
-			cx = (uint32_t)cx_in;
-			cy = (uint32_t)cy_in;
-		}
-	}
-
-	/* ------------------------- */
-
-	ss->cx = cx;
-	ss->cy = cy;
-	ss->cur_item = 0;
 	ss->elapsed = 0.0f;
-	obs_transition_set_size(ss->transition, cx, cy);
 	obs_transition_set_alignment(ss->transition, OBS_ALIGN_CENTER);
 	obs_transition_set_scale_type(ss->transition,
 				      OBS_TRANSITION_SCALE_ASPECT);
@@ -481,6 +815,9 @@ static void ss_update(void *data, obs_data_t *settings)
 		obs_source_media_started(ss->source);
 	}
 
+	os_atomic_set_bool(&ss->size_changed, false);
+	update_size(ss);
+
 	obs_data_array_release(array);
 }
 
@@ -628,8 +965,15 @@ static void ss_destroy(void *data)
 {
 	struct slideshow *ss = data;
 
+	if (ss->prefetch_thread_valid) {
+		os_atomic_set_bool(&ss->prefetch_stop, true);
+		os_event_signal(ss->prefetch_event);
+		pthread_join(ss->prefetch_thread, NULL);
+	}
+
 	obs_source_release(ss->transition);
 	free_files(&ss->files.da);
+	os_event_destroy(ss->prefetch_event);
 	pthread_mutex_destroy(&ss->mutex);
 	bfree(ss);
 }
@@ -668,9 +1012,16 @@ static void *ss_create(obs_data_t *settings, obs_source_t *source)
 	pthread_mutex_init_value(&ss->mutex);
 	if (pthread_mutex_init(&ss->mutex, NULL) != 0)
 		goto error;
+	if (os_event_init(&ss->prefetch_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto error;
 
 	obs_source_update(source, NULL);
 
+	if (pthread_create(&ss->prefetch_thread, NULL, prefetch_thread, ss) !=
+	    0)
+		goto error;
+	ss->prefetch_thread_valid = true;
+
 	UNUSED_PARAMETER(settings);
 	return ss;
 
@@ -699,6 +1050,9 @@ static void ss_video_tick(void *data, float seconds)
 	if (!ss->transition || !ss->slide_time)
 		return;
 
+	if (os_atomic_set_bool(&ss->size_changed, false))
+		update_size(ss);
+
 	if (ss->restart_on_activate && ss->use_cut) {
 		ss->elapsed = 0.0f;
 		ss->cur_item = ss->randomize ? random_file(ss) : 0;
@@ -741,12 +1095,7 @@ static void ss_video_tick(void *data, float seconds)
 		}
 
 		if (ss->randomize) {
-			size_t next = ss->cur_item;
-			if (ss->files.num > 1) {
-				while (next == ss->cur_item)
-					next = random_file(ss);
-			}
-			ss->cur_item = next;
+			ss->cur_item = next_random_file(ss);
 
 		} else if (++ss->cur_item >= ss->files.num) {
 			ss->cur_item = 0;
@@ -845,6 +1194,7 @@ static void ss_defaults(obs_data_t *settings)
 				    S_BEHAVIOR_ALWAYS_PLAY);
 	obs_data_set_default_string(settings, S_MODE, S_MODE_AUTO);
 	obs_data_set_default_bool(settings, S_LOOP, true);
+	obs_data_set_default_int(settings, S_MEM_LIMIT, DEFAULT_MEM_LIMIT_MB);
 }
 
 static const char *file_filter =
@@ -915,6 +1265,10 @@ static obs_properties_t *ss_properties(void *data)
 	snprintf(str, 32, "%dx%d", cx, cy);
 	obs_property_list_add_string(p, str, str);
 
+	p = obs_properties_add_int(ppts, S_MEM_LIMIT, T_MEM_LIMIT, 16, 4096,
+				   16);
+	obs_property_int_set_suffix(p, " MB");
+
 	if (ss) {
 		pthread_mutex_lock(&ss->mutex);
 		if (ss->files.num) {
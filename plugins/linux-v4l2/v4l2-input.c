@@ -149,6 +149,24 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+/*
+ * Packed 4:2:2 and greyscale frames would cost the graphics thread a
+ * conversion pass of their own, so they are converted to RGB as they are
+ * captured instead.
+ */
+static bool v4l2_cpu_conversion(struct v4l2_data *data)
+{
+	switch (v4l2_to_obs_video_format(data->pixfmt)) {
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+	case VIDEO_FORMAT_Y800:
+		return true;
+	default:
+		return false;
+	}
+}
+
 /*
  * Worker thread to get video data
  */
@@ -988,6 +1006,8 @@ static void v4l2_init(struct v4l2_data *data)
 	blog(LOG_INFO, "Resolution: %dx%d", data->width, data->height);
 	blog(LOG_INFO, "Pixelformat: %s", V4L2_FOURCC_STR(data->pixfmt));
 	blog(LOG_INFO, "Linesize: %d Bytes", data->linesize);
+	obs_source_set_async_cpu_conversion(data->source,
+					    v4l2_cpu_conversion(data));
 
 	/* set framerate */
 	if (v4l2_set_framerate(data->dev, &data->framerate) < 0) {
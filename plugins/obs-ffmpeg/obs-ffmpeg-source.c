@@ -16,6 +16,7 @@
 
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/darray.h>
 #include <util/dstr.h>
 
 #include "obs-ffmpeg-compat.h"
@@ -31,10 +32,14 @@
 #define FF_BLOG(level, format, ...) \
 	FF_LOG_S(s->source, level, format, ##__VA_ARGS__)
 
+struct shared_media;
+
 struct ffmpeg_source {
 	mp_media_t media;
+	struct shared_media *shared;
 	bool media_valid;
 	bool destroy_media;
+	bool unshared;
 
 	struct SwsContext *sws_ctx;
 	int sws_width;
@@ -49,6 +54,8 @@ struct ffmpeg_source {
 	char *input;
 	char *input_format;
 	int buffering_mb;
+	int frame_cache_mb;
+	int decode_ahead;
 	int speed_percent;
 	bool is_looping;
 	bool is_local_file;
@@ -87,6 +94,8 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_t *local_file = obs_properties_get(props, "local_file");
 	obs_property_t *looping = obs_properties_get(props, "looping");
 	obs_property_t *buffering = obs_properties_get(props, "buffering_mb");
+	obs_property_t *frame_cache =
+		obs_properties_get(props, "frame_cache_mb");
 	obs_property_t *seekable = obs_properties_get(props, "seekable");
 	obs_property_t *speed = obs_properties_get(props, "speed_percent");
 	obs_property_t *reconnect_delay_sec =
@@ -96,6 +105,7 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_set_visible(buffering, !enabled);
 	obs_property_set_visible(local_file, enabled);
 	obs_property_set_visible(looping, enabled);
+	obs_property_set_visible(frame_cache, enabled);
 	obs_property_set_visible(speed, enabled);
 	obs_property_set_visible(seekable, !enabled);
 	obs_property_set_visible(reconnect_delay_sec, !enabled);
@@ -111,6 +121,8 @@ static void ffmpeg_source_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "restart_on_activate", true);
 	obs_data_set_default_int(settings, "reconnect_delay_sec", 10);
 	obs_data_set_default_int(settings, "buffering_mb", 2);
+	obs_data_set_default_int(settings, "frame_cache_mb", 0);
+	obs_data_set_default_int(settings, "decode_ahead", 0);
 	obs_data_set_default_int(settings, "speed_percent", 100);
 }
 
@@ -169,6 +181,13 @@ static obs_properties_t *ffmpeg_source_getproperties(void *data)
 	obs_properties_add_bool(props, "restart_on_activate",
 				obs_module_text("RestartWhenActivated"));
 
+	prop = obs_properties_add_int_slider(props, "frame_cache_mb",
+					     obs_module_text("FrameCacheMB"), 0,
+					     1024, 16);
+	obs_property_int_set_suffix(prop, " MB");
+	obs_property_set_long_description(
+		prop, obs_module_text("FrameCacheMB.ToolTip"));
+
 	prop = obs_properties_add_int_slider(props, "buffering_mb",
 					     obs_module_text("BufferingMB"), 0,
 					     16, 1);
@@ -219,6 +238,12 @@ static obs_properties_t *ffmpeg_source_getproperties(void *data)
 
 	obs_properties_add_bool(props, "seekable", obs_module_text("Seekable"));
 
+	prop = obs_properties_add_int_slider(props, "decode_ahead",
+					     obs_module_text("DecodeAhead"), 0,
+					     16, 1);
+	obs_property_set_long_description(
+		prop, obs_module_text("DecodeAhead.ToolTip"));
+
 	return props;
 }
 
@@ -231,13 +256,16 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 		"\tinput_format:            %s\n"
 		"\tspeed:                   %d\n"
 		"\tis_looping:              %s\n"
+		"\tframe_cache_mb:          %d\n"
+		"\tdecode_ahead:            %d\n"
 		"\tis_hw_decoding:          %s\n"
 		"\tis_clear_on_media_end:   %s\n"
 		"\trestart_on_activate:     %s\n"
 		"\tclose_when_inactive:     %s",
 		input ? input : "(null)",
 		input_format ? input_format : "(null)", s->speed_percent,
-		s->is_looping ? "yes" : "no", s->is_hw_decoding ? "yes" : "no",
+		s->is_looping ? "yes" : "no", s->frame_cache_mb, s->decode_ahead,
+		s->is_hw_decoding ? "yes" : "no",
 		s->is_clear_on_media_end ? "yes" : "no",
 		s->restart_on_activate ? "yes" : "no",
 		s->close_when_inactive ? "yes" : "no");
@@ -291,30 +319,263 @@ static void media_stopped(void *opaque)
 	obs_source_media_ended(s->source);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Looping local files that are never restarted or closed play the same frames
+ * in every source using them, so sources with identical settings share one
+ * media instance (and its demux/decode thread) and each receive its output.
+ * Using a media control on a shared source moves it to its own instance. */
+
+struct shared_media {
+	mp_media_t media;
+	char *key;
+	bool playing;
+
+	pthread_mutex_t mutex;
+	DARRAY(struct ffmpeg_source *) sources;
+
+	struct shared_media *next;
+};
+
+static struct shared_media *shared_media_list = NULL;
+static pthread_mutex_t shared_media_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define SHARED_MEDIA_CALLBACK(name, callback, type)           \
+	static void name(void *opaque, type data)             \
+	{                                                     \
+		struct shared_media *sm = opaque;             \
+		pthread_mutex_lock(&sm->mutex);               \
+		for (size_t i = 0; i < sm->sources.num; i++)  \
+			callback(sm->sources.array[i], data); \
+		pthread_mutex_unlock(&sm->mutex);             \
+	}
+
+SHARED_MEDIA_CALLBACK(shared_get_frame, get_frame, struct obs_source_frame *)
+SHARED_MEDIA_CALLBACK(shared_preload_frame, preload_frame,
+		      struct obs_source_frame *)
+SHARED_MEDIA_CALLBACK(shared_seek_frame, seek_frame, struct obs_source_frame *)
+SHARED_MEDIA_CALLBACK(shared_get_audio, get_audio, struct obs_source_audio *)
+
+#undef SHARED_MEDIA_CALLBACK
+
+static void shared_media_stopped(void *opaque)
+{
+	struct shared_media *sm = opaque;
+
+	pthread_mutex_lock(&sm->mutex);
+	sm->playing = false;
+	for (size_t i = 0; i < sm->sources.num; i++)
+		media_stopped(sm->sources.array[i]);
+	pthread_mutex_unlock(&sm->mutex);
+}
+
+static inline bool can_share_media(struct ffmpeg_source *s)
+{
+	return s->is_local_file && s->is_looping && !s->restart_on_activate &&
+	       !s->close_when_inactive && !s->unshared;
+}
+
+static void get_media_info(struct ffmpeg_source *s, struct mp_media_info *info)
+{
+	size_t frame_cache_size =
+		s->is_local_file ? (size_t)s->frame_cache_mb << 20 : 0;
+
+	struct mp_media_info new_info = {
+		.opaque = s,
+		.v_cb = get_frame,
+		.v_preload_cb = preload_frame,
+		.v_seek_cb = seek_frame,
+		.a_cb = get_audio,
+		.stop_cb = media_stopped,
+		.path = s->input,
+		.format = s->input_format,
+		.buffering = s->buffering_mb * 1024 * 1024,
+		.speed = s->speed_percent,
+		.force_range = s->range,
+		.hardware_decoding = s->is_hw_decoding,
+		.is_local_file = s->is_local_file || s->seekable,
+		.reconnecting = s->reconnecting,
+		.frame_cache_size = frame_cache_size,
+		.pipeline_depth = s->decode_ahead,
+	};
+
+	*info = new_info;
+}
+
+static struct shared_media *shared_media_create(struct ffmpeg_source *s,
+						const char *key)
+{
+	struct shared_media *sm = bzalloc(sizeof(*sm));
+	struct mp_media_info info;
+
+	get_media_info(s, &info);
+	info.opaque = sm;
+	info.v_cb = shared_get_frame;
+	info.v_preload_cb = shared_preload_frame;
+	info.v_seek_cb = shared_seek_frame;
+	info.a_cb = shared_get_audio;
+	info.stop_cb = shared_media_stopped;
+
+	if (pthread_mutex_init(&sm->mutex, NULL) != 0) {
+		bfree(sm);
+		return NULL;
+	}
+
+	/* the media thread can output a frame before this returns */
+	da_push_back(sm->sources, &s);
+
+	if (!mp_media_init(&sm->media, &info)) {
+		pthread_mutex_destroy(&sm->mutex);
+		da_free(sm->sources);
+		bfree(sm);
+		return NULL;
+	}
+
+	sm->key = bstrdup(key);
+	return sm;
+}
+
+static void shared_media_destroy(struct shared_media *sm)
+{
+	mp_media_free(&sm->media);
+	pthread_mutex_destroy(&sm->mutex);
+	da_free(sm->sources);
+	bfree(sm->key);
+	bfree(sm);
+}
+
+static struct shared_media *shared_media_attach(struct ffmpeg_source *s)
+{
+	struct shared_media *sm;
+	struct dstr key = {0};
+	size_t num_sources;
+
+	dstr_printf(&key, "%s|%d|%d|%d|%d|%d", s->input, s->speed_percent,
+		    (int)s->range, (int)s->is_hw_decoding, s->frame_cache_mb,
+		    s->decode_ahead);
+
+	pthread_mutex_lock(&shared_media_mutex);
+
+	sm = shared_media_list;
+	while (sm && strcmp(sm->key, key.array) != 0)
+		sm = sm->next;
+
+	if (!sm) {
+		sm = shared_media_create(s, key.array);
+		if (sm) {
+			sm->next = shared_media_list;
+			shared_media_list = sm;
+		}
+	} else {
+		pthread_mutex_lock(&sm->mutex);
+		da_push_back(sm->sources, &s);
+		num_sources = sm->sources.num;
+		pthread_mutex_unlock(&sm->mutex);
+
+		if (num_sources > 1)
+			FF_BLOG(LOG_INFO,
+				"Sharing media with %d other source(s)",
+				(int)num_sources - 1);
+	}
+
+	pthread_mutex_unlock(&shared_media_mutex);
+
+	dstr_free(&key);
+	return sm;
+}
+
+static void shared_media_detach(struct ffmpeg_source *s)
+{
+	struct shared_media *sm = s->shared;
+	bool last;
+
+	pthread_mutex_lock(&shared_media_mutex);
+
+	pthread_mutex_lock(&sm->mutex);
+	da_erase_item(sm->sources, &s);
+	last = sm->sources.num == 0;
+	pthread_mutex_unlock(&sm->mutex);
+
+	if (last) {
+		struct shared_media **p_next = &shared_media_list;
+		while (*p_next != sm)
+			p_next = &(*p_next)->next;
+		*p_next = sm->next;
+	}
+
+	pthread_mutex_unlock(&shared_media_mutex);
+
+	if (last)
+		shared_media_destroy(sm);
+	s->shared = NULL;
+}
+
+static void shared_media_play(struct shared_media *sm, bool loop)
+{
+	bool play;
+
+	pthread_mutex_lock(&sm->mutex);
+	play = !sm->playing;
+	sm->playing = true;
+	pthread_mutex_unlock(&sm->mutex);
+
+	if (play)
+		mp_media_play(&sm->media, loop, false);
+}
+
+static inline mp_media_t *get_media(struct ffmpeg_source *s)
+{
+	return s->shared ? &s->shared->media : &s->media;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static void ffmpeg_source_open(struct ffmpeg_source *s)
 {
 	if (s->input && *s->input) {
-		struct mp_media_info info = {
-			.opaque = s,
-			.v_cb = get_frame,
-			.v_preload_cb = preload_frame,
-			.v_seek_cb = seek_frame,
-			.a_cb = get_audio,
-			.stop_cb = media_stopped,
-			.path = s->input,
-			.format = s->input_format,
-			.buffering = s->buffering_mb * 1024 * 1024,
-			.speed = s->speed_percent,
-			.force_range = s->range,
-			.hardware_decoding = s->is_hw_decoding,
-			.is_local_file = s->is_local_file || s->seekable,
-			.reconnecting = s->reconnecting,
-		};
+		if (can_share_media(s)) {
+			s->shared = shared_media_attach(s);
+			s->media_valid = !!s->shared;
+			return;
+		}
+
+		struct mp_media_info info;
+		get_media_info(s, &info);
 
 		s->media_valid = mp_media_init(&s->media, &info);
 	}
 }
 
+static void ffmpeg_source_close(struct ffmpeg_source *s)
+{
+	if (!s->media_valid)
+		return;
+
+	if (s->shared)
+		shared_media_detach(s);
+	else
+		mp_media_free(&s->media);
+	s->media_valid = false;
+}
+
+/* Moves a source off its shared media on to its own instance, continuing
+ * from the same position, so that media controls only affect that source. */
+static void ffmpeg_source_unshare(struct ffmpeg_source *s)
+{
+	if (!s->shared)
+		return;
+
+	int64_t ms = mp_get_current_time(&s->shared->media);
+
+	ffmpeg_source_close(s);
+	s->unshared = true;
+	ffmpeg_source_open(s);
+
+	if (s->media_valid) {
+		mp_media_play(&s->media, s->is_looping, false);
+		mp_media_seek_to(&s->media, ms);
+	}
+}
+
 static void ffmpeg_source_start(struct ffmpeg_source *s)
 {
 	if (!s->media_valid)
@@ -323,7 +584,10 @@ static void ffmpeg_source_start(struct ffmpeg_source *s)
 	if (!s->media_valid)
 		return;
 
-	mp_media_play(&s->media, s->is_looping, s->reconnecting);
+	if (s->shared)
+		shared_media_play(s->shared, s->is_looping);
+	else
+		mp_media_play(&s->media, s->is_looping, s->reconnecting);
 	if (s->is_local_file && (s->is_clear_on_media_end || s->is_looping))
 		obs_source_show_preloaded_video(s->source);
 	else
@@ -358,11 +622,7 @@ static void ffmpeg_source_tick(void *data, float seconds)
 
 	struct ffmpeg_source *s = data;
 	if (s->destroy_media) {
-		if (s->media_valid) {
-			mp_media_free(&s->media);
-			s->media_valid = false;
-		}
-
+		ffmpeg_source_close(s);
 		s->destroy_media = false;
 
 		if (!s->is_local_file) {
@@ -430,6 +690,8 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	s->range = (enum video_range_type)obs_data_get_int(settings,
 							   "color_range");
 	s->buffering_mb = (int)obs_data_get_int(settings, "buffering_mb");
+	s->frame_cache_mb = (int)obs_data_get_int(settings, "frame_cache_mb");
+	s->decode_ahead = (int)obs_data_get_int(settings, "decode_ahead");
 	s->speed_percent = (int)obs_data_get_int(settings, "speed_percent");
 	s->is_local_file = is_local_file;
 	s->seekable = obs_data_get_bool(settings, "seekable");
@@ -437,10 +699,8 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	if (s->speed_percent < 1 || s->speed_percent > 200)
 		s->speed_percent = 100;
 
-	if (s->media_valid) {
-		mp_media_free(&s->media);
-		s->media_valid = false;
-	}
+	ffmpeg_source_close(s);
+	s->unshared = false;
 
 	bool active = obs_source_active(s->source);
 	if (!s->close_when_inactive || active)
@@ -480,9 +740,10 @@ static void restart_proc(void *data, calldata_t *cd)
 static void get_duration(void *data, calldata_t *cd)
 {
 	struct ffmpeg_source *s = data;
+	mp_media_t *m = get_media(s);
 	int64_t dur = 0;
-	if (s->media.fmt)
-		dur = s->media.fmt->duration;
+	if (m->fmt)
+		dur = m->fmt->duration;
 
 	calldata_set_int(cd, "duration", dur * 1000);
 }
@@ -490,15 +751,16 @@ static void get_duration(void *data, calldata_t *cd)
 static void get_nb_frames(void *data, calldata_t *cd)
 {
 	struct ffmpeg_source *s = data;
+	mp_media_t *m = get_media(s);
 	int64_t frames = 0;
 
-	if (!s->media.fmt) {
+	if (!m->fmt) {
 		calldata_set_int(cd, "num_frames", frames);
 		return;
 	}
 
 	int video_stream_index = av_find_best_stream(
-		s->media.fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+		m->fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
 
 	if (video_stream_index < 0) {
 		FF_BLOG(LOG_WARNING, "Getting number of frames failed: No "
@@ -507,7 +769,7 @@ static void get_nb_frames(void *data, calldata_t *cd)
 		return;
 	}
 
-	AVStream *stream = s->media.fmt->streams[video_stream_index];
+	AVStream *stream = m->fmt->streams[video_stream_index];
 
 	if (stream->nb_frames > 0) {
 		frames = stream->nb_frames;
@@ -515,7 +777,7 @@ static void get_nb_frames(void *data, calldata_t *cd)
 		FF_BLOG(LOG_DEBUG, "nb_frames not set, estimating using frame "
 				   "rate and duration");
 		AVRational avg_frame_rate = stream->avg_frame_rate;
-		frames = (int64_t)ceil((double)s->media.fmt->duration /
+		frames = (int64_t)ceil((double)m->fmt->duration /
 				       (double)AV_TIME_BASE *
 				       (double)avg_frame_rate.num /
 				       (double)avg_frame_rate.den);
@@ -524,6 +786,30 @@ static void get_nb_frames(void *data, calldata_t *cd)
 	calldata_set_int(cd, "num_frames", frames);
 }
 
+static void get_pipeline_stats(void *data, calldata_t *cd)
+{
+	struct ffmpeg_source *s = data;
+	struct mp_media_pipeline_stats stats = {0};
+	double decode_ms = 0.0;
+	double convert_ms = 0.0;
+
+	if (s->media_valid &&
+	    mp_media_get_pipeline_stats(get_media(s), &stats)) {
+		if (stats.decode_count)
+			decode_ms = (double)stats.decode_ns /
+				    (double)stats.decode_count / 1000000.0;
+		if (stats.convert_count)
+			convert_ms = (double)stats.convert_ns /
+				     (double)stats.convert_count / 1000000.0;
+	}
+
+	calldata_set_int(cd, "depth", (long long)stats.depth);
+	calldata_set_int(cd, "max_depth", (long long)stats.max_depth);
+	calldata_set_float(cd, "decode_ms", decode_ms);
+	calldata_set_float(cd, "convert_ms", convert_ms);
+	calldata_set_int(cd, "late_frames", (long long)stats.late_frames);
+}
+
 static bool ffmpeg_source_play_hotkey(void *data, obs_hotkey_pair_id id,
 				      obs_hotkey_t *hotkey, bool pressed)
 {
@@ -604,6 +890,11 @@ static void *ffmpeg_source_create(obs_data_t *settings, obs_source_t *source)
 			 get_duration, s);
 	proc_handler_add(ph, "void get_nb_frames(out int num_frames)",
 			 get_nb_frames, s);
+	proc_handler_add(ph,
+			 "void get_pipeline_stats(out int depth, "
+			 "out int max_depth, out float decode_ms, "
+			 "out float convert_ms, out int late_frames)",
+			 get_pipeline_stats, s);
 
 	ffmpeg_source_update(s, settings);
 	return s;
@@ -620,8 +911,7 @@ static void ffmpeg_source_destroy(void *data)
 		if (s->reconnect_thread_valid)
 			pthread_join(s->reconnect_thread, NULL);
 	}
-	if (s->media_valid)
-		mp_media_free(&s->media);
+	ffmpeg_source_close(s);
 
 	if (s->sws_ctx != NULL)
 		sws_freeContext(s->sws_ctx);
@@ -663,6 +953,10 @@ static void ffmpeg_source_play_pause(void *data, bool pause)
 	if (!s->media_valid)
 		return;
 
+	ffmpeg_source_unshare(s);
+	if (!s->media_valid)
+		return;
+
 	mp_media_play_pause(&s->media, pause);
 
 	if (pause)
@@ -675,6 +969,8 @@ static void ffmpeg_source_stop(void *data)
 {
 	struct ffmpeg_source *s = data;
 
+	ffmpeg_source_unshare(s);
+
 	if (s->media_valid) {
 		mp_media_stop(&s->media);
 		obs_source_output_video(s->source, NULL);
@@ -686,8 +982,10 @@ static void ffmpeg_source_restart(void *data)
 {
 	struct ffmpeg_source *s = data;
 
-	if (obs_source_showing(s->source))
+	if (obs_source_showing(s->source)) {
+		ffmpeg_source_unshare(s);
 		ffmpeg_source_start(s);
+	}
 
 	set_media_state(s, OBS_MEDIA_STATE_PLAYING);
 }
@@ -695,10 +993,11 @@ static void ffmpeg_source_restart(void *data)
 static int64_t ffmpeg_source_get_duration(void *data)
 {
 	struct ffmpeg_source *s = data;
+	mp_media_t *m = get_media(s);
 	int64_t dur = 0;
 
-	if (s->media.fmt)
-		dur = s->media.fmt->duration / INT64_C(1000);
+	if (m->fmt)
+		dur = m->fmt->duration / INT64_C(1000);
 
 	return dur;
 }
@@ -707,13 +1006,17 @@ static int64_t ffmpeg_source_get_time(void *data)
 {
 	struct ffmpeg_source *s = data;
 
-	return mp_get_current_time(&s->media);
+	return mp_get_current_time(get_media(s));
 }
 
 static void ffmpeg_source_set_time(void *data, int64_t ms)
 {
 	struct ffmpeg_source *s = data;
 
+	if (!s->media_valid)
+		return;
+
+	ffmpeg_source_unshare(s);
 	if (!s->media_valid)
 		return;
 
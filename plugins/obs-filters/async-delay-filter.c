@@ -1,5 +1,6 @@
 #include <obs-module.h>
 #include <util/circlebuf.h>
+#include <util/threading.h>
 #include <util/util_uint64.h>
 
 #ifndef SEC_TO_NSEC
@@ -10,19 +11,65 @@
 #define MSEC_TO_NSEC 1000000ULL
 #endif
 
+#define do_log(level, format, ...)                   \
+	blog(level, "[async delay: '%s'] " format,   \
+	     obs_source_get_name(filter->context), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
 #define SETTING_DELAY_MS "delay_ms"
+#define SETTING_MAX_MEMORY "max_memory_mb"
+#define SETTING_EVICTION "eviction"
 
 #define TEXT_DELAY_MS obs_module_text("DelayMs")
+#define TEXT_MAX_MEMORY obs_module_text("AsyncDelay.MaxMemory")
+#define TEXT_EVICTION obs_module_text("AsyncDelay.Eviction")
+#define TEXT_EVICTION_OLDEST obs_module_text("AsyncDelay.Eviction.DropOldest")
+#define TEXT_EVICTION_NEWEST obs_module_text("AsyncDelay.Eviction.DropNewest")
+
+/* frame rate the delay line is preallocated for */
+#define EXPECTED_FPS 60
+
+enum eviction_policy {
+	/* shortens the delay */
+	EVICT_OLDEST,
+	/* keeps the delay, lowers the frame rate */
+	EVICT_NEWEST,
+};
+
+#ifdef DELAY_AUDIO
+struct audio_packet {
+	uint64_t timestamp;
+	uint32_t frames;
+};
+#endif
 
 struct async_delay_data {
 	obs_source_t *context;
 
-	/* contains struct obs_source_frame* */
+	/* contains struct obs_source_frame*, frames are borrowed from the
+	 * async frame cache of the parent source, never copied */
 	struct circlebuf video_frames;
+	size_t reserve_frames;
+
+	/* memory held by the delayed frames */
+	uint64_t memory;
+	uint64_t peak_memory;
+	uint64_t max_memory;
+	enum eviction_policy eviction;
+	volatile long dropped_frames;
+	bool evicting;
 
-	/* stores the audio data */
-	struct circlebuf audio_frames;
+#ifdef DELAY_AUDIO
+	/* planar float samples and the packets they came in */
+	struct circlebuf audio_buffers[MAX_AV_PLANES];
+	struct circlebuf audio_packets;
 	struct obs_audio_data audio_output;
+	float *audio_output_data;
+	size_t audio_output_capacity;
+	size_t audio_channels;
+#endif
 
 	uint64_t last_video_ts;
 	uint64_t last_audio_ts;
@@ -40,35 +87,89 @@ static const char *async_delay_filter_name(void *unused)
 	return obs_module_text("AsyncDelayFilter");
 }
 
+static size_t get_frame_size(const struct obs_source_frame *frame)
+{
+	const uint32_t h = frame->height;
+	const uint32_t half = (frame->height + 1) / 2;
+	uint32_t heights[MAX_AV_PLANES] = {0};
+	size_t size = 0;
+
+	switch (frame->format) {
+	case VIDEO_FORMAT_I420:
+		heights[0] = h;
+		heights[1] = heights[2] = half;
+		break;
+	case VIDEO_FORMAT_NV12:
+		heights[0] = h;
+		heights[1] = half;
+		break;
+	case VIDEO_FORMAT_I40A:
+		heights[0] = heights[3] = h;
+		heights[1] = heights[2] = half;
+		break;
+	case VIDEO_FORMAT_I444:
+	case VIDEO_FORMAT_I422:
+		heights[0] = heights[1] = heights[2] = h;
+		break;
+	case VIDEO_FORMAT_I42A:
+	case VIDEO_FORMAT_YUVA:
+		heights[0] = heights[1] = heights[2] = heights[3] = h;
+		break;
+	case VIDEO_FORMAT_NONE:
+		break;
+	default:
+		heights[0] = h;
+		break;
+	}
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		size += (size_t)frame->linesize[i] * heights[i];
+	return size;
+}
+
+static void push_video_frame(struct async_delay_data *filter,
+			     struct obs_source_frame *frame)
+{
+	circlebuf_push_back(&filter->video_frames, &frame,
+			    sizeof(struct obs_source_frame *));
+
+	filter->memory += get_frame_size(frame);
+	if (filter->memory > filter->peak_memory)
+		filter->peak_memory = filter->memory;
+}
+
+static struct obs_source_frame *pop_video_frame(struct async_delay_data *filter)
+{
+	struct obs_source_frame *frame;
+
+	circlebuf_pop_front(&filter->video_frames, &frame,
+			    sizeof(struct obs_source_frame *));
+
+	filter->memory -= get_frame_size(frame);
+	return frame;
+}
+
 static void free_video_data(struct async_delay_data *filter,
 			    obs_source_t *parent)
 {
 	while (filter->video_frames.size) {
-		struct obs_source_frame *frame;
-
-		circlebuf_pop_front(&filter->video_frames, &frame,
-				    sizeof(struct obs_source_frame *));
+		struct obs_source_frame *frame = pop_video_frame(filter);
 		obs_source_release_frame(parent, frame);
 	}
-}
 
-static inline void free_audio_packet(struct obs_audio_data *audio)
-{
-	for (size_t i = 0; i < MAX_AV_PLANES; i++)
-		bfree(audio->data[i]);
-	memset(audio, 0, sizeof(*audio));
+	filter->memory = 0;
 }
 
+#ifdef DELAY_AUDIO
 static void free_audio_data(struct async_delay_data *filter)
 {
-	while (filter->audio_frames.size) {
-		struct obs_audio_data audio;
-
-		circlebuf_pop_front(&filter->audio_frames, &audio,
-				    sizeof(struct obs_audio_data));
-		free_audio_packet(&audio);
-	}
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		circlebuf_pop_front(&filter->audio_buffers[i], NULL,
+				    filter->audio_buffers[i].size);
+	circlebuf_pop_front(&filter->audio_packets, NULL,
+			    filter->audio_packets.size);
 }
+#endif
 
 static void async_delay_filter_update(void *data, obs_data_t *settings)
 {
@@ -76,10 +177,19 @@ static void async_delay_filter_update(void *data, obs_data_t *settings)
 	uint64_t new_interval =
 		(uint64_t)obs_data_get_int(settings, SETTING_DELAY_MS) *
 		MSEC_TO_NSEC;
+	uint64_t max_memory_mb =
+		(uint64_t)obs_data_get_int(settings, SETTING_MAX_MEMORY);
 
 	if (new_interval < filter->interval)
 		free_video_data(filter, obs_filter_get_parent(filter->context));
 
+	filter->reserve_frames =
+		(size_t)(new_interval * EXPECTED_FPS / SEC_TO_NSEC) + 1;
+	filter->max_memory = max_memory_mb * 1024 * 1024;
+	filter->eviction =
+		(enum eviction_policy)obs_data_get_int(settings,
+						       SETTING_EVICTION);
+
 	filter->reset_audio = true;
 	filter->reset_video = true;
 	filter->interval = new_interval;
@@ -87,6 +197,19 @@ static void async_delay_filter_update(void *data, obs_data_t *settings)
 	filter->audio_delay_reached = false;
 }
 
+static void get_memory_usage(void *data, calldata_t *cd)
+{
+	struct async_delay_data *filter = data;
+
+	calldata_set_int(cd, "memory", (long long)filter->memory);
+	calldata_set_int(cd, "peak_memory", (long long)filter->peak_memory);
+	calldata_set_int(cd, "frames",
+			 (long long)(filter->video_frames.size /
+				     sizeof(struct obs_source_frame *)));
+	calldata_set_int(cd, "dropped_frames",
+			 os_atomic_load_long(&filter->dropped_frames));
+}
+
 static void *async_delay_filter_create(obs_data_t *settings,
 				       obs_source_t *context)
 {
@@ -98,20 +221,53 @@ static void *async_delay_filter_create(obs_data_t *settings,
 
 	obs_get_audio_info(&oai);
 	filter->samplerate = oai.samples_per_sec;
+#ifdef DELAY_AUDIO
+	filter->audio_channels = get_audio_channels(oai.speakers);
+#endif
+
+	proc_handler_t *ph = obs_source_get_proc_handler(context);
+	proc_handler_add(ph,
+			 "void get_memory_usage(out int memory, "
+			 "out int peak_memory, out int frames, "
+			 "out int dropped_frames)",
+			 get_memory_usage, filter);
 
 	return filter;
 }
 
+static void log_memory_usage(struct async_delay_data *filter)
+{
+	if (!filter->peak_memory)
+		return;
+
+	info("peak memory use: %.1f MB, %ld frames dropped to stay within "
+	     "the memory limit",
+	     (double)filter->peak_memory / (1024.0 * 1024.0),
+	     os_atomic_load_long(&filter->dropped_frames));
+}
+
 static void async_delay_filter_destroy(void *data)
 {
 	struct async_delay_data *filter = data;
 
-	free_audio_packet(&filter->audio_output);
+	log_memory_usage(filter);
+
 	circlebuf_free(&filter->video_frames);
-	circlebuf_free(&filter->audio_frames);
+#ifdef DELAY_AUDIO
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		circlebuf_free(&filter->audio_buffers[i]);
+	circlebuf_free(&filter->audio_packets);
+	bfree(filter->audio_output_data);
+#endif
 	bfree(data);
 }
 
+static void async_delay_filter_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, SETTING_MAX_MEMORY, 0);
+	obs_data_set_default_int(settings, SETTING_EVICTION, EVICT_OLDEST);
+}
+
 static obs_properties_t *async_delay_filter_properties(void *data)
 {
 	obs_properties_t *props = obs_properties_create();
@@ -120,6 +276,15 @@ static obs_properties_t *async_delay_filter_properties(void *data)
 						   TEXT_DELAY_MS, 0, 20000, 1);
 	obs_property_int_set_suffix(p, " ms");
 
+	p = obs_properties_add_int(props, SETTING_MAX_MEMORY, TEXT_MAX_MEMORY,
+				   0, 65536, 64);
+	obs_property_int_set_suffix(p, " MB");
+
+	p = obs_properties_add_list(props, SETTING_EVICTION, TEXT_EVICTION,
+				    OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, TEXT_EVICTION_OLDEST, EVICT_OLDEST);
+	obs_property_list_add_int(p, TEXT_EVICTION_NEWEST, EVICT_NEWEST);
+
 	UNUSED_PARAMETER(data);
 	return props;
 }
@@ -129,7 +294,9 @@ static void async_delay_filter_remove(void *data, obs_source_t *parent)
 	struct async_delay_data *filter = data;
 
 	free_video_data(filter, parent);
+#ifdef DELAY_AUDIO
 	free_audio_data(filter);
+#endif
 }
 
 /* due to the fact that we need timing information to be consistent in order to
@@ -141,6 +308,45 @@ static inline bool is_timestamp_jump(uint64_t ts, uint64_t prev_ts)
 	return ts < prev_ts || (ts - prev_ts) > SEC_TO_NSEC;
 }
 
+/* Makes room for a new frame within the memory limit.  Returns false if the
+ * new frame should be dropped instead. */
+static bool evict_frames(struct async_delay_data *filter,
+			 obs_source_t *parent, size_t frame_size)
+{
+	bool over = filter->max_memory &&
+		    filter->memory + frame_size > filter->max_memory;
+
+	if (!over) {
+		filter->evicting = false;
+		return true;
+	}
+
+	if (!filter->evicting) {
+		warn("delay needs more than the memory limit of %.0f MB, "
+		     "dropping %s frames",
+		     (double)filter->max_memory / (1024.0 * 1024.0),
+		     filter->eviction == EVICT_OLDEST ? "the oldest" : "new");
+		filter->evicting = true;
+	}
+
+	if (filter->eviction == EVICT_NEWEST) {
+		/* always keep at least one frame to output */
+		if (!filter->video_frames.size)
+			return true;
+
+		os_atomic_inc_long(&filter->dropped_frames);
+		return false;
+	}
+
+	while (filter->video_frames.size &&
+	       filter->memory + frame_size > filter->max_memory) {
+		obs_source_release_frame(parent, pop_video_frame(filter));
+		os_atomic_inc_long(&filter->dropped_frames);
+	}
+
+	return true;
+}
+
 static struct obs_source_frame *
 async_delay_filter_video(void *data, struct obs_source_frame *frame)
 {
@@ -152,23 +358,31 @@ async_delay_filter_video(void *data, struct obs_source_frame *frame)
 	if (filter->reset_video ||
 	    is_timestamp_jump(frame->timestamp, filter->last_video_ts)) {
 		free_video_data(filter, parent);
+		circlebuf_reserve(&filter->video_frames,
+				  filter->reserve_frames *
+					  sizeof(struct obs_source_frame *));
 		filter->video_delay_reached = false;
 		filter->reset_video = false;
 	}
 
 	filter->last_video_ts = frame->timestamp;
 
-	circlebuf_push_back(&filter->video_frames, &frame,
-			    sizeof(struct obs_source_frame *));
+	if (evict_frames(filter, parent, get_frame_size(frame)))
+		push_video_frame(filter, frame);
+	else
+		obs_source_release_frame(parent, frame);
+
+	if (!filter->video_frames.size)
+		return NULL;
+
 	circlebuf_peek_front(&filter->video_frames, &output,
 			     sizeof(struct obs_source_frame *));
 
-	cur_interval = frame->timestamp - output->timestamp;
+	cur_interval = filter->last_video_ts - output->timestamp;
 	if (!filter->video_delay_reached && cur_interval < filter->interval)
 		return NULL;
 
-	circlebuf_pop_front(&filter->video_frames, NULL,
-			    sizeof(struct obs_source_frame *));
+	pop_video_frame(filter);
 
 	if (!filter->video_delay_reached)
 		filter->video_delay_reached = true;
@@ -186,14 +400,23 @@ static struct obs_audio_data *
 async_delay_filter_audio(void *data, struct obs_audio_data *audio)
 {
 	struct async_delay_data *filter = data;
-	struct obs_audio_data cached = *audio;
+	struct audio_packet packet = {audio->timestamp, audio->frames};
+	const size_t channels = filter->audio_channels;
 	uint64_t cur_interval;
 	uint64_t duration;
 	uint64_t end_ts;
 
 	if (filter->reset_audio ||
 	    is_timestamp_jump(audio->timestamp, filter->last_audio_ts)) {
+		size_t reserve = (size_t)util_mul_div64(
+			filter->interval, filter->samplerate, SEC_TO_NSEC);
+
 		free_audio_data(filter);
+		for (size_t i = 0; i < channels; i++)
+			circlebuf_reserve(&filter->audio_buffers[i],
+					  (reserve + audio->frames) *
+						  sizeof(float));
+
 		filter->audio_delay_reached = false;
 		filter->reset_audio = false;
 	}
@@ -204,25 +427,41 @@ async_delay_filter_audio(void *data, struct obs_audio_data *audio)
 		util_mul_div64(audio->frames, SEC_TO_NSEC, filter->samplerate);
 	end_ts = audio->timestamp + duration;
 
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-		if (!audio->data[i])
-			break;
-
-		cached.data[i] =
-			bmemdup(audio->data[i], audio->frames * sizeof(float));
+	for (size_t i = 0; i < channels; i++) {
+		if (audio->data[i])
+			circlebuf_push_back(&filter->audio_buffers[i],
+					    audio->data[i],
+					    audio->frames * sizeof(float));
+		else
+			circlebuf_push_back_zero(&filter->audio_buffers[i],
+						 audio->frames * sizeof(float));
 	}
+	circlebuf_push_back(&filter->audio_packets, &packet, sizeof(packet));
+	circlebuf_peek_front(&filter->audio_packets, &packet, sizeof(packet));
 
-	free_audio_packet(&filter->audio_output);
-
-	circlebuf_push_back(&filter->audio_frames, &cached, sizeof(cached));
-	circlebuf_peek_front(&filter->audio_frames, &cached, sizeof(cached));
-
-	cur_interval = end_ts - cached.timestamp;
+	cur_interval = end_ts - packet.timestamp;
 	if (!filter->audio_delay_reached && cur_interval < filter->interval)
 		return NULL;
 
-	circlebuf_pop_front(&filter->audio_frames, NULL, sizeof(cached));
-	memcpy(&filter->audio_output, &cached, sizeof(cached));
+	circlebuf_pop_front(&filter->audio_packets, NULL, sizeof(packet));
+
+	if (packet.frames > filter->audio_output_capacity) {
+		filter->audio_output_capacity = packet.frames;
+		filter->audio_output_data =
+			brealloc(filter->audio_output_data,
+				 packet.frames * channels * sizeof(float));
+	}
+
+	memset(&filter->audio_output, 0, sizeof(filter->audio_output));
+	for (size_t i = 0; i < channels; i++) {
+		float *out = filter->audio_output_data + i * packet.frames;
+
+		circlebuf_pop_front(&filter->audio_buffers[i], out,
+				    packet.frames * sizeof(float));
+		filter->audio_output.data[i] = (uint8_t *)out;
+	}
+	filter->audio_output.frames = packet.frames;
+	filter->audio_output.timestamp = packet.timestamp;
 
 	if (!filter->audio_delay_reached)
 		filter->audio_delay_reached = true;
@@ -239,6 +478,7 @@ struct obs_source_info async_delay_filter = {
 	.create = async_delay_filter_create,
 	.destroy = async_delay_filter_destroy,
 	.update = async_delay_filter_update,
+	.get_defaults = async_delay_filter_defaults,
 	.get_properties = async_delay_filter_properties,
 	.filter_video = async_delay_filter_video,
 #ifdef DELAY_AUDIO
@@ -0,0 +1,405 @@
+#include <float.h>
+#include <string.h>
+
+#include <media-io/audio-io.h>
+#include <media-io/audio-math.h>
+#include <util/sse-intrin.h>
+
+#include "dynamics-kernels.h"
+
+/* -------------------------------------------------------- */
+
+/* clang-format off */
+
+#define LOG2_E                          1.44269504f
+#define LOG2_10_OVER_20                 0.166096405f
+#define DB_PER_LOG2                     6.02059991f
+
+/* clang-format on */
+
+#define set1 _mm_set1_ps
+
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/* log2 of positive, normal floats; the natural log polynomial is the one of
+ * the cephes logf, relative error around 1e-7 */
+static inline __m128 log2_ps(__m128 x)
+{
+	const __m128 one = set1(1.0f);
+	__m128i bits = _mm_castps_si128(x);
+	__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23),
+					 _mm_set1_epi32(127));
+	__m128i mantissa = _mm_or_si128(
+		_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+		_mm_set1_epi32(0x3f800000));
+	__m128 m = _mm_castsi128_ps(mantissa);
+	__m128 e = _mm_cvtepi32_ps(exponent);
+
+	/* move the mantissa from [1, 2) to [sqrt(0.5), sqrt(2)) */
+	__m128 big = _mm_cmpgt_ps(m, set1(1.41421356f));
+	m = select_ps(big, _mm_mul_ps(m, set1(0.5f)), m);
+	e = _mm_add_ps(e, _mm_and_ps(big, one));
+
+	__m128 t = _mm_sub_ps(m, one);
+	__m128 z = _mm_mul_ps(t, t);
+	__m128 p = set1(7.0376836292e-2f);
+	p = _mm_add_ps(_mm_mul_ps(p, t), set1(-1.1514610310e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), set1(1.1676998740e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), set1(-1.2420140846e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), set1(1.4249322787e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), set1(-1.6668057665e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), set1(2.0000714765e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), set1(-2.4999993993e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), set1(3.3333331174e-1f));
+
+	__m128 y = _mm_mul_ps(_mm_mul_ps(t, z), p);
+	y = _mm_sub_ps(y, _mm_mul_ps(z, set1(0.5f)));
+	y = _mm_add_ps(t, y);
+
+	return _mm_add_ps(_mm_mul_ps(y, set1(LOG2_E)), e);
+}
+
+/* 2^x, with the polynomial of the cephes exp2f; relative error around 2e-7.
+ * x is clamped to the range of normal floats. */
+static inline __m128 exp2_ps(__m128 x)
+{
+	x = _mm_max_ps(_mm_min_ps(x, set1(127.0f)), set1(-126.0f));
+
+	__m128i n = _mm_cvtps_epi32(x);
+	__m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(n));
+
+	__m128 p = set1(1.535336188319500e-4f);
+	p = _mm_add_ps(_mm_mul_ps(p, f), set1(1.339887440266574e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), set1(9.618437357674640e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), set1(5.550332471162809e-2f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), set1(2.402264791363012e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), set1(6.931472028550421e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), set1(1.0f));
+
+	__m128i scale = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)),
+				       23);
+	return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+}
+
+/* -------------------------------------------------------- */
+/* envelope followers                                        */
+
+/* Channels are processed four at a time, one per lane.  Four samples of each
+ * channel are loaded and transposed so each vector holds one sample of all
+ * four channels, then transposed back after the recursion. */
+
+static inline size_t get_active_planes(float **active, float **samples,
+				       size_t num_channels)
+{
+	size_t num_active = 0;
+
+	for (size_t c = 0; c < num_channels && c < MAX_AUDIO_CHANNELS; c++) {
+		if (samples[c])
+			active[num_active++] = samples[c];
+	}
+
+	/* unused lanes duplicate the first channel of their group, which
+	 * leaves the maximum of the group unchanged */
+	for (size_t c = num_active; c % 4 != 0; c++)
+		active[c] = active[c - c % 4];
+
+	return num_active;
+}
+
+static inline __m128 follow_peak(__m128 env, __m128 env_in, __m128 attack,
+				 __m128 release)
+{
+	__m128 rising = _mm_cmplt_ps(env, env_in);
+	__m128 gain = select_ps(rising, attack, release);
+	return _mm_add_ps(env_in, _mm_mul_ps(gain, _mm_sub_ps(env, env_in)));
+}
+
+static void peak_envelope_x4(float *envelope, float **planes,
+			     size_t num_samples, float start_env,
+			     float attack_gain, float release_gain)
+{
+	const __m128 attack = set1(attack_gain);
+	const __m128 release = set1(release_gain);
+	const __m128 sign = set1(-0.f);
+	__m128 env = set1(start_env);
+	size_t i = 0;
+
+	for (; i + 3 < num_samples; i += 4) {
+		__m128 in0 = _mm_loadu_ps(planes[0] + i);
+		__m128 in1 = _mm_loadu_ps(planes[1] + i);
+		__m128 in2 = _mm_loadu_ps(planes[2] + i);
+		__m128 in3 = _mm_loadu_ps(planes[3] + i);
+		__m128 e0, e1, e2, e3;
+
+		_MM_TRANSPOSE4_PS(in0, in1, in2, in3);
+
+		e0 = env = follow_peak(env, _mm_andnot_ps(sign, in0), attack,
+				       release);
+		e1 = env = follow_peak(env, _mm_andnot_ps(sign, in1), attack,
+				       release);
+		e2 = env = follow_peak(env, _mm_andnot_ps(sign, in2), attack,
+				       release);
+		e3 = env = follow_peak(env, _mm_andnot_ps(sign, in3), attack,
+				       release);
+
+		_MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+
+		__m128 max = _mm_max_ps(_mm_max_ps(e0, e1), _mm_max_ps(e2, e3));
+		max = _mm_max_ps(max, _mm_loadu_ps(envelope + i));
+		_mm_storeu_ps(envelope + i, max);
+	}
+
+	float env_mem[4];
+	_mm_storeu_ps(env_mem, env);
+
+	for (; i < num_samples; i++) {
+		for (size_t lane = 0; lane < 4; lane++) {
+			const float env_in = fabsf(planes[lane][i]);
+			float e = env_mem[lane];
+
+			if (e < env_in)
+				e = env_in + attack_gain * (e - env_in);
+			else
+				e = env_in + release_gain * (e - env_in);
+
+			env_mem[lane] = e;
+			envelope[i] = fmaxf(envelope[i], e);
+		}
+	}
+}
+
+void dynamics_peak_envelope(float *envelope, float **samples,
+			    size_t num_channels, size_t num_samples,
+			    float start_env, float attack_gain,
+			    float release_gain)
+{
+	float *active[MAX_AUDIO_CHANNELS + 3];
+	size_t num_active = get_active_planes(active, samples, num_channels);
+
+	memset(envelope, 0, num_samples * sizeof(envelope[0]));
+
+	for (size_t c = 0; c < num_active; c += 4)
+		peak_envelope_x4(envelope, active + c, num_samples, start_env,
+				 attack_gain, release_gain);
+}
+
+static inline __m128 follow_rms(__m128 runave, __m128 x, __m128 coef,
+				__m128 coef_in)
+{
+	return _mm_add_ps(_mm_mul_ps(coef, runave),
+			  _mm_mul_ps(coef_in, _mm_mul_ps(x, x)));
+}
+
+static void rms_envelope_x4(float **envelope, float **planes, float *runave,
+			    size_t lanes, size_t num_samples, float rmscoef)
+{
+	const __m128 coef = set1(rmscoef);
+	const __m128 coef_in = set1(1 - rmscoef);
+	float ave_mem[4] = {0};
+	__m128 ave;
+	size_t i = 0;
+
+	for (size_t lane = 0; lane < lanes; lane++)
+		ave_mem[lane] = runave[lane];
+	ave = _mm_loadu_ps(ave_mem);
+
+	for (; i + 3 < num_samples; i += 4) {
+		__m128 in0 = _mm_loadu_ps(planes[0] + i);
+		__m128 in1 = _mm_loadu_ps(planes[1] + i);
+		__m128 in2 = _mm_loadu_ps(planes[2] + i);
+		__m128 in3 = _mm_loadu_ps(planes[3] + i);
+		__m128 e0, e1, e2, e3;
+
+		_MM_TRANSPOSE4_PS(in0, in1, in2, in3);
+
+		e0 = ave = follow_rms(ave, in0, coef, coef_in);
+		e1 = ave = follow_rms(ave, in1, coef, coef_in);
+		e2 = ave = follow_rms(ave, in2, coef, coef_in);
+		e3 = ave = follow_rms(ave, in3, coef, coef_in);
+
+		_MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+
+		if (lanes > 0)
+			_mm_storeu_ps(envelope[0] + i, _mm_sqrt_ps(e0));
+		if (lanes > 1)
+			_mm_storeu_ps(envelope[1] + i, _mm_sqrt_ps(e1));
+		if (lanes > 2)
+			_mm_storeu_ps(envelope[2] + i, _mm_sqrt_ps(e2));
+		if (lanes > 3)
+			_mm_storeu_ps(envelope[3] + i, _mm_sqrt_ps(e3));
+	}
+
+	_mm_storeu_ps(ave_mem, ave);
+
+	for (; i < num_samples; i++) {
+		for (size_t lane = 0; lane < lanes; lane++) {
+			const float x = planes[lane][i];
+
+			ave_mem[lane] = rmscoef * ave_mem[lane] +
+					(1 - rmscoef) * (x * x);
+			envelope[lane][i] = sqrtf(ave_mem[lane]);
+		}
+	}
+
+	for (size_t lane = 0; lane < lanes; lane++)
+		runave[lane] = ave_mem[lane];
+}
+
+void dynamics_rms_envelope(float **envelope, float **samples, float *runave,
+			   size_t num_channels, size_t num_samples,
+			   float rmscoef)
+{
+	size_t channels[MAX_AUDIO_CHANNELS];
+	size_t num_active = 0;
+
+	for (size_t c = 0; c < num_channels && c < MAX_AUDIO_CHANNELS; c++) {
+		if (samples[c])
+			channels[num_active++] = c;
+	}
+
+	for (size_t first = 0; first < num_active; first += 4) {
+		size_t lanes = num_active - first < 4 ? num_active - first : 4;
+		float *planes[4];
+		float *envelopes[4];
+		float aves[4];
+
+		for (size_t lane = 0; lane < 4; lane++) {
+			size_t c = channels[first + (lane < lanes ? lane : 0)];
+
+			planes[lane] = samples[c];
+			envelopes[lane] = envelope[c];
+			aves[lane] = runave[c];
+		}
+
+		rms_envelope_x4(envelopes, planes, aves, lanes, num_samples,
+				rmscoef);
+
+		for (size_t lane = 0; lane < lanes; lane++)
+			runave[channels[first + lane]] = aves[lane];
+	}
+}
+
+/* -------------------------------------------------------- */
+/* gain computation                                          */
+
+void dynamics_compress(float **samples, const float *envelope,
+		       size_t num_channels, size_t num_samples,
+		       float threshold, float slope, float output_gain)
+{
+	/* min(0, slope * (threshold - env_db)) in dB is
+	 * min(0, slope * (log2(threshold) - log2(env))) in log2 units */
+	const __m128 thr_mul = set1(db_to_mul(threshold));
+	const __m128 thr_log2 = set1(threshold * LOG2_10_OVER_20);
+	const __m128 slope_v = set1(slope);
+	const __m128 out_gain = set1(output_gain);
+	const __m128 min_env = set1(FLT_MIN);
+	const __m128 zero = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 3 < num_samples; i += 4) {
+		__m128 env = _mm_loadu_ps(envelope + i);
+		__m128 gain = out_gain;
+
+		/* nothing to do while the envelope is below the threshold */
+		if (_mm_movemask_ps(_mm_cmpgt_ps(env, thr_mul)) != 0) {
+			__m128 env_log2 = log2_ps(_mm_max_ps(env, min_env));
+			__m128 gain_log2 = _mm_mul_ps(
+				slope_v, _mm_sub_ps(thr_log2, env_log2));
+
+			gain_log2 = _mm_min_ps(gain_log2, zero);
+			gain = _mm_mul_ps(exp2_ps(gain_log2), out_gain);
+		}
+
+		for (size_t c = 0; c < num_channels; c++) {
+			if (!samples[c])
+				continue;
+
+			__m128 s = _mm_loadu_ps(samples[c] + i);
+			_mm_storeu_ps(samples[c] + i, _mm_mul_ps(s, gain));
+		}
+	}
+
+	for (; i < num_samples; i++) {
+		const float env_db = mul_to_db(envelope[i]);
+		float gain = slope * (threshold - env_db);
+		gain = db_to_mul(fminf(0, gain));
+
+		for (size_t c = 0; c < num_channels; c++) {
+			if (samples[c])
+				samples[c][i] *= gain * output_gain;
+		}
+	}
+}
+
+static inline float expander_gain(float env, float threshold, float slope)
+{
+	float env_db = mul_to_db(env);
+	return threshold - env_db > 0.0f
+		       ? fmaxf(slope * (threshold - env_db), -60.0f)
+		       : 0.0f;
+}
+
+void dynamics_expander_gain(float *gain_db, const float *envelope,
+			    size_t num_samples, float threshold, float slope)
+{
+	const __m128 thr_mul = set1(db_to_mul(threshold));
+	const __m128 thr = set1(threshold);
+	const __m128 slope_v = set1(slope);
+	const __m128 db_per_log2 = set1(DB_PER_LOG2);
+	const __m128 min_env = set1(FLT_MIN);
+	const __m128 min_gain = set1(-60.0f);
+	const __m128 zero = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 3 < num_samples; i += 4) {
+		__m128 env = _mm_loadu_ps(envelope + i);
+
+		/* nothing to do while the envelope is above the threshold */
+		if (_mm_movemask_ps(_mm_cmplt_ps(env, thr_mul)) == 0) {
+			_mm_storeu_ps(gain_db + i, zero);
+			continue;
+		}
+
+		__m128 env_db = _mm_mul_ps(
+			log2_ps(_mm_max_ps(env, min_env)), db_per_log2);
+		__m128 diff = _mm_sub_ps(thr, env_db);
+		__m128 gain = _mm_max_ps(_mm_mul_ps(slope_v, diff), min_gain);
+
+		gain = _mm_and_ps(_mm_cmpgt_ps(diff, zero), gain);
+
+		/* silence is -inf dB, which always gives the minimum gain */
+		gain = select_ps(_mm_cmpeq_ps(env, zero), min_gain, gain);
+
+		_mm_storeu_ps(gain_db + i, gain);
+	}
+
+	for (; i < num_samples; i++)
+		gain_db[i] = expander_gain(envelope[i], threshold, slope);
+}
+
+void dynamics_apply_gain_db(float *samples, const float *gain_db,
+			    size_t num_samples, float output_gain)
+{
+	const __m128 out_gain = set1(output_gain);
+	const __m128 to_log2 = set1(LOG2_10_OVER_20);
+	const __m128 zero = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 3 < num_samples; i += 4) {
+		__m128 g = _mm_min_ps(_mm_loadu_ps(gain_db + i), zero);
+		__m128 gain = out_gain;
+
+		if (_mm_movemask_ps(_mm_cmplt_ps(g, zero)) != 0)
+			gain = _mm_mul_ps(exp2_ps(_mm_mul_ps(g, to_log2)),
+					  out_gain);
+
+		__m128 s = _mm_loadu_ps(samples + i);
+		_mm_storeu_ps(samples + i, _mm_mul_ps(s, gain));
+	}
+
+	for (; i < num_samples; i++)
+		samples[i] *= db_to_mul(fminf(0, gain_db[i])) * output_gain;
+}
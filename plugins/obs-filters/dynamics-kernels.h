@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Block processing kernels shared by the compressor, limiter and expander
+ * filters.  Envelope followers run all channels side by side in SSE lanes and
+ * give the same results as the per-sample scalar loops.  Gains are computed
+ * with vectorized log2/exp2 approximations whose error stays below
+ * DYNAMICS_MAX_GAIN_ERROR_DB. */
+
+#define DYNAMICS_MAX_GAIN_ERROR_DB 0.0001f
+
+/* Peak envelope follower of every non-NULL channel, each starting at
+ * start_env.  envelope receives the maximum of all channels per sample. */
+extern void dynamics_peak_envelope(float *envelope, float **samples,
+				   size_t num_channels, size_t num_samples,
+				   float start_env, float attack_gain,
+				   float release_gain);
+
+/* Running RMS of every non-NULL channel.  runave holds the running mean
+ * square of each channel and is updated to the last sample. */
+extern void dynamics_rms_envelope(float **envelope, float **samples,
+				  float *runave, size_t num_channels,
+				  size_t num_samples, float rmscoef);
+
+/* Downward compression of all non-NULL channels:
+ * gain = min(0, slope * (threshold - envelope)) dB, times output_gain */
+extern void dynamics_compress(float **samples, const float *envelope,
+			      size_t num_channels, size_t num_samples,
+			      float threshold, float slope, float output_gain);
+
+/* Target gain in dB of the expander before its attack/release ballistics:
+ * max(slope * (threshold - envelope), -60) dB below the threshold, else 0 */
+extern void dynamics_expander_gain(float *gain_db, const float *envelope,
+				   size_t num_samples, float threshold,
+				   float slope);
+
+/* samples *= db_to_mul(min(0, gain_db)) * output_gain */
+extern void dynamics_apply_gain_db(float *samples, const float *gain_db,
+				   size_t num_samples, float output_gain);
+
+#ifdef __cplusplus
+}
+#endif
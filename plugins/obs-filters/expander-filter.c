@@ -8,6 +8,8 @@
 #include <util/circlebuf.h>
 #include <util/threading.h>
 
+#include "dynamics-kernels.h"
+
 /* -------------------------------------------------------- */
 
 #define do_log(level, format, ...)              \
@@ -85,13 +87,9 @@ struct expander_data {
 	int detector;
 	float runave[MAX_AUDIO_CHANNELS];
 	bool is_gate;
-	float *runaverage[MAX_AUDIO_CHANNELS];
-	size_t runaverage_len;
 	float *gaindB[MAX_AUDIO_CHANNELS];
 	size_t gaindB_len;
 	float gaindB_buf[MAX_AUDIO_CHANNELS];
-	float *env_in;
-	size_t env_in_len;
 };
 
 enum { RMS_DETECT,
@@ -110,20 +108,6 @@ static void resize_env_buffer(struct expander_data *cd, size_t len)
 				 cd->envelope_buf_len * sizeof(float));
 }
 
-static void resize_runaverage_buffer(struct expander_data *cd, size_t len)
-{
-	cd->runaverage_len = len;
-	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++)
-		cd->runaverage[i] = brealloc(
-			cd->runaverage[i], cd->runaverage_len * sizeof(float));
-}
-
-static void resize_env_in_buffer(struct expander_data *cd, size_t len)
-{
-	cd->env_in_len = len;
-	cd->env_in = brealloc(cd->env_in, cd->env_in_len * sizeof(float));
-}
-
 static void resize_gaindB_buffer(struct expander_data *cd, size_t len)
 {
 	cd->gaindB_len = len;
@@ -208,10 +192,6 @@ static void expander_update(void *data, obs_data_t *s)
 	size_t sample_len = sample_rate * DEFAULT_AUDIO_BUF_MS / MS_IN_S;
 	if (cd->envelope_buf_len == 0)
 		resize_env_buffer(cd, sample_len);
-	if (cd->runaverage_len == 0)
-		resize_runaverage_buffer(cd, sample_len);
-	if (cd->env_in_len == 0)
-		resize_env_in_buffer(cd, sample_len);
 	if (cd->gaindB_len == 0)
 		resize_gaindB_buffer(cd, sample_len);
 }
@@ -240,10 +220,8 @@ static void expander_destroy(void *data)
 
 	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++) {
 		bfree(cd->envelope_buf[i]);
-		bfree(cd->runaverage[i]);
 		bfree(cd->gaindB[i]);
 	}
-	bfree(cd->env_in);
 	bfree(cd);
 }
 
@@ -253,53 +231,35 @@ static void analyze_envelope(struct expander_data *cd, float **samples,
 {
 	if (cd->envelope_buf_len < num_samples)
 		resize_env_buffer(cd, num_samples);
-	if (cd->runaverage_len < num_samples)
-		resize_runaverage_buffer(cd, num_samples);
-	if (cd->env_in_len < num_samples)
-		resize_env_in_buffer(cd, num_samples);
 
 	// 10 ms RMS window
 	const float rmscoef = exp2f(-100.0f / cd->sample_rate);
 
-	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++) {
+	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++)
 		memset(cd->envelope_buf[i], 0,
 		       num_samples * sizeof(cd->envelope_buf[i][0]));
-		memset(cd->runaverage[i], 0,
-		       num_samples * sizeof(cd->runaverage[i][0]));
-	}
-	memset(cd->env_in, 0, num_samples * sizeof(cd->env_in[0]));
 
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!samples[chan])
-			continue;
-
-		float *envelope_buf = cd->envelope_buf[chan];
-		float *runave = cd->runaverage[chan];
-		float *env_in = cd->env_in;
-
-		if (cd->detector == RMS_DETECT) {
-			runave[0] =
-				rmscoef * cd->runave[chan] +
-				(1 - rmscoef) * powf(samples[chan][0], 2.0f);
-			env_in[0] = sqrtf(fmaxf(runave[0], 0));
-			for (uint32_t i = 1; i < num_samples; ++i) {
-				runave[i] =
-					rmscoef * runave[i - 1] +
-					(1 - rmscoef) *
-						powf(samples[chan][i], 2.0f);
-				env_in[i] = sqrtf(runave[i]);
-			}
-		} else if (cd->detector == PEAK_DETECT) {
-			for (uint32_t i = 0; i < num_samples; ++i) {
-				runave[i] = powf(samples[chan][i], 2);
-				env_in[i] = fabsf(samples[chan][i]);
-			}
+	if (cd->detector == RMS_DETECT) {
+		dynamics_rms_envelope(cd->envelope_buf, samples, cd->runave,
+				      cd->num_channels, num_samples, rmscoef);
+	} else if (cd->detector == PEAK_DETECT) {
+		for (size_t chan = 0; chan < cd->num_channels; ++chan) {
+			if (!samples[chan])
+				continue;
+
+			float *envelope_buf = cd->envelope_buf[chan];
+			for (uint32_t i = 0; i < num_samples; ++i)
+				envelope_buf[i] = fabsf(samples[chan][i]);
+
+			const float last = samples[chan][num_samples - 1];
+			cd->runave[chan] = last * last;
 		}
+	}
 
-		cd->runave[chan] = runave[num_samples - 1];
-		for (uint32_t i = 0; i < num_samples; ++i)
-			envelope_buf[i] = fmaxf(envelope_buf[i], env_in[i]);
-		cd->envelope[chan] = cd->envelope_buf[chan][num_samples - 1];
+	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
+		if (samples[chan])
+			cd->envelope[chan] =
+				cd->envelope_buf[chan][num_samples - 1];
 	}
 }
 
@@ -312,50 +272,34 @@ static inline void process_expansion(struct expander_data *cd, float **samples,
 
 	if (cd->gaindB_len < num_samples)
 		resize_gaindB_buffer(cd, num_samples);
-	for (int i = 0; i < MAX_AUDIO_CHANNELS; i++)
-		memset(cd->gaindB[i], 0,
-		       num_samples * sizeof(cd->gaindB[i][0]));
 
 	for (size_t chan = 0; chan < cd->num_channels; chan++) {
+		float *gaindB = cd->gaindB[chan];
+		float prev_gain = cd->gaindB_buf[chan];
+
+		// gain stage of expansion
+		dynamics_expander_gain(gaindB, cd->envelope_buf[chan],
+				       num_samples, cd->threshold, cd->slope);
+
+		// ballistics (attack/release)
 		for (size_t i = 0; i < num_samples; ++i) {
-			// gain stage of expansion
-			float env_db = mul_to_db(cd->envelope_buf[chan][i]);
-			float gain =
-				cd->threshold - env_db > 0.0f
-					? fmaxf(cd->slope * (cd->threshold -
-							     env_db),
-						-60.0f)
-					: 0.0f;
-			// ballistics (attack/release)
-			if (i > 0) {
-				if (gain > cd->gaindB[chan][i - 1])
-					cd->gaindB[chan][i] =
-						attack_gain *
-							cd->gaindB[chan][i - 1] +
-						(1.0f - attack_gain) * gain;
-				else
-					cd->gaindB[chan][i] =
-						release_gain *
-							cd->gaindB[chan][i - 1] +
-						(1.0f - release_gain) * gain;
-			} else {
-				if (gain > cd->gaindB_buf[chan])
-					cd->gaindB[chan][i] =
-						attack_gain *
-							cd->gaindB_buf[chan] +
-						(1.0f - attack_gain) * gain;
-				else
-					cd->gaindB[chan][i] =
-						release_gain *
-							cd->gaindB_buf[chan] +
-						(1.0f - release_gain) * gain;
-			}
-
-			gain = db_to_mul(fminf(0, cd->gaindB[chan][i]));
-			if (samples[chan])
-				samples[chan][i] *= gain * cd->output_gain;
+			const float gain = gaindB[i];
+
+			if (gain > prev_gain)
+				prev_gain = attack_gain * prev_gain +
+					    (1.0f - attack_gain) * gain;
+			else
+				prev_gain = release_gain * prev_gain +
+					    (1.0f - release_gain) * gain;
+
+			gaindB[i] = prev_gain;
 		}
-		cd->gaindB_buf[chan] = cd->gaindB[chan][num_samples - 1];
+
+		cd->gaindB_buf[chan] = prev_gain;
+
+		if (samples[chan])
+			dynamics_apply_gain_db(samples[chan], gaindB,
+					       num_samples, cd->output_gain);
 	}
 }
 
@@ -16,7 +16,6 @@
 
 struct gain_data {
 	obs_source_t *context;
-	size_t channels;
 	float multiple;
 };
 
@@ -36,7 +35,6 @@ static void gain_update(void *data, obs_data_t *s)
 {
 	struct gain_data *gf = data;
 	double val = obs_data_get_double(s, S_GAIN_DB);
-	gf->channels = audio_output_get_channels(obs_get_audio());
 	gf->multiple = db_to_mul((float)val);
 }
 
@@ -48,23 +46,10 @@ static void *gain_create(obs_data_t *settings, obs_source_t *filter)
 	return gf;
 }
 
-static struct obs_audio_data *gain_filter_audio(void *data,
-						struct obs_audio_data *audio)
+static float gain_get_audio_gain(void *data)
 {
 	struct gain_data *gf = data;
-	const size_t channels = gf->channels;
-	float **adata = (float **)audio->data;
-	const float multiple = gf->multiple;
-
-	for (size_t c = 0; c < channels; c++) {
-		if (audio->data[c]) {
-			for (size_t i = 0; i < audio->frames; i++) {
-				adata[c][i] *= multiple;
-			}
-		}
-	}
-
-	return audio;
+	return gf->multiple;
 }
 
 static void gain_defaults(obs_data_t *s)
@@ -92,7 +77,7 @@ struct obs_source_info gain_filter = {
 	.create = gain_create,
 	.destroy = gain_destroy,
 	.update = gain_update,
-	.filter_audio = gain_filter_audio,
+	.get_audio_gain = gain_get_audio_gain,
 	.get_defaults = gain_defaults,
 	.get_properties = gain_properties,
 };
@@ -17,25 +17,10 @@ static void *invert_polarity_create(obs_data_t *settings, obs_source_t *filter)
 	return filter;
 }
 
-static struct obs_audio_data *
-invert_polarity_filter_audio(void *unused, struct obs_audio_data *audio)
+static float invert_polarity_get_audio_gain(void *unused)
 {
-	float **adata = (float **)audio->data;
-
-	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
-		register float *channel_data = adata[c];
-		register float *channel_end = channel_data + audio->frames;
-
-		if (!channel_data)
-			break;
-
-		while (channel_data < channel_end) {
-			*(channel_data++) *= -1.0f;
-		}
-	}
-
 	UNUSED_PARAMETER(unused);
-	return audio;
+	return -1.0f;
 }
 
 struct obs_source_info invert_polarity_filter = {
@@ -45,5 +30,5 @@ struct obs_source_info invert_polarity_filter = {
 	.get_name = invert_polarity_name,
 	.create = invert_polarity_create,
 	.destroy = invert_polarity_destroy,
-	.filter_audio = invert_polarity_filter_audio,
+	.get_audio_gain = invert_polarity_get_audio_gain,
 };
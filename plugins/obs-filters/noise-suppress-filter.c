@@ -2,6 +2,9 @@
 #include <inttypes.h>
 
 #include <util/circlebuf.h>
+#include <util/platform.h>
+#include <util/sse-intrin.h>
+#include <util/threading.h>
 #include <obs-module.h>
 
 #ifdef LIBSPEEXDSP_ENABLED
@@ -53,6 +56,8 @@
 /* If the following constant changes, RNNoise breaks */
 #define BUFFER_SIZE_MSEC 10
 
+#define RNN_MAX_WORKERS 7
+
 /* -------------------------------------------------------- */
 
 struct noise_suppress_data {
@@ -64,6 +69,7 @@ struct noise_suppress_data {
 
 	size_t frames;
 	size_t channels;
+	size_t max_segments;
 
 	struct circlebuf info_buffer;
 	struct circlebuf input_buffers[MAX_PREPROC_CHANNELS];
@@ -83,6 +89,14 @@ struct noise_suppress_data {
 	/* Resampler */
 	audio_resampler_t *rnn_resampler;
 	audio_resampler_t *rnn_resampler_back;
+
+	/* delay of the resamplers, added to the latency */
+	uint64_t resampler_latency;
+
+	/* channels are denoised in parallel on the shared worker pool */
+	bool uses_pool;
+	os_event_t *rnn_done;
+	volatile long rnn_remaining;
 #endif
 
 	/* PCM buffers */
@@ -109,6 +123,248 @@ static const float c_16_to_32 = ((float)INT16_MAX + 1.0f);
 
 /* -------------------------------------------------------- */
 
+static void scale_samples(float *dst, const float *src, size_t count,
+			  float scale)
+{
+	const __m128 scale_v = _mm_set1_ps(scale);
+	size_t i = 0;
+
+	for (; i + 3 < count; i += 4) {
+		__m128 v = _mm_loadu_ps(src + i);
+		_mm_storeu_ps(dst + i, _mm_mul_ps(v, scale_v));
+	}
+	for (; i < count; i++)
+		dst[i] = src[i] * scale;
+}
+
+#ifdef LIBSPEEXDSP_ENABLED
+/* clamps to [-1, 1] and truncates, like the scalar conversion */
+static void float_to_s16(spx_int16_t *dst, const float *src, size_t count)
+{
+	const __m128 max = _mm_set1_ps(1.0f);
+	const __m128 min = _mm_set1_ps(-1.0f);
+	const __m128 scale = _mm_set1_ps(c_32_to_16);
+	size_t i = 0;
+
+	for (; i + 7 < count; i += 8) {
+		__m128 lo = _mm_loadu_ps(src + i);
+		__m128 hi = _mm_loadu_ps(src + i + 4);
+
+		lo = _mm_mul_ps(_mm_max_ps(_mm_min_ps(lo, max), min), scale);
+		hi = _mm_mul_ps(_mm_max_ps(_mm_min_ps(hi, max), min), scale);
+
+		__m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(lo),
+						 _mm_cvttps_epi32(hi));
+		_mm_storeu_si128((__m128i *)(dst + i), packed);
+	}
+	for (; i < count; i++) {
+		float s = src[i];
+		if (s > 1.0f)
+			s = 1.0f;
+		else if (s < -1.0f)
+			s = -1.0f;
+		dst[i] = (spx_int16_t)(s * c_32_to_16);
+	}
+}
+
+static void s16_to_float(float *dst, const spx_int16_t *src, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / c_16_to_32);
+	size_t i = 0;
+
+	for (; i + 7 < count; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(dst + i + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+	for (; i < count; i++)
+		dst[i] = (float)src[i] / c_16_to_32;
+}
+#endif
+
+/* -------------------------------------------------------- */
+
+#ifdef LIBRNNOISE_ENABLED
+/* RNNoise frames of one channel, which have to be processed in order */
+struct rnn_job {
+	DenoiseState *state;
+	float *frames;
+	size_t num_frames;
+	struct noise_suppress_data *ng;
+};
+
+/* Worker threads shared by all noise suppression filters, started with the
+ * first multi-channel filter and stopped when the last one is destroyed. */
+struct rnn_pool {
+	pthread_t threads[RNN_MAX_WORKERS];
+	size_t num_threads;
+	os_sem_t *sem;
+	volatile bool stop;
+};
+
+static pthread_mutex_t rnn_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t rnn_jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct rnn_job) rnn_jobs = {0};
+static struct rnn_pool *rnn_pool = NULL;
+static long rnn_pool_users = 0;
+
+static void run_rnn_job(struct rnn_job *job)
+{
+	struct noise_suppress_data *ng = job->ng;
+
+	for (size_t i = 0; i < job->num_frames; i++) {
+		float *frame = job->frames + i * RNNOISE_FRAME_SIZE;
+		rnnoise_process_frame(job->state, frame, frame);
+	}
+
+	if (os_atomic_dec_long(&ng->rnn_remaining) == 0)
+		os_event_signal(ng->rnn_done);
+}
+
+/* takes a queued job, only of the given filter if ng is not NULL */
+static bool take_rnn_job(struct noise_suppress_data *ng, struct rnn_job *job)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&rnn_jobs_mutex);
+	for (size_t i = 0; i < rnn_jobs.num; i++) {
+		if (ng && rnn_jobs.array[i].ng != ng)
+			continue;
+
+		*job = rnn_jobs.array[i];
+		da_erase(rnn_jobs, i);
+		found = true;
+		break;
+	}
+	pthread_mutex_unlock(&rnn_jobs_mutex);
+
+	return found;
+}
+
+static void *rnn_worker_thread(void *data)
+{
+	struct rnn_pool *pool = data;
+	struct rnn_job job;
+
+	os_set_thread_name("noise suppress: rnnoise worker");
+
+	while (os_sem_wait(pool->sem) == 0) {
+		if (os_atomic_load_bool(&pool->stop))
+			break;
+		if (take_rnn_job(NULL, &job))
+			run_rnn_job(&job);
+	}
+
+	return NULL;
+}
+
+static void rnn_pool_free(struct rnn_pool *pool)
+{
+	os_atomic_set_bool(&pool->stop, true);
+	for (size_t i = 0; i < pool->num_threads; i++)
+		os_sem_post(pool->sem);
+	for (size_t i = 0; i < pool->num_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	os_sem_destroy(pool->sem);
+	bfree(pool);
+}
+
+static struct rnn_pool *rnn_pool_create(void)
+{
+	struct rnn_pool *pool = bzalloc(sizeof(*pool));
+	int cores = os_get_logical_cores();
+	size_t num_threads = cores > 1 ? (size_t)cores - 1 : 1;
+
+	if (num_threads > RNN_MAX_WORKERS)
+		num_threads = RNN_MAX_WORKERS;
+
+	if (os_sem_init(&pool->sem, 0) != 0) {
+		bfree(pool);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < num_threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL, rnn_worker_thread,
+				   pool) != 0)
+			break;
+		pool->num_threads++;
+	}
+
+	if (!pool->num_threads) {
+		rnn_pool_free(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+static void rnn_pool_acquire(void)
+{
+	pthread_mutex_lock(&rnn_pool_mutex);
+	if (rnn_pool_users++ == 0) {
+		rnn_pool = rnn_pool_create();
+		if (!rnn_pool)
+			blog(LOG_WARNING, "[noise suppress] Failed to start "
+					  "RNNoise worker threads");
+	}
+	pthread_mutex_unlock(&rnn_pool_mutex);
+}
+
+static void rnn_pool_release(void)
+{
+	struct rnn_pool *pool = NULL;
+
+	pthread_mutex_lock(&rnn_pool_mutex);
+	if (--rnn_pool_users == 0) {
+		pool = rnn_pool;
+		rnn_pool = NULL;
+	}
+	pthread_mutex_unlock(&rnn_pool_mutex);
+
+	if (pool) {
+		rnn_pool_free(pool);
+		da_free(rnn_jobs);
+	}
+}
+
+/* Runs the jobs of one filter, spread over the worker pool.  The calling
+ * thread works on its own jobs too and only waits for the ones that the
+ * workers are still busy with. */
+static void run_rnn_jobs(struct noise_suppress_data *ng, struct rnn_job *jobs,
+			 size_t num_jobs)
+{
+	struct rnn_job job;
+
+	os_atomic_set_long(&ng->rnn_remaining, (long)num_jobs);
+
+	if (num_jobs > 1 && ng->uses_pool && rnn_pool) {
+		pthread_mutex_lock(&rnn_jobs_mutex);
+		da_push_back_array(rnn_jobs, jobs + 1, num_jobs - 1);
+		pthread_mutex_unlock(&rnn_jobs_mutex);
+
+		for (size_t i = 1; i < num_jobs; i++)
+			os_sem_post(rnn_pool->sem);
+
+		run_rnn_job(&jobs[0]);
+
+		while (take_rnn_job(ng, &job))
+			run_rnn_job(&job);
+	} else {
+		for (size_t i = 0; i < num_jobs; i++)
+			run_rnn_job(&jobs[i]);
+	}
+
+	os_event_wait(ng->rnn_done);
+}
+#endif
+
+/* -------------------------------------------------------- */
+
 static const char *noise_suppress_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -140,6 +396,10 @@ static void noise_suppress_destroy(void *data)
 		audio_resampler_destroy(ng->rnn_resampler);
 		audio_resampler_destroy(ng->rnn_resampler_back);
 	}
+
+	if (ng->uses_pool)
+		rnn_pool_release();
+	os_event_destroy(ng->rnn_done);
 #endif
 
 	bfree(ng->copy_buffers[0]);
@@ -187,6 +447,30 @@ static inline enum speaker_layout convert_speaker_layout(uint8_t channels)
 	}
 }
 
+/* buffers for the segments processed at once by a single call */
+static void alloc_segment_buffers(struct noise_suppress_data *ng,
+				  size_t segments)
+{
+	size_t frames = ng->frames * segments;
+
+	ng->max_segments = segments;
+	ng->copy_buffers[0] = brealloc(ng->copy_buffers[0],
+				       frames * ng->channels * sizeof(float));
+	for (size_t c = 1; c < ng->channels; ++c)
+		ng->copy_buffers[c] = ng->copy_buffers[c - 1] + frames;
+
+#ifdef LIBRNNOISE_ENABLED
+	size_t rnn_frames = RNNOISE_FRAME_SIZE * segments;
+
+	ng->rnn_segment_buffers[0] =
+		brealloc(ng->rnn_segment_buffers[0],
+			 rnn_frames * ng->channels * sizeof(float));
+	for (size_t c = 1; c < ng->channels; ++c)
+		ng->rnn_segment_buffers[c] =
+			ng->rnn_segment_buffers[c - 1] + rnn_frames;
+#endif
+}
+
 static void noise_suppress_update(void *data, obs_data_t *s)
 {
 	struct noise_suppress_data *ng = data;
@@ -215,31 +499,25 @@ static void noise_suppress_update(void *data, obs_data_t *s)
 #endif
 
 	/* One speex/rnnoise state for each channel (limit 2) */
-	ng->copy_buffers[0] = bmalloc(frames * channels * sizeof(float));
 #ifdef LIBSPEEXDSP_ENABLED
 	ng->spx_segment_buffers[0] =
 		bmalloc(frames * channels * sizeof(spx_int16_t));
-#endif
-#ifdef LIBRNNOISE_ENABLED
-	ng->rnn_segment_buffers[0] =
-		bmalloc(RNNOISE_FRAME_SIZE * channels * sizeof(float));
-#endif
-	for (size_t c = 1; c < channels; ++c) {
-		ng->copy_buffers[c] = ng->copy_buffers[c - 1] + frames;
-#ifdef LIBSPEEXDSP_ENABLED
+	for (size_t c = 1; c < channels; ++c)
 		ng->spx_segment_buffers[c] =
 			ng->spx_segment_buffers[c - 1] + frames;
 #endif
-#ifdef LIBRNNOISE_ENABLED
-		ng->rnn_segment_buffers[c] =
-			ng->rnn_segment_buffers[c - 1] + RNNOISE_FRAME_SIZE;
-#endif
-	}
+	alloc_segment_buffers(ng, 1);
 
 	for (size_t i = 0; i < channels; i++)
 		alloc_channel(ng, sample_rate, i, frames);
 
 #ifdef LIBRNNOISE_ENABLED
+	os_event_init(&ng->rnn_done, OS_EVENT_TYPE_AUTO);
+
+	ng->uses_pool = channels > 1;
+	if (ng->uses_pool)
+		rnn_pool_acquire();
+
 	if (sample_rate == RNNOISE_SAMPLE_RATE) {
 		ng->rnn_resampler = NULL;
 		ng->rnn_resampler_back = NULL;
@@ -269,9 +547,12 @@ static void *noise_suppress_create(obs_data_t *settings, obs_source_t *filter)
 	return ng;
 }
 
-static inline void process_speexdsp(struct noise_suppress_data *ng)
+static inline void process_speexdsp(struct noise_suppress_data *ng,
+				    size_t segment)
 {
 #ifdef LIBSPEEXDSP_ENABLED
+	size_t offset = segment * ng->frames;
+
 	/* Set args */
 	for (size_t i = 0; i < ng->channels; i++)
 		speex_preprocess_ctl(ng->spx_states[i],
@@ -280,15 +561,8 @@ static inline void process_speexdsp(struct noise_suppress_data *ng)
 
 	/* Convert to 16bit */
 	for (size_t i = 0; i < ng->channels; i++)
-		for (size_t j = 0; j < ng->frames; j++) {
-			float s = ng->copy_buffers[i][j];
-			if (s > 1.0f)
-				s = 1.0f;
-			else if (s < -1.0f)
-				s = -1.0f;
-			ng->spx_segment_buffers[i][j] =
-				(spx_int16_t)(s * c_32_to_16);
-		}
+		float_to_s16(ng->spx_segment_buffers[i],
+			     ng->copy_buffers[i] + offset, ng->frames);
 
 	/* Execute */
 	for (size_t i = 0; i < ng->channels; i++)
@@ -297,107 +571,152 @@ static inline void process_speexdsp(struct noise_suppress_data *ng)
 
 	/* Convert back to 32bit */
 	for (size_t i = 0; i < ng->channels; i++)
-		for (size_t j = 0; j < ng->frames; j++)
-			ng->copy_buffers[i][j] =
-				(float)ng->spx_segment_buffers[i][j] /
-				c_16_to_32;
+		s16_to_float(ng->copy_buffers[i] + offset,
+			     ng->spx_segment_buffers[i], ng->frames);
+#else
+	UNUSED_PARAMETER(ng);
+	UNUSED_PARAMETER(segment);
 #endif
 }
 
-static inline void process_rnnoise(struct noise_suppress_data *ng)
+#ifdef LIBRNNOISE_ENABLED
+/* copies the last dst_frames of the resampler output, padding the front with
+ * silence if it returned less */
+static inline void copy_resampled(float *dst, size_t dst_frames,
+				  const float *output, size_t out_frames,
+				  float scale)
+{
+	size_t count = out_frames < dst_frames ? out_frames : dst_frames;
+
+	memset(dst, 0, (dst_frames - count) * sizeof(float));
+	scale_samples(dst + dst_frames - count, output + out_frames - count,
+		      count, scale);
+}
+#endif
+
+static inline void process_rnnoise(struct noise_suppress_data *ng,
+				   size_t segments)
 {
 #ifdef LIBRNNOISE_ENABLED
+	const uint8_t *input[MAX_PREPROC_CHANNELS];
+	float *output[MAX_PREPROC_CHANNELS];
+	struct rnn_job jobs[MAX_PREPROC_CHANNELS];
+	uint32_t out_frames;
+	uint64_t latency_in = 0;
+	uint64_t latency_out = 0;
+
 	/* Adjust signal level to what RNNoise expects, resample if necessary */
-	if (ng->rnn_resampler) {
-		float *output[MAX_PREPROC_CHANNELS];
-		uint32_t out_frames;
-		uint64_t ts_offset;
-		audio_resampler_resample(ng->rnn_resampler, (uint8_t **)output,
-					 &out_frames, &ts_offset,
-					 (const uint8_t **)ng->copy_buffers,
-					 (uint32_t)ng->frames);
-
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (ssize_t j = 0, k = (ssize_t)out_frames -
-						RNNOISE_FRAME_SIZE;
-			     j < RNNOISE_FRAME_SIZE; ++j, ++k) {
-				if (k >= 0) {
-					ng->rnn_segment_buffers[i][j] =
-						output[i][k] * 32768.0f;
-				} else {
-					ng->rnn_segment_buffers[i][j] = 0;
-				}
-			}
-		}
-	} else {
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (size_t j = 0; j < RNNOISE_FRAME_SIZE; ++j) {
-				ng->rnn_segment_buffers[i][j] =
-					ng->copy_buffers[i][j] * 32768.0f;
+	for (size_t seg = 0; seg < segments; seg++) {
+		if (ng->rnn_resampler) {
+			size_t offset = seg * ng->frames;
+
+			for (size_t i = 0; i < ng->channels; i++) {
+				const float *src = ng->copy_buffers[i] + offset;
+				input[i] = (const uint8_t *)src;
 			}
+
+			audio_resampler_resample(ng->rnn_resampler,
+						 (uint8_t **)output,
+						 &out_frames, &latency_in,
+						 input, (uint32_t)ng->frames);
+
+			for (size_t i = 0; i < ng->channels; i++)
+				copy_resampled(ng->rnn_segment_buffers[i] +
+						       seg * RNNOISE_FRAME_SIZE,
+					       RNNOISE_FRAME_SIZE, output[i],
+					       out_frames, 32768.0f);
+		} else {
+			for (size_t i = 0; i < ng->channels; i++)
+				scale_samples(ng->rnn_segment_buffers[i] +
+						      seg * RNNOISE_FRAME_SIZE,
+					      ng->copy_buffers[i] +
+						      seg * ng->frames,
+					      RNNOISE_FRAME_SIZE, 32768.0f);
 		}
 	}
 
-	/* Execute */
+	/* Execute, all segments of a channel in one job */
 	for (size_t i = 0; i < ng->channels; i++) {
-		rnnoise_process_frame(ng->rnn_states[i],
-				      ng->rnn_segment_buffers[i],
-				      ng->rnn_segment_buffers[i]);
+		jobs[i].state = ng->rnn_states[i];
+		jobs[i].frames = ng->rnn_segment_buffers[i];
+		jobs[i].num_frames = segments;
+		jobs[i].ng = ng;
 	}
 
+	run_rnn_jobs(ng, jobs, ng->channels);
+
 	/* Revert signal level adjustment, resample back if necessary */
-	if (ng->rnn_resampler) {
-		float *output[MAX_PREPROC_CHANNELS];
-		uint32_t out_frames;
-		uint64_t ts_offset;
-		audio_resampler_resample(
-			ng->rnn_resampler_back, (uint8_t **)output, &out_frames,
-			&ts_offset, (const uint8_t **)ng->rnn_segment_buffers,
-			RNNOISE_FRAME_SIZE);
-
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (ssize_t j = 0,
-				     k = (ssize_t)out_frames - ng->frames;
-			     j < (ssize_t)ng->frames; ++j, ++k) {
-				if (k >= 0) {
-					ng->copy_buffers[i][j] =
-						output[i][k] / 32768.0f;
-				} else {
-					ng->copy_buffers[i][j] = 0;
-				}
-			}
-		}
-	} else {
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (size_t j = 0; j < RNNOISE_FRAME_SIZE; ++j) {
-				ng->copy_buffers[i][j] =
-					ng->rnn_segment_buffers[i][j] /
-					32768.0f;
+	for (size_t seg = 0; seg < segments; seg++) {
+		if (ng->rnn_resampler) {
+			size_t offset = seg * RNNOISE_FRAME_SIZE;
+
+			for (size_t i = 0; i < ng->channels; i++) {
+				const float *src =
+					ng->rnn_segment_buffers[i] + offset;
+				input[i] = (const uint8_t *)src;
 			}
+
+			audio_resampler_resample(ng->rnn_resampler_back,
+						 (uint8_t **)output,
+						 &out_frames, &latency_out,
+						 input, RNNOISE_FRAME_SIZE);
+
+			for (size_t i = 0; i < ng->channels; i++)
+				copy_resampled(ng->copy_buffers[i] +
+						       seg * ng->frames,
+					       ng->frames, output[i],
+					       out_frames, 1.0f / 32768.0f);
+		} else {
+			for (size_t i = 0; i < ng->channels; i++)
+				scale_samples(ng->copy_buffers[i] +
+						      seg * ng->frames,
+					      ng->rnn_segment_buffers[i] +
+						      seg * RNNOISE_FRAME_SIZE,
+					      RNNOISE_FRAME_SIZE,
+					      1.0f / 32768.0f);
 		}
 	}
+
+	/* samples buffered inside of the resamplers delay the output further */
+	ng->resampler_latency = latency_in + latency_out;
 #else
 	UNUSED_PARAMETER(ng);
+	UNUSED_PARAMETER(segments);
 #endif
 }
 
-static inline void process(struct noise_suppress_data *ng)
+static inline void process(struct noise_suppress_data *ng, size_t segments)
 {
+	size_t size = segments * ng->frames * sizeof(float);
+
+	if (segments > ng->max_segments)
+		alloc_segment_buffers(ng, segments);
+
 	/* Pop from input circlebuf */
 	for (size_t i = 0; i < ng->channels; i++)
 		circlebuf_pop_front(&ng->input_buffers[i], ng->copy_buffers[i],
-				    ng->frames * sizeof(float));
+				    size);
 
 	if (ng->use_rnnoise) {
-		process_rnnoise(ng);
+		process_rnnoise(ng, segments);
 	} else {
-		process_speexdsp(ng);
+		for (size_t seg = 0; seg < segments; seg++)
+			process_speexdsp(ng, seg);
 	}
 
 	/* Push to output circlebuf */
 	for (size_t i = 0; i < ng->channels; i++)
 		circlebuf_push_back(&ng->output_buffers[i], ng->copy_buffers[i],
-				    ng->frames * sizeof(float));
+				    size);
+}
+
+static inline uint64_t get_latency(const struct noise_suppress_data *ng)
+{
+#ifdef LIBRNNOISE_ENABLED
+	if (ng->use_rnnoise && ng->rnn_resampler)
+		return ng->latency + ng->resampler_latency;
+#endif
+	return ng->latency;
 }
 
 struct ng_audio_info {
@@ -426,6 +745,7 @@ noise_suppress_filter_audio(void *data, struct obs_audio_data *audio)
 	struct noise_suppress_data *ng = data;
 	struct ng_audio_info info;
 	size_t segment_size = ng->frames * sizeof(float);
+	size_t segments;
 	size_t out_size;
 
 #ifdef LIBSPEEXDSP_ENABLED
@@ -463,9 +783,11 @@ noise_suppress_filter_audio(void *data, struct obs_audio_data *audio)
 				    audio->frames * sizeof(float));
 
 	/* -----------------------------------------------
-	 * pop/process each 10ms segments, push back to output circlebuf */
-	while (ng->input_buffers[0].size >= segment_size)
-		process(ng);
+	 * pop/process all available 10ms segments at once, push back to
+	 * output circlebuf */
+	segments = ng->input_buffers[0].size / segment_size;
+	if (segments)
+		process(ng, segments);
 
 	/* -----------------------------------------------
 	 * peek front of info circlebuf, check to see if we have enough to
@@ -492,7 +814,7 @@ noise_suppress_filter_audio(void *data, struct obs_audio_data *audio)
 	}
 
 	ng->output_audio.frames = info.frames;
-	ng->output_audio.timestamp = info.timestamp - ng->latency;
+	ng->output_audio.timestamp = info.timestamp - get_latency(ng);
 	return &ng->output_audio;
 }
 
@@ -70,3 +70,65 @@ void obs_x264_free_options(struct obs_x264_options options)
 	bfree(options.ignored_words);
 	strlist_free(options.input_words);
 }
+
+static bool parse_core(const char **str, long *core)
+{
+	char *end;
+
+	if (**str < '0' || **str > '9')
+		return false;
+
+	*core = strtol(*str, &end, 10);
+	*str = end;
+	return *core < OBS_X264_MAX_CORES;
+}
+
+size_t obs_x264_parse_cores(const char *cores_string,
+			    unsigned char mask[OBS_X264_MAX_CORES / 8])
+{
+	const char *str = cores_string;
+	size_t count = 0;
+
+	memset(mask, 0, OBS_X264_MAX_CORES / 8);
+
+	if (!str)
+		return 0;
+
+	while (*str == ' ')
+		str++;
+	if (!*str)
+		return 0;
+
+	for (;;) {
+		long first, last;
+
+		if (!parse_core(&str, &first))
+			goto invalid;
+
+		last = first;
+		if (*str == '-') {
+			str++;
+			if (!parse_core(&str, &last) || last < first)
+				goto invalid;
+		}
+
+		for (long core = first; core <= last; core++) {
+			if (!(mask[core / 8] & (1 << (core % 8))))
+				count++;
+			mask[core / 8] |= (unsigned char)(1 << (core % 8));
+		}
+
+		while (*str == ' ')
+			str++;
+		if (!*str)
+			return count;
+		if (*str++ != ',')
+			goto invalid;
+		while (*str == ' ')
+			str++;
+	}
+
+invalid:
+	memset(mask, 0, OBS_X264_MAX_CORES / 8);
+	return 0;
+}
@@ -17,3 +17,10 @@ struct obs_x264_options {
 
 struct obs_x264_options obs_x264_parse_options(const char *options_string);
 void obs_x264_free_options(struct obs_x264_options options);
+
+#define OBS_X264_MAX_CORES 256
+
+/* Parses a list of CPU cores such as "0-3,8" into a bit mask.  Returns the
+ * number of cores in the list, 0 if it is empty or invalid. */
+size_t obs_x264_parse_cores(const char *cores_string,
+			    unsigned char mask[OBS_X264_MAX_CORES / 8]);
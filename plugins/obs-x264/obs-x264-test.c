@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -67,8 +68,44 @@ static void test_obs_x264_parse_options()
 	obs_x264_free_options(options);
 }
 
+static bool has_core(const unsigned char *mask, int core)
+{
+	return (mask[core / 8] & (1 << (core % 8))) != 0;
+}
+
+static void test_obs_x264_parse_cores()
+{
+	unsigned char mask[OBS_X264_MAX_CORES / 8];
+
+	CHECK(obs_x264_parse_cores(NULL, mask) == 0);
+	CHECK(obs_x264_parse_cores("", mask) == 0);
+	CHECK(obs_x264_parse_cores("  ", mask) == 0);
+
+	CHECK(obs_x264_parse_cores("3", mask) == 1);
+	CHECK(has_core(mask, 3));
+	CHECK(!has_core(mask, 2));
+
+	CHECK(obs_x264_parse_cores("0-3,8, 10-11", mask) == 7);
+	CHECK(has_core(mask, 0) && has_core(mask, 3));
+	CHECK(!has_core(mask, 4) && !has_core(mask, 9));
+	CHECK(has_core(mask, 8) && has_core(mask, 11));
+
+	// Overlapping ranges count each core once.
+	CHECK(obs_x264_parse_cores("0-3,2-5", mask) == 6);
+
+	// Invalid lists select no core at all.
+	CHECK(obs_x264_parse_cores("3-1", mask) == 0);
+	CHECK(!has_core(mask, 1) && !has_core(mask, 3));
+	CHECK(obs_x264_parse_cores("0-3,", mask) == 0);
+	CHECK(obs_x264_parse_cores("a", mask) == 0);
+	CHECK(obs_x264_parse_cores("-1", mask) == 0);
+	CHECK(obs_x264_parse_cores("0-256", mask) == 0);
+	CHECK(obs_x264_parse_cores("0;1", mask) == 0);
+}
+
 int main()
 {
 	test_obs_x264_parse_options();
+	test_obs_x264_parse_cores();
 	return 0;
 }
@@ -15,12 +15,19 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include <util/bmem.h>
 #include <util/dstr.h>
 #include <util/darray.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <obs-module.h>
 #include "obs-x264-options.h"
 
@@ -61,6 +68,16 @@ struct obs_x264 {
 
 	os_performance_token_t *performance_token;
 	bool request_key_frame;
+
+	/* per-rendition statistics, read by the get_stats procedure and
+	 * logged when the encoder is destroyed */
+	pthread_mutex_t stats_mutex;
+	uint64_t encoded_frames;
+	uint64_t total_encode_ns;
+	uint64_t max_encode_ns;
+	uint64_t total_delayed_frames;
+	int delayed_frames;
+	int max_delayed_frames;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -86,14 +103,40 @@ static void clear_data(struct obs_x264 *obsx264)
 	}
 }
 
+static void log_stats(struct obs_x264 *obsx264)
+{
+	uint64_t frames = obsx264->encoded_frames;
+
+	if (!frames)
+		return;
+
+	info("encoded %" PRIu64 " frames at %dx%d, "
+	     "encode time avg/max: %.2f/%.2f ms, "
+	     "lookahead depth avg/max: %.1f/%d frames",
+	     frames, obsx264->params.i_width, obsx264->params.i_height,
+	     (double)obsx264->total_encode_ns / (double)frames / 1000000.0,
+	     (double)obsx264->max_encode_ns / 1000000.0,
+	     (double)obsx264->total_delayed_frames / (double)frames,
+	     obsx264->max_delayed_frames);
+}
+
+static void get_stats_proc(void *data, calldata_t *cd);
+
 static void obs_x264_destroy(void *data)
 {
 	struct obs_x264 *obsx264 = data;
 
 	if (obsx264) {
+		/* the encoder outlives this context across restarts */
+		proc_handler_remove(
+			obs_encoder_get_proc_handler(obsx264->encoder),
+			"get_stats", get_stats_proc, obsx264);
+
+		log_stats(obsx264);
 		os_end_high_performance(obsx264->performance_token);
 		clear_data(obsx264);
 		da_free(obsx264->packet_data);
+		pthread_mutex_destroy(&obsx264->stats_mutex);
 		bfree(obsx264);
 	}
 }
@@ -114,6 +157,7 @@ static void obs_x264_defaults(obs_data_t *settings)
 	obs_data_set_default_string(settings, "profile", "");
 	obs_data_set_default_string(settings, "tune", "");
 	obs_data_set_default_string(settings, "x264opts", "");
+	obs_data_set_default_string(settings, "cpu_cores", "");
 	obs_data_set_default_bool(settings, "repeat_headers", false);
 }
 
@@ -137,6 +181,7 @@ static inline void add_strings(obs_property_t *list, const char *const *strings)
 #define TEXT_TUNE obs_module_text("Tune")
 #define TEXT_NONE obs_module_text("None")
 #define TEXT_X264_OPTS obs_module_text("EncoderOptions")
+#define TEXT_CPU_CORES obs_module_text("CPUCores")
 
 static bool use_bufsize_modified(obs_properties_t *ppts, obs_property_t *p,
 				 obs_data_t *settings)
@@ -228,6 +273,11 @@ static obs_properties_t *obs_x264_props(void *unused)
 	obs_properties_add_text(props, "x264opts", TEXT_X264_OPTS,
 				OBS_TEXT_DEFAULT);
 
+#ifdef __linux__
+	obs_properties_add_text(props, "cpu_cores", TEXT_CPU_CORES,
+				OBS_TEXT_DEFAULT);
+#endif
+
 	headers = obs_properties_add_bool(props, "repeat_headers",
 					  "repeat_headers");
 	obs_property_set_visible(headers, false);
@@ -687,13 +737,84 @@ static void load_headers(struct obs_x264 *obsx264)
 	obsx264->sei_size = sei.num;
 }
 
+/* x264 has no affinity setting, but on Linux the threads it starts in
+ * x264_encoder_open inherit the affinity of the thread that opens it.  Pinning
+ * the renditions of a ladder to separate core sets keeps them from
+ * competing for the same cores. */
+static x264_t *open_encoder(struct obs_x264 *obsx264, const char *cores)
+{
+	unsigned char mask[OBS_X264_MAX_CORES / 8];
+	size_t count = obs_x264_parse_cores(cores, mask);
+
+	if (!count) {
+		if (cores && *cores)
+			warn("invalid CPU core list '%s', not pinning", cores);
+		return x264_encoder_open(&obsx264->params);
+	}
+
+#ifdef __linux__
+	pthread_t self = pthread_self();
+	cpu_set_t old_set;
+	cpu_set_t set;
+	bool pinned = false;
+	x264_t *context;
+
+	CPU_ZERO(&set);
+	for (int core = 0; core < OBS_X264_MAX_CORES; core++) {
+		if (mask[core / 8] & (1 << (core % 8)))
+			CPU_SET(core, &set);
+	}
+
+	if (pthread_getaffinity_np(self, sizeof(old_set), &old_set) == 0)
+		pinned = pthread_setaffinity_np(self, sizeof(set), &set) == 0;
+
+	if (pinned)
+		info("encoder threads pinned to CPU cores %s", cores);
+	else
+		warn("failed to pin encoder threads to CPU cores %s", cores);
+
+	context = x264_encoder_open(&obsx264->params);
+
+	if (pinned)
+		pthread_setaffinity_np(self, sizeof(old_set), &old_set);
+	return context;
+#else
+	warn("pinning encoder threads is only supported on Linux");
+	return x264_encoder_open(&obsx264->params);
+#endif
+}
+
+static void get_stats_proc(void *data, calldata_t *cd)
+{
+	struct obs_x264 *obsx264 = data;
+	double frames;
+
+	pthread_mutex_lock(&obsx264->stats_mutex);
+	frames = obsx264->encoded_frames ? (double)obsx264->encoded_frames
+					 : 1.0;
+
+	calldata_set_int(cd, "frames", (long long)obsx264->encoded_frames);
+	calldata_set_float(cd, "encode_time_avg",
+			   (double)obsx264->total_encode_ns / frames /
+				   1000000.0);
+	calldata_set_float(cd, "encode_time_max",
+			   (double)obsx264->max_encode_ns / 1000000.0);
+	calldata_set_int(cd, "lookahead_depth", obsx264->delayed_frames);
+	calldata_set_float(cd, "lookahead_depth_avg",
+			   (double)obsx264->total_delayed_frames / frames);
+	calldata_set_int(cd, "lookahead_depth_max",
+			 obsx264->max_delayed_frames);
+	pthread_mutex_unlock(&obsx264->stats_mutex);
+}
+
 static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 {
 	struct obs_x264 *obsx264 = bzalloc(sizeof(struct obs_x264));
 	obsx264->encoder = encoder;
 
 	if (update_settings(obsx264, settings, false)) {
-		obsx264->context = x264_encoder_open(&obsx264->params);
+		obsx264->context = open_encoder(
+			obsx264, obs_data_get_string(settings, "cpu_cores"));
 
 		if (obsx264->context == NULL)
 			warn("x264 failed to load");
@@ -708,6 +829,19 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 		return NULL;
 	}
 
+	pthread_mutex_init_value(&obsx264->stats_mutex);
+	pthread_mutex_init(&obsx264->stats_mutex, NULL);
+
+	proc_handler_t *ph = obs_encoder_get_proc_handler(encoder);
+	proc_handler_add(ph,
+			 "void get_stats(out int frames, "
+			 "out float encode_time_avg, "
+			 "out float encode_time_max, "
+			 "out int lookahead_depth, "
+			 "out float lookahead_depth_avg, "
+			 "out int lookahead_depth_max)",
+			 get_stats_proc, obsx264);
+
 	obsx264->performance_token =
 		os_request_high_performance("x264 encoding");
 
@@ -758,6 +892,26 @@ static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic,
 	}
 }
 
+/* lookahead depth is the number of frames x264 holds after the call */
+static inline void update_stats(struct obs_x264 *obsx264, uint64_t encode_ns)
+{
+	int delayed = x264_encoder_delayed_frames(obsx264->context);
+
+	pthread_mutex_lock(&obsx264->stats_mutex);
+
+	obsx264->encoded_frames++;
+	obsx264->total_encode_ns += encode_ns;
+	if (encode_ns > obsx264->max_encode_ns)
+		obsx264->max_encode_ns = encode_ns;
+
+	obsx264->delayed_frames = delayed;
+	obsx264->total_delayed_frames += (uint64_t)delayed;
+	if (delayed > obsx264->max_delayed_frames)
+		obsx264->max_delayed_frames = delayed;
+
+	pthread_mutex_unlock(&obsx264->stats_mutex);
+}
+
 static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 			    struct encoder_packet *packet,
 			    bool *received_packet)
@@ -779,6 +933,8 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 		}
 	}
 
+	uint64_t start_ns = os_gettime_ns();
+
 	ret = x264_encoder_encode(obsx264->context, &nals, &nal_count,
 				  (frame ? &pic : NULL), &pic_out);
 	if (ret < 0) {
@@ -786,6 +942,10 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 		return false;
 	}
 
+	/* flushing (no input frame) is not a frame of the rendition */
+	if (frame)
+		update_stats(obsx264, os_gettime_ns() - start_ns);
+
 	*received_packet = (nal_count != 0);
 	parse_packet(obsx264, packet, nals, nal_count, &pic_out);
 
@@ -26,6 +26,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 FT_Library ft2_lib;
 
+/* faces are created from several threads when sources are created in
+ * parallel, which a single FT_Library does not allow */
+static pthread_mutex_t ft2_lib_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("text-freetype2", "en-US")
 MODULE_EXPORT const char *obs_module_description(void)
@@ -39,7 +43,7 @@ static struct obs_source_info freetype2_source_info_v1 = {
 	.id = "text_ft2_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
-			OBS_SOURCE_CUSTOM_DRAW,
+			OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_PARALLEL_CREATE,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create_v1,
 	.destroy = ft2_source_destroy,
@@ -60,7 +64,7 @@ static struct obs_source_info freetype2_source_info_v2 = {
 #ifdef _WIN32
 			OBS_SOURCE_DEPRECATED |
 #endif
-			OBS_SOURCE_CUSTOM_DRAW,
+			OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_PARALLEL_CREATE,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create_v2,
 	.destroy = ft2_source_destroy,
@@ -78,20 +82,35 @@ static bool plugin_initialized = false;
 
 static void init_plugin(void)
 {
+	pthread_mutex_lock(&ft2_lib_mutex);
+
 	if (plugin_initialized)
-		return;
+		goto unlock;
 
 	FT_Init_FreeType(&ft2_lib);
 
 	if (ft2_lib == NULL) {
 		blog(LOG_WARNING, "FT2-text: Failed to initialize FT2.");
-		return;
+		goto unlock;
 	}
 
 	if (!load_cached_os_font_list())
 		load_os_font_list();
 
 	plugin_initialized = true;
+
+unlock:
+	pthread_mutex_unlock(&ft2_lib_mutex);
+}
+
+static void free_font_face(struct ft2_source *srcdata)
+{
+	if (srcdata->font_face != NULL) {
+		pthread_mutex_lock(&ft2_lib_mutex);
+		FT_Done_Face(srcdata->font_face);
+		pthread_mutex_unlock(&ft2_lib_mutex);
+		srcdata->font_face = NULL;
+	}
 }
 
 bool obs_module_load()
@@ -192,37 +211,27 @@ static void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
-
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	free_font_face(srcdata);
+	free_glyph_atlas(srcdata);
 
 	if (srcdata->font_name != NULL)
 		bfree(srcdata->font_name);
 	if (srcdata->font_style != NULL)
 		bfree(srcdata->font_style);
+	if (srcdata->font_path != NULL)
+		bfree(srcdata->font_path);
 	if (srcdata->text != NULL)
 		bfree(srcdata->text);
-	if (srcdata->texbuf != NULL)
-		bfree(srcdata->texbuf);
 	if (srcdata->colorbuf != NULL)
 		bfree(srcdata->colorbuf);
 	if (srcdata->text_file != NULL)
 		bfree(srcdata->text_file);
 
+	os_file_watch_destroy(srcdata->file_watch);
+	dstr_free(&srcdata->tail);
+
 	obs_enter_graphics();
 
-	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
-		srcdata->tex = NULL;
-	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
@@ -256,6 +265,11 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	if (srcdata->drop_shadow)
 		draw_drop_shadow(srcdata);
 
+	if (srcdata->vbuf_dirty) {
+		gs_vertexbuffer_flush(srcdata->vbuf);
+		srcdata->vbuf_dirty = false;
+	}
+
 	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect,
 			(uint32_t)wcslen(srcdata->text) * 6);
 
@@ -273,12 +287,11 @@ static void ft2_video_tick(void *data, float seconds)
 		return;
 
 	if (os_gettime_ns() - srcdata->last_checked >= 1000000000) {
-		time_t t = get_modified_timestamp(srcdata->text_file);
 		srcdata->last_checked = os_gettime_ns();
 
 		if (srcdata->update_file) {
 			if (srcdata->log_mode)
-				read_from_end(srcdata, srcdata->text_file);
+				tail_file(srcdata, srcdata->text_file);
 			else
 				load_text_from_file(srcdata,
 						    srcdata->text_file);
@@ -287,10 +300,8 @@ static void ft2_video_tick(void *data, float seconds)
 			srcdata->update_file = false;
 		}
 
-		if (srcdata->m_timestamp != t) {
-			srcdata->m_timestamp = t;
+		if (os_file_watch_changed(srcdata->file_watch))
 			srcdata->update_file = true;
-		}
 	}
 
 	UNUSED_PARAMETER(seconds);
@@ -299,18 +310,24 @@ static void ft2_video_tick(void *data, float seconds)
 static bool init_font(struct ft2_source *srcdata)
 {
 	FT_Long index;
+	bool success;
 	const char *path = get_font_path(srcdata->font_name, srcdata->font_size,
 					 srcdata->font_style,
 					 srcdata->font_flags, &index);
 	if (!path)
 		return false;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
+	free_font_face(srcdata);
+
+	bfree(srcdata->font_path);
+	srcdata->font_path = bstrdup(path);
+	srcdata->font_index = index;
+
+	pthread_mutex_lock(&ft2_lib_mutex);
+	success = FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	pthread_mutex_unlock(&ft2_lib_mutex);
 
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	return success;
 }
 
 static void ft2_source_update(void *data, obs_data_t *settings)
@@ -381,8 +398,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (ft2_lib == NULL)
 		goto error;
 
-	const size_t texbuf_size = (size_t)texbuf_w * (size_t)texbuf_h;
-
 	if (srcdata->draw_effect == NULL) {
 		char *effect_file = NULL;
 		char *error_string = NULL;
@@ -408,10 +423,8 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	const bool aa_changed = srcdata->antialiasing != new_aa_setting;
 	if (aa_changed) {
 		srcdata->antialiasing = new_aa_setting;
-		if (srcdata->texbuf != NULL) {
-			memset(srcdata->texbuf, 0, texbuf_size);
-		}
 		cache_standard_glyphs(srcdata);
+		vbuf_needs_update = true;
 	}
 
 	srcdata->file_load_failed = false;
@@ -446,12 +459,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 		FT_Select_Charmap(srcdata->font_face, FT_ENCODING_UNICODE);
 	}
 
-	if (srcdata->texbuf != NULL) {
-		bfree(srcdata->texbuf);
-		srcdata->texbuf = NULL;
-	}
-	srcdata->texbuf = bzalloc(texbuf_size);
-
 	if (srcdata->font_face)
 		cache_standard_glyphs(srcdata);
 
@@ -480,6 +487,10 @@ skip_font_load:
 			bfree(srcdata->text_file);
 
 			srcdata->text_file = bstrdup(tmp);
+
+			os_file_watch_destroy(srcdata->file_watch);
+			srcdata->file_watch = os_file_watch_create(tmp);
+
 			if (chat_log_mode)
 				read_from_end(srcdata, tmp);
 			else
@@ -488,6 +499,10 @@ skip_font_load:
 		}
 	} else {
 		const char *tmp = obs_data_get_string(settings, "text");
+
+		os_file_watch_destroy(srcdata->file_watch);
+		srcdata->file_watch = NULL;
+
 		if (!tmp || !*tmp)
 			goto error;
 
@@ -18,20 +18,57 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <obs-module.h>
+#include <util/threading.h>
+#include <util/file-watch.h>
+#include <util/darray.h>
+#include <util/dstr.h>
 #include <ft2build.h>
+#include FT_FREETYPE_H
 
 #define num_cache_slots 65535
-#define src_glyph srcdata->cacheglyphs[glyph_index]
+#define src_glyph srcdata->atlas->glyphs[glyph_index]
 
 struct glyph_info {
 	float u, v, u2, v2;
 	int32_t w, h, xoff, yoff;
 	int32_t xadv;
+	size_t shelf;
+};
+
+/* a row of the atlas holding glyphs of the same (rounded up) height */
+struct glyph_shelf {
+	uint32_t y, h, x;
+	long pins;
+	uint64_t last_used;
+};
+
+/* Glyph atlas, shared by all sources using the same font face, size and
+ * antialiasing mode */
+struct glyph_atlas {
+	char *font_path;
+	FT_Long font_index;
+	uint16_t font_size;
+	bool antialiasing;
+	long refs;
+
+	pthread_mutex_t mutex;
+	struct glyph_info *glyphs[num_cache_slots];
+	DARRAY(struct glyph_shelf) shelves;
+	uint32_t next_shelf_y;
+	uint64_t use_counter;
+
+	uint8_t *texbuf;
+	gs_texture_t *tex;
+	bool dirty;
+
+	struct glyph_atlas *next;
 };
 
 struct ft2_source {
 	char *font_name;
 	char *font_style;
+	char *font_path;
+	FT_Long font_index;
 	uint16_t font_size;
 	uint32_t font_flags;
 
@@ -40,26 +77,34 @@ struct ft2_source {
 	bool antialiasing;
 	char *text_file;
 	wchar_t *text;
-	time_t m_timestamp;
+	os_file_watch_t *file_watch;
 	bool update_file;
 	uint64_t last_checked;
 
+	/* end of the text file in chat log mode, for reading only what was
+	 * appended to it */
+	struct dstr tail;
+	int64_t tail_offset;
+	bool tail_valid;
+
 	uint32_t cx, cy, max_h, custom_width;
 	uint32_t outline_width;
-	uint32_t texbuf_x, texbuf_y;
 	uint32_t color[2];
 	uint32_t *colorbuf;
 
 	int32_t cur_scroll, scroll_speed;
 
+	/* owned by the glyph atlas */
 	gs_texture_t *tex;
 
-	struct glyph_info *cacheglyphs[num_cache_slots];
+	struct glyph_atlas *atlas;
+	DARRAY(struct glyph_info *) pinned_glyphs;
 
 	FT_Face font_face;
 
-	uint8_t *texbuf;
 	gs_vertbuffer_t *vbuf;
+	uint32_t vbuf_capacity;
+	bool vbuf_dirty;
 
 	gs_effect_t *draw_effect;
 	bool outline_text, drop_shadow;
@@ -92,12 +137,13 @@ static obs_missing_files_t *ft2_missing_files(void *data);
 
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata);
 
-time_t get_modified_timestamp(char *filename);
 void load_text_from_file(struct ft2_source *srcdata, const char *filename);
 void read_from_end(struct ft2_source *srcdata, const char *filename);
+void tail_file(struct ft2_source *srcdata, const char *filename);
 
 void cache_standard_glyphs(struct ft2_source *srcdata);
 void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs);
+void free_glyph_atlas(struct ft2_source *srcdata);
 
 void set_up_vertex_buffer(struct ft2_source *srcdata);
 void fill_vertex_buffer(struct ft2_source *srcdata);
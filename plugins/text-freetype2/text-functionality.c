@@ -28,6 +28,197 @@ float offsets[16] = {-2.0f, 0.0f, 0.0f, -2.0f, 2.0f,  0.0f, 2.0f,  0.0f,
 
 extern uint32_t texbuf_w, texbuf_h;
 
+/* Glyph atlases are shared by every source using the same font face, size
+ * and antialiasing mode, so glyphs are only rasterized once.  Glyphs are
+ * packed in to shelves, which are rows of glyphs of the same rounded up
+ * height.  Each source pins the shelves holding the glyphs of its current
+ * text, and when the atlas is full, the least recently used shelf that is
+ * not pinned is cleared and reused.  The texture is only updated rather than
+ * recreated when glyphs are added. */
+
+#define SHELF_ALIGN 8
+
+static pthread_mutex_t atlas_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct glyph_atlas *first_atlas = NULL;
+
+static struct glyph_atlas *get_glyph_atlas(struct ft2_source *srcdata)
+{
+	struct glyph_atlas *atlas;
+
+	pthread_mutex_lock(&atlas_mutex);
+
+	for (atlas = first_atlas; atlas; atlas = atlas->next) {
+		if (atlas->font_index == srcdata->font_index &&
+		    atlas->font_size == srcdata->font_size &&
+		    atlas->antialiasing == srcdata->antialiasing &&
+		    strcmp(atlas->font_path, srcdata->font_path) == 0) {
+			atlas->refs++;
+			break;
+		}
+	}
+
+	if (!atlas) {
+		atlas = bzalloc(sizeof(struct glyph_atlas));
+		atlas->font_path = bstrdup(srcdata->font_path);
+		atlas->font_index = srcdata->font_index;
+		atlas->font_size = srcdata->font_size;
+		atlas->antialiasing = srcdata->antialiasing;
+		atlas->refs = 1;
+		atlas->texbuf = bzalloc((size_t)texbuf_w * (size_t)texbuf_h);
+		pthread_mutex_init(&atlas->mutex, NULL);
+
+		atlas->next = first_atlas;
+		first_atlas = atlas;
+	}
+
+	pthread_mutex_unlock(&atlas_mutex);
+	return atlas;
+}
+
+static void release_glyph_atlas(struct glyph_atlas *atlas)
+{
+	struct glyph_atlas **p_atlas = &first_atlas;
+
+	if (!atlas)
+		return;
+
+	pthread_mutex_lock(&atlas_mutex);
+	if (--atlas->refs == 0) {
+		while (*p_atlas != atlas)
+			p_atlas = &(*p_atlas)->next;
+		*p_atlas = atlas->next;
+	} else {
+		atlas = NULL;
+	}
+	pthread_mutex_unlock(&atlas_mutex);
+
+	if (!atlas)
+		return;
+
+	obs_enter_graphics();
+	gs_texture_destroy(atlas->tex);
+	obs_leave_graphics();
+
+	for (uint32_t i = 0; i < num_cache_slots; i++)
+		bfree(atlas->glyphs[i]);
+
+	pthread_mutex_destroy(&atlas->mutex);
+	da_free(atlas->shelves);
+	bfree(atlas->texbuf);
+	bfree(atlas->font_path);
+	bfree(atlas);
+}
+
+static void unpin_glyphs(struct ft2_source *srcdata)
+{
+	struct glyph_atlas *atlas = srcdata->atlas;
+
+	if (atlas) {
+		pthread_mutex_lock(&atlas->mutex);
+		for (size_t i = 0; i < srcdata->pinned_glyphs.num; i++) {
+			struct glyph_info *glyph =
+				srcdata->pinned_glyphs.array[i];
+			atlas->shelves.array[glyph->shelf].pins--;
+		}
+		pthread_mutex_unlock(&atlas->mutex);
+	}
+
+	da_free(srcdata->pinned_glyphs);
+}
+
+void free_glyph_atlas(struct ft2_source *srcdata)
+{
+	unpin_glyphs(srcdata);
+	release_glyph_atlas(srcdata->atlas);
+	srcdata->atlas = NULL;
+	srcdata->tex = NULL;
+}
+
+static void clear_shelf(struct glyph_atlas *atlas, size_t idx)
+{
+	struct glyph_shelf *shelf = &atlas->shelves.array[idx];
+
+	for (uint32_t i = 0; i < num_cache_slots; i++) {
+		if (atlas->glyphs[i] && atlas->glyphs[i]->shelf == idx) {
+			bfree(atlas->glyphs[i]);
+			atlas->glyphs[i] = NULL;
+		}
+	}
+
+	for (uint32_t y = shelf->y; y < shelf->y + shelf->h; y++)
+		memset(atlas->texbuf + (size_t)y * texbuf_w, 0, texbuf_w);
+
+	shelf->x = 0;
+	atlas->dirty = true;
+}
+
+static bool alloc_glyph_space(struct glyph_atlas *atlas, const uint32_t g_w,
+			      const uint32_t g_h, size_t *idx)
+{
+	uint32_t h = (g_h + SHELF_ALIGN - 1) / SHELF_ALIGN * SHELF_ALIGN;
+	struct glyph_shelf *lru = NULL;
+
+	if (!h)
+		h = SHELF_ALIGN;
+	if (g_w + 1 >= texbuf_w)
+		return false;
+
+	for (size_t i = 0; i < atlas->shelves.num; i++) {
+		struct glyph_shelf *shelf = &atlas->shelves.array[i];
+
+		if (shelf->h == h && shelf->x + g_w + 1 < texbuf_w) {
+			*idx = i;
+			return true;
+		}
+	}
+
+	if (atlas->next_shelf_y + h + 1 < texbuf_h) {
+		struct glyph_shelf *shelf = da_push_back_new(atlas->shelves);
+
+		shelf->y = atlas->next_shelf_y;
+		shelf->h = h;
+		atlas->next_shelf_y += h + 1;
+
+		*idx = atlas->shelves.num - 1;
+		return true;
+	}
+
+	for (size_t i = 0; i < atlas->shelves.num; i++) {
+		struct glyph_shelf *shelf = &atlas->shelves.array[i];
+
+		if (shelf->pins || shelf->h < h)
+			continue;
+		if (!lru || shelf->last_used < lru->last_used) {
+			lru = shelf;
+			*idx = i;
+		}
+	}
+
+	if (!lru)
+		return false;
+
+	clear_shelf(atlas, *idx);
+	return true;
+}
+
+static void upload_glyph_atlas(struct glyph_atlas *atlas)
+{
+	obs_enter_graphics();
+	pthread_mutex_lock(&atlas->mutex);
+
+	if (!atlas->tex)
+		atlas->tex = gs_texture_create(
+			texbuf_w, texbuf_h, GS_A8, 1,
+			(const uint8_t **)&atlas->texbuf, GS_DYNAMIC);
+	else if (atlas->dirty)
+		gs_texture_set_image(atlas->tex, atlas->texbuf, texbuf_w,
+				     false);
+	atlas->dirty = false;
+
+	pthread_mutex_unlock(&atlas->mutex);
+	obs_leave_graphics();
+}
+
 void draw_outlines(struct ft2_source *srcdata)
 {
 	// Horrible (hopefully temporary) solution for outlines.
@@ -40,6 +231,7 @@ void draw_outlines(struct ft2_source *srcdata)
 
 	tmp = vdata->colors;
 	vdata->colors = srcdata->colorbuf;
+	gs_vertexbuffer_flush(srcdata->vbuf);
 
 	gs_matrix_push();
 	for (int32_t i = 0; i < 8; i++) {
@@ -53,6 +245,7 @@ void draw_outlines(struct ft2_source *srcdata)
 	gs_matrix_pop();
 
 	vdata->colors = tmp;
+	srcdata->vbuf_dirty = true;
 }
 
 void draw_drop_shadow(struct ft2_source *srcdata)
@@ -67,6 +260,7 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	tmp = vdata->colors;
 	vdata->colors = srcdata->colorbuf;
+	gs_vertexbuffer_flush(srcdata->vbuf);
 
 	gs_matrix_push();
 	gs_matrix_translate3f(4.0f, 4.0f, 0.0f);
@@ -76,6 +270,35 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 	gs_matrix_pop();
 
 	vdata->colors = tmp;
+	srcdata->vbuf_dirty = true;
+}
+
+/* the vertex buffer is only recreated when the text outgrows it */
+static void ensure_vbuf_capacity(struct ft2_source *srcdata,
+				 uint32_t num_verts)
+{
+	uint32_t capacity = srcdata->vbuf_capacity * 2;
+
+	if (srcdata->vbuf && srcdata->vbuf_capacity >= num_verts)
+		return;
+
+	if (srcdata->vbuf != NULL) {
+		gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
+		srcdata->vbuf = NULL;
+		gs_vertexbuffer_destroy(tmpvbuf);
+	}
+
+	if (capacity < num_verts)
+		capacity = num_verts;
+
+	srcdata->vbuf = create_uv_vbuffer(capacity, true);
+	srcdata->vbuf_capacity = srcdata->vbuf ? capacity : 0;
+	srcdata->vbuf_dirty = true;
+
+	bfree(srcdata->colorbuf);
+	srcdata->colorbuf = bmalloc(sizeof(uint32_t) * capacity);
+	for (uint32_t i = 0; i < capacity; i++)
+		srcdata->colorbuf[i] = 0xFF000000;
 }
 
 void set_up_vertex_buffer(struct ft2_source *srcdata)
@@ -84,7 +307,7 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 	uint32_t x = 0, space_pos = 0, word_width = 0;
 	size_t len;
 
-	if (!srcdata->text)
+	if (!srcdata->text || !srcdata->atlas)
 		return;
 
 	if (srcdata->custom_width >= 100)
@@ -93,20 +316,15 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 		srcdata->cx = get_ft2_text_width(srcdata->text, srcdata);
 	srcdata->cy = srcdata->max_h;
 
-	obs_enter_graphics();
-	if (srcdata->vbuf != NULL) {
-		gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
-		srcdata->vbuf = NULL;
-		gs_vertexbuffer_destroy(tmpvbuf);
-	}
-
-	if (*srcdata->text == 0) {
-		obs_leave_graphics();
+	if (*srcdata->text == 0)
 		return;
-	}
 
-	srcdata->vbuf =
-		create_uv_vbuffer((uint32_t)wcslen(srcdata->text) * 6, true);
+	obs_enter_graphics();
+	ensure_vbuf_capacity(srcdata, (uint32_t)wcslen(srcdata->text) * 6);
+
+	/* other sources using the atlas can evict glyphs this one did not
+	 * manage to pin, so they are only read with the atlas locked */
+	pthread_mutex_lock(&srcdata->atlas->mutex);
 
 	if (srcdata->custom_width <= 100)
 		goto skip_word_wrap;
@@ -140,15 +358,18 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 	next_char:;
 		glyph_index =
 			FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
-		word_width += src_glyph->xadv;
+		if (src_glyph)
+			word_width += src_glyph->xadv;
 	eos_skip:;
 	}
 
 skip_word_wrap:;
 	fill_vertex_buffer(srcdata);
+	pthread_mutex_unlock(&srcdata->atlas->mutex);
 	obs_leave_graphics();
 }
 
+/* called with the atlas mutex held */
 void fill_vertex_buffer(struct ft2_source *srcdata)
 {
 	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
@@ -165,21 +386,15 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 	uint32_t offset = 0;
 	size_t len = wcslen(srcdata->text);
 
+	struct vec3 points[6];
+	struct vec2 uvs[6];
+	uint32_t colors[6];
+
 	if (srcdata->outline_text) {
 		offset = 2;
 		dx = offset;
 	}
 
-	if (srcdata->colorbuf != NULL) {
-		bfree(srcdata->colorbuf);
-		srcdata->colorbuf = NULL;
-	}
-	srcdata->colorbuf =
-		bzalloc(sizeof(uint32_t) * wcslen(srcdata->text) * 6);
-	for (size_t i = 0; i < len * 6; i++) {
-		srcdata->colorbuf[i] = 0xFF000000;
-	}
-
 	for (size_t i = 0; i < len; i++) {
 	add_linebreak:;
 		if (srcdata->text[i] != L'\n')
@@ -211,14 +426,25 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 
 	skip_custom_width:;
 
-		set_v3_rect(vdata->points + (cur_glyph * 6),
-			    (float)dx + (float)src_glyph->xoff,
+		set_v3_rect(points, (float)dx + (float)src_glyph->xoff,
 			    (float)dy - (float)src_glyph->yoff,
 			    (float)src_glyph->w, (float)src_glyph->h);
-		set_v2_uv(tvarray + (cur_glyph * 6), src_glyph->u, src_glyph->v,
-			  src_glyph->u2, src_glyph->v2);
-		set_rect_colors2(col + (cur_glyph * 6), srcdata->color[0],
-				 srcdata->color[1]);
+		set_v2_uv(uvs, src_glyph->u, src_glyph->v, src_glyph->u2,
+			  src_glyph->v2);
+		set_rect_colors2(colors, srcdata->color[0], srcdata->color[1]);
+
+		/* only mark the buffer dirty if the glyph actually changed */
+		if (memcmp(vdata->points + cur_glyph * 6, points,
+			   sizeof(points)) != 0 ||
+		    memcmp(tvarray + cur_glyph * 6, uvs, sizeof(uvs)) != 0 ||
+		    memcmp(col + cur_glyph * 6, colors, sizeof(colors)) != 0) {
+			memcpy(vdata->points + cur_glyph * 6, points,
+			       sizeof(points));
+			memcpy(tvarray + cur_glyph * 6, uvs, sizeof(uvs));
+			memcpy(col + cur_glyph * 6, colors, sizeof(colors));
+			srcdata->vbuf_dirty = true;
+		}
+
 		dx += src_glyph->xadv;
 		if (dy - (float)src_glyph->yoff + src_glyph->h > max_y)
 			max_y = dy - src_glyph->yoff + src_glyph->h;
@@ -226,24 +452,34 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 	skip_glyph:;
 	}
 
+	/* clear what is left of the previous text in the drawn range */
+	for (size_t i = cur_glyph * 6; i < len * 6; i++) {
+		if (vdata->points[i].x != 0.0f || vdata->points[i].y != 0.0f) {
+			vec3_zero(vdata->points + i);
+			srcdata->vbuf_dirty = true;
+		}
+	}
+
 	srcdata->cy = max_y;
 }
 
+static void cache_glyphs_internal(struct ft2_source *srcdata,
+				  const wchar_t *cache_glyphs, bool pin);
+
 void cache_standard_glyphs(struct ft2_source *srcdata)
 {
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	free_glyph_atlas(srcdata);
+
+	if (!srcdata->font_face || !srcdata->font_path)
+		return;
 
-	srcdata->texbuf_x = 0;
-	srcdata->texbuf_y = 0;
+	srcdata->atlas = get_glyph_atlas(srcdata);
 
-	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz"
+	cache_glyphs_internal(srcdata,
+			      L"abcdefghijklmnopqrstuvwxyz"
 			      L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
-			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
+			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0",
+			      false);
 }
 
 FT_Render_Mode get_render_mode(struct ft2_source *srcdata)
@@ -292,7 +528,7 @@ uint8_t get_pixel_value(const unsigned char *buf_row,
 	return pixel_set ? 255 : 0;
 }
 
-void rasterize(struct ft2_source *srcdata, FT_GlyphSlot slot,
+void rasterize(uint8_t *texbuf, FT_GlyphSlot slot,
 	       const FT_Render_Mode render_mode, const uint32_t dx,
 	       const uint32_t dy)
 {
@@ -313,98 +549,98 @@ void rasterize(struct ft2_source *srcdata, FT_GlyphSlot slot,
 			const uint8_t pixel_value =
 				get_pixel_value(&slot->bitmap.buffer[row_start],
 						render_mode, x);
-			srcdata->texbuf[row_pixel_position + row] = pixel_value;
+			texbuf[row_pixel_position + row] = pixel_value;
 		}
 	}
 }
 
-void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
+static void cache_glyphs_internal(struct ft2_source *srcdata,
+				  const wchar_t *cache_glyphs, bool pin)
 {
-	if (!srcdata->font_face || !cache_glyphs)
+	struct glyph_atlas *atlas = srcdata->atlas;
+	DARRAY(struct glyph_info *) pinned;
+	bool dirty;
+
+	if (!srcdata->font_face || !atlas || !cache_glyphs)
 		return;
 
 	FT_GlyphSlot slot = srcdata->font_face->glyph;
 
-	uint32_t dx = srcdata->texbuf_x;
-	uint32_t dy = srcdata->texbuf_y;
-
-	int32_t cached_glyphs = 0;
 	const size_t len = wcslen(cache_glyphs);
 
 	const FT_Render_Mode render_mode = get_render_mode(srcdata);
 
+	da_init(pinned);
+
+	pthread_mutex_lock(&atlas->mutex);
+	atlas->use_counter++;
+
 	for (size_t i = 0; i < len; i++) {
 		const FT_UInt glyph_index =
 			FT_Get_Char_Index(srcdata->font_face, cache_glyphs[i]);
+		struct glyph_info *glyph = atlas->glyphs[glyph_index];
+		struct glyph_shelf *shelf;
 
-		if (src_glyph != NULL) {
-			continue;
-		}
+		if (glyph == NULL) {
+			size_t idx;
 
-		load_glyph(srcdata, glyph_index, render_mode);
-		FT_Render_Glyph(slot, render_mode);
+			load_glyph(srcdata, glyph_index, render_mode);
+			FT_Render_Glyph(slot, render_mode);
 
-		const uint32_t g_w = slot->bitmap.width;
-		const uint32_t g_h = slot->bitmap.rows;
+			const uint32_t g_w = slot->bitmap.width;
+			const uint32_t g_h = slot->bitmap.rows;
 
-		if (srcdata->max_h < g_h) {
-			srcdata->max_h = g_h;
-		}
+			if (!alloc_glyph_space(atlas, g_w, g_h, &idx)) {
+				blog(LOG_WARNING,
+				     "Out of space trying to render glyphs");
+				break;
+			}
 
-		if (dx + g_w >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h + 1;
-		}
+			shelf = &atlas->shelves.array[idx];
 
-		if (dy + g_h >= texbuf_h) {
-			blog(LOG_WARNING,
-			     "Out of space trying to render glyphs");
-			break;
-		}
+			glyph = init_glyph(slot, shelf->x, shelf->y, g_w, g_h);
+			glyph->shelf = idx;
+			atlas->glyphs[glyph_index] = glyph;
 
-		src_glyph = init_glyph(slot, dx, dy, g_w, g_h);
-		rasterize(srcdata, slot, render_mode, dx, dy);
-
-		dx += (g_w + 1);
-		if (dx >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h;
+			rasterize(atlas->texbuf, slot, render_mode, shelf->x,
+				  shelf->y);
+			shelf->x += g_w + 1;
+			atlas->dirty = true;
 		}
 
-		cached_glyphs++;
-	}
-
-	srcdata->texbuf_x = dx;
-	srcdata->texbuf_y = dy;
+		/* the line height only depends on the glyphs of this source,
+		 * not on those other sources added to the atlas */
+		if (srcdata->max_h < (uint32_t)glyph->h)
+			srcdata->max_h = (uint32_t)glyph->h;
 
-	if (cached_glyphs > 0) {
+		shelf = &atlas->shelves.array[glyph->shelf];
+		shelf->last_used = atlas->use_counter;
 
-		obs_enter_graphics();
-
-		if (srcdata->tex != NULL) {
-			gs_texture_t *tmp_texture = srcdata->tex;
-			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
+		if (pin) {
+			shelf->pins++;
+			da_push_back(pinned, &glyph);
 		}
+	}
 
-		srcdata->tex = gs_texture_create(
-			texbuf_w, texbuf_h, GS_A8, 1,
-			(const uint8_t **)&srcdata->texbuf, 0);
+	dirty = atlas->dirty || !atlas->tex;
+	pthread_mutex_unlock(&atlas->mutex);
 
-		obs_leave_graphics();
+	/* pin the new text before unpinning the old one so that glyphs used
+	 * by both are not evicted in between */
+	if (pin) {
+		unpin_glyphs(srcdata);
+		srcdata->pinned_glyphs.da = pinned.da;
 	}
-}
 
-time_t get_modified_timestamp(char *filename)
-{
-	struct stat stats;
+	if (dirty)
+		upload_glyph_atlas(atlas);
 
-	// stat is apparently terrifying and horrible, but we only call it once
-	// every second at most.
-	if (os_stat(filename, &stats) != 0)
-		return -1;
+	srcdata->tex = atlas->tex;
+}
 
-	return stats.st_mtime;
+void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
+{
+	cache_glyphs_internal(srcdata, cache_glyphs, true);
 }
 
 static void remove_cr(wchar_t *source)
@@ -483,6 +719,8 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 
 	bool utf16 = false;
 
+	srcdata->tail_valid = false;
+
 	tmp_file = fopen(filename, "rb");
 	if (tmp_file == NULL) {
 		if (!srcdata->file_load_failed) {
@@ -553,9 +791,99 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 		       (strlen(tmp_read) + 1));
 
 	remove_cr(srcdata->text);
+
+	dstr_copy(&srcdata->tail, tmp_read);
+	srcdata->tail_offset = filesize;
+	srcdata->tail_valid = true;
+
 	bfree(tmp_read);
 }
 
+static void trim_to_last_lines(struct dstr *str, uint32_t log_lines)
+{
+	uint32_t line_breaks = 0;
+
+	for (size_t i = str->len; i > 0; i--) {
+		if (str->array[i - 1] == '\n' && ++line_breaks > log_lines) {
+			dstr_remove(str, 0, i);
+			return;
+		}
+	}
+}
+
+/* Reads only what was appended to the file since it was last read.  If the
+ * file shrank or the end of what was read before changed, the file was
+ * rewritten, so the end of the file is read again instead. */
+void tail_file(struct ft2_source *srcdata, const char *filename)
+{
+	struct dstr *tail = &srcdata->tail;
+	FILE *tmp_file = NULL;
+	char check[64];
+	size_t check_len;
+	int64_t filesize;
+	char *tmp_read;
+	size_t bytes_read;
+
+	if (!srcdata->tail_valid)
+		goto read_end;
+
+	tmp_file = os_fopen(filename, "rb");
+	if (tmp_file == NULL)
+		goto read_end;
+
+	os_fseeki64(tmp_file, 0, SEEK_END);
+	filesize = os_ftelli64(tmp_file);
+	if (filesize < srcdata->tail_offset)
+		goto read_end;
+
+	check_len = tail->len < sizeof(check) ? tail->len : sizeof(check);
+	if (check_len) {
+		os_fseeki64(tmp_file, srcdata->tail_offset - check_len,
+			    SEEK_SET);
+		bytes_read = fread(check, 1, check_len, tmp_file);
+
+		if (bytes_read != check_len ||
+		    memcmp(check, tail->array + tail->len - check_len,
+			   check_len) != 0)
+			goto read_end;
+	} else {
+		os_fseeki64(tmp_file, srcdata->tail_offset, SEEK_SET);
+	}
+
+	if (filesize == srcdata->tail_offset) {
+		fclose(tmp_file);
+		return;
+	}
+
+	tmp_read = bmalloc((size_t)(filesize - srcdata->tail_offset));
+	bytes_read = fread(tmp_read, 1,
+			   (size_t)(filesize - srcdata->tail_offset), tmp_file);
+	fclose(tmp_file);
+
+	dstr_ncat(tail, tmp_read, bytes_read);
+	srcdata->tail_offset += bytes_read;
+	bfree(tmp_read);
+
+	trim_to_last_lines(tail, srcdata->log_lines);
+
+	const char *str = tail->array ? tail->array : "";
+
+	if (srcdata->text != NULL) {
+		bfree(srcdata->text);
+		srcdata->text = NULL;
+	}
+	srcdata->text = bzalloc((strlen(str) + 1) * sizeof(wchar_t));
+	os_utf8_to_wcs(str, strlen(str), srcdata->text, (strlen(str) + 1));
+
+	remove_cr(srcdata->text);
+	return;
+
+read_end:
+	if (tmp_file)
+		fclose(tmp_file);
+	read_from_end(srcdata, filename);
+}
+
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 {
 	if (!text) {
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+#include <util/platform.h>
+#include <media-io/audio-io.h>
+
+/* Replays the audio encoder input buffering of obs-encoder.c on the mix
+ * blocks of a 48 kHz stereo session with 6 tracks and 2 encoders on each,
+ * once the way it used to be done (every block copied in to the input
+ * buffers, every frame copied out again) and once the way receive_audio does
+ * it now (whole frames encoded straight from the mix data, only the rest of
+ * a block buffered).  Reports the bytes memcpy'd per second of audio and the
+ * time spent per mix block.  The second encoder of each track starts part
+ * way through a block, like one synced to video does.
+ *
+ * usage: audio-copy-bench [seconds] */
+
+#define SAMPLE_RATE 48000
+#define PLANES 2
+#define BLOCK_SIZE sizeof(float)
+#define TRACKS 6
+#define ENCODERS_PER_TRACK 2
+#define NUM_ENCODERS (TRACKS * ENCODERS_PER_TRACK)
+#define START_OFFSET 300
+
+struct bench_encoder {
+	struct circlebuf input[PLANES];
+	uint8_t *output[PLANES];
+	size_t frame_bytes;
+	size_t offset_size;
+	uint64_t copied;
+	float sum;
+};
+
+/* stands in for the encoder, which reads the whole frame */
+static void encode(struct bench_encoder *enc, uint8_t *data[PLANES])
+{
+	for (size_t i = 0; i < PLANES; i++) {
+		const float *samples = (const float *)data[i];
+
+		for (size_t j = 0; j < enc->frame_bytes / BLOCK_SIZE; j++)
+			enc->sum += samples[j];
+	}
+}
+
+static void push_back(struct bench_encoder *enc, uint8_t *data[PLANES],
+		      size_t size, size_t offset_size)
+{
+	size -= offset_size;
+	if (!size)
+		return;
+
+	for (size_t i = 0; i < PLANES; i++)
+		circlebuf_push_back(&enc->input[i], data[i] + offset_size,
+				    size);
+	enc->copied += size * PLANES;
+}
+
+static void receive_copy(struct bench_encoder *enc, uint8_t *data[PLANES],
+			 size_t size, size_t offset_size)
+{
+	push_back(enc, data, size, offset_size);
+
+	while (enc->input[0].size >= enc->frame_bytes) {
+		for (size_t i = 0; i < PLANES; i++)
+			circlebuf_pop_front(&enc->input[i], enc->output[i],
+					    enc->frame_bytes);
+		enc->copied += enc->frame_bytes * PLANES;
+		encode(enc, enc->output);
+	}
+}
+
+static void send_buffered(struct bench_encoder *enc)
+{
+	uint8_t *data[PLANES];
+	bool in_place[PLANES];
+
+	for (size_t i = 0; i < PLANES; i++) {
+		struct circlebuf *buf = &enc->input[i];
+
+		in_place[i] = buf->start_pos + enc->frame_bytes <=
+			      buf->capacity;
+		if (in_place[i]) {
+			data[i] = (uint8_t *)buf->data + buf->start_pos;
+		} else {
+			circlebuf_pop_front(buf, enc->output[i],
+					    enc->frame_bytes);
+			data[i] = enc->output[i];
+			enc->copied += enc->frame_bytes;
+		}
+	}
+
+	encode(enc, data);
+
+	for (size_t i = 0; i < PLANES; i++) {
+		if (in_place[i])
+			circlebuf_pop_front(&enc->input[i], NULL,
+					    enc->frame_bytes);
+	}
+}
+
+static void receive_in_place(struct bench_encoder *enc, uint8_t *data[PLANES],
+			     size_t size, size_t pos)
+{
+	uint8_t *frame[PLANES];
+
+	while (enc->input[0].size >= enc->frame_bytes)
+		send_buffered(enc);
+
+	if (enc->input[0].size) {
+		size_t needed = enc->frame_bytes - enc->input[0].size;
+
+		if (size - pos < needed) {
+			push_back(enc, data, size, pos);
+			return;
+		}
+
+		push_back(enc, data, pos + needed, pos);
+		pos += needed;
+		send_buffered(enc);
+	}
+
+	while (size - pos >= enc->frame_bytes) {
+		for (size_t i = 0; i < PLANES; i++)
+			frame[i] = data[i] + pos;
+		encode(enc, frame);
+		pos += enc->frame_bytes;
+	}
+
+	push_back(enc, data, size, pos);
+}
+
+struct bench_result {
+	double copied_per_sec;
+	double us_per_block;
+	float sum;
+};
+
+static void run(struct bench_result *result, uint32_t frame_size,
+		bool in_place, int seconds)
+{
+	const size_t size = AUDIO_OUTPUT_FRAMES * BLOCK_SIZE;
+	const uint32_t blocks = (uint32_t)((uint64_t)seconds * SAMPLE_RATE /
+					   AUDIO_OUTPUT_FRAMES);
+	struct bench_encoder encoders[NUM_ENCODERS];
+	uint8_t *mix[TRACKS][PLANES];
+	uint64_t copied = 0;
+	uint64_t start;
+
+	memset(result, 0, sizeof(*result));
+	memset(encoders, 0, sizeof(encoders));
+
+	for (size_t t = 0; t < TRACKS; t++) {
+		for (size_t i = 0; i < PLANES; i++) {
+			float *samples = bmalloc(size);
+			for (size_t j = 0; j < AUDIO_OUTPUT_FRAMES; j++)
+				samples[j] = (float)(j % 100) / 100.0f;
+			mix[t][i] = (uint8_t *)samples;
+		}
+	}
+
+	for (size_t e = 0; e < NUM_ENCODERS; e++) {
+		struct bench_encoder *enc = &encoders[e];
+
+		enc->frame_bytes = frame_size * BLOCK_SIZE;
+		enc->offset_size = e % ENCODERS_PER_TRACK
+					   ? START_OFFSET * BLOCK_SIZE
+					   : 0;
+		for (size_t i = 0; i < PLANES; i++)
+			enc->output[i] = bmalloc(enc->frame_bytes);
+	}
+
+	start = os_gettime_ns();
+
+	for (uint32_t block = 0; block < blocks; block++) {
+		for (size_t e = 0; e < NUM_ENCODERS; e++) {
+			struct bench_encoder *enc = &encoders[e];
+			uint8_t **data = mix[e / ENCODERS_PER_TRACK];
+			size_t offset_size = block ? 0 : enc->offset_size;
+
+			if (in_place)
+				receive_in_place(enc, data, size,
+						 offset_size);
+			else
+				receive_copy(enc, data, size, offset_size);
+		}
+	}
+
+	result->us_per_block =
+		(double)(os_gettime_ns() - start) / 1000.0 / (double)blocks;
+
+	for (size_t e = 0; e < NUM_ENCODERS; e++) {
+		struct bench_encoder *enc = &encoders[e];
+
+		copied += enc->copied;
+		result->sum += enc->sum;
+		for (size_t i = 0; i < PLANES; i++) {
+			circlebuf_free(&enc->input[i]);
+			bfree(enc->output[i]);
+		}
+	}
+
+	for (size_t t = 0; t < TRACKS; t++) {
+		for (size_t i = 0; i < PLANES; i++)
+			bfree(mix[t][i]);
+	}
+
+	result->copied_per_sec = (double)copied * SAMPLE_RATE /
+				 ((double)blocks * AUDIO_OUTPUT_FRAMES);
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t frame_sizes[] = {1024, 960};
+	int seconds = argc > 1 ? atoi(argv[1]) : 60;
+	int ret = 0;
+
+	if (seconds < 1) {
+		fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%-18s %14s %14s %10s %12s\n", "", "copy bytes/s",
+	       "in place B/s", "copy us", "in place us");
+
+	for (size_t i = 0; i < sizeof(frame_sizes) / sizeof(frame_sizes[0]);
+	     i++) {
+		struct bench_result copy, in_place;
+		char name[32];
+
+		run(&copy, frame_sizes[i], false, seconds);
+		run(&in_place, frame_sizes[i], true, seconds);
+
+		/* both have to hand the encoders the same samples */
+		if (copy.sum != in_place.sum) {
+			fprintf(stderr, "%u: encoded samples differ\n",
+				frame_sizes[i]);
+			ret = 1;
+		}
+
+		snprintf(name, sizeof(name), "%u frame encoder",
+			 frame_sizes[i]);
+		printf("%-18s %14.0f %14.0f %10.2f %12.2f\n", name,
+		       copy.copied_per_sec, in_place.copied_per_sec,
+		       copy.us_per_block, in_place.us_per_block);
+	}
+
+	printf("(%d encoders, time per 1024 frame mix block)\n", NUM_ENCODERS);
+	return ret;
+}
@@ -0,0 +1,154 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <media-io/audio-io.h>
+#include <media-io/audio-buffering.h>
+
+/* Runs the audio buffering of the mix the way audio_callback does, with the
+ * packets of the audio thread and the catch up packets it mixes right after
+ * one when asked to (audio_output_catch_up).  A source falls behind, which
+ * adds buffering, then catches up, which should give it back without a gap
+ * in the timestamps of the output. */
+
+#define RATE 48000
+
+/* 100 ms, just under 5 packets */
+#define LATE_NS 100000000ULL
+#define LATE_TICKS 5
+
+#define LATE_PACKET 100
+#define CATCH_UP_PACKET 1000
+
+struct mix {
+	struct audio_buffering buf;
+	uint64_t last_end;
+	uint32_t outputs;
+	uint32_t releases;
+	uint64_t last_release;
+};
+
+static uint64_t packet_ns(uint64_t packets)
+{
+	return audio_frames_to_ns(RATE, packets * AUDIO_OUTPUT_FRAMES);
+}
+
+/* one call of the mix callback.  The audio of the source ends at
+ * source_end, and starts at min_ts if it is late. */
+static bool mix_packet(struct mix *mix, struct ts_info ts, bool catch_up,
+		       uint64_t min_ts, uint64_t source_end)
+{
+	uint64_t headroom;
+	bool release;
+
+	if (!audio_buffering_begin(&mix->buf, &ts, catch_up))
+		return false;
+
+	if (min_ts < ts.start)
+		audio_buffering_add(&mix->buf, RATE, &ts, min_ts);
+
+	headroom = source_end > ts.end ? source_end - ts.end : 0;
+
+	if (audio_buffering_end(&mix->buf, RATE, &ts, headroom, catch_up,
+				&release)) {
+		/* the output carries on where it left off */
+		if (mix->outputs)
+			assert_true(ts.start == mix->last_end);
+		mix->last_end = ts.end;
+		mix->outputs++;
+	}
+
+	return release;
+}
+
+static void release_test(void **state)
+{
+	const uint32_t packets =
+		CATCH_UP_PACKET +
+		(uint32_t)(AUDIO_BUFFERING_RELEASE_TIME / packet_ns(1) + 2) *
+			LATE_TICKS;
+	struct mix mix = {0};
+	struct ts_info ts;
+
+	mix.last_release = packet_ns(CATCH_UP_PACKET);
+
+	/* nothing to give back yet */
+	ts.start = ts.end = 0;
+	assert_false(audio_buffering_begin(&mix.buf, &ts, true));
+
+	for (uint32_t i = 0; i < packets; i++) {
+		const uint64_t now = packet_ns(i + 1);
+		uint64_t latency = i >= LATE_PACKET && i < CATCH_UP_PACKET
+					   ? LATE_NS
+					   : 0;
+		uint64_t min_ts = UINT64_MAX;
+
+		ts.start = packet_ns(i);
+		ts.end = now;
+
+		if (i == LATE_PACKET)
+			min_ts = ts.start - LATE_NS;
+
+		if (mix_packet(&mix, ts, false, min_ts, now - latency)) {
+			/* never while the source is late, and only after it
+			 * has stayed ahead for a while */
+			assert_true(i >= CATCH_UP_PACKET);
+			assert_true(now - mix.last_release >=
+				    AUDIO_BUFFERING_RELEASE_TIME);
+			mix.last_release = now;
+			mix.releases++;
+
+			ts.start = ts.end = now;
+			assert_false(
+				mix_packet(&mix, ts, true, UINT64_MAX, now));
+		}
+
+		if (i >= LATE_PACKET && i < CATCH_UP_PACKET)
+			assert_int_equal(mix.buf.total_ticks, LATE_TICKS);
+	}
+
+	/* given back a packet at a time while the source stays two packets
+	 * ahead of the mix, which leaves one */
+	assert_int_equal(mix.releases, LATE_TICKS - 1);
+	assert_int_equal(mix.buf.total_ticks, 1);
+
+	/* every packet went out, but the one still buffered */
+	assert_int_equal(mix.outputs + mix.buf.total_ticks, packets);
+
+	audio_buffering_free(&mix.buf);
+	UNUSED_PARAMETER(state);
+}
+
+static void max_buffering_test(void **state)
+{
+	struct audio_buffering buf = {0};
+	struct ts_info ts = {packet_ns(100), packet_ns(101)};
+	bool release;
+
+	/* buffering stops at the maximum */
+	assert_true(audio_buffering_begin(&buf, &ts, false));
+	assert_int_equal(audio_buffering_add(&buf, RATE, &ts, 0),
+			 AUDIO_BUFFERING_MAX_TICKS);
+	assert_true(ts.start == packet_ns(100 - AUDIO_BUFFERING_MAX_TICKS));
+	assert_false(audio_buffering_end(&buf, RATE, &ts, 0, false, &release));
+	assert_false(release);
+
+	ts.start = packet_ns(101);
+	ts.end = packet_ns(102);
+	assert_true(audio_buffering_begin(&buf, &ts, false));
+	assert_int_equal(audio_buffering_add(&buf, RATE, &ts, 0), 0);
+
+	audio_buffering_free(&buf);
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(release_test),
+		cmocka_unit_test(max_buffering_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
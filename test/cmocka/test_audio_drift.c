@@ -0,0 +1,338 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <media-io/audio-io.h>
+#include <media-io/audio-drift.h>
+
+/* Feeds sine waves to the drift compensator and compares its output to the
+ * ideal signal.  Output frame k is input frame k / ratio, delayed by the
+ * half window of the filter (audio_drift_get_delay_ns). */
+
+#define PI 3.14159265358979323846
+
+#define RATE 48000
+#define BLOCK 480
+#define NUM_BLOCKS 200
+
+/* the first outputs see the silence before the first input */
+#define SETTLE_FRAMES 32.0
+
+static double sine(double freq, double pos)
+{
+	return 0.5 * sin(2.0 * PI * freq * pos / RATE);
+}
+
+static double delay_frames(const audio_drift_t *drift)
+{
+	return (double)audio_drift_get_delay_ns(drift, RATE) * RATE /
+	       1000000000.0;
+}
+
+/* returns the worst error against the ideal signal, and in pending the input
+ * not output yet on top of the initial delay.  ratios holds a ratio for each
+ * block; at a ratio of 1 the output snaps to whole input frames. */
+static double run_sine(const double *ratios, double freq, uint64_t *total_out,
+		       double *pending)
+{
+	audio_drift_t *drift = audio_drift_create(2);
+	float left[BLOCK];
+	float right[BLOCK];
+	const float *input[2] = {left, right};
+	double pos, delay;
+	double max_error = 0.0;
+
+	assert_non_null(drift);
+	*total_out = 0;
+
+	delay = delay_frames(drift);
+	pos = -delay;
+
+	for (uint32_t block = 0; block < NUM_BLOCKS; block++) {
+		const double ratio = ratios[block];
+		float *output[2] = {NULL, NULL};
+		uint32_t out_frames = 0;
+
+		for (uint32_t i = 0; i < BLOCK; i++) {
+			const uint64_t frame = (uint64_t)block * BLOCK + i;
+			left[i] = (float)sine(freq, (double)frame);
+			right[i] = -left[i];
+		}
+
+		if (ratio == 1.0)
+			pos = floor(pos + 0.5);
+
+		assert_true(audio_drift_process(drift, ratio, output,
+						&out_frames, input, BLOCK));
+
+		for (uint32_t i = 0; i < out_frames; i++) {
+			const double expected = sine(freq, pos);
+			double error = fabs(output[0][i] - expected);
+
+			if (error > max_error && pos >= SETTLE_FRAMES)
+				max_error = error;
+			assert_true(output[0][i] == -output[1][i]);
+
+			pos += 1.0 / ratio;
+		}
+
+		*total_out += out_frames;
+	}
+
+	*pending = delay_frames(drift) - delay;
+	audio_drift_destroy(drift);
+	return max_error;
+}
+
+static void fill_ratios(double *ratios, double ratio, double step)
+{
+	for (uint32_t i = 0; i < NUM_BLOCKS; i++) {
+		ratios[i] = ratio;
+		ratio += step;
+	}
+}
+
+static void unity_test(void **state)
+{
+	audio_drift_t *drift = audio_drift_create(1);
+	float in[BLOCK];
+	const float *input[1] = {in};
+	float *output[1];
+	uint32_t out_frames;
+	uint32_t delay;
+
+	for (uint32_t i = 0; i < BLOCK; i++)
+		in[i] = (float)(i + 1);
+
+	delay = (uint32_t)(delay_frames(drift) + 0.5);
+	assert_in_range(delay, 1, BLOCK - 1);
+
+	/* a ratio of 1 only delays the input */
+	assert_true(audio_drift_process(drift, 1.0, output, &out_frames, input,
+					BLOCK));
+	assert_int_equal(out_frames, BLOCK);
+	for (uint32_t i = 0; i < delay; i++)
+		assert_true(output[0][i] == 0.0f);
+	for (uint32_t i = delay; i < BLOCK; i++)
+		assert_true(output[0][i] == in[i - delay]);
+
+	/* the end of a block comes out in the next one */
+	assert_true(audio_drift_process(drift, 1.0, output, &out_frames, input,
+					BLOCK));
+	assert_int_equal(out_frames, BLOCK);
+	for (uint32_t i = 0; i < delay; i++)
+		assert_true(output[0][i] == in[BLOCK - delay + i]);
+	assert_true(output[0][delay] == in[0]);
+
+	/* unless it is reset */
+	audio_drift_reset(drift);
+	assert_true(audio_drift_process(drift, 1.0, output, &out_frames, input,
+					BLOCK));
+	assert_true(output[0][0] == 0.0f);
+	assert_true(output[0][delay] == in[0]);
+
+	audio_drift_destroy(drift);
+	UNUSED_PARAMETER(state);
+}
+
+static void ratio_test(void **state)
+{
+	const uint64_t total_in = (uint64_t)NUM_BLOCKS * BLOCK;
+	const double values[] = {0.995, 0.9999, 1.0, 1.0001, 1.005};
+	double ratios[NUM_BLOCKS];
+	uint64_t total_out;
+	double pending;
+
+	/* everything comes out but the input still in the filter */
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		double expected;
+
+		fill_ratios(ratios, values[i], 0.0);
+		run_sine(ratios, 440.0, &total_out, &pending);
+
+		expected = ((double)total_in - pending) * values[i];
+		assert_true(fabs((double)total_out - expected) <= 1.0);
+	}
+
+	UNUSED_PARAMETER(state);
+}
+
+static void sine_test(void **state)
+{
+	double ratios[NUM_BLOCKS];
+	uint64_t total_out;
+	double pending;
+
+	/* the sinc filter stays under -80 dB through the audible range */
+	fill_ratios(ratios, 1.001, 0.0);
+	assert_true(run_sine(ratios, 440.0, &total_out, &pending) < 1e-4);
+	fill_ratios(ratios, 0.999, 0.0);
+	assert_true(run_sine(ratios, 10000.0, &total_out, &pending) < 1e-4);
+	fill_ratios(ratios, 1.003, 0.0);
+	assert_true(run_sine(ratios, 18000.0, &total_out, &pending) < 1e-4);
+
+	/* changing ratios must not introduce discontinuities */
+	fill_ratios(ratios, 0.998, 0.00002);
+	assert_true(run_sine(ratios, 10000.0, &total_out, &pending) < 1e-4);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void bypass_test(void **state)
+{
+	double ratios[NUM_BLOCKS];
+	uint64_t total_out;
+	double pending;
+
+	/* going in and out of the unfiltered copy, as the clock deadband
+	 * does, only snaps to a whole frame on the way in */
+	for (uint32_t i = 0; i < NUM_BLOCKS; i++)
+		ratios[i] = (i / 10) % 2 ? 1.0 : 1.00003;
+
+	assert_true(run_sine(ratios, 1000.0, &total_out, &pending) < 1e-4);
+
+	UNUSED_PARAMETER(state);
+}
+
+/* TS_SMOOTHING_THRESHOLD of obs-source.c: timestamps further than this from
+ * the sample count jump instead of being smoothed */
+#define TS_SMOOTHING_THRESHOLD 70000000LL
+
+#define JITTER_NS 1000000
+
+static uint32_t jitter_seed = 1;
+
+static double jitter(void)
+{
+	jitter_seed = jitter_seed * 1103515245 + 12345;
+	return ((double)(jitter_seed >> 8) / (1 << 24) * 2.0 - 1.0) *
+	       JITTER_NS;
+}
+
+/* Feeds packets from a device whose clock is drift_ppm fast, timestamped by
+ * the system clock with some jitter, the way source_output_audio_data does:
+ * a timestamp is compared to the end of the audio output before it, which
+ * then takes its place.  Returns the worst error, and in bypassed the
+ * number of packets that went through unfiltered after settle seconds. */
+static int64_t run_clock(struct audio_drift_clock *clock, double drift_ppm,
+			 uint32_t seconds, uint32_t settle, uint32_t *bypassed)
+{
+	audio_drift_t *drift = audio_drift_create(1);
+	float in[BLOCK] = {0};
+	const float *input[1] = {in};
+	const double device_rate = RATE * (1.0 + drift_ppm / 1000000.0);
+	const uint32_t packets = seconds * (RATE / BLOCK);
+	const uint32_t settled = settle * (RATE / BLOCK);
+	double next_ts = 0.0;
+	int64_t max_error = 0;
+
+	assert_non_null(drift);
+	audio_drift_clock_init(clock);
+	*bypassed = 0;
+
+	for (uint32_t i = 0; i < packets; i++) {
+		const double ts =
+			(double)i * BLOCK * 1000000000.0 / device_rate +
+			jitter();
+		float *output[1];
+		uint32_t out_frames;
+
+		if (i >= settled && clock->ratio == 1.0)
+			(*bypassed)++;
+
+		assert_true(audio_drift_process(drift, clock->ratio, output,
+						&out_frames, input, BLOCK));
+
+		if (i > 0) {
+			int64_t error = (int64_t)(ts - next_ts);
+
+			if (llabs(error) > max_error)
+				max_error = llabs(error);
+			audio_drift_clock_update(clock, error, out_frames,
+						 RATE);
+		} else {
+			next_ts = ts;
+		}
+
+		next_ts += (double)out_frames * 1000000000.0 / RATE;
+	}
+
+	audio_drift_destroy(drift);
+	return max_error;
+}
+
+static void clock_drift_test(void **state)
+{
+	const double drifts[] = {500.0, -500.0, 50.0};
+	const uint32_t seconds = 180;
+
+	for (size_t i = 0; i < sizeof(drifts) / sizeof(drifts[0]); i++) {
+		struct audio_drift_clock clock;
+		uint32_t bypassed;
+		int64_t max_error;
+		double ratio;
+
+		max_error =
+			run_clock(&clock, drifts[i], seconds, 0, &bypassed);
+
+		/* left alone, 500 ppm would hit the threshold in 140 seconds,
+		 * and more audio buffering would be needed long before */
+		assert_true(max_error < TS_SMOOTHING_THRESHOLD / 4);
+
+		/* settles on the drift, with the timestamps lined up */
+		ratio = 1.0 / (1.0 + drifts[i] / 1000000.0);
+		assert_true(fabs(clock.ratio - ratio) < 0.00002);
+		assert_true(fabs(clock.error) < 0.0002);
+	}
+
+	UNUSED_PARAMETER(state);
+}
+
+static void clock_deadband_test(void **state)
+{
+	const uint32_t seconds = 120;
+	const uint32_t settle = 40;
+	const uint32_t packets = (seconds - settle) * (RATE / BLOCK);
+	struct audio_drift_clock clock;
+	uint32_t bypassed;
+	int64_t max_error;
+
+	/* Without drift, the audio is left untouched once the jitter of the
+	 * first timestamp has been evened out */
+	max_error = run_clock(&clock, 0.0, seconds, settle, &bypassed);
+	assert_true(max_error < 2 * JITTER_NS);
+	assert_int_equal(bypassed, packets);
+
+	/* and most of the time with drift too small to matter */
+	run_clock(&clock, 5.0, seconds, settle, &bypassed);
+	assert_true(bypassed > packets / 2);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void bad_channels_test(void **state)
+{
+	assert_null(audio_drift_create(0));
+	assert_null(audio_drift_create(MAX_AUDIO_CHANNELS + 1));
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(unity_test),
+		cmocka_unit_test(ratio_test),
+		cmocka_unit_test(sine_test),
+		cmocka_unit_test(bypass_test),
+		cmocka_unit_test(clock_drift_test),
+		cmocka_unit_test(clock_deadband_test),
+		cmocka_unit_test(bad_channels_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,442 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <media-io/video-deinterlace.h>
+#include <media-io/video-frame.h>
+
+/* Compares the CPU deinterlacer to the pixel shaders of
+ * deinterlace_base.effect, ported line by line below.  The port works on
+ * floats in the 0-255 range rather than normalized ones, so the constant 1
+ * of yadif's spatial score becomes 255.  Outputs may differ by the rounding
+ * of the averages.  Like the deinterlacer, the port clamps reads to the
+ * edges where the GPU reads zeros. */
+
+#define WIDTH 96
+#define HEIGHT 40
+
+struct image {
+	const uint8_t *data;
+	uint32_t linesize;
+	uint32_t bytes;
+	uint32_t rows;
+	uint32_t step;
+};
+
+struct shader_state {
+	struct image image;
+	struct image previous_image;
+	int field_order;
+	bool frame2;
+};
+
+static float load(const struct image *img, uint32_t i, int x, int y)
+{
+	const uint32_t comp = i % img->step;
+	long idx = (long)i + (long)x * img->step;
+	int row = y;
+
+	if (idx < 0)
+		idx = comp;
+	else if (idx >= (long)img->bytes)
+		idx = comp + (img->bytes - 1 - comp) / img->step * img->step;
+
+	if (row < 0)
+		row = 0;
+	else if (row >= (int)img->rows)
+		row = (int)img->rows - 1;
+
+	return (float)img->data[(size_t)row * img->linesize + (size_t)idx];
+}
+
+#define load_at_image(x, y) load(&s->image, i, x, y + ty)
+#define load_at_prev(x, y) load(&s->previous_image, i, x, y + ty)
+#define load_at(x, y, field) \
+	((field) == 0 ? load_at_image(x, y) : load_at_prev(x, y))
+
+static float yadif_score(const struct shader_state *s, uint32_t i, int ty,
+			 int level, int field)
+{
+	return fabsf(load_at(-1 + level, 1, field) -
+		     load_at(-1 - level, -1, field)) +
+	       fabsf(load_at(level, 1, field) - load_at(-level, -1, field)) +
+	       fabsf(load_at(1 + level, 1, field) -
+		     load_at(1 - level, -1, field));
+}
+
+static void yadif_check(const struct shader_state *s, uint32_t i, int ty,
+			int level, int field, float *spatial_score,
+			float *spatial_pred)
+{
+	float score = yadif_score(s, i, ty, level, field);
+	if (score < *spatial_score) {
+		*spatial_score = score;
+		*spatial_pred = (load_at(level, -1, field) +
+				 load_at(-level, 1, field)) /
+				2;
+
+		score = yadif_score(s, i, ty, level * 2, field);
+		if (score < *spatial_score) {
+			*spatial_score = score;
+			*spatial_pred = (load_at(level * 2, -1, field) +
+					 load_at(-level * 2, 1, field)) /
+					2;
+		}
+	}
+}
+
+static float texel_at_yadif(const struct shader_state *s, uint32_t i, int ty,
+			    int field)
+{
+	if ((ty % 2) == field)
+		return load_at(0, 0, field);
+
+	float c = load_at(0, 1, field);
+	float d = (load_at_prev(0, 0) + load_at_image(0, 0)) / 2;
+	float e = load_at(0, -1, field);
+
+	float temporal_diff0 = fabsf(load_at_prev(0, 0) - load_at_image(0, 0)) /
+			       2;
+	float temporal_diff1 = (fabsf(load_at_prev(0, 1) - c) +
+				fabsf(load_at_prev(0, -1) - e)) /
+			       2;
+	float temporal_diff2 = (fabsf(load_at_image(0, 1) - c) +
+				fabsf(load_at_image(0, -1) - e)) /
+			       2;
+	float diff = fmaxf(temporal_diff0,
+			   fmaxf(temporal_diff1, temporal_diff2));
+
+	float spatial_pred = (c + e) / 2;
+	float spatial_score =
+		fabsf(load_at(-1, 1, field) - load_at(-1, -1, field)) +
+		fabsf(c - e) +
+		fabsf(load_at(1, 1, field) - load_at(1, -1, field)) - 255;
+
+	yadif_check(s, i, ty, -1, field, &spatial_score, &spatial_pred);
+	yadif_check(s, i, ty, 1, field, &spatial_score, &spatial_pred);
+
+	float b = (load_at_prev(0, 2) + load_at_image(0, 2)) / 2;
+	float f = (load_at_prev(0, -2) + load_at_image(0, -2)) / 2;
+
+	float max_ = fmaxf(d - e, fmaxf(d - c, fminf(b - c, f - e)));
+	float min_ = fminf(d - e, fminf(d - c, fmaxf(b - c, f - e)));
+
+	diff = fmaxf(diff, fmaxf(min_, -max_));
+
+	if (spatial_pred > d + diff)
+		spatial_pred = d + diff;
+	else if (spatial_pred < d - diff)
+		spatial_pred = d - diff;
+
+	return spatial_pred;
+}
+
+static float texel_at_discard(const struct shader_state *s, uint32_t i,
+			      int ty, int field)
+{
+	ty = ty / 2 * 2;
+	return load_at_image(0, field);
+}
+
+static float texel_at_blend(const struct shader_state *s, uint32_t i, int ty)
+{
+	return (load_at_image(0, 0) + load_at_image(0, 1)) / 2;
+}
+
+static float texel_at_blend_2x(const struct shader_state *s, uint32_t i,
+			       int ty)
+{
+	if (!s->frame2)
+		return (load_at_image(0, 0) + load_at_prev(0, 1)) / 2;
+	else
+		return (load_at_image(0, 0) + load_at_image(0, 1)) / 2;
+}
+
+static float texel_at_linear(const struct shader_state *s, uint32_t i, int ty,
+			     int field)
+{
+	if ((ty % 2) == field)
+		return load_at_image(0, 0);
+	return (load_at_image(0, -1) + load_at_image(0, 1)) / 2;
+}
+
+#undef load_at
+#undef load_at_prev
+#undef load_at_image
+
+static float shade(const struct shader_state *s,
+		   enum video_deinterlace_type type, uint32_t i, int ty)
+{
+	const int field = s->field_order;
+
+	switch (type) {
+	case VIDEO_DEINTERLACE_DISCARD:
+		return texel_at_discard(s, i, ty, field);
+	case VIDEO_DEINTERLACE_RETRO:
+		return texel_at_discard(s, i, ty,
+					s->frame2 ? field : (1 - field));
+	case VIDEO_DEINTERLACE_BLEND:
+		return texel_at_blend(s, i, ty);
+	case VIDEO_DEINTERLACE_BLEND_2X:
+		return texel_at_blend_2x(s, i, ty);
+	case VIDEO_DEINTERLACE_LINEAR:
+		return texel_at_linear(s, i, ty, field);
+	case VIDEO_DEINTERLACE_LINEAR_2X:
+		return texel_at_linear(s, i, ty,
+				       s->frame2 ? field : (1 - field));
+	case VIDEO_DEINTERLACE_YADIF:
+		return texel_at_yadif(s, i, ty, field);
+	case VIDEO_DEINTERLACE_YADIF_2X:
+		return texel_at_yadif(s, i, ty,
+				      s->frame2 ? (1 - field) : field);
+	}
+
+	return 0.0f;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static uint32_t rand_state = 1;
+
+static uint8_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (uint8_t)(rand_state >> 16);
+}
+
+static uint32_t get_plane_rows(enum video_format format, size_t plane)
+{
+	if (plane > 0 &&
+	    (format == VIDEO_FORMAT_I420 || format == VIDEO_FORMAT_NV12))
+		return HEIGHT / 2;
+	return HEIGHT;
+}
+
+/* moving stripes with some noise, so both the temporal and the spatial
+ * parts of yadif have something to do */
+static void fill_frame(struct video_frame *frame, enum video_format format,
+		       int time)
+{
+	for (size_t p = 0; p < MAX_AV_PLANES && frame->data[p]; p++) {
+		const uint32_t rows = get_plane_rows(format, p);
+
+		for (uint32_t y = 0; y < rows; y++) {
+			uint8_t *row = frame->data[p] + y * frame->linesize[p];
+
+			for (uint32_t x = 0; x < frame->linesize[p]; x++) {
+				int v = (int)((x * 3 + y * 7 + time * 11) % 64);
+
+				v = v * 3 + (next_rand() & 31) +
+				    (int)((x / 8 + y) % 2) * 20;
+
+				row[x] = (uint8_t)(v > 255 ? 255 : v);
+			}
+		}
+	}
+}
+
+static void check_plane(const struct video_frame *out,
+			const struct video_frame *cur,
+			const struct video_frame *prev, size_t plane,
+			uint32_t bytes, uint32_t rows, uint32_t step,
+			enum video_deinterlace_type type, bool top, bool frame2)
+{
+	struct shader_state s = {
+		{cur->data[plane], cur->linesize[plane], bytes, rows, step},
+		{prev->data[plane], prev->linesize[plane], bytes, rows, step},
+		top ? 1 : 0,
+		frame2,
+	};
+	float tolerance = 0.5f;
+	float max_diff = 0.0f;
+
+	/* averages round up, yadif's halved differences round down */
+	if (type == VIDEO_DEINTERLACE_DISCARD ||
+	    type == VIDEO_DEINTERLACE_RETRO)
+		tolerance = 0.0f;
+	else if (type == VIDEO_DEINTERLACE_YADIF ||
+		 type == VIDEO_DEINTERLACE_YADIF_2X)
+		tolerance = 1.0f;
+
+	for (uint32_t y = 0; y < rows; y++) {
+		for (uint32_t i = 0; i < bytes; i++) {
+			float expected = shade(&s, type, i, (int)y);
+			float actual =
+				out->data[plane][y * out->linesize[plane] + i];
+			float diff = fabsf(expected - actual);
+
+			if (diff > max_diff)
+				max_diff = diff;
+		}
+	}
+
+	assert_true(max_diff <= tolerance);
+}
+
+static void check_format(enum video_format format, uint32_t threads)
+{
+	struct video_frame prev, cur, out;
+
+	video_frame_init(&prev, format, WIDTH, HEIGHT);
+	video_frame_init(&cur, format, WIDTH, HEIGHT);
+	video_frame_init(&out, format, WIDTH, HEIGHT);
+	fill_frame(&prev, format, 0);
+	fill_frame(&cur, format, 1);
+
+	for (int t = VIDEO_DEINTERLACE_DISCARD; t <= VIDEO_DEINTERLACE_YADIF_2X;
+	     t++) {
+		for (int top = 0; top < 2; top++) {
+			struct video_deinterlace_info info = {
+				format, WIDTH, HEIGHT,
+				(enum video_deinterlace_type)t, top != 0,
+				threads};
+			video_deinterlacer_t *d = NULL;
+
+			assert_int_equal(video_deinterlacer_create(&d, &info),
+					 VIDEO_DEINTERLACER_SUCCESS);
+
+			for (int frame2 = 0; frame2 < 2; frame2++) {
+				assert_true(video_deinterlacer_deinterlace(
+					d, out.data, out.linesize,
+					(const uint8_t *const *)cur.data,
+					cur.linesize,
+					(const uint8_t *const *)prev.data,
+					prev.linesize, frame2 != 0));
+
+				switch (format) {
+				case VIDEO_FORMAT_I420:
+					check_plane(&out, &cur, &prev, 0, WIDTH,
+						    HEIGHT, 1, info.type,
+						    top != 0, frame2 != 0);
+					check_plane(&out, &cur, &prev, 1,
+						    WIDTH / 2, HEIGHT / 2, 1,
+						    info.type, top != 0,
+						    frame2 != 0);
+					break;
+				case VIDEO_FORMAT_NV12:
+					check_plane(&out, &cur, &prev, 1, WIDTH,
+						    HEIGHT / 2, 2, info.type,
+						    top != 0, frame2 != 0);
+					break;
+				case VIDEO_FORMAT_BGRA:
+					check_plane(&out, &cur, &prev, 0,
+						    WIDTH * 4, HEIGHT, 4,
+						    info.type, top != 0,
+						    frame2 != 0);
+					break;
+				default:
+					break;
+				}
+			}
+
+			video_deinterlacer_destroy(d);
+		}
+	}
+
+	video_frame_free(&prev);
+	video_frame_free(&cur);
+	video_frame_free(&out);
+}
+
+static void planar_test(void **state)
+{
+	check_format(VIDEO_FORMAT_I420, 1);
+	UNUSED_PARAMETER(state);
+}
+
+static void interleaved_test(void **state)
+{
+	check_format(VIDEO_FORMAT_NV12, 1);
+	check_format(VIDEO_FORMAT_BGRA, 1);
+	UNUSED_PARAMETER(state);
+}
+
+/* slices have to give exactly the same result as a single thread */
+static void threads_test(void **state)
+{
+	struct video_frame prev, cur, out1, out2;
+	const size_t size = (size_t)WIDTH * HEIGHT * 4;
+
+	video_frame_init(&prev, VIDEO_FORMAT_BGRA, WIDTH, HEIGHT);
+	video_frame_init(&cur, VIDEO_FORMAT_BGRA, WIDTH, HEIGHT);
+	video_frame_init(&out1, VIDEO_FORMAT_BGRA, WIDTH, HEIGHT);
+	video_frame_init(&out2, VIDEO_FORMAT_BGRA, WIDTH, HEIGHT);
+	fill_frame(&prev, VIDEO_FORMAT_BGRA, 0);
+	fill_frame(&cur, VIDEO_FORMAT_BGRA, 1);
+
+	for (uint32_t threads = 2; threads <= 5; threads++) {
+		struct video_deinterlace_info info = {VIDEO_FORMAT_BGRA,
+						      WIDTH,
+						      HEIGHT,
+						      VIDEO_DEINTERLACE_YADIF,
+						      true,
+						      1};
+		video_deinterlacer_t *single = NULL;
+		video_deinterlacer_t *sliced = NULL;
+
+		assert_int_equal(video_deinterlacer_create(&single, &info),
+				 VIDEO_DEINTERLACER_SUCCESS);
+		info.threads = threads;
+		assert_int_equal(video_deinterlacer_create(&sliced, &info),
+				 VIDEO_DEINTERLACER_SUCCESS);
+
+		/* run a few times to reuse the workers */
+		for (int i = 0; i < 4; i++) {
+			video_deinterlacer_deinterlace(
+				single, out1.data, out1.linesize,
+				(const uint8_t *const *)cur.data, cur.linesize,
+				(const uint8_t *const *)prev.data,
+				prev.linesize, false);
+			memset(out2.data[0], 0, size);
+			video_deinterlacer_deinterlace(
+				sliced, out2.data, out2.linesize,
+				(const uint8_t *const *)cur.data, cur.linesize,
+				(const uint8_t *const *)prev.data,
+				prev.linesize, false);
+
+			assert_true(memcmp(out1.data[0], out2.data[0], size) ==
+				    0);
+		}
+
+		video_deinterlacer_destroy(single);
+		video_deinterlacer_destroy(sliced);
+	}
+
+	video_frame_free(&prev);
+	video_frame_free(&cur);
+	video_frame_free(&out1);
+	video_frame_free(&out2);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void bad_format_test(void **state)
+{
+	struct video_deinterlace_info info = {VIDEO_FORMAT_NONE, WIDTH,
+					      HEIGHT, VIDEO_DEINTERLACE_YADIF,
+					      true, 1};
+	video_deinterlacer_t *d = NULL;
+
+	assert_int_equal(video_deinterlacer_create(&d, &info),
+			 VIDEO_DEINTERLACER_BAD_FORMAT);
+	assert_null(d);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(planar_test),
+		cmocka_unit_test(interleaved_test),
+		cmocka_unit_test(threads_test),
+		cmocka_unit_test(bad_format_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,335 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <media-io/audio-io.h>
+#include <media-io/audio-math.h>
+
+#include "dynamics-kernels.h"
+
+/* Compares the dynamics kernels against the scalar loops the compressor,
+ * limiter and expander filters used before. */
+
+#define NUM_SAMPLES 1023
+#define SAMPLE_RATE 48000
+
+/* envelopes are computed with the same operations as the scalar code */
+#define ENVELOPE_TOLERANCE 1e-6f
+
+static float buffers[MAX_AUDIO_CHANNELS][NUM_SAMPLES];
+static float expected[MAX_AUDIO_CHANNELS][NUM_SAMPLES];
+static float envelope[MAX_AUDIO_CHANNELS][NUM_SAMPLES];
+static float ref_envelope[MAX_AUDIO_CHANNELS][NUM_SAMPLES];
+
+static uint32_t seed = 1;
+
+static float random_sample(void)
+{
+	seed = seed * 1664525 + 1013904223;
+	return (float)(seed >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+/* noise with a level sweeping from -80 dB to +6 dB, different for every
+ * channel, with some silence */
+static void generate(float **samples, size_t num_channels)
+{
+	for (size_t c = 0; c < num_channels; c++) {
+		samples[c] = buffers[c];
+
+		for (size_t i = 0; i < NUM_SAMPLES; i++) {
+			float db = -80.0f + 86.0f * (float)((i + c * 97) %
+							     NUM_SAMPLES) /
+						    NUM_SAMPLES;
+			bool silent = (i / 128 + c) % 5 == 0;
+
+			buffers[c][i] =
+				silent ? 0.0f : random_sample() * db_to_mul(db);
+		}
+	}
+}
+
+static void assert_close(float value, float expected_value, float tolerance)
+{
+	float diff = fabsf(value - expected_value);
+	assert_true(diff <= fabsf(expected_value) * tolerance + 1e-12f);
+}
+
+/* allowed relative error of a sample multiplied by the computed gain */
+static float gain_tolerance(void)
+{
+	return db_to_mul(DYNAMICS_MAX_GAIN_ERROR_DB) - 1.0f;
+}
+
+/* -------------------------------------------------------- */
+/* reference implementations                                 */
+
+static void ref_peak_envelope(float *env_buf, float **samples,
+			      size_t num_channels, size_t num_samples,
+			      float start_env, float attack_gain,
+			      float release_gain)
+{
+	memset(env_buf, 0, num_samples * sizeof(env_buf[0]));
+	for (size_t chan = 0; chan < num_channels; ++chan) {
+		if (!samples[chan])
+			continue;
+
+		float env = start_env;
+		for (size_t i = 0; i < num_samples; ++i) {
+			const float env_in = fabsf(samples[chan][i]);
+			if (env < env_in) {
+				env = env_in + attack_gain * (env - env_in);
+			} else {
+				env = env_in + release_gain * (env - env_in);
+			}
+			env_buf[i] = fmaxf(env_buf[i], env);
+		}
+	}
+}
+
+static void ref_compress(float **samples, const float *env_buf,
+			 size_t num_channels, size_t num_samples,
+			 float threshold, float slope, float output_gain)
+{
+	for (size_t i = 0; i < num_samples; ++i) {
+		const float env_db = mul_to_db(env_buf[i]);
+		float gain = slope * (threshold - env_db);
+		gain = db_to_mul(fminf(0, gain));
+
+		for (size_t c = 0; c < num_channels; ++c) {
+			if (samples[c]) {
+				samples[c][i] *= gain * output_gain;
+			}
+		}
+	}
+}
+
+static void ref_rms_envelope(float **env_buf, float **samples,
+			     float *runave, size_t num_channels,
+			     size_t num_samples, float rmscoef)
+{
+	for (size_t chan = 0; chan < num_channels; ++chan) {
+		if (!samples[chan])
+			continue;
+
+		float ave = runave[chan];
+		for (size_t i = 0; i < num_samples; ++i) {
+			ave = rmscoef * ave +
+			      (1 - rmscoef) * powf(samples[chan][i], 2.0f);
+			env_buf[chan][i] = sqrtf(ave);
+		}
+		runave[chan] = ave;
+	}
+}
+
+static void ref_expand(float *samples, const float *env_buf,
+		       size_t num_samples, float threshold, float slope,
+		       float attack_gain, float release_gain,
+		       float output_gain)
+{
+	float prev = 0.0f;
+
+	for (size_t i = 0; i < num_samples; ++i) {
+		float env_db = mul_to_db(env_buf[i]);
+		float gain = threshold - env_db > 0.0f
+				     ? fmaxf(slope * (threshold - env_db),
+					     -60.0f)
+				     : 0.0f;
+		if (gain > prev)
+			prev = attack_gain * prev + (1.0f - attack_gain) * gain;
+		else
+			prev = release_gain * prev +
+			       (1.0f - release_gain) * gain;
+
+		gain = db_to_mul(fminf(0, prev));
+		samples[i] *= gain * output_gain;
+	}
+}
+
+/* -------------------------------------------------------- */
+
+static float gain_coefficient(float time)
+{
+	return expf(-1.0f / (SAMPLE_RATE * time));
+}
+
+static void peak_envelope_test(void **state)
+{
+	const float attack_gain = gain_coefficient(0.006f);
+	const float release_gain = gain_coefficient(0.06f);
+	float *samples[MAX_AUDIO_CHANNELS];
+
+	for (size_t channels = 1; channels <= MAX_AUDIO_CHANNELS; channels++) {
+		generate(samples, channels);
+		if (channels > 2)
+			samples[1] = NULL;
+
+		ref_peak_envelope(ref_envelope[0], samples, channels,
+				  NUM_SAMPLES, 0.25f, attack_gain,
+				  release_gain);
+		dynamics_peak_envelope(envelope[0], samples, channels,
+				       NUM_SAMPLES, 0.25f, attack_gain,
+				       release_gain);
+
+		for (size_t i = 0; i < NUM_SAMPLES; i++)
+			assert_close(envelope[0][i], ref_envelope[0][i],
+				     ENVELOPE_TOLERANCE);
+	}
+
+	UNUSED_PARAMETER(state);
+}
+
+static void compress_test(void **state)
+{
+	const float attack_gain = gain_coefficient(0.001f);
+	const float release_gain = gain_coefficient(0.05f);
+	const float ratios[] = {1.0f, 4.0f, 32.0f};
+	const float thresholds[] = {-60.0f, -18.0f, 0.0f};
+	float *samples[MAX_AUDIO_CHANNELS];
+	float *ref_samples[MAX_AUDIO_CHANNELS];
+
+	for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++) {
+		for (size_t t = 0; t < sizeof(thresholds) / sizeof(float);
+		     t++) {
+			const float slope = 1.0f - 1.0f / ratios[r];
+			const size_t channels = 6;
+
+			generate(samples, channels);
+			samples[3] = NULL;
+
+			for (size_t c = 0; c < channels; c++) {
+				ref_samples[c] = samples[c] ? expected[c]
+							    : NULL;
+				if (samples[c])
+					memcpy(expected[c], samples[c],
+					       sizeof(expected[c]));
+			}
+
+			dynamics_peak_envelope(envelope[0], samples, channels,
+					       NUM_SAMPLES, 0.0f, attack_gain,
+					       release_gain);
+			ref_compress(ref_samples, envelope[0], channels,
+				     NUM_SAMPLES, thresholds[t], slope, 1.5f);
+			dynamics_compress(samples, envelope[0], channels,
+					  NUM_SAMPLES, thresholds[t], slope,
+					  1.5f);
+
+			for (size_t c = 0; c < channels; c++) {
+				if (!samples[c])
+					continue;
+
+				for (size_t i = 0; i < NUM_SAMPLES; i++)
+					assert_close(samples[c][i],
+						     expected[c][i],
+						     gain_tolerance());
+			}
+		}
+	}
+
+	UNUSED_PARAMETER(state);
+}
+
+static void rms_envelope_test(void **state)
+{
+	const float rmscoef = exp2f(-100.0f / SAMPLE_RATE);
+	float *samples[MAX_AUDIO_CHANNELS];
+	float *env[MAX_AUDIO_CHANNELS];
+	float *ref_env[MAX_AUDIO_CHANNELS];
+	float runave[MAX_AUDIO_CHANNELS];
+	float ref_runave[MAX_AUDIO_CHANNELS];
+
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+		env[c] = envelope[c];
+		ref_env[c] = ref_envelope[c];
+		runave[c] = ref_runave[c] = 0.01f * (float)c;
+	}
+
+	for (size_t channels = 1; channels <= MAX_AUDIO_CHANNELS; channels++) {
+		generate(samples, channels);
+		samples[channels - 1] = channels > 4 ? NULL : samples[0];
+
+		ref_rms_envelope(ref_env, samples, ref_runave, channels,
+				 NUM_SAMPLES, rmscoef);
+		dynamics_rms_envelope(env, samples, runave, channels,
+				      NUM_SAMPLES, rmscoef);
+
+		for (size_t c = 0; c < channels; c++) {
+			if (!samples[c])
+				continue;
+
+			assert_close(runave[c], ref_runave[c],
+				     ENVELOPE_TOLERANCE);
+			for (size_t i = 0; i < NUM_SAMPLES; i++)
+				assert_close(env[c][i], ref_env[c][i],
+					     ENVELOPE_TOLERANCE);
+		}
+	}
+
+	UNUSED_PARAMETER(state);
+}
+
+static void expand_test(void **state)
+{
+	const float rmscoef = exp2f(-100.0f / SAMPLE_RATE);
+	const float attack_gain = gain_coefficient(0.01f);
+	const float release_gain = gain_coefficient(0.05f);
+	const float ratios[] = {1.0f, 2.0f, 20.0f};
+	const float thresholds[] = {-60.0f, -40.0f, 0.0f};
+	float *samples[1];
+	float *env[1] = {envelope[0]};
+	float gain_db[NUM_SAMPLES];
+
+	for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++) {
+		for (size_t t = 0; t < sizeof(thresholds) / sizeof(float);
+		     t++) {
+			const float slope = 1.0f - ratios[r];
+			float runave = 0.0f;
+			float prev = 0.0f;
+
+			generate(samples, 1);
+			memcpy(expected[0], samples[0], sizeof(expected[0]));
+
+			dynamics_rms_envelope(env, samples, &runave, 1,
+					      NUM_SAMPLES, rmscoef);
+			ref_expand(expected[0], envelope[0], NUM_SAMPLES,
+				   thresholds[t], slope, attack_gain,
+				   release_gain, 0.5f);
+
+			dynamics_expander_gain(gain_db, envelope[0],
+					       NUM_SAMPLES, thresholds[t],
+					       slope);
+			for (size_t i = 0; i < NUM_SAMPLES; i++) {
+				const float gain = gain_db[i];
+				const float coef = gain > prev ? attack_gain
+							       : release_gain;
+
+				prev = coef * prev + (1.0f - coef) * gain;
+				gain_db[i] = prev;
+			}
+			dynamics_apply_gain_db(samples[0], gain_db,
+					       NUM_SAMPLES, 0.5f);
+
+			for (size_t i = 0; i < NUM_SAMPLES; i++)
+				assert_close(samples[0][i], expected[0][i],
+					     gain_tolerance());
+		}
+	}
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(peak_envelope_test),
+		cmocka_unit_test(compress_test),
+		cmocka_unit_test(rms_envelope_test),
+		cmocka_unit_test(expand_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,147 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <graphics/image-file.h>
+
+/* Plays a small animated gif through the frame budget ring, which decodes
+ * frames on a worker thread, and checks that the displayed frame moves. */
+
+#define NUM_FRAMES 3
+#define FRAME_TIME_NS 100000000ULL
+#define WAIT_MS 2000
+
+static const uint8_t gif_header[] = {
+	'G', 'I', 'F', '8', '9', 'a',
+	/* 1x1, global color table of 4 colors */
+	0x01, 0x00, 0x01, 0x00, 0x81, 0x00, 0x00,
+	/* color table */
+	0xFF, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+	/* loop forever */
+	0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+	0x03, 0x01, 0x00, 0x00, 0x00};
+
+static const char *gif_path = "test_image_file.gif";
+
+/* writes a gif whose frame i is a single pixel of color i, each displayed for
+ * 100 ms */
+static int write_gif(void **state)
+{
+	FILE *file = fopen(gif_path, "wb");
+	if (!file)
+		return -1;
+
+	fwrite(gif_header, 1, sizeof(gif_header), file);
+
+	for (uint8_t i = 0; i < NUM_FRAMES; i++) {
+		/* a 3-bit clear code, the pixel, and the end code */
+		const uint16_t codes = 4 | (i << 3) | (5 << 6);
+		const uint8_t frame[] = {
+			/* graphic control extension, 10 hundredths delay */
+			0x21, 0xF9, 0x04, 0x00, 0x0A, 0x00, 0x00, 0x00,
+			/* image descriptor */
+			0x2C, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00,
+			0x00,
+			/* image data */
+			0x02, 0x02, (uint8_t)codes, (uint8_t)(codes >> 8),
+			0x00};
+
+		fwrite(frame, 1, sizeof(frame), file);
+	}
+
+	fputc(0x3B, file);
+	fclose(file);
+
+	UNUSED_PARAMETER(state);
+	return 0;
+}
+
+static int remove_gif(void **state)
+{
+	os_unlink(gif_path);
+	UNUSED_PARAMETER(state);
+	return 0;
+}
+
+/* ticks until the frame ring has caught up with the wanted frame */
+static bool wait_for_frame(gs_image_file_t *image, uint64_t elapsed)
+{
+	if (gs_image_file_tick(image, elapsed))
+		return true;
+
+	for (int i = 0; i < WAIT_MS; i++) {
+		os_sleep_ms(1);
+		if (gs_image_file_tick(image, 0))
+			return true;
+	}
+
+	return false;
+}
+
+static void play_gif(uint32_t gif_frame_budget)
+{
+	gs_image_file2_t if2;
+
+	gs_image_file2_init_gif_budget(&if2, gif_path, gif_frame_budget);
+	assert_true(if2.image.loaded);
+	assert_true(if2.image.is_animated_gif);
+	assert_int_equal(if2.image.gif.frame_count, NUM_FRAMES);
+	assert_non_null(if2.image.gif_stream);
+	assert_int_equal(if2.image.cur_frame, 0);
+
+	/* twice through the animation, so the ring is reused after looping */
+	for (int i = 1; i <= NUM_FRAMES * 2; i++) {
+		assert_true(wait_for_frame(&if2.image, FRAME_TIME_NS + 1));
+		assert_int_equal(if2.image.cur_frame, i % NUM_FRAMES);
+	}
+
+	/* the frame stays put until its time is up */
+	assert_false(gs_image_file_tick(&if2.image, FRAME_TIME_NS / 2));
+
+	gs_image_file2_free(&if2);
+}
+
+static void frame_budget_test(void **state)
+{
+	play_gif(2);
+	UNUSED_PARAMETER(state);
+}
+
+static void small_frame_budget_test(void **state)
+{
+	/* a budget of 1 leaves no room to decode ahead, so it is raised */
+	play_gif(1);
+	UNUSED_PARAMETER(state);
+}
+
+static void full_decode_test(void **state)
+{
+	gs_image_file2_t if2;
+
+	gs_image_file2_init_gif_budget(&if2, gif_path, 0);
+	assert_true(if2.image.loaded);
+	assert_null(if2.image.gif_stream);
+
+	assert_true(gs_image_file_tick(&if2.image, FRAME_TIME_NS + 1));
+	assert_int_equal(if2.image.cur_frame, 1);
+
+	gs_image_file2_free(&if2);
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(frame_budget_test),
+		cmocka_unit_test(small_frame_budget_test),
+		cmocka_unit_test(full_decode_test),
+	};
+
+	return cmocka_run_group_tests(tests, write_gif, remove_gif);
+}
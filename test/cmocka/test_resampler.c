@@ -0,0 +1,232 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <media-io/audio-resampler.h>
+
+/* Runs the native resampler on sine waves and compares its output to the
+ * ideal signal at the timestamps it reports. */
+
+#define PI 3.14159265358979323846
+
+/* blocks of 10 ms for one second, skipping the first 50 ms */
+#define NUM_BLOCKS 100
+#define SKIP_BLOCKS 5
+
+struct sine_result {
+	double signal;
+	double error;
+	uint64_t frames;
+};
+
+static double sine(double freq, double t)
+{
+	return 0.5 * sin(2.0 * PI * freq * t);
+}
+
+static void run_sine(struct sine_result *result, uint32_t in_rate,
+		     uint32_t out_rate, double freq, enum audio_format format)
+{
+	const struct resample_info src = {in_rate, AUDIO_FORMAT_FLOAT_PLANAR,
+					  SPEAKERS_STEREO};
+	const struct resample_info dst = {out_rate, format, SPEAKERS_STEREO};
+	const uint32_t in_frames = in_rate / 100;
+	const bool planar = format == AUDIO_FORMAT_FLOAT_PLANAR;
+	float left[4800];
+	float right[4800];
+	const uint8_t *input[2] = {(uint8_t *)left, (uint8_t *)right};
+	audio_resampler_t *rs;
+
+	audio_resampler_set_type(AUDIO_RESAMPLER_NATIVE);
+	rs = audio_resampler_create(&dst, &src);
+	assert_non_null(rs);
+
+	memset(result, 0, sizeof(*result));
+
+	for (uint32_t block = 0; block < NUM_BLOCKS; block++) {
+		uint8_t *output[MAX_AV_PLANES] = {0};
+		uint64_t first = (uint64_t)block * in_frames;
+		uint64_t ts_offset;
+		uint32_t out_frames;
+		double start;
+
+		for (uint32_t i = 0; i < in_frames; i++) {
+			double t = (double)(first + i) / in_rate;
+			left[i] = (float)sine(freq, t);
+			right[i] = -left[i];
+		}
+
+		assert_true(audio_resampler_resample(rs, output, &out_frames,
+						     &ts_offset, input,
+						     in_frames));
+		result->frames += out_frames;
+
+		if (block < SKIP_BLOCKS)
+			continue;
+
+		start = (double)first / in_rate - (double)ts_offset / 1e9;
+
+		for (uint32_t i = 0; i < out_frames; i++) {
+			const float *l = (const float *)output[0];
+			const float *r = (const float *)output[planar ? 1 : 0];
+			double t = start + (double)i / out_rate;
+			double expected = sine(freq, t);
+			float out_l = planar ? l[i] : l[i * 2];
+			float out_r = planar ? r[i] : r[i * 2 + 1];
+
+			result->signal += expected * expected * 2.0;
+			result->error += (out_l - expected) * (out_l - expected);
+			result->error += (out_r + expected) * (out_r + expected);
+		}
+	}
+
+	audio_resampler_destroy(rs);
+	audio_resampler_set_type(AUDIO_RESAMPLER_SWRESAMPLE);
+}
+
+static double snr_db(const struct sine_result *result)
+{
+	return 10.0 * log10(result->signal / result->error);
+}
+
+static void check_rates(uint32_t in_rate, uint32_t out_rate)
+{
+	/* relative to the lower sample rate, up to the end of the passband */
+	const double freqs[] = {0.01, 0.1, 0.35};
+	const uint32_t rate = in_rate < out_rate ? in_rate : out_rate;
+	const uint64_t expected = (uint64_t)NUM_BLOCKS * out_rate / 100;
+	struct sine_result result;
+
+	for (size_t i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++) {
+		run_sine(&result, in_rate, out_rate, freqs[i] * rate,
+			 AUDIO_FORMAT_FLOAT_PLANAR);
+
+		/* all of the output is accounted for, apart from what is
+		 * still buffered in the filter */
+		assert_true(result.frames <= expected);
+		assert_true(result.frames + out_rate / 100 >= expected);
+
+		assert_true(snr_db(&result) > 70.0);
+	}
+}
+
+static void upsample_test(void **state)
+{
+	check_rates(44100, 48000);
+	check_rates(32000, 48000);
+	check_rates(22050, 44100);
+	UNUSED_PARAMETER(state);
+}
+
+static void downsample_test(void **state)
+{
+	check_rates(48000, 44100);
+	check_rates(96000, 48000);
+	UNUSED_PARAMETER(state);
+}
+
+static void same_rate_test(void **state)
+{
+	struct sine_result result;
+
+	run_sine(&result, 48000, 48000, 1000.0, AUDIO_FORMAT_FLOAT);
+	assert_int_equal(result.frames, NUM_BLOCKS * 480);
+	assert_true(snr_db(&result) > 120.0);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void packed_output_test(void **state)
+{
+	struct sine_result result;
+
+	run_sine(&result, 44100, 48000, 1000.0, AUDIO_FORMAT_FLOAT);
+	assert_true(snr_db(&result) > 70.0);
+
+	UNUSED_PARAMETER(state);
+}
+
+/* constant levels on every channel, to check the remix matrices */
+static void remix(enum speaker_layout out_layout,
+		  enum speaker_layout in_layout, float *levels)
+{
+	const struct resample_info src = {48000, AUDIO_FORMAT_16BIT,
+					  in_layout};
+	const struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+					  out_layout};
+	const uint32_t in_ch = get_audio_channels(in_layout);
+	int16_t samples[16 * MAX_AUDIO_CHANNELS];
+	const uint8_t *input[1] = {(uint8_t *)samples};
+	uint8_t *output[MAX_AV_PLANES] = {0};
+	uint64_t ts_offset;
+	uint32_t out_frames;
+	audio_resampler_t *rs;
+
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t c = 0; c < in_ch; c++)
+			samples[i * in_ch + c] = (int16_t)(1024 * (c + 1));
+
+	audio_resampler_set_type(AUDIO_RESAMPLER_NATIVE);
+	rs = audio_resampler_create(&dst, &src);
+	assert_non_null(rs);
+	assert_true(audio_resampler_resample(rs, output, &out_frames,
+					     &ts_offset, input, 16));
+	assert_int_equal(out_frames, 16);
+	assert_int_equal(ts_offset, 0);
+
+	for (uint32_t c = 0; c < get_audio_channels(out_layout); c++)
+		levels[c] = ((const float *)output[c])[15] * 32.0f;
+
+	audio_resampler_destroy(rs);
+	audio_resampler_set_type(AUDIO_RESAMPLER_SWRESAMPLE);
+}
+
+static void assert_level(float level, float expected)
+{
+	assert_true(fabsf(level - expected) < 1e-4f);
+}
+
+static void remix_test(void **state)
+{
+	const float sqrt1_2 = 0.70710678f;
+	float levels[MAX_AUDIO_CHANNELS];
+
+	/* channel n has a level of n + 1 */
+	remix(SPEAKERS_STEREO, SPEAKERS_MONO, levels);
+	assert_level(levels[0], 1.0f);
+	assert_level(levels[1], 1.0f);
+
+	remix(SPEAKERS_MONO, SPEAKERS_STEREO, levels);
+	assert_level(levels[0], 3.0f * sqrt1_2);
+
+	/* FL FR FC LFE BL BR */
+	remix(SPEAKERS_STEREO, SPEAKERS_5POINT1, levels);
+	assert_level(levels[0], 1.0f + (3.0f + 5.0f) * sqrt1_2);
+	assert_level(levels[1], 2.0f + (3.0f + 6.0f) * sqrt1_2);
+
+	/* FL FR FC LFE BL BR SL SR */
+	remix(SPEAKERS_5POINT1, SPEAKERS_7POINT1, levels);
+	assert_level(levels[2], 3.0f);
+	assert_level(levels[3], 4.0f);
+	assert_level(levels[4], 5.0f + 7.0f);
+	assert_level(levels[5], 6.0f + 8.0f);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(upsample_test),
+		cmocka_unit_test(downsample_test),
+		cmocka_unit_test(same_rate_test),
+		cmocka_unit_test(packed_output_test),
+		cmocka_unit_test(remix_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,328 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+
+#include <util/bmem.h>
+#include <media-io/video-unpack.h>
+#include <media-io/video-frame.h>
+
+/* Unpacks frames made of known colors and checks the result against their
+ * reference RGB values.  Every 2x2 block has a single color so that
+ * subsampled chroma is the same whatever the format is. */
+
+#define WIDTH 32
+#define HEIGHT 16
+#define MAX_DIFF 2
+
+struct ref_color {
+	uint8_t y, u, v, a;
+	uint8_t r, g, b;
+};
+
+/* 100% colors of BT.709 */
+static const struct ref_color limited_colors[] = {
+	{16, 128, 128, 255, 0, 0, 0},
+	{235, 128, 128, 128, 255, 255, 255},
+	{126, 128, 128, 0, 128, 128, 128},
+	{63, 102, 240, 64, 255, 0, 0},
+	{173, 42, 26, 192, 0, 255, 0},
+	{32, 240, 118, 255, 0, 0, 255},
+};
+
+static const struct ref_color full_colors[] = {
+	{0, 128, 128, 255, 0, 0, 0},
+	{255, 128, 128, 128, 255, 255, 255},
+	{128, 128, 128, 0, 128, 128, 128},
+	{54, 99, 255, 64, 255, 0, 0},
+	{182, 30, 12, 192, 0, 255, 0},
+	{18, 255, 116, 255, 0, 0, 255},
+};
+
+#define NUM_COLORS (sizeof(limited_colors) / sizeof(limited_colors[0]))
+
+/* levels of RGB and greyscale frames, and what they expand to when they are
+ * limited range */
+static const uint8_t levels[] = {16, 235, 126, 0, 255, 40};
+static const uint8_t expanded_levels[] = {0, 255, 128, 0, 255, 28};
+
+#define NUM_LEVELS (sizeof(levels) / sizeof(levels[0]))
+
+static inline size_t block_index(uint32_t x, uint32_t y, size_t count)
+{
+	return (x / 2 + y / 2) % count;
+}
+
+static inline void store(struct video_frame *frame, size_t plane, uint32_t x,
+			 uint32_t y, uint8_t val)
+{
+	frame->data[plane][y * frame->linesize[plane] + x] = val;
+}
+
+static void store_yuv(struct video_frame *f, enum video_format format,
+		      uint32_t x, uint32_t y, const struct ref_color *c)
+{
+	const uint32_t pair = x / 2 * 4;
+
+	switch (format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_I40A:
+		store(f, 0, x, y, c->y);
+		store(f, 1, x / 2, y / 2, c->u);
+		store(f, 2, x / 2, y / 2, c->v);
+		if (format == VIDEO_FORMAT_I40A)
+			store(f, 3, x, y, c->a);
+		break;
+
+	case VIDEO_FORMAT_I422:
+		store(f, 0, x, y, c->y);
+		store(f, 1, x / 2, y, c->u);
+		store(f, 2, x / 2, y, c->v);
+		break;
+
+	case VIDEO_FORMAT_I444:
+		store(f, 0, x, y, c->y);
+		store(f, 1, x, y, c->u);
+		store(f, 2, x, y, c->v);
+		break;
+
+	case VIDEO_FORMAT_NV12:
+		store(f, 0, x, y, c->y);
+		store(f, 1, x / 2 * 2, y / 2, c->u);
+		store(f, 1, x / 2 * 2 + 1, y / 2, c->v);
+		break;
+
+	case VIDEO_FORMAT_YUY2:
+		store(f, 0, pair + (x % 2 ? 2 : 0), y, c->y);
+		store(f, 0, pair + 1, y, c->u);
+		store(f, 0, pair + 3, y, c->v);
+		break;
+
+	case VIDEO_FORMAT_YVYU:
+		store(f, 0, pair + (x % 2 ? 2 : 0), y, c->y);
+		store(f, 0, pair + 1, y, c->v);
+		store(f, 0, pair + 3, y, c->u);
+		break;
+
+	case VIDEO_FORMAT_UYVY:
+		store(f, 0, pair + (x % 2 ? 3 : 1), y, c->y);
+		store(f, 0, pair, y, c->u);
+		store(f, 0, pair + 2, y, c->v);
+		break;
+
+	case VIDEO_FORMAT_AYUV:
+		store(f, 0, x * 4, y, c->v);
+		store(f, 0, x * 4 + 1, y, c->u);
+		store(f, 0, x * 4 + 2, y, c->y);
+		store(f, 0, x * 4 + 3, y, c->a);
+		break;
+
+	default:
+		fail();
+	}
+}
+
+/* greyscale gets one level, BGR a different level for each component */
+static void store_rgb(struct video_frame *f, enum video_format format,
+		      uint32_t x, uint32_t y, size_t level, uint8_t alpha)
+{
+	switch (format) {
+	case VIDEO_FORMAT_Y800:
+		store(f, 0, x, y, levels[level]);
+		break;
+
+	case VIDEO_FORMAT_BGR3:
+	case VIDEO_FORMAT_BGRA:
+		for (size_t c = 0; c < 3; c++) {
+			const uint32_t bpp = format == VIDEO_FORMAT_BGR3 ? 3
+									 : 4;
+			store(f, 0, x * bpp + 2 - (uint32_t)c, y,
+			      levels[(level + c) % NUM_LEVELS]);
+		}
+		if (format == VIDEO_FORMAT_BGRA)
+			store(f, 0, x * 4 + 3, y, alpha);
+		break;
+
+	default:
+		fail();
+	}
+}
+
+static inline bool is_rgb(enum video_format format)
+{
+	return format == VIDEO_FORMAT_Y800 || format == VIDEO_FORMAT_BGR3 ||
+	       format == VIDEO_FORMAT_BGRA;
+}
+
+static void get_expected(enum video_format format, bool full_range,
+			 uint32_t x, uint32_t y, uint8_t bgra[4])
+{
+	const bool has_alpha = video_unpack_format(format) ==
+			       VIDEO_FORMAT_BGRA;
+
+	if (is_rgb(format)) {
+		const uint8_t *out = full_range ? levels : expanded_levels;
+		const size_t level = block_index(x, y, NUM_LEVELS);
+		const bool grey = format == VIDEO_FORMAT_Y800;
+
+		for (size_t c = 0; c < 3; c++)
+			bgra[2 - c] = out[(level + (grey ? 0 : c)) % NUM_LEVELS];
+		bgra[3] = has_alpha ? limited_colors[level % NUM_COLORS].a
+				    : 255;
+	} else {
+		const struct ref_color *colors = full_range ? full_colors
+							    : limited_colors;
+		const struct ref_color *c = &colors[block_index(x, y,
+								 NUM_COLORS)];
+
+		bgra[0] = c->b;
+		bgra[1] = c->g;
+		bgra[2] = c->r;
+		bgra[3] = has_alpha ? c->a : 255;
+	}
+}
+
+static void fill_frame(struct video_frame *frame, enum video_format format,
+		       bool full_range)
+{
+	const struct ref_color *colors = full_range ? full_colors
+						    : limited_colors;
+
+	for (uint32_t y = 0; y < HEIGHT; y++) {
+		for (uint32_t x = 0; x < WIDTH; x++) {
+			if (is_rgb(format)) {
+				const size_t level =
+					block_index(x, y, NUM_LEVELS);
+				store_rgb(frame, format, x, y, level,
+					  limited_colors[level % NUM_COLORS].a);
+			} else {
+				store_yuv(frame, format, x, y,
+					  &colors[block_index(x, y,
+							      NUM_COLORS)]);
+			}
+		}
+	}
+}
+
+static void check_output(const struct video_frame *out,
+			 enum video_format format, bool full_range)
+{
+	for (uint32_t y = 0; y < HEIGHT; y++) {
+		for (uint32_t x = 0; x < WIDTH; x++) {
+			const uint8_t *px =
+				out->data[0] + y * out->linesize[0] + x * 4;
+			uint8_t expected[4];
+
+			get_expected(format, full_range, x, y, expected);
+			for (size_t c = 0; c < 4; c++)
+				assert_in_range(abs(px[c] - expected[c]), 0,
+						MAX_DIFF);
+		}
+	}
+}
+
+/* each slice count has to give the reference colors */
+static void check_format(enum video_format format, bool full_range)
+{
+	const enum video_range_type range = full_range ? VIDEO_RANGE_FULL
+						       : VIDEO_RANGE_PARTIAL;
+	struct video_frame in, out;
+	float matrix[16];
+	float range_min[3];
+	float range_max[3];
+
+	assert_true(video_format_get_parameters(VIDEO_CS_709, range, matrix,
+						range_min, range_max));
+	video_frame_init(&in, format, WIDTH, HEIGHT);
+	video_frame_init(&out, video_unpack_format(format), WIDTH, HEIGHT);
+	fill_frame(&in, format, full_range);
+
+	for (uint32_t threads = 1; threads <= 4; threads++) {
+		struct video_unpack_info info = {format, WIDTH, HEIGHT,
+						 threads};
+		video_unpacker_t *u = NULL;
+
+		memset(out.data[0], 0, out.linesize[0] * HEIGHT);
+
+		assert_int_equal(video_unpacker_create(&u, &info),
+				 VIDEO_UNPACKER_SUCCESS);
+		assert_true(video_unpacker_unpack(
+			u, out.data[0], out.linesize[0],
+			(const uint8_t *const *)in.data, in.linesize, matrix,
+			full_range ? NULL : range_min,
+			full_range ? NULL : range_max));
+		video_unpacker_destroy(u);
+
+		check_output(&out, format, full_range);
+	}
+
+	video_frame_free(&in);
+	video_frame_free(&out);
+}
+
+static void planar_test(void **state)
+{
+	check_format(VIDEO_FORMAT_I420, false);
+	check_format(VIDEO_FORMAT_I420, true);
+	check_format(VIDEO_FORMAT_I422, false);
+	check_format(VIDEO_FORMAT_I444, true);
+	check_format(VIDEO_FORMAT_I40A, false);
+	check_format(VIDEO_FORMAT_NV12, false);
+	UNUSED_PARAMETER(state);
+}
+
+static void packed_test(void **state)
+{
+	check_format(VIDEO_FORMAT_YUY2, false);
+	check_format(VIDEO_FORMAT_YUY2, true);
+	check_format(VIDEO_FORMAT_YVYU, false);
+	check_format(VIDEO_FORMAT_UYVY, false);
+	check_format(VIDEO_FORMAT_AYUV, false);
+	UNUSED_PARAMETER(state);
+}
+
+static void rgb_test(void **state)
+{
+	check_format(VIDEO_FORMAT_Y800, false);
+	check_format(VIDEO_FORMAT_Y800, true);
+	check_format(VIDEO_FORMAT_BGR3, false);
+	check_format(VIDEO_FORMAT_BGR3, true);
+	check_format(VIDEO_FORMAT_BGRA, true);
+	UNUSED_PARAMETER(state);
+}
+
+static void create_test(void **state)
+{
+	struct video_unpack_info info = {VIDEO_FORMAT_NONE, WIDTH, HEIGHT, 1};
+	video_unpacker_t *u = NULL;
+
+	assert_int_equal(video_unpacker_create(&u, &info),
+			 VIDEO_UNPACKER_BAD_FORMAT);
+	info.format = VIDEO_FORMAT_I420;
+	info.height = 0;
+	assert_int_equal(video_unpacker_create(&u, &info),
+			 VIDEO_UNPACKER_BAD_FORMAT);
+	assert_int_equal(video_unpacker_create(&u, NULL),
+			 VIDEO_UNPACKER_FAILED);
+	assert_null(u);
+
+	assert_false(video_unpacker_unpack(NULL, NULL, 0, NULL, NULL, NULL,
+					   NULL, NULL));
+	video_unpacker_destroy(NULL);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(planar_test),
+		cmocka_unit_test(packed_test),
+		cmocka_unit_test(rgb_test),
+		cmocka_unit_test(create_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,216 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/video-queue.h>
+
+#define WIDTH 16
+#define HEIGHT 16
+#define MAX_FRAMES 4
+
+/* Stands in for an encoder: records the pts of every frame it is given, and
+ * can fail or block on a given frame. */
+struct encoder {
+	video_queue_t *queue;
+	int64_t pts[64];
+	size_t frames;
+
+	int64_t fail_pts;
+	int64_t stop_pts;
+	bool stopped;
+
+	os_event_t *started;
+	os_event_t *release;
+};
+
+static bool encode(void *param, struct video_frame *frame, int64_t pts)
+{
+	struct encoder *enc = param;
+
+	assert_non_null(frame->data[0]);
+	enc->pts[enc->frames++] = pts;
+
+	if (enc->started) {
+		os_event_signal(enc->started);
+		os_event_wait(enc->release);
+	} else {
+		os_sleep_ms(2);
+	}
+
+	if (pts == enc->stop_pts)
+		enc->stopped = video_queue_stop(enc->queue);
+	return pts != enc->fail_pts;
+}
+
+static void create_queue(struct encoder *enc, enum video_queue_drop drop)
+{
+	struct video_queue_info info = {
+		.max_frames = MAX_FRAMES,
+		.drop = drop,
+		.format = VIDEO_FORMAT_I420,
+		.width = WIDTH,
+		.height = HEIGHT,
+		.callback = encode,
+		.param = enc,
+	};
+
+	memset(enc, 0, sizeof(*enc));
+	enc->fail_pts = -1;
+	enc->stop_pts = -1;
+	enc->queue = video_queue_create(&info);
+	assert_non_null(enc->queue);
+}
+
+static bool push(struct encoder *enc, int64_t pts)
+{
+	struct video_frame frame;
+	struct video_data data = {0};
+	bool queued;
+
+	video_frame_init(&frame, VIDEO_FORMAT_I420, WIDTH, HEIGHT);
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		data.data[i] = frame.data[i];
+		data.linesize[i] = frame.linesize[i];
+	}
+
+	queued = video_queue_push(enc->queue, &data, pts);
+	video_frame_free(&frame);
+	return queued;
+}
+
+static void stop_test(void **state)
+{
+	struct encoder enc;
+
+	/* every frame queued before the stop is still encoded */
+	create_queue(&enc, VIDEO_QUEUE_DROP_NEWEST);
+	for (int64_t i = 0; i < MAX_FRAMES; i++)
+		assert_true(push(&enc, i));
+
+	assert_true(video_queue_stop(enc.queue));
+	assert_int_equal(enc.frames, MAX_FRAMES);
+	for (size_t i = 0; i < enc.frames; i++)
+		assert_int_equal(enc.pts[i], i);
+	assert_int_equal(video_queue_get_depth(enc.queue), 0);
+
+	/* and nothing is taken after it */
+	assert_false(push(&enc, MAX_FRAMES));
+	video_queue_destroy(enc.queue);
+	assert_int_equal(enc.frames, MAX_FRAMES);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void error_test(void **state)
+{
+	struct encoder enc;
+
+	/* an error drops the rest */
+	create_queue(&enc, VIDEO_QUEUE_DROP_NEWEST);
+	enc.fail_pts = 1;
+	for (int64_t i = 0; i < MAX_FRAMES; i++)
+		push(&enc, i);
+
+	video_queue_destroy(enc.queue);
+	assert_int_equal(enc.frames, 2);
+
+	/* so does stopping from the callback, as encode errors do */
+	create_queue(&enc, VIDEO_QUEUE_DROP_NEWEST);
+	enc.stop_pts = 1;
+	for (int64_t i = 0; i < MAX_FRAMES; i++)
+		push(&enc, i);
+
+	video_queue_destroy(enc.queue);
+	assert_int_equal(enc.frames, 2);
+	assert_false(enc.stopped);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void drop(enum video_queue_drop policy, const int64_t *expected)
+{
+	struct video_queue_stats stats;
+	struct encoder enc;
+	os_event_t *started;
+	os_event_t *release;
+
+	assert_int_equal(os_event_init(&started, OS_EVENT_TYPE_AUTO), 0);
+	assert_int_equal(os_event_init(&release, OS_EVENT_TYPE_MANUAL), 0);
+
+	create_queue(&enc, policy);
+	enc.started = started;
+	enc.release = release;
+
+	/* one frame being encoded and a full queue */
+	assert_true(push(&enc, 0));
+	os_event_wait(started);
+	for (int64_t i = 1; i <= MAX_FRAMES; i++)
+		assert_true(push(&enc, i));
+
+	assert_true(push(&enc, MAX_FRAMES + 1) ==
+		    (policy == VIDEO_QUEUE_DROP_OLDEST));
+	assert_true(push(&enc, MAX_FRAMES + 2) ==
+		    (policy == VIDEO_QUEUE_DROP_OLDEST));
+
+	video_queue_get_stats(enc.queue, &stats);
+	assert_int_equal(stats.depth, MAX_FRAMES);
+	assert_int_equal(stats.max_depth, MAX_FRAMES);
+	assert_int_equal(stats.dropped_frames, 2);
+
+	os_event_signal(release);
+	assert_true(video_queue_stop(enc.queue));
+
+	assert_int_equal(enc.frames, MAX_FRAMES + 1);
+	for (size_t i = 0; i < enc.frames; i++)
+		assert_int_equal(enc.pts[i], expected[i]);
+
+	video_queue_get_stats(enc.queue, &stats);
+	assert_int_equal(stats.depth, 0);
+
+	video_queue_destroy(enc.queue);
+	os_event_destroy(started);
+	os_event_destroy(release);
+}
+
+static void drop_test(void **state)
+{
+	const int64_t newest[] = {0, 1, 2, 3, 4};
+	const int64_t oldest[] = {0, 3, 4, 5, 6};
+
+	drop(VIDEO_QUEUE_DROP_NEWEST, newest);
+	drop(VIDEO_QUEUE_DROP_OLDEST, oldest);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void bad_info_test(void **state)
+{
+	struct video_queue_info info = {
+		.format = VIDEO_FORMAT_I420,
+		.width = WIDTH,
+		.height = HEIGHT,
+		.callback = encode,
+	};
+
+	assert_null(video_queue_create(&info));
+	assert_null(video_queue_create(NULL));
+	assert_true(video_queue_stop(NULL));
+	video_queue_destroy(NULL);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(stop_test),
+		cmocka_unit_test(error_test),
+		cmocka_unit_test(drop_test),
+		cmocka_unit_test(bad_info_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
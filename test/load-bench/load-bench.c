@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/darray.h>
+
+/* Times obs_load_sources on a generated scene collection, once creating the
+ * sources serially and once in parallel, and checks that both loads end up
+ * with the same sources.
+ *
+ * usage: load-bench [inputs] [create milliseconds] [scenes] */
+
+static uint64_t create_ns = 20000000ULL;
+
+static const char *bench_input_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Load benchmark input";
+}
+
+/* busy waits rather than sleeping, like decoding an image or loading a font
+ * would */
+static void *bench_input_create(obs_data_t *settings, obs_source_t *source)
+{
+	uint64_t end = os_gettime_ns() + create_ns;
+	volatile uint32_t hash = 2166136261U;
+
+	while (os_gettime_ns() < end) {
+		for (uint32_t i = 0; i < 1000; i++)
+			hash = (hash ^ i) * 16777619U;
+	}
+
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void bench_input_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info bench_input = {
+	.id = "load_bench_input",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_PARALLEL_CREATE,
+	.get_name = bench_input_getname,
+	.create = bench_input_create,
+	.destroy = bench_input_destroy,
+};
+
+static const char *bench_filter_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Load benchmark filter";
+}
+
+static void *bench_filter_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static struct obs_source_info bench_filter = {
+	.id = "load_bench_filter",
+	.type = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name = bench_filter_getname,
+	.create = bench_filter_create,
+	.destroy = bench_input_destroy,
+};
+
+static obs_data_t *generate_source(const char *id, const char *name)
+{
+	obs_data_t *source_data = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+
+	obs_data_set_string(source_data, "id", id);
+	obs_data_set_string(source_data, "name", name);
+	obs_data_set_obj(source_data, "settings", settings);
+	obs_data_release(settings);
+	return source_data;
+}
+
+static void add_scene_item(obs_data_array_t *items, const char *name)
+{
+	obs_data_t *item = obs_data_create();
+	obs_data_set_string(item, "name", name);
+	obs_data_array_push_back(items, item);
+	obs_data_release(item);
+}
+
+static obs_data_array_t *generate_collection(int inputs, int scenes)
+{
+	obs_data_array_t *array = obs_data_array_create();
+	char name[64];
+
+	/* scenes are saved before the sources they contain, like the frontend
+	 * does, and the first scene nests all the others */
+	for (int i = 0; i < scenes; i++) {
+		obs_data_array_t *items = obs_data_array_create();
+		obs_data_t *scene;
+		obs_data_t *settings;
+
+		for (int j = i; j < inputs; j += scenes) {
+			snprintf(name, sizeof(name), "Input %d", j);
+			add_scene_item(items, name);
+		}
+		for (int j = 1; i == 0 && j < scenes; j++) {
+			snprintf(name, sizeof(name), "Scene %d", j);
+			add_scene_item(items, name);
+		}
+
+		snprintf(name, sizeof(name), "Scene %d", i);
+		scene = generate_source("scene", name);
+		settings = obs_data_get_obj(scene, "settings");
+		obs_data_set_array(settings, "items", items);
+		obs_data_array_push_back(array, scene);
+
+		obs_data_release(settings);
+		obs_data_release(scene);
+		obs_data_array_release(items);
+	}
+
+	for (int i = 0; i < inputs; i++) {
+		obs_data_array_t *filters = obs_data_array_create();
+		obs_data_t *input;
+
+		for (int j = 0; j < 2; j++) {
+			obs_data_t *filter;
+
+			snprintf(name, sizeof(name), "Filter %d", j);
+			filter = generate_source("load_bench_filter", name);
+			obs_data_array_push_back(filters, filter);
+			obs_data_release(filter);
+		}
+
+		snprintf(name, sizeof(name), "Input %d", i);
+		input = generate_source("load_bench_input", name);
+		obs_data_set_array(input, "filters", filters);
+		obs_data_array_push_back(array, input);
+
+		obs_data_release(input);
+		obs_data_array_release(filters);
+	}
+
+	return array;
+}
+
+static bool startup(void)
+{
+	struct obs_audio_info ai = {
+		.samples_per_sec = 48000,
+		.speakers = SPEAKERS_STEREO,
+	};
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return false;
+	if (!obs_reset_audio(&ai)) {
+		obs_shutdown();
+		return false;
+	}
+
+	obs_register_source(&bench_input);
+	obs_register_source(&bench_filter);
+	return true;
+}
+
+/* holds a reference to the loaded sources, like the frontend does */
+static void loaded_source(void *param, obs_source_t *source)
+{
+	struct darray *sources = param;
+
+	obs_source_addref(source);
+	darray_push_back(sizeof(obs_source_t *), sources, &source);
+}
+
+/* returns the loaded collection as json, or NULL on failure */
+static char *run_load(obs_data_array_t *collection, bool parallel,
+		      double *ms)
+{
+	DARRAY(obs_source_t *) sources;
+	obs_data_array_t *saved;
+	obs_data_t *wrapper;
+	uint64_t start;
+	char *json;
+
+	if (!startup())
+		return NULL;
+
+	obs_set_parallel_source_load(parallel);
+	da_init(sources);
+
+	start = os_gettime_ns();
+	obs_load_sources(collection, loaded_source, &sources.da);
+	*ms = (double)(os_gettime_ns() - start) / 1000000.0;
+
+	saved = obs_save_sources();
+	wrapper = obs_data_create();
+	obs_data_set_array(wrapper, "sources", saved);
+	json = bstrdup(obs_data_get_json(wrapper));
+
+	obs_data_release(wrapper);
+	obs_data_array_release(saved);
+
+	for (size_t i = 0; i < sources.num; i++)
+		obs_source_release(sources.array[i]);
+	da_free(sources);
+
+	obs_shutdown();
+	return json;
+}
+
+int main(int argc, char *argv[])
+{
+	int inputs = argc > 1 ? atoi(argv[1]) : 64;
+	int create_ms = argc > 2 ? atoi(argv[2]) : 20;
+	int scenes = argc > 3 ? atoi(argv[3]) : 8;
+	obs_data_array_t *collection;
+	char *serial_json;
+	char *parallel_json;
+	double serial_ms = 0.0;
+	double parallel_ms = 0.0;
+	int ret = 0;
+
+	if (inputs < 1 || create_ms < 0 || scenes < 1) {
+		fprintf(stderr, "usage: %s [inputs] [create milliseconds] "
+				"[scenes]\n",
+			argv[0]);
+		return 1;
+	}
+
+	create_ns = (uint64_t)create_ms * 1000000ULL;
+	collection = generate_collection(inputs, scenes);
+
+	serial_json = run_load(collection, false, &serial_ms);
+	parallel_json = run_load(collection, true, &parallel_ms);
+
+	if (!serial_json || !parallel_json) {
+		fprintf(stderr, "failed to initialize libobs\n");
+		ret = 1;
+	} else {
+		printf("%d inputs, %d scenes, %d ms per input\n", inputs,
+		       scenes, create_ms);
+		printf("serial:   %10.2f ms\n", serial_ms);
+		printf("parallel: %10.2f ms (%d logical cores)\n", parallel_ms,
+		       os_get_logical_cores());
+
+		if (strcmp(serial_json, parallel_json) != 0) {
+			fprintf(stderr, "loaded sources differ\n");
+			ret = 1;
+		}
+	}
+
+	bfree(serial_json);
+	bfree(parallel_json);
+	obs_data_array_release(collection);
+	return ret;
+}
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-resampler.h>
+
+/* Times the swresample and the native resampler on the conversions sources
+ * commonly go through, and compares the quality of both on a sine wave:
+ * the signal to noise ratio of each output against the ideal signal, and
+ * the level of the difference between the two outputs.
+ *
+ * usage: resampler-bench [seconds] */
+
+#define PI 3.14159265358979323846
+#define TONE_FREQ 997.0
+#define WARMUP_BLOCKS 10
+
+struct bench_path {
+	const char *name;
+	struct resample_info src;
+	struct resample_info dst;
+};
+
+static const struct bench_path paths[] = {
+	{"44.1k stereo -> 48k stereo",
+	 {44100, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"48k stereo -> 44.1k stereo",
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO},
+	 {44100, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"44.1k mono s16 -> 48k stereo",
+	 {44100, AUDIO_FORMAT_16BIT, SPEAKERS_MONO},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"48k 5.1 -> 48k stereo",
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_5POINT1},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"44.1k 5.1 -> 48k stereo",
+	 {44100, AUDIO_FORMAT_FLOAT, SPEAKERS_5POINT1},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"48k stereo -> 44.1k stereo packed",
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO},
+	 {44100, AUDIO_FORMAT_FLOAT, SPEAKERS_STEREO}},
+};
+
+#define NUM_PATHS (sizeof(paths) / sizeof(paths[0]))
+
+struct bench_result {
+	/* output channels back to back, all starting at the same time */
+	float *samples;
+	size_t frames;
+	double ns_per_block;
+};
+
+static double tone(uint64_t frame, uint32_t rate)
+{
+	return 0.5 * sin(2.0 * PI * TONE_FREQ * (double)frame / rate);
+}
+
+static void fill_input(uint8_t *buf, const struct resample_info *info,
+		       uint64_t first, uint32_t frames)
+{
+	const uint32_t channels = get_audio_channels(info->speakers);
+	const bool planar = is_audio_planar(info->format);
+
+	for (uint32_t i = 0; i < frames; i++) {
+		double v = tone(first + i, info->samples_per_sec);
+
+		for (uint32_t c = 0; c < channels; c++) {
+			size_t idx = planar ? c * frames + i : i * channels + c;
+
+			if (info->format == AUDIO_FORMAT_16BIT ||
+			    info->format == AUDIO_FORMAT_16BIT_PLANAR)
+				((int16_t *)buf)[idx] = (int16_t)(v * 32767.0);
+			else
+				((float *)buf)[idx] = (float)v;
+		}
+	}
+}
+
+static void store_output(struct bench_result *result,
+			 const struct resample_info *dst, uint8_t *output[],
+			 uint32_t frames, size_t total)
+{
+	const uint32_t channels = get_audio_channels(dst->speakers);
+	const bool planar = is_audio_planar(dst->format);
+
+	for (uint32_t c = 0; c < channels; c++) {
+		const float *in = (const float *)output[planar ? c : 0];
+		float *out = result->samples + c * total + result->frames;
+
+		for (uint32_t i = 0; i < frames && result->frames + i < total;
+		     i++)
+			out[i] = planar ? in[i] : in[i * channels + c];
+	}
+
+	result->frames += frames;
+	if (result->frames > total)
+		result->frames = total;
+}
+
+static bool run_path(struct bench_result *result,
+		     const struct bench_path *path, bool native, int seconds)
+{
+	const uint32_t in_frames = path->src.samples_per_sec / 100;
+	const uint32_t out_ch = get_audio_channels(path->dst.speakers);
+	const size_t total = (size_t)path->dst.samples_per_sec * seconds;
+	const uint32_t blocks = (uint32_t)seconds * 100;
+	const size_t in_size =
+		get_audio_channels(path->src.speakers) * in_frames * 4;
+	const size_t plane_size =
+		in_frames * get_audio_bytes_per_channel(path->src.format);
+	uint8_t *input_buf = bmalloc(in_size);
+	const uint8_t *input[MAX_AV_PLANES] = {0};
+	audio_resampler_t *rs;
+	uint64_t elapsed = 0;
+
+	memset(result, 0, sizeof(*result));
+	result->samples = bzalloc(total * out_ch * sizeof(float));
+
+	audio_resampler_set_type(native ? AUDIO_RESAMPLER_NATIVE
+					: AUDIO_RESAMPLER_SWRESAMPLE);
+	rs = audio_resampler_create(&path->dst, &path->src);
+	if (!rs) {
+		bfree(input_buf);
+		return false;
+	}
+
+	for (size_t c = 0; c < get_audio_planes(path->src.format,
+						path->src.speakers);
+	     c++)
+		input[c] = input_buf + c * plane_size;
+
+	for (uint32_t block = 0; block < blocks; block++) {
+		uint8_t *output[MAX_AV_PLANES] = {0};
+		uint64_t ts_offset;
+		uint32_t out_frames;
+		uint64_t start;
+
+		fill_input(input_buf, &path->src,
+			   (uint64_t)block * in_frames, in_frames);
+
+		start = os_gettime_ns();
+		audio_resampler_resample(rs, output, &out_frames, &ts_offset,
+					 input, in_frames);
+		if (block >= WARMUP_BLOCKS)
+			elapsed += os_gettime_ns() - start;
+
+		store_output(result, &path->dst, output, out_frames, total);
+	}
+
+	result->ns_per_block =
+		(double)elapsed / (double)(blocks - WARMUP_BLOCKS);
+
+	audio_resampler_destroy(rs);
+	bfree(input_buf);
+	return true;
+}
+
+/* Fits the ideal tone to a channel and returns the signal to noise ratio of
+ * what's left, skipping the start-up of the filters */
+static double channel_snr(const float *samples, size_t frames, uint32_t rate,
+			  size_t skip, double *gain)
+{
+	double dot = 0.0;
+	double ideal_sq = 0.0;
+	double error_sq = 0.0;
+
+	for (size_t i = skip; i < frames; i++) {
+		double ideal = tone(i, rate);
+		dot += samples[i] * ideal;
+		ideal_sq += ideal * ideal;
+	}
+
+	*gain = dot / ideal_sq;
+	if (fabs(*gain) < 1e-6)
+		return 0.0;
+
+	for (size_t i = skip; i < frames; i++) {
+		double err = samples[i] - *gain * tone(i, rate);
+		error_sq += err * err;
+	}
+
+	return 10.0 * log10(*gain * *gain * ideal_sq / error_sq);
+}
+
+static double difference_db(const float *a, const float *b, size_t frames,
+			    size_t skip)
+{
+	double signal = 0.0;
+	double diff = 0.0;
+
+	for (size_t i = skip; i < frames; i++) {
+		signal += (double)a[i] * a[i];
+		diff += ((double)a[i] - b[i]) * ((double)a[i] - b[i]);
+	}
+
+	if (signal == 0.0)
+		return 0.0;
+	return 10.0 * log10(diff / signal);
+}
+
+int main(int argc, char *argv[])
+{
+	int seconds = argc > 1 ? atoi(argv[1]) : 10;
+	int ret = 0;
+
+	if (seconds < 1) {
+		fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%-34s %10s %10s %8s %8s %8s\n", "", "swr us", "native us",
+	       "swr dB", "nat dB", "diff dB");
+
+	for (size_t p = 0; p < NUM_PATHS; p++) {
+		const struct bench_path *path = &paths[p];
+		const uint32_t rate = path->dst.samples_per_sec;
+		const uint32_t channels = get_audio_channels(path->dst.speakers);
+		const size_t skip = rate / 10;
+		struct bench_result swr, native;
+		double swr_snr = 1000.0;
+		double native_snr = 1000.0;
+		double diff = -1000.0;
+
+		if (!run_path(&swr, path, false, seconds) ||
+		    !run_path(&native, path, true, seconds)) {
+			fprintf(stderr, "%s: failed to create resampler\n",
+				path->name);
+			ret = 1;
+			continue;
+		}
+
+		for (uint32_t c = 0; c < channels; c++) {
+			const size_t total = (size_t)rate * seconds;
+			const float *a = swr.samples + c * total;
+			const float *b = native.samples + c * total;
+			size_t frames = swr.frames < native.frames
+						? swr.frames
+						: native.frames;
+			double swr_gain, native_gain, snr, d;
+
+			snr = channel_snr(a, frames, rate, skip, &swr_gain);
+			if (snr < swr_snr)
+				swr_snr = snr;
+			snr = channel_snr(b, frames, rate, skip, &native_gain);
+			if (snr < native_snr)
+				native_snr = snr;
+			d = difference_db(a, b, frames, skip);
+			if (d > diff)
+				diff = d;
+
+			/* both have to mix the channels the same way */
+			if (fabs(swr_gain - native_gain) > 0.001) {
+				fprintf(stderr,
+					"%s: channel %u gain %f, swresample "
+					"%f\n",
+					path->name, c, native_gain, swr_gain);
+				ret = 1;
+			}
+		}
+
+		printf("%-34s %10.2f %10.2f %8.1f %8.1f %8.1f\n", path->name,
+		       swr.ns_per_block / 1000.0, native.ns_per_block / 1000.0,
+		       swr_snr, native_snr, diff);
+
+		bfree(swr.samples);
+		bfree(native.samples);
+	}
+
+	printf("(time per 10 ms block of one source, worst channel)\n");
+	audio_resampler_set_type(AUDIO_RESAMPLER_SWRESAMPLE);
+	return ret;
+}